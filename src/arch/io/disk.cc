@@ -25,6 +25,7 @@
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
 #include "arch/io/disk/accounting.hpp"
+#include "arch/io/disk/uring.hpp"
 #include "backtrace.hpp"
 #include "config/args.hpp"
 #include "do_on_thread.hpp"
@@ -50,14 +51,40 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         io_backend_t backend_type,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
         accounter(batch_factor),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
         outstanding_txn(0)
     {
+        if (backend_type == io_backend_t::uring) {
+#if USE_IO_URING
+            int errsv = make_uring_diskmgr(queue, backend_stats.producer,
+                                           max_concurrent_io_requests, &uring_backend);
+            if (errsv != 0) {
+                logWRN("Could not set up io_uring (%s).  Falling back to the thread "
+                       "pool I/O backend.", errno_string(errsv).c_str());
+            }
+#else
+            logWRN("This build does not support io_uring.  Falling back to the "
+                   "thread pool I/O backend.");
+#endif
+        }
+#if USE_IO_URING
+        if (uring_backend.has()) {
+            uring_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                                &backend_stats, ph::_1);
+        } else
+#endif
+        {
+            pool_backend.init(new pool_diskmgr_t(queue, backend_stats.producer,
+                                                 max_concurrent_io_requests));
+            pool_backend->done_fun = std::bind(&stats_diskmgr_2_t::done,
+                                               &backend_stats, ph::_1);
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -66,8 +93,7 @@ public:
         conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
                                                  &accounter, ph::_1);
 
-        /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+        /* Hook up everything's `done_fun`. (The backend's was set up above.) */
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -81,6 +107,15 @@ public:
                 outstanding_txn);
     }
 
+    io_backend_t get_backend_type() const {
+#if USE_IO_URING
+        if (uring_backend.has()) {
+            return io_backend_t::uring;
+        }
+#endif
+        return io_backend_t::pool;
+    }
+
     void *create_account(int pri, int outstanding_requests_limit) {
         return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
     }
@@ -183,7 +218,8 @@ private:
     from the queue.
 
     At two points in the process--once as soon as it is submitted, and again right
-    as the backend pops it off the queue--its statistics are recorded. The "stack stats"
+    as the backend pops it off the queue--its statistics are recorded. The backend is
+    either a `pool_diskmgr_t` or, if requested and supported, a `uring_diskmgr_t`. The "stack stats"
     will tell you how many IO operations are queued. The "backend stats" will tell you
     how long the OS takes to perform the operations. Note that it's not perfect, because
     it counts operations that have been queued by the backend but not sent to the OS yet
@@ -193,7 +229,10 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+#if USE_IO_URING
+    scoped_ptr_t<uring_diskmgr_t> uring_backend;
+#endif
 
 
     intptr_t outstanding_txn;
@@ -202,17 +241,23 @@ private:
 };
 
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               io_backend_t backend_type)
     : direct_io_mode(_direct_io_mode),
       diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
                                        DEFAULT_IO_BATCH_FACTOR,
                                        max_concurrent_io_requests,
+                                       backend_type,
                                        &stats)) { }
 
 io_backender_t::~io_backender_t() { }
 
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
+io_backend_t io_backender_t::get_backend_type() const {
+    return diskmgr->get_backend_type();
+}
+
 
 /* Disk file object */
 
@@ -0,0 +1,400 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "arch/io/disk.hpp"
+#include "logger.hpp"
+
+// We don't want to depend on liburing, so we talk to the kernel directly.
+static int sys_io_uring_setup(unsigned int entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(fd_t ring_fd, unsigned int to_submit,
+                              unsigned int min_complete, unsigned int flags) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                   nullptr, 0);
+}
+
+static int sys_io_uring_register(fd_t ring_fd, unsigned int opcode, void *arg,
+                                 unsigned int nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+// The kernel refuses rings with more entries than this.
+const int MAX_URING_ENTRIES = 4096;
+
+struct uring_diskmgr_t::request_t {
+    enum stage_t { PRE_DATASYNC, READ_WRITE, POST_DATASYNC };
+
+    explicit request_t(action_t *_action)
+        : action(_action), stage(PRE_DATASYNC),
+          remaining_vecs(nullptr), remaining_vecs_len(0), bytes_done(0) {
+        // Resize actions have no buffers.
+        if (!action->get_is_resize()) {
+            action->copy_vectors(&vectors);
+            remaining_vecs = vectors.data();
+            remaining_vecs_len = vectors.size();
+        }
+    }
+
+    action_t *action;
+    stage_t stage;
+
+    // A copy of the action's io vectors.  We advance `remaining_vecs` through it as
+    // the kernel reports partial reads or writes.
+    scoped_array_t<iovec> vectors;
+    iovec *remaining_vecs;
+    size_t remaining_vecs_len;
+    int64_t bytes_done;
+
+    DISABLE_COPYING(request_t);
+};
+
+int make_uring_diskmgr(linux_event_queue_t *queue,
+                       passive_producer_t<uring_diskmgr_t::action_t *> *source,
+                       int max_concurrent_io_requests,
+                       scoped_ptr_t<uring_diskmgr_t> *out) {
+    scoped_ptr_t<uring_diskmgr_t> diskmgr(new uring_diskmgr_t(queue, source));
+    int errsv = diskmgr->init_ring(max_concurrent_io_requests);
+    if (errsv != 0) {
+        return errsv;
+    }
+    *out = std::move(diskmgr);
+    return 0;
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source)
+    : queue(_queue),
+      source(_source),
+      queue_depth(0),
+      n_pending(0),
+      n_unsubmitted(0),
+      n_in_flight(0),
+      ring_fd(INVALID_FD),
+      sq_ring_ptr(MAP_FAILED),
+      sq_ring_size(0),
+      cq_ring_ptr(MAP_FAILED),
+      cq_ring_size(0),
+      sqes(nullptr),
+      sqes_size(0),
+      watching_completion_event(false) { }
+
+int uring_diskmgr_t::init_ring(int max_concurrent_io_requests) {
+    guarantee(max_concurrent_io_requests > 0);
+    guarantee(max_concurrent_io_requests < MAXIMUM_MAX_CONCURRENT_IO_REQUESTS);
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = sys_io_uring_setup(
+        std::min(max_concurrent_io_requests, MAX_URING_ENTRIES), &params);
+    if (ring_fd == INVALID_FD) {
+        return get_errno();
+    }
+
+    // The kernel rounds the number of entries up to a power of two.  We don't use
+    // the extra entries, so that a request in flight can always be resubmitted.
+    queue_depth = std::min<int>(max_concurrent_io_requests, params.sq_entries);
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        return get_errno();
+    }
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr == MAP_FAILED) {
+            return get_errno();
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) {
+        return get_errno();
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+    char *sq = static_cast<char *>(sq_ring_ptr);
+    sq_head = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ring_ptr);
+    cq_head = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    int notify_fd = completion_event.get_notify_fd();
+    int res = sys_io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &notify_fd, 1);
+    if (res != 0) {
+        return get_errno();
+    }
+
+    queue->watch_event(&completion_event, this);
+    watching_completion_event = true;
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+    return 0;
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    if (watching_completion_event) {
+        rassert(n_pending == 0);
+        source->available->unset_callback();
+        queue->forget_event(&completion_event, this);
+    }
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring_ptr != MAP_FAILED && cq_ring_ptr != sq_ring_ptr) {
+        munmap(cq_ring_ptr, cq_ring_size);
+    }
+    if (sq_ring_ptr != MAP_FAILED) {
+        munmap(sq_ring_ptr, sq_ring_size);
+    }
+    if (ring_fd != INVALID_FD) {
+        int res = close(ring_fd);
+        guarantee_err(res == 0 || get_errno() == EINTR, "Could not close io_uring fd");
+    }
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap_completions();
+    pump();
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    while (source->available->get() && n_pending < queue_depth) {
+        action_t *a = source->pop();
+        n_pending++;
+        start_request(new request_t(a));
+    }
+    flush_submissions();
+}
+
+void uring_diskmgr_t::reap_completions() {
+    process_completions();
+    flush_submissions();
+}
+
+bool uring_diskmgr_t::process_completions() {
+    bool processed_any = false;
+    // The kernel may post more completions while we're processing these, so we
+    // keep going until the completion queue is empty.  We read `cq_head` again for
+    // every entry, because `handle_completion()` can get back here through
+    // `flush_submissions()`.
+    for (;;) {
+        const unsigned int head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        const io_uring_cqe *cqe = &cqes[head & cq_mask];
+        request_t *req = reinterpret_cast<request_t *>(cqe->user_data);
+        int32_t res = cqe->res;
+        // Hand the slot back to the kernel before we process the completion.
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        --n_in_flight;
+        processed_any = true;
+        handle_completion(req, res);
+    }
+    return processed_any;
+}
+
+void uring_diskmgr_t::start_request(request_t *req) {
+    if (req->action->wrap_in_datasyncs) {
+        req->stage = request_t::PRE_DATASYNC;
+        submit_datasync(req);
+    } else {
+        start_main_operation(req);
+    }
+}
+
+void uring_diskmgr_t::start_main_operation(request_t *req) {
+    req->stage = request_t::READ_WRITE;
+    if (req->action->get_is_resize()) {
+        int res;
+        do {
+            res = ftruncate(req->action->get_fd(), req->action->get_offset());
+        } while (res == -1 && get_errno() == EINTR);
+        if (res != 0) {
+            finish_request(req, -get_errno());
+        } else {
+            finish_main_operation(req);
+        }
+    } else if (req->remaining_vecs_len == 0) {
+        finish_main_operation(req);
+    } else {
+        submit_read_write(req);
+    }
+}
+
+void uring_diskmgr_t::finish_main_operation(request_t *req) {
+    if (req->action->wrap_in_datasyncs) {
+        req->stage = request_t::POST_DATASYNC;
+        submit_datasync(req);
+    } else {
+        finish_request(req, req->action->get_count());
+    }
+}
+
+void uring_diskmgr_t::finish_request(request_t *req, int64_t io_result) {
+    action_t *a = req->action;
+    delete req;
+    a->io_result = io_result;
+    n_pending--;
+    done_fun(a);
+}
+
+void uring_diskmgr_t::handle_completion(request_t *req, int32_t res) {
+    switch (req->stage) {
+    case request_t::PRE_DATASYNC:
+        if (res < 0) {
+            finish_request(req, res);
+        } else {
+            start_main_operation(req);
+        }
+        break;
+    case request_t::READ_WRITE: {
+        if (res == -EINTR || res == -EAGAIN) {
+            submit_read_write(req);
+            break;
+        } else if (res < 0) {
+            finish_request(req, res);
+            break;
+        } else if (res == 0) {
+            if (req->action->get_is_write()) {
+                // Same as in `pool_diskmgr_t`: a zero-length write means that we ran out
+                // of disk space, but the kernel doesn't tell us so.
+                logERR("Failed I/O: vectored write of %zu bytes stopped after "
+                       "%" PRIi64 " bytes. Assuming we ran out of disk space.",
+                       req->action->get_count(), req->bytes_done);
+                finish_request(req, -ENOSPC);
+            } else {
+                // We never read past the end of the file, so this shouldn't happen.
+                logERR("Failed I/O: vectored read of %zu bytes stopped after "
+                       "%" PRIi64 " bytes.",
+                       req->action->get_count(), req->bytes_done);
+                finish_request(req, -EIO);
+            }
+            break;
+        }
+        req->bytes_done += action_t::advance_vector(&req->remaining_vecs,
+                                                    &req->remaining_vecs_len,
+                                                    res);
+        if (req->remaining_vecs_len == 0) {
+            finish_main_operation(req);
+        } else {
+            submit_read_write(req);
+        }
+    } break;
+    case request_t::POST_DATASYNC:
+        if (res < 0) {
+            finish_request(req, res);
+        } else {
+            finish_request(req, req->action->get_count());
+        }
+        break;
+    default:
+        unreachable();
+    }
+}
+
+io_uring_sqe *uring_diskmgr_t::get_sqe(request_t *req) {
+    // `queue_depth` never exceeds the number of submission queue entries, and each
+    // request has at most one entry in the ring at a time, so there's always room.
+    unsigned int tail = *sq_tail;
+    rassert(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) <= sq_mask);
+    unsigned int index = tail & sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<uint64_t>(req);
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++n_unsubmitted;
+    return sqe;
+}
+
+void uring_diskmgr_t::submit_datasync(request_t *req) {
+    io_uring_sqe *sqe = get_sqe(req);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = req->action->get_fd();
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+}
+
+void uring_diskmgr_t::submit_read_write(request_t *req) {
+    io_uring_sqe *sqe = get_sqe(req);
+    sqe->opcode = req->action->get_is_read() ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = req->action->get_fd();
+    sqe->off = req->action->get_offset() + req->bytes_done;
+    sqe->addr = reinterpret_cast<uint64_t>(req->remaining_vecs);
+    sqe->len = std::min<size_t>(req->remaining_vecs_len, IOV_MAX);
+}
+
+void uring_diskmgr_t::flush_submissions() {
+    while (n_unsubmitted > 0) {
+        int res = sys_io_uring_enter(ring_fd, n_unsubmitted, 0, 0);
+        if (res == -1) {
+            const int err = get_errno();
+            if (err == EAGAIN || err == EBUSY) {
+                // The kernel is out of memory for new requests (`EAGAIN`), or the
+                // completion queue is full (`EBUSY`).  Both get better as requests
+                // complete, so we process the completions that are there, or wait
+                // for one if there aren't any, and try again.
+                if (!process_completions() && n_in_flight > 0) {
+                    wait_for_completion();
+                }
+            } else {
+                guarantee_xerr(err == EINTR, err, "io_uring_enter failed");
+            }
+            continue;
+        }
+        n_unsubmitted -= res;
+        n_in_flight += res;
+    }
+}
+
+void uring_diskmgr_t::wait_for_completion() {
+    int res;
+    do {
+        res = sys_io_uring_enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+    } while (res == -1 && get_errno() == EINTR);
+    guarantee_err(res != -1, "io_uring_enter failed while waiting for a completion");
+    process_completions();
+}
+
+#endif  // USE_IO_URING
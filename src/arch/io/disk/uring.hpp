@@ -0,0 +1,130 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <functional>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "containers/scoped.hpp"
+
+#if defined(__linux__) && !defined(NO_EVENTFD) && !defined(NO_IO_URING)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The uring disk manager submits I/O requests to the kernel through an io_uring
+instance, instead of running blocking syscalls on a `blocker_pool_t`.  Submission
+happens directly on the disk manager's event loop, and completions are reaped when
+the ring's registered eventfd fires in that same event loop.  This avoids the thread
+hop and context switches per request, and lets us keep as many requests in flight as
+the device can handle rather than as many as we have helper threads.
+
+It consumes the same `pool_diskmgr_t::action_t`s as the pool disk manager, so it
+plugs into the rest of the I/O stack unchanged.  Resize operations have no io_uring
+opcode on the kernels we support; they are performed inline on the event loop (the
+datasyncs wrapped around them still go through the ring). */
+
+class uring_diskmgr_t : private availability_callback_t,
+                        private linux_event_callback_t,
+                        public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_t::action_t action_t;
+
+    ~uring_diskmgr_t();
+
+    /* Like `pool_diskmgr_t`, calls `done_fun` on each action once it completed. */
+    std::function<void(action_t *)> done_fun;
+
+private:
+    friend int make_uring_diskmgr(linux_event_queue_t *, passive_producer_t<action_t *> *,
+                                  int, scoped_ptr_t<uring_diskmgr_t> *);
+
+    struct request_t;
+
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source);
+
+    // Sets up the ring.  Returns 0 on success or an errno value otherwise.
+    int init_ring(int max_concurrent_io_requests);
+
+    void on_source_availability_changed();
+    void on_event(int events);
+
+    void pump();
+    void reap_completions();
+    // Returns true if there were any completions to process.
+    bool process_completions();
+    // Blocks until the kernel completes a request, and processes the completions.
+    void wait_for_completion();
+
+    // The stages a request goes through.  See `handle_completion()`.
+    void start_request(request_t *req);
+    void start_main_operation(request_t *req);
+    void finish_main_operation(request_t *req);
+    void finish_request(request_t *req, int64_t io_result);
+    void handle_completion(request_t *req, int32_t res);
+
+    io_uring_sqe *get_sqe(request_t *req);
+    void submit_datasync(request_t *req);
+    void submit_read_write(request_t *req);
+    void flush_submissions();
+
+    linux_event_queue_t *const queue;
+    passive_producer_t<action_t *> *const source;
+
+    // The number of requests we keep in flight at most.  This is the number of entries
+    // in the submission queue, so we never run out of submission slots.
+    int queue_depth;
+    int n_pending;
+
+    // Submission queue entries that have been filled in but not yet passed to
+    // `io_uring_enter()`.
+    unsigned int n_unsubmitted;
+
+    // Submission queue entries that the kernel has taken but not completed yet.
+    unsigned int n_in_flight;
+
+    fd_t ring_fd;
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int sq_mask;
+    unsigned int *sq_array;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int cq_mask;
+    io_uring_cqe *cqes;
+
+    // The kernel signals this whenever it posts a completion.
+    system_event_t completion_event;
+    bool watching_completion_event;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+/* Creates a `uring_diskmgr_t` drawing its actions from `source`.  Returns 0 on
+success, or an errno value if io_uring is not supported by the running kernel (or
+not permitted), in which case `*out` is left uninitialized and the caller should fall
+back to `pool_diskmgr_t`. */
+int make_uring_diskmgr(linux_event_queue_t *queue,
+                       passive_producer_t<uring_diskmgr_t::action_t *> *source,
+                       int max_concurrent_io_requests,
+                       scoped_ptr_t<uring_diskmgr_t> *out);
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
@@ -0,0 +1,169 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <limits.h>
+
+#include <atomic>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+bool parse_cpu_list(const std::string &list, std::vector<int> *cpus_out) {
+    std::vector<int> cpus;
+    size_t i = 0;
+    // sysfs terminates the list with a newline.
+    const size_t end = list.find_last_not_of(" \n");
+    if (end == std::string::npos) {
+        *cpus_out = cpus;
+        return true;
+    }
+    while (i <= end) {
+        size_t range_end = list.find(',', i);
+        if (range_end == std::string::npos || range_end > end) {
+            range_end = end + 1;
+        }
+        const std::string range = list.substr(i, range_end - i);
+        const size_t dash = range.find('-');
+        uint64_t first, last;
+        if (dash == std::string::npos) {
+            if (!strtou64_strict(range, 10, &first)) {
+                return false;
+            }
+            last = first;
+        } else {
+            if (!strtou64_strict(range.substr(0, dash), 10, &first)
+                || !strtou64_strict(range.substr(dash + 1), 10, &last)
+                || last < first) {
+                return false;
+            }
+        }
+        if (last > static_cast<uint64_t>(INT_MAX)) {
+            return false;
+        }
+        for (uint64_t cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        i = range_end + 1;
+    }
+    *cpus_out = std::move(cpus);
+    return true;
+}
+
+#ifdef __linux__
+// Reads the "Node N MemTotal: X kB" line of a node's meminfo file.
+bool read_numa_node_memory(int node, uint64_t *bytes_out) {
+    std::string contents;
+    const std::string path
+        = strprintf("/sys/devices/system/node/node%d/meminfo", node);
+    if (!blocking_read_file(path.c_str(), &contents)) {
+        return false;
+    }
+    const std::string field = "MemTotal:";
+    size_t i = contents.find(field);
+    if (i == std::string::npos) {
+        return false;
+    }
+    i = contents.find_first_not_of(' ', i + field.size());
+    const size_t number_end = contents.find(' ', i);
+    if (i == std::string::npos || number_end == std::string::npos) {
+        return false;
+    }
+    uint64_t kilobytes;
+    if (!strtou64_strict(contents.substr(i, number_end - i), 10, &kilobytes)) {
+        return false;
+    }
+    *bytes_out = kilobytes * KILOBYTE;
+    return true;
+}
+
+bool read_numa_nodes(std::vector<numa_node_t> *nodes_out) {
+    std::string online;
+    std::vector<int> node_ids;
+    if (!blocking_read_file("/sys/devices/system/node/online", &online)
+        || !parse_cpu_list(online, &node_ids)
+        || node_ids.empty()) {
+        return false;
+    }
+    std::vector<numa_node_t> nodes;
+    for (int id : node_ids) {
+        std::string cpulist;
+        const std::string path
+            = strprintf("/sys/devices/system/node/node%d/cpulist", id);
+        numa_node_t node;
+        if (!blocking_read_file(path.c_str(), &cpulist)
+            || !parse_cpu_list(cpulist, &node.cpus)) {
+            return false;
+        }
+        // Nodes with memory but no CPUs are of no use to the thread pool.
+        if (node.cpus.empty()) {
+            continue;
+        }
+        if (!read_numa_node_memory(id, &node.memory_bytes)) {
+            node.memory_bytes = 0;
+        }
+        nodes.push_back(std::move(node));
+    }
+    if (nodes.empty()) {
+        return false;
+    }
+    *nodes_out = std::move(nodes);
+    return true;
+}
+#endif  // __linux__
+
+std::vector<numa_node_t> compute_numa_nodes() {
+    std::vector<numa_node_t> nodes;
+#ifdef __linux__
+    if (read_numa_nodes(&nodes)) {
+        return nodes;
+    }
+#endif
+    numa_node_t node;
+    for (int i = 0; i < get_cpu_count(); ++i) {
+        node.cpus.push_back(i);
+    }
+    node.memory_bytes = 0;
+    nodes.clear();
+    nodes.push_back(std::move(node));
+    return nodes;
+}
+
+const std::vector<numa_node_t> &get_numa_nodes() {
+    static const std::vector<numa_node_t> nodes = compute_numa_nodes();
+    return nodes;
+}
+
+size_t assign_numa_node(int thread, int num_db_threads,
+                        const std::vector<numa_node_t> &nodes) {
+    guarantee(!nodes.empty());
+    guarantee(thread >= 0 && thread < num_db_threads);
+    size_t total_cpus = 0;
+    for (const numa_node_t &node : nodes) {
+        total_cpus += node.cpus.size();
+    }
+    // The thread's position, scaled to the number of CPUs, determines the node.
+    size_t cpu = static_cast<size_t>(thread) * total_cpus / num_db_threads;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (cpu < nodes[i].cpus.size()) {
+            return i;
+        }
+        cpu -= nodes[i].cpus.size();
+    }
+    unreachable();
+}
+
+static std::atomic<bool> numa_pinning(false);
+
+void set_numa_pinning(bool enabled) {
+    numa_pinning.store(enabled);
+}
+
+bool get_numa_pinning() {
+    return numa_pinning.load();
+}
+
+size_t get_thread_numa_node(threadnum_t thread) {
+    return linux_thread_pool_t::get_thread_pool()->get_numa_node(thread.threadnum);
+}
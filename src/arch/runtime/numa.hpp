@@ -0,0 +1,43 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "threading.hpp"
+
+struct numa_node_t {
+    // The CPUs of the node, in ascending order.
+    std::vector<int> cpus;
+    // The total memory of the node, or 0 if we don't know it.
+    uint64_t memory_bytes;
+};
+
+/* Returns the NUMA nodes of the machine, which are read from sysfs on the first call.
+On systems without NUMA information (or without NUMA), this is a single node with all
+the CPUs. */
+const std::vector<numa_node_t> &get_numa_nodes();
+
+/* Parses a list of CPU ranges in the format of sysfs' `cpulist` files, such as
+"0-3,8-11".  Returns false if `list` is malformed. */
+MUST_USE bool parse_cpu_list(const std::string &list, std::vector<int> *cpus_out);
+
+/* Places DB thread `thread` (out of `num_db_threads`) on a node.  Every node gets a
+contiguous range of threads, in proportion to its number of CPUs. */
+size_t assign_numa_node(int thread, int num_db_threads,
+                        const std::vector<numa_node_t> &nodes);
+
+/* Whether thread pools that get started after the call pin their DB threads to NUMA
+nodes.  Off by default. */
+void set_numa_pinning(bool enabled);
+bool get_numa_pinning();
+
+/* Returns the NUMA node that the thread pool has pinned the given thread to.  The
+utility thread, threads that aren't pinned, and every thread on a single node
+machine are considered to be on node 0. */
+size_t get_thread_numa_node(threadnum_t thread);
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
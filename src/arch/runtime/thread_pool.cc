@@ -15,6 +15,7 @@
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/timing.hpp"
 #include "errors.hpp"
@@ -62,18 +63,29 @@ void linux_thread_pool_t::set_thread(linux_thread_t *val) {
     thread = val;
 }
 
+blocker_pool_t *linux_thread_pool_t::get_cpu_blocker_pool() {
+    rassert(get_thread_pool()->cpu_blocker_pool != nullptr,
+            "get_cpu_blocker_pool called while cpu_blocker_pool uninitialized");
+    return get_thread_pool()->cpu_blocker_pool;
+}
+
 linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity) :
 #ifndef NDEBUG
       coroutine_summary(false),
 #endif
       interrupt_message(nullptr),
       generic_blocker_pool(nullptr),
+      cpu_blocker_pool(nullptr),
       n_threads(worker_threads + 1),    // we create an extra utility thread
       do_set_affinity(_do_set_affinity)
 {
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        numa_nodes[i] = 0;
+    }
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, nullptr);
@@ -135,6 +147,7 @@ void *linux_thread_pool_t::start_thread(void *arg) {
         tdata->thread_pool->threads[tdata->current_thread] = &local_thread;
         set_thread(&local_thread);
         blocker_pool_t *generic_blocker_pool = nullptr; // Will only be instantiated by one thread
+        blocker_pool_t *cpu_blocker_pool = nullptr;
 
         /* Install a handler for segmentation faults that just prints a backtrace. If we're
         running under valgrind, we don't install this handler because Valgrind will print the
@@ -168,6 +181,8 @@ void *linux_thread_pool_t::start_thread(void *arg) {
             generic_blocker_pool = new blocker_pool_t(GENERIC_BLOCKER_THREAD_COUNT,
                                                       &local_thread.queue);
             tdata->thread_pool->generic_blocker_pool = generic_blocker_pool;
+            cpu_blocker_pool = new blocker_pool_t(get_cpu_count(), &local_thread.queue);
+            tdata->thread_pool->cpu_blocker_pool = cpu_blocker_pool;
         }
 
         // If one thread is allowed to run before another one has finished
@@ -194,6 +209,10 @@ void *linux_thread_pool_t::start_thread(void *arg) {
             delete generic_blocker_pool;
             tdata->thread_pool->generic_blocker_pool = nullptr;
         }
+        if (cpu_blocker_pool != nullptr) {
+            delete cpu_blocker_pool;
+            tdata->thread_pool->cpu_blocker_pool = nullptr;
+        }
 
         tdata->thread_pool->threads[tdata->current_thread] = nullptr;
         set_thread(nullptr);
@@ -238,6 +257,31 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
             CPU_SET(i % ncpus, &mask);
             res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
             guarantee_xerr(res == 0, res, "Could not set thread affinity");
+#endif
+        } else if (!is_utility_thread && get_numa_pinning()
+                   && get_numa_nodes().size() > 1) {
+#ifdef _GNU_SOURCE
+            // Keep each thread on the CPUs of a single NUMA node, so that the memory
+            // it allocates and first touches (such as the buffer cache pages of the
+            // stores homed on it) stays local to it.
+            const size_t node_index = assign_numa_node(i, n_threads - 1, get_numa_nodes());
+            const numa_node_t &node = get_numa_nodes()[node_index];
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            for (int cpu : node.cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &mask);
+                }
+            }
+            res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
+            if (res == 0) {
+                numa_nodes[i] = node_index;
+            } else {
+                // This happens if we're restricted to a subset of the CPUs, e.g.
+                // by a cpuset.  We can run fine without the pinning.
+                logWRN("Could not pin thread %d to its NUMA node: %s", i,
+                       errno_string(res).c_str());
+            }
 #endif
         }
     }
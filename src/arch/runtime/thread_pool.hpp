@@ -92,6 +92,13 @@ private:
     static const int GENERIC_BLOCKER_THREAD_COUNT = 2;
     blocker_pool_t* generic_blocker_pool;
 
+    // Has one thread per CPU, for CPU-bound work that is split up to use the whole
+    // machine, such as replaying the LBA when a serializer file is opened
+    blocker_pool_t* cpu_blocker_pool;
+
+    // Only set for the threads that we managed to pin to a NUMA node; 0 otherwise
+    size_t numa_nodes[MAX_THREADS];
+
 public:
     pthread_t pthreads[MAX_THREADS];
     linux_thread_t *threads[MAX_THREADS];
@@ -100,9 +107,19 @@ public:
     template <class Callable>
     static void run_in_blocker_pool(const Callable &);
 
+    // The process-wide pool for CPU-bound jobs. `done()` is called on the thread that
+    // created the pool, which is not necessarily the thread that submitted the job.
+    static blocker_pool_t *get_cpu_blocker_pool();
+
     int n_threads;
     bool do_set_affinity;
 
+    // The NUMA node that the thread has been pinned to, see `get_thread_numa_node()`
+    size_t get_numa_node(int thread) const {
+        rassert(thread >= 0 && thread < n_threads);
+        return numa_nodes[thread];
+    }
+
 #ifdef _WIN32
     static linux_thread_pool_t *get_global_thread_pool();
 #endif
@@ -105,6 +105,15 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which mechanism the disk manager uses to hand I/O requests to the kernel.
+enum class io_backend_t {
+    // Blocking syscalls run on a pool of helper threads.  Available everywhere.
+    pool,
+    // Asynchronous requests submitted through an io_uring instance owned by the disk
+    // manager's event loop.  Falls back to `pool` where io_uring is unavailable.
+    uring
+};
+
 // A linux file.  It expects reads and writes and buffers to have an
 // alignment of DEVICE_BLOCK_SIZE.
 class file_t {
@@ -0,0 +1,273 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+
+btree_bulk_loader_t::btree_bulk_loader_t(
+        value_sizer_t *sizer, superblock_t *superblock)
+    : sizer_(sizer), superblock_(superblock), has_last_key_(false),
+      leaf_compacted_(false), max_tstamp_(repli_timestamp_t::distant_past),
+      num_appended_(0) {
+    // Walk down the right-most path.  We collect it root first and reverse it below.
+    std::vector<level_t> path;
+    path.push_back(level_t(get_root(sizer_, superblock_)));
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&path.back().node);
+            auto node = static_cast<const node_t *>(read.get_data_read());
+            if (!node::is_internal(node)) {
+                auto leaf = reinterpret_cast<const leaf_node_t *>(node);
+                if (leaf::greatest_key(leaf, &last_key_)) {
+                    has_last_key_ = true;
+                }
+                break;
+            }
+            auto internal = reinterpret_cast<const internal_node_t *>(node);
+            if (internal->npairs >= 2) {
+                // Every key in the right-most child is greater than this one.
+                last_key_.assign(
+                    &internal_node::get_pair_by_index(internal,
+                                                      internal->npairs - 2)->key);
+                has_last_key_ = true;
+            }
+            child_id = internal_node::get_pair_by_index(internal,
+                                                        internal->npairs - 1)->lnode;
+        }
+        buf_lock_t child(&path.back().node, child_id, access_t::write);
+        path.push_back(level_t(std::move(child)));
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        levels_.push_back(std::move(*it));
+    }
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    if (!levels_.empty()) {
+        finish();
+    }
+}
+
+bool btree_bulk_loader_t::can_append(const btree_key_t *key) const {
+    return !has_last_key_ || btree_key_cmp(key, last_key_.btree_key()) > 0;
+}
+
+bool btree_bulk_loader_t::can_append_to(
+        superblock_t *superblock, const btree_key_t *key) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return true;
+    }
+    // This follows the same path as the constructor, and compares `key` to the same
+    // keys that it would pick `last_key_` from.
+    buf_lock_t node(superblock->expose_buf(), root_id, access_t::read);
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&node);
+            auto n = static_cast<const node_t *>(read.get_data_read());
+            if (!node::is_internal(n)) {
+                store_key_t greatest;
+                return !leaf::greatest_key(reinterpret_cast<const leaf_node_t *>(n),
+                                           &greatest)
+                    || btree_key_cmp(key, greatest.btree_key()) > 0;
+            }
+            auto internal = reinterpret_cast<const internal_node_t *>(n);
+            if (internal->npairs >= 2
+                && btree_key_cmp(key, &internal_node::get_pair_by_index(
+                        internal, internal->npairs - 2)->key) <= 0) {
+                return false;
+            }
+            child_id = internal_node::get_pair_by_index(internal,
+                                                        internal->npairs - 1)->lnode;
+        }
+        buf_lock_t child(&node, child_id, access_t::read);
+        node = std::move(child);
+    }
+}
+
+buf_parent_t btree_bulk_loader_t::prepare_append(const btree_key_t *key) {
+    guarantee(!levels_.empty());
+    guarantee(can_append(key));
+    buf_lock_t *leaf = &levels_[0].node;
+    bool full;
+    {
+        buf_read_t read(leaf);
+        full = leaf::is_full_for_value_size(
+            sizer_, static_cast<const leaf_node_t *>(read.get_data_read()), key,
+            sizer_->max_possible_size());
+    }
+    if (full && !leaf_compacted_) {
+        // A leaf that gets filled in key order never needs to make room by itself,
+        // so we give it the chance to pick a key prefix before we give up on it.
+        buf_write_t write(leaf);
+        auto node = static_cast<leaf_node_t *>(write.get_data_write());
+        leaf::compact(sizer_, node, key);
+        leaf_compacted_ = true;
+        full = leaf::is_full_for_value_size(
+            sizer_, node, key, sizer_->max_possible_size());
+    }
+    if (full) {
+        buf_lock_t new_leaf(superblock_->expose_buf(), alt_create_t::create);
+        {
+            buf_write_t write(&new_leaf);
+            leaf::init(sizer_, static_cast<leaf_node_t *>(write.get_data_write()));
+        }
+        rassert(has_last_key_);
+        add_node(0, std::move(new_leaf), last_key_);
+        leaf_compacted_ = false;
+    }
+    return buf_parent_t(&levels_[0].node);
+}
+
+void btree_bulk_loader_t::append(
+        const btree_key_t *key, const void *value, repli_timestamp_t tstamp) {
+    guarantee(can_append(key));
+    buf_lock_t *leaf = &levels_[0].node;
+    const repli_timestamp_t previous_leaf_recency = leaf->get_recency();
+    leaf->set_recency(superceding_recency(tstamp, previous_leaf_recency));
+    {
+        buf_write_t write(leaf);
+        auto node = static_cast<leaf_node_t *>(write.get_data_write());
+        rassert(!leaf::is_full(sizer_, node, key, value));
+        leaf::insert(sizer_, node, key, value, tstamp, previous_leaf_recency,
+                     key_modification_proof_t::real_proof());
+    }
+    max_tstamp_ = superceding_recency(max_tstamp_, tstamp);
+    last_key_.assign(key);
+    has_last_key_ = true;
+    ++num_appended_;
+}
+
+void btree_bulk_loader_t::add_node(
+        size_t level, buf_lock_t &&node, const store_key_t &left_key) {
+    guarantee(level < levels_.size());
+    level_t *current = &levels_[level];
+
+    if (level + 1 == levels_.size()) {
+        // `current->node` is the root, so the two nodes get a new root above them.
+        rassert(!current->pending);
+        superblock_->expose_buf().detach_child(current->node.block_id());
+        buf_lock_t root(superblock_->expose_buf(), alt_create_t::create);
+        {
+            buf_write_t write(&root);
+            auto root_node = static_cast<internal_node_t *>(write.get_data_write());
+            internal_node::init(sizer_->block_size(), root_node);
+            internal_node::insert(root_node, left_key.btree_key(),
+                                  current->node.block_id(), node.block_id());
+        }
+        root.set_recency(superceding_recency(current->node.get_recency(),
+                                             max_tstamp_));
+        insert_root(root.block_id(), superblock_);
+        update_recency(&current->node);
+        current->node = std::move(node);
+        levels_.push_back(level_t(std::move(root)));
+        return;
+    }
+
+    buf_lock_t *parent = &levels_[level + 1].node;
+    if (!current->pending) {
+        bool parent_full;
+        {
+            buf_read_t read(parent);
+            parent_full = internal_node::is_full(
+                static_cast<const internal_node_t *>(read.get_data_read()));
+        }
+        if (!parent_full) {
+            // This turns the old right-most child into a regular one, and makes
+            // `node` the right-most child.
+            buf_write_t write(parent);
+            internal_node::insert(
+                static_cast<internal_node_t *>(write.get_data_write()),
+                left_key.btree_key(), current->node.block_id(), node.block_id());
+        } else {
+            // We don't want to create a parent with only one child, so `node` waits
+            // for its right sibling before it gets a parent.
+            current->pending = true;
+            current->pending_left_key = left_key;
+        }
+        update_recency(&current->node);
+        current->node = std::move(node);
+        return;
+    }
+
+    // `current->node` has no parent yet, so it gets a new one together with `node`.
+    buf_lock_t new_parent(superblock_->expose_buf(), alt_create_t::create);
+    {
+        buf_write_t write(&new_parent);
+        auto parent_node = static_cast<internal_node_t *>(write.get_data_write());
+        internal_node::init(sizer_->block_size(), parent_node);
+        internal_node::insert(parent_node, left_key.btree_key(),
+                              current->node.block_id(), node.block_id());
+    }
+    new_parent.set_recency(superceding_recency(current->node.get_recency(),
+                                               max_tstamp_));
+    update_recency(&current->node);
+    current->node = std::move(node);
+    current->pending = false;
+    // The new parent goes to the right of the full one.  `current` might not be
+    // valid anymore after this.
+    const store_key_t parent_left_key = current->pending_left_key;
+    add_node(level + 1, std::move(new_parent), parent_left_key);
+}
+
+void btree_bulk_loader_t::update_recency(buf_lock_t *node) {
+    node->set_recency(superceding_recency(node->get_recency(), max_tstamp_));
+}
+
+void btree_bulk_loader_t::finish() {
+    guarantee(!levels_.empty());
+    // A pending node can only be left over if a full node ended up being the last
+    // one on its level.  We link it in by splitting that node like a regular
+    // insertion would.
+    for (size_t level = 0; level + 1 < levels_.size(); ++level) {
+        level_t *current = &levels_[level];
+        if (!current->pending) {
+            continue;
+        }
+        buf_lock_t *parent = &levels_[level + 1].node;
+        buf_lock_t rparent(superblock_->expose_buf(), alt_create_t::create);
+        store_key_t median;
+        {
+            buf_write_t write(parent);
+            buf_write_t rwrite(&rparent);
+            auto rnode = static_cast<internal_node_t *>(rwrite.get_data_write());
+            internal_node::split(
+                sizer_->block_size(),
+                static_cast<internal_node_t *>(write.get_data_write()),
+                rnode, median.btree_key());
+            // We must detach the children that we have moved to `rparent`.
+            for (int i = 0; i < rnode->npairs; ++i) {
+                parent->detach_child(internal_node::get_pair_by_index(rnode, i)->lnode);
+            }
+            const block_id_t left_sibling
+                = internal_node::get_pair_by_index(rnode, rnode->npairs - 1)->lnode;
+            internal_node::insert(rnode, current->pending_left_key.btree_key(),
+                                  left_sibling, current->node.block_id());
+        }
+        rparent.set_recency(superceding_recency(parent->get_recency(), max_tstamp_));
+        current->pending = false;
+        add_node(level + 1, std::move(rparent), median);
+    }
+
+    for (level_t &level : levels_) {
+        update_recency(&level.node);
+    }
+
+    if (num_appended_ != 0) {
+        const block_id_t stat_block_id = superblock_->get_stat_block_id();
+        if (stat_block_id != NULL_BLOCK_ID) {
+            buf_lock_t stat_block(buf_parent_t(levels_[0].node.txn()),
+                                  stat_block_id, access_t::write);
+            buf_write_t write(&stat_block);
+            auto stats = static_cast<btree_statblock_t *>(
+                write.get_data_write(BTREE_STATBLOCK_SIZE));
+            stats->population += num_appended_;
+        }
+    }
+
+    levels_.clear();
+}
@@ -0,0 +1,94 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/alt.hpp"
+#include "repli_timestamp.hpp"
+
+class superblock_t;
+class value_sizer_t;
+
+/* `btree_bulk_loader_t` appends key/value pairs in ascending key order to the right
+edge of a B-tree, which is what loading sorted data into an empty B-tree (or into the
+key range past its last key) comes down to.
+
+Inserting such pairs one by one splits every leaf in half when it fills up, and then
+never touches the left half again, so the B-tree ends up with half-full leaves. The
+bulk loader instead fills every leaf completely before it starts the next one, and it
+builds the internal nodes bottom-up from the finished nodes below them, so it never
+has to split anything. New nodes only become reachable once they're linked into the
+right-most path of the B-tree, which the bulk loader keeps acquired for write from
+construction to `finish()`, and a new root is swapped into the superblock in one go.
+
+All of this happens in the transaction of `superblock`. Callers that load a lot of
+data should use one bulk loader per transaction; every bulk loader picks up at the
+right edge that the previous one left behind. */
+class btree_bulk_loader_t {
+public:
+    // `superblock` must be acquired for write, and must stay acquired until
+    // `finish()`.
+    btree_bulk_loader_t(value_sizer_t *sizer, superblock_t *superblock);
+    ~btree_bulk_loader_t();
+
+    // Returns true if `key` is greater than every key in the B-tree (including
+    // deleted ones) and every key that was appended so far.
+    bool can_append(const btree_key_t *key) const;
+
+    // Returns true if a bulk loader constructed on `superblock` could append `key`.
+    // This only acquires the right-most path for read, one node at a time, so it's
+    // a cheap way to find out whether constructing a bulk loader is worth it.
+    static bool can_append_to(superblock_t *superblock, const btree_key_t *key);
+
+    // Makes room for appending `key` with a value of up to
+    // `sizer->max_possible_size()` bytes, starting a new leaf if necessary, and
+    // returns the leaf that the value will go to, so that the caller can put the
+    // value's blob under it.
+    buf_parent_t prepare_append(const btree_key_t *key);
+
+    // Must be preceded by `prepare_append(key)`.
+    void append(const btree_key_t *key, const void *value, repli_timestamp_t tstamp);
+
+    // Updates the recencies of the right-most path and the B-tree's population, and
+    // releases the nodes.  Called by the destructor if necessary.
+    void finish();
+
+private:
+    struct level_t {
+        explicit level_t(buf_lock_t &&_node) : node(std::move(_node)), pending(false) { }
+        // The right-most node on this level.
+        buf_lock_t node;
+        // True if `node` isn't linked into its parent yet, because that was full.
+        bool pending;
+        // If `pending` is set, the greatest key in the subtree of the node to the
+        // left of `node`, which is the parent's right-most child.
+        store_key_t pending_left_key;
+    };
+
+    // Makes `node` the new right-most node on level `level`, to the right of the
+    // current one, whose subtree ends with `left_key`.
+    void add_node(size_t level, buf_lock_t &&node, const store_key_t &left_key);
+
+    void update_recency(buf_lock_t *node);
+
+    value_sizer_t *const sizer_;
+    superblock_t *const superblock_;
+
+    // From the leaf up to the root.
+    std::vector<level_t> levels_;
+
+    // The greatest key in the B-tree, if there is one.
+    bool has_last_key_;
+    store_key_t last_key_;
+    // Whether we've already compacted the current leaf (see `leaf::compact()`).
+    bool leaf_compacted_;
+
+    repli_timestamp_t max_tstamp_;
+    int64_t num_appended_;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
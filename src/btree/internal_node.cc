@@ -291,6 +291,16 @@ bool is_full(const internal_node_t *node) {
     return sizeof(internal_node_t) + (node->npairs + 1) * sizeof(*node->pair_offsets) + impl::pair_size_with_key_size(MAX_KEY_SIZE) >=  node->frontmost_offset;
 }
 
+int spare_capacity(const internal_node_t *node) {
+    const int pair_cost = sizeof(*node->pair_offsets)
+        + impl::pair_size_with_key_size(MAX_KEY_SIZE);
+    const int room = static_cast<int>(node->frontmost_offset)
+        - static_cast<int>(sizeof(internal_node_t)
+                           + (node->npairs + 1) * sizeof(*node->pair_offsets)
+                           + impl::pair_size_with_key_size(MAX_KEY_SIZE));
+    return room > 0 ? (room - 1) / pair_cost + 1 : 0;
+}
+
 bool change_unsafe(const internal_node_t *node) {
     return sizeof(internal_node_t) + node->npairs * sizeof(*node->pair_offsets) + MAX_KEY_SIZE >= node->frontmost_offset;
 }
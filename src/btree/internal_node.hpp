@@ -43,6 +43,9 @@ int sibling(const internal_node_t *node, const btree_key_t *key, block_id_t *sib
 void update_key(internal_node_t *node, const btree_key_t *key_to_replace, const btree_key_t *replacement_key);
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2);
 bool is_full(const internal_node_t *node);
+// How many keys can be inserted into the node (or replaced by longer keys) one
+// after the other, with is_full() returning false before each of them.
+int spare_capacity(const internal_node_t *node);
 bool is_underfull(block_size_t block_size, const internal_node_t *node);
 bool change_unsafe(const internal_node_t *node);
 bool is_mergable(block_size_t block_size, const internal_node_t *node, const internal_node_t *sibling, const internal_node_t *parent);
@@ -51,6 +51,11 @@ const int SKIP_ENTRY_CODE_MANY = 252;
 // A reserved meaningless value.
 const int SKIP_ENTRY_RESERVED = 251;
 
+// In prefix-compressed nodes, means that the key that follows is stored in full
+// because it doesn't start with the node's key prefix.  Since the prefix is at least
+// one byte long, the rest of a key after the prefix is always shorter than this.
+const int ESCAPED_KEY_CODE = MAX_KEY_SIZE;
+
 
 
 
@@ -82,11 +87,98 @@ const int SKIP_ENTRY_RESERVED = 251;
 // itself three bytes, so it can't fit in a slot of size one or two. We don't
 // expect to actually see many entries of size one or two, but it pays to be
 // thorough.
+//
+// A prefix-compressed node (see `PREFIXED_LEAF_MAGIC_BIT`) has the key prefix right
+// after the header, stored like a btree key and padded to an even size:
+//
+// [magic][num_pairs][live_size][frontmost][tstamp_cutpoint][prefix][off0][off1]...
+//
+// and the "[btree key]" of its entries only holds the part of the key that follows
+// the prefix.  Keys that don't start with the prefix (because they were inserted
+// after the prefix was chosen) are stored in full, as "[250][btree key]".
 
 
 struct entry_t;
 struct value_t;
 
+bool is_prefixed(const leaf_node_t *node) {
+    return (node->magic.bytes[3] & PREFIXED_LEAF_MAGIC_BIT) != 0;
+}
+
+bool has_leaf_magic(value_sizer_t *sizer, const leaf_node_t *node) {
+    block_magic_t magic = node->magic;
+    magic.bytes[3] &= ~PREFIXED_LEAF_MAGIC_BIT;
+    return magic == sizer->btree_leaf_magic();
+}
+
+// Returns the node's key prefix, which is empty for nodes that aren't
+// prefix-compressed.
+const btree_key_t *prefix_of(const leaf_node_t *node) {
+    static const uint8_t empty_key = 0;
+    if (is_prefixed(node)) {
+        return reinterpret_cast<const btree_key_t *>(
+            reinterpret_cast<const char *>(node) + sizeof(leaf_node_t));
+    } else {
+        return reinterpret_cast<const btree_key_t *>(&empty_key);
+    }
+}
+
+int prefix_size(const leaf_node_t *node) {
+    return prefix_of(node)->size;
+}
+
+store_key_t key_prefix(const leaf_node_t *node) {
+    return store_key_t(prefix_of(node));
+}
+
+// The space taken up by a key prefix of the given size.  We round it up to an even
+// number of bytes to keep the pair offsets aligned.
+int prefix_region_size(int size) {
+    return size == 0 ? 0 : (offsetof(btree_key_t, contents) + size + 1) & ~1;
+}
+
+int pair_offsets_offset(const leaf_node_t *node) {
+    return sizeof(leaf_node_t) + prefix_region_size(prefix_size(node));
+}
+
+uint16_t *pair_offsets(leaf_node_t *node) {
+    return reinterpret_cast<uint16_t *>(
+        reinterpret_cast<char *>(node) + pair_offsets_offset(node));
+}
+
+const uint16_t *pair_offsets(const leaf_node_t *node) {
+    return reinterpret_cast<const uint16_t *>(
+        reinterpret_cast<const char *>(node) + pair_offsets_offset(node));
+}
+
+// Makes `node` use the key prefix `prefix`, without re-encoding its entries or moving
+// its pair offsets.
+void set_prefix(leaf_node_t *node, const btree_key_t *prefix) {
+    if (prefix->size == 0) {
+        node->magic.bytes[3] &= ~PREFIXED_LEAF_MAGIC_BIT;
+    } else {
+        node->magic.bytes[3] |= PREFIXED_LEAF_MAGIC_BIT;
+        keycpy(reinterpret_cast<btree_key_t *>(
+                   reinterpret_cast<char *>(node) + sizeof(leaf_node_t)),
+               prefix);
+    }
+}
+
+bool key_has_prefix(const btree_key_t *key, const btree_key_t *prefix) {
+    return key->size >= prefix->size
+        && memcmp(key->contents, prefix->contents, prefix->size) == 0;
+}
+
+// Sets `*prefix_out` to the longest common prefix of `a` and `b`.
+void common_prefix(const btree_key_t *a, const btree_key_t *b, store_key_t *prefix_out) {
+    int size = 0;
+    int max_size = std::min(a->size, b->size);
+    while (size < max_size && a->contents[size] == b->contents[size]) {
+        ++size;
+    }
+    prefix_out->assign(size, a->contents);
+}
+
 bool entry_is_deletion(const entry_t *p) {
     uint8_t x = *reinterpret_cast<const uint8_t *>(p);
     rassert(x != SKIP_ENTRY_RESERVED);
@@ -104,27 +196,62 @@ bool entry_is_skip(const entry_t *p) {
     return !entry_is_deletion(p) && !entry_is_live(p);
 }
 
-const btree_key_t *entry_key(const entry_t *p) {
-    if (entry_is_deletion(p)) {
-        return reinterpret_cast<const btree_key_t *>(1 + reinterpret_cast<const char *>(p));
-    } else {
-        return reinterpret_cast<const btree_key_t *>(p);
+const uint8_t *entry_key_start(const entry_t *p) {
+    const uint8_t *start = reinterpret_cast<const uint8_t *>(p);
+    return entry_is_deletion(p) ? start + 1 : start;
+}
+
+bool entry_key_is_escaped(const leaf_node_t *node, const entry_t *p) {
+    return *entry_key_start(p) == ESCAPED_KEY_CODE && is_prefixed(node);
+}
+
+// Returns the key as it's stored in the entry, which is the full key if the node
+// isn't prefix-compressed or the key is escaped, and the rest of the key after the
+// node's prefix otherwise.
+const btree_key_t *stored_key(const leaf_node_t *node, const entry_t *p) {
+    const uint8_t *start = entry_key_start(p);
+    if (*start == ESCAPED_KEY_CODE && is_prefixed(node)) {
+        ++start;
     }
+    return reinterpret_cast<const btree_key_t *>(start);
+}
+
+bool stored_key_is_full(const leaf_node_t *node, const entry_t *p) {
+    return !is_prefixed(node) || entry_key_is_escaped(node, p);
+}
+
+int stored_key_size(const leaf_node_t *node, const entry_t *p) {
+    return (entry_key_is_escaped(node, p) ? 1 : 0) + stored_key(node, p)->full_size();
+}
+
+// Returns the full key of the entry, which either points into the node or to
+// `buffer`.
+const btree_key_t *entry_key(const leaf_node_t *node, const entry_t *p,
+                             store_key_t *buffer) {
+    const btree_key_t *key = stored_key(node, p);
+    if (stored_key_is_full(node, p)) {
+        return key;
+    }
+    const btree_key_t *prefix = prefix_of(node);
+    buffer->set_size(prefix->size + key->size);
+    memcpy(buffer->contents(), prefix->contents, prefix->size);
+    memcpy(buffer->contents() + prefix->size, key->contents, key->size);
+    return buffer->btree_key();
 }
 
-const void *entry_value(const entry_t *p) {
+const void *entry_value(const leaf_node_t *node, const entry_t *p) {
     if (entry_is_deletion(p)) {
         return nullptr;
     } else {
-        return reinterpret_cast<const char *>(p) + entry_key(p)->full_size();
+        return reinterpret_cast<const char *>(p) + stored_key_size(node, p);
     }
 }
 
-int entry_size(value_sizer_t *sizer, const entry_t *p) {
+int entry_size(value_sizer_t *sizer, const leaf_node_t *node, const entry_t *p) {
     uint8_t code = *reinterpret_cast<const uint8_t *>(p);
     switch (code) {
     case DELETE_ENTRY_CODE:
-        return 1 + entry_key(p)->full_size();
+        return 1 + stored_key_size(node, p);
     case SKIP_ENTRY_CODE_ONE:
         return 1;
     case SKIP_ENTRY_CODE_TWO:
@@ -133,10 +260,119 @@ int entry_size(value_sizer_t *sizer, const entry_t *p) {
         return 3 + *reinterpret_cast<const uint16_t *>(1 + reinterpret_cast<const char *>(p));
     default:
         rassert(code <= MAX_KEY_SIZE);
-        return entry_key(p)->full_size() + sizer->size(entry_value(p));
+        return stored_key_size(node, p) + sizer->size(entry_value(node, p));
+    }
+}
+
+// The size that `key` takes up in an entry of a node with the key prefix `prefix`.
+int encoded_key_size(const btree_key_t *prefix, const btree_key_t *key) {
+    if (prefix->size == 0) {
+        return key->full_size();
+    } else if (key_has_prefix(key, prefix)) {
+        return key->full_size() - prefix->size;
+    } else {
+        return 1 + key->full_size();
+    }
+}
+
+// Writes `key` as it's stored in an entry of a node with the key prefix `prefix`.
+// Returns the end of what it wrote.
+char *encode_key(const btree_key_t *prefix, const btree_key_t *key, char *dest) {
+    if (prefix->size == 0) {
+        memcpy(dest, key, key->full_size());
+        return dest + key->full_size();
+    } else if (key_has_prefix(key, prefix)) {
+        uint8_t suffix_size = key->size - prefix->size;
+        *reinterpret_cast<uint8_t *>(dest) = suffix_size;
+        memcpy(dest + 1, key->contents + prefix->size, suffix_size);
+        return dest + 1 + suffix_size;
+    } else {
+        *reinterpret_cast<uint8_t *>(dest) = ESCAPED_KEY_CODE;
+        memcpy(dest + 1, key, key->full_size());
+        return dest + 1 + key->full_size();
+    }
+}
+
+// The size that the live or deletion entry `p` of `node` would have in a node with
+// the key prefix `prefix`.
+int reencoded_entry_size(value_sizer_t *sizer, const leaf_node_t *node,
+                         const entry_t *p, const btree_key_t *prefix) {
+    if (btree_key_cmp(prefix, prefix_of(node)) == 0) {
+        return entry_size(sizer, node, p);
+    }
+    store_key_t buffer;
+    int size = encoded_key_size(prefix, entry_key(node, p, &buffer));
+    if (entry_is_deletion(p)) {
+        return 1 + size;
+    } else {
+        return size + sizer->size(entry_value(node, p));
+    }
+}
+
+// Writes the live or deletion entry `p` of `node` to `dest` in the format of a node
+// with the key prefix `prefix`, and returns its new size.  `dest` may only overlap
+// the entry if the prefix is `node`'s own.
+int copy_entry(value_sizer_t *sizer, const leaf_node_t *node, const entry_t *p,
+               const btree_key_t *prefix, char *dest) {
+    if (btree_key_cmp(prefix, prefix_of(node)) == 0) {
+        int sz = entry_size(sizer, node, p);
+        memmove(dest, p, sz);
+        return sz;
+    }
+    store_key_t buffer;
+    const btree_key_t *key = entry_key(node, p, &buffer);
+    char *w = dest;
+    if (entry_is_deletion(p)) {
+        *w = static_cast<char>(DELETE_ENTRY_CODE);
+        w = encode_key(prefix, key, w + 1);
+    } else {
+        w = encode_key(prefix, key, w);
+        const void *value = entry_value(node, p);
+        int value_size = sizer->size(value);
+        memcpy(w, value, value_size);
+        w += value_size;
     }
+    return w - dest;
 }
 
+// Compares a key with the keys of a node's entries.  The key only gets compared with
+// the node's key prefix once.
+class entry_key_comparator_t {
+public:
+    entry_key_comparator_t(const leaf_node_t *node, const btree_key_t *key)
+        : node_(node), key_(key), prefix_size_(prefix_size(node)), prefix_res_(0) {
+        if (prefix_size_ > 0) {
+            const btree_key_t *prefix = prefix_of(node);
+            prefix_res_ = memcmp(key->contents, prefix->contents,
+                                 std::min<int>(key->size, prefix_size_));
+            if (prefix_res_ == 0 && key->size < prefix_size_) {
+                // The key is shorter than the prefix, so it's smaller than every key
+                // that starts with the prefix.
+                prefix_res_ = -1;
+            }
+        }
+    }
+
+    // Like `btree_key_cmp(key, <the entry's key>)`.
+    int operator()(const entry_t *p) const {
+        const btree_key_t *ek = stored_key(node_, p);
+        if (stored_key_is_full(node_, p)) {
+            return btree_key_cmp(key_, ek);
+        } else if (prefix_res_ != 0) {
+            return prefix_res_;
+        } else {
+            return sized_strcmp(key_->contents + prefix_size_, key_->size - prefix_size_,
+                                ek->contents, ek->size);
+        }
+    }
+
+private:
+    const leaf_node_t *node_;
+    const btree_key_t *key_;
+    int prefix_size_;
+    int prefix_res_;
+};
+
 const entry_t *get_entry(const leaf_node_t *node, int offset) {
     return reinterpret_cast<const entry_t *>(reinterpret_cast<const char *>(node) + offset + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0));
 }
@@ -159,7 +395,7 @@ struct entry_iter_t {
     void step(value_sizer_t *sizer, const leaf_node_t *node) {
         rassert(!done(sizer));
 
-        offset += entry_size(sizer, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
+        offset += entry_size(sizer, node, get_entry(node, offset)) + (offset < node->tstamp_cutpoint ? sizeof(repli_timestamp_t) : 0);
     }
 
     bool done(value_sizer_t *sizer) const {
@@ -175,17 +411,19 @@ struct entry_iter_t {
     }
 };
 
-void strprint_entry(std::string *out, value_sizer_t *sizer, const entry_t *entry) {
+void strprint_entry(std::string *out, value_sizer_t *sizer, const leaf_node_t *node,
+                    const entry_t *entry) {
+    store_key_t buffer;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_key(node, entry, &buffer);
         *out += strprintf("%.*s:", static_cast<int>(key->size), key->contents);
-        *out += strprintf("[entry size=%d]", entry_size(sizer, entry));
-        *out += strprintf("[value size=%d]", sizer->size(entry_value(entry)));
+        *out += strprintf("[entry size=%d]", entry_size(sizer, node, entry));
+        *out += strprintf("[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_key(node, entry, &buffer);
         *out += strprintf("%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        *out += strprintf("[skip %d]", entry_size(sizer, entry));
+        *out += strprintf("[skip %d]", entry_size(sizer, node, entry));
     } else {
         *out += strprintf("[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -194,19 +432,22 @@ void strprint_entry(std::string *out, value_sizer_t *sizer, const entry_t *entry
 
 std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
     std::string out;
-    out += strprintf("Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    const btree_key_t *prefix = prefix_of(node);
+    out += strprintf("Leaf(magic='%3.3s%c', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, prefix='%.*s')\n",
+            node->magic.bytes, node->magic.bytes[3] & ~PREFIXED_LEAF_MAGIC_BIT,
+            node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            static_cast<int>(prefix->size), prefix->contents);
 
     out += strprintf("  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        out += strprintf(" %d", node->pair_offsets[i]);
+        out += strprintf(" %d", pair_offsets(node)[i]);
     }
     out += strprintf("\n");
 
     out += strprintf("  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        out += strprintf(" %d:", node->pair_offsets[i]);
-        strprint_entry(&out, sizer, get_entry(node, node->pair_offsets[i]));
+        out += strprintf(" %d:", pair_offsets(node)[i]);
+        strprint_entry(&out, sizer, node, get_entry(node, pair_offsets(node)[i]));
     }
     out += strprintf("\n");
 
@@ -219,7 +460,7 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
             repli_timestamp_t tstamp = get_timestamp(node, iter.offset);
             out += strprintf("[t=%" PRIu64 "]", tstamp.longtime);
         }
-        strprint_entry(&out, sizer, get_entry(node, iter.offset));
+        strprint_entry(&out, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     out += strprintf("\n");
@@ -228,17 +469,19 @@ std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node) {
 }
 
 
-void print_entry(FILE *fp, value_sizer_t *sizer, const entry_t *entry) {
+void print_entry(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node,
+                 const entry_t *entry) {
+    store_key_t buffer;
     if (entry_is_live(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_key(node, entry, &buffer);
         fprintf(fp, "%.*s:", static_cast<int>(key->size), key->contents);
-        fprintf(fp, "[entry size=%d]", entry_size(sizer, entry));
-        fprintf(fp, "[value size=%d]", sizer->size(entry_value(entry)));
+        fprintf(fp, "[entry size=%d]", entry_size(sizer, node, entry));
+        fprintf(fp, "[value size=%d]", sizer->size(entry_value(node, entry)));
     } else if (entry_is_deletion(entry)) {
-        const btree_key_t *key = entry_key(entry);
+        const btree_key_t *key = entry_key(node, entry, &buffer);
         fprintf(fp, "%.*s:[deletion]", static_cast<int>(key->size), key->contents);
     } else if (entry_is_skip(entry)) {
-        fprintf(fp, "[skip %d]", entry_size(sizer, entry));
+        fprintf(fp, "[skip %d]", entry_size(sizer, node, entry));
     } else {
         fprintf(fp, "[code %d]", *reinterpret_cast<const uint8_t *>(entry));
     }
@@ -247,20 +490,23 @@ void print_entry(FILE *fp, value_sizer_t *sizer, const entry_t *entry) {
 
 
 void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
-    fprintf(fp, "Leaf(magic='%4.4s', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u)\n",
-            node->magic.bytes, node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint);
+    const btree_key_t *prefix = prefix_of(node);
+    fprintf(fp, "Leaf(magic='%3.3s%c', num_pairs=%u, live_size=%u, frontmost=%u, tstamp_cutpoint=%u, prefix='%.*s')\n",
+            node->magic.bytes, node->magic.bytes[3] & ~PREFIXED_LEAF_MAGIC_BIT,
+            node->num_pairs, node->live_size, node->frontmost, node->tstamp_cutpoint,
+            static_cast<int>(prefix->size), prefix->contents);
 
     fprintf(fp, "  Offsets:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        fprintf(fp, " %d", node->pair_offsets[i]);
+        fprintf(fp, " %d", pair_offsets(node)[i]);
     }
     fprintf(fp, "\n");
     fflush(fp);
 
     fprintf(fp, "  By Key:");
     for (int i = 0; i < node->num_pairs; ++i) {
-        fprintf(fp, " %d:", node->pair_offsets[i]);
-        print_entry(fp, sizer, get_entry(node, node->pair_offsets[i]));
+        fprintf(fp, " %d:", pair_offsets(node)[i]);
+        print_entry(fp, sizer, node, get_entry(node, pair_offsets(node)[i]));
     }
     fprintf(fp, "\n");
 
@@ -276,7 +522,7 @@ void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node) {
             fprintf(fp, "[t=%" PRIu64 "]", tstamp.longtime);
             fflush(fp);
         }
-        print_entry(fp, sizer, get_entry(node, iter.offset));
+        print_entry(fp, sizer, node, get_entry(node, iter.offset));
         iter.step(sizer, node);
     }
     fprintf(fp, "\n");
@@ -312,9 +558,12 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // is not before the end of pair_offsets
 
     // Basic sanity checks on fields' values.
-    if (failed(node->magic == sizer->btree_leaf_magic(),
+    if (failed(has_leaf_magic(sizer, node),
                "bad leaf magic")
-        || failed(node->frontmost >= offsetof(leaf_node_t, pair_offsets) + node->num_pairs * sizeof(uint16_t),
+        || failed(prefix_size(node) <= MAX_KEY_SIZE
+                  && (!is_prefixed(node) || prefix_size(node) > 0),
+                  "bad key prefix size")
+        || failed(node->frontmost >= pair_offsets_offset(node) + node->num_pairs * sizeof(uint16_t),
                   "frontmost offset is before the end of pair_offsets")
         || failed(node->live_size <= (sizer->block_size().value() - node->frontmost) + sizeof(uint16_t) * node->num_pairs,
                   "live_size is impossibly large")
@@ -328,7 +577,7 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
 
     // sizeof(offs) is guaranteed to be less than the block_size() thanks to assertions above.
     scoped_array_t<uint16_t> offs(node->num_pairs);
-    memcpy(offs.data(), node->pair_offsets, node->num_pairs * sizeof(uint16_t));
+    memcpy(offs.data(), pair_offsets(node), node->num_pairs * sizeof(uint16_t));
 
     std::sort(offs.data(), offs.data() + node->num_pairs);
 
@@ -375,21 +624,29 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
         }
 
         const entry_t *ent = get_entry(node, offset);
+        if (!entry_is_skip(ent)
+            && failed(stored_key_is_full(node, ent)
+                      || prefix_size(node) + stored_key(node, ent)->size <= MAX_KEY_SIZE,
+                      "key is too long with the key prefix")) {
+            return false;
+        }
         if (entry_is_live(ent)) {
-            const void *value = entry_value(ent);
+            const void *value = entry_value(node, ent);
             int space = sizer->block_size().value() - (reinterpret_cast<const char *>(value) - reinterpret_cast<const char *>(node));
+            store_key_t buffer;
+            const btree_key_t *key = entry_key(node, ent, &buffer);
             if (!sizer->fits(value, space)) {
-                *msg_out = strprintf("problem with key %.*s: value does not fit\n", entry_key(ent)->size, entry_key(ent)->contents);
+                *msg_out = strprintf("problem with key %.*s: value does not fit\n", key->size, key->contents);
                 return false;
             }
 
             std::string fscker_msg;
-            if (!fscker->fsck(sizer, entry_key(ent), value, &fscker_msg)) {
-                *msg_out = strprintf("Problem with key %.*s: %s\n", entry_key(ent)->size, entry_key(ent)->contents, fscker_msg.c_str());
+            if (!fscker->fsck(sizer, key, value, &fscker_msg)) {
+                *msg_out = strprintf("Problem with key %.*s: %s\n", key->size, key->contents, fscker_msg.c_str());
                 return false;
             }
 
-            observed_live_size += sizeof(uint16_t) + entry_size(sizer, ent);
+            observed_live_size += sizeof(uint16_t) + entry_size(sizer, node, ent);
             if (failed(i < node->num_pairs, "missing entry offsets")) {
                 return false;
             }
@@ -423,13 +680,16 @@ bool fsck(value_sizer_t *sizer, const btree_key_t *left_exclusive_or_null, const
     // Entries look valid, check key ordering.
 
     const btree_key_t *last = left_exclusive_or_null;
+    store_key_t last_buffer;
     for (int k = 0; k < node->num_pairs; ++k) {
-        const btree_key_t *key = entry_key(get_entry(node, node->pair_offsets[k]));
+        store_key_t buffer;
+        const btree_key_t *key = entry_key(node, get_entry(node, pair_offsets(node)[k]), &buffer);
         if (failed(last == nullptr || btree_key_cmp(last, key) < 0,
                    "keys out of order")) {
             return false;
         }
-        last = key;
+        last_buffer.assign(key);
+        last = last_buffer.btree_key();
     }
 
     if (failed(last == nullptr || right_inclusive_or_null == nullptr
@@ -460,14 +720,15 @@ void init(value_sizer_t *sizer, leaf_node_t *node) {
 }
 
 int free_space(value_sizer_t *sizer) {
-    return sizer->block_size().value() - offsetof(leaf_node_t, pair_offsets);
+    return sizer->block_size().value() - sizeof(leaf_node_t);
 }
 
 // Returns the mandatory storage cost of the node, returning a value
 // in the closed interval [0, free_space(sizer)].  Outputs the offset
 // of the first entry for which storing a timestamp is not mandatory.
 int mandatory_cost(value_sizer_t *sizer, const leaf_node_t *node, int required_timestamps, int *tstamp_back_offset_out) {
-    int size = node->live_size;
+    // The key prefix counts as part of the node's contents.
+    int size = node->live_size + prefix_region_size(prefix_size(node));
 
     // node->live_size does not include deletion entries, deletion
     // entries' timestamps, and live entries' timestamps.  We add that
@@ -484,7 +745,7 @@ int mandatory_cost(value_sizer_t *sizer, const leaf_node_t *node, int required_t
                 break;
             }
 
-            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, ent);
+            int this_entry_cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + entry_size(sizer, node, ent);
             deletions_cost += this_entry_cost;
             size += this_entry_cost;
             ++count;
@@ -510,7 +771,8 @@ int leaf_epsilon(value_sizer_t *sizer) {
     // Returns the maximum possible entry size, i.e. the key cost plus
     // the value cost plus pair_offsets plus timestamp cost.
 
-    int key_cost = sizeof(uint8_t) + MAX_KEY_SIZE;
+    // An escaped key in a prefix-compressed node takes an extra byte.
+    int key_cost = sizeof(uint8_t) + sizeof(uint8_t) + MAX_KEY_SIZE;
 
     // If the value is always empty, the DELETE_ENTRY_CODE byte needs to be considered.
     int n = std::max(sizer->max_possible_size(), 1);
@@ -524,7 +786,22 @@ bool is_empty(const leaf_node_t *node) {
     return node->num_pairs == 0;
 }
 
+bool greatest_key(const leaf_node_t *node, store_key_t *key_out) {
+    if (node->num_pairs == 0) {
+        return false;
+    }
+    const entry_t *ent = get_entry(node, pair_offsets(node)[node->num_pairs - 1]);
+    store_key_t buffer;
+    key_out->assign(entry_key(node, ent, &buffer));
+    return true;
+}
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
+    return is_full_for_value_size(sizer, node, key, sizer->size(value));
+}
+
+bool is_full_for_value_size(value_sizer_t *sizer, const leaf_node_t *node,
+                            const btree_key_t *key, int value_size) {
 
     // Upon an insertion, we preserve `MANDATORY_TIMESTAMPS - 1`
     // timestamps and add our own (accounted for below)
@@ -543,7 +820,7 @@ bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *k
     // insert.  We conservatively assume the key is not already
     // contained in the node.
 
-    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size() + sizer->size(value);
+    size += sizeof(uint16_t) + sizeof(repli_timestamp_t) + encoded_key_size(prefix_of(node), key) + value_size;
 
     // The node is full if we can't fit all that data within the free space.
     return size > free_space(sizer);
@@ -583,19 +860,89 @@ private:
 };
 
 
+// Decides which key prefix `node` should have after `garbage_collect()` has dropped
+// the entries that it doesn't keep (given the `mand_offset` it computed), and
+// `new_key` (if not null) has been added to the node.  The candidates are the node's
+// current prefix and the common prefix of all of the remaining keys, and we pick
+// whichever makes the node smaller, so changing the prefix never costs space.
+// Returns true and sets `*prefix_out` if the prefix should change.
+bool choose_prefix(value_sizer_t *sizer, const leaf_node_t *node, int mand_offset,
+                   const btree_key_t *new_key, store_key_t *prefix_out) {
+    const uint16_t *offsets = pair_offsets(node);
+
+    // Garbage collection keeps the live entries, and all entries before
+    // `mand_offset`.
+    auto is_kept = [&](int index) {
+        return offsets[index] < mand_offset
+            || entry_is_live(get_entry(node, offsets[index]));
+    };
+
+    int first = 0;
+    while (first < node->num_pairs && !is_kept(first)) {
+        ++first;
+    }
+    int last = node->num_pairs - 1;
+    while (last > first && !is_kept(last)) {
+        --last;
+    }
+
+    store_key_t prefix;
+    if (first < node->num_pairs) {
+        store_key_t first_buffer, last_buffer;
+        common_prefix(entry_key(node, get_entry(node, offsets[first]), &first_buffer),
+                      entry_key(node, get_entry(node, offsets[last]), &last_buffer),
+                      &prefix);
+        if (new_key != nullptr) {
+            common_prefix(prefix.btree_key(), new_key, &prefix);
+        }
+    } else if (new_key != nullptr) {
+        prefix.assign(new_key);
+    }
+
+    const btree_key_t *old_prefix = prefix_of(node);
+    if (btree_key_cmp(prefix.btree_key(), old_prefix) == 0) {
+        return false;
+    }
+
+    int growth = prefix_region_size(prefix.size()) - prefix_region_size(old_prefix->size);
+    if (new_key != nullptr) {
+        growth += encoded_key_size(prefix.btree_key(), new_key)
+            - encoded_key_size(old_prefix, new_key);
+    }
+    for (int i = first; i <= last && i < node->num_pairs; ++i) {
+        if (is_kept(i)) {
+            const entry_t *ent = get_entry(node, offsets[i]);
+            growth += reencoded_entry_size(sizer, node, ent, prefix.btree_key())
+                - entry_size(sizer, node, ent);
+        }
+    }
+
+    if (growth >= 0) {
+        return false;
+    }
+    *prefix_out = prefix;
+    return true;
+}
+
+// Compacts the node, dropping the timestamps (and deletion entries) beyond the
+// `num_tstamped` most recent ones.  If `may_change_prefix` is set, also switches to a
+// different key prefix if that makes the node smaller, taking into account that
+// `new_key` (if not null) is about to be added to the node.
 void garbage_collect(
         value_sizer_t *sizer,
         leaf_node_t *node,
         int num_tstamped,
         int *preserved_index,
-        boost::optional<int> tstamp_cutoff_upper_bound = boost::optional<int>()) {
+        boost::optional<int> tstamp_cutoff_upper_bound = boost::optional<int>(),
+        bool may_change_prefix = false,
+        const btree_key_t *new_key = nullptr) {
     scoped_array_t<uint16_t> indices(node->num_pairs);
 
     for (int i = 0; i < node->num_pairs; ++i) {
         indices[i] = i;
     }
 
-    std::sort(indices.data(), indices.data() + node->num_pairs, indirect_index_comparator_t(node->pair_offsets));
+    std::sort(indices.data(), indices.data() + node->num_pairs, indirect_index_comparator_t(pair_offsets(node)));
 
     int mand_offset;
     UNUSED int cost = mandatory_cost(sizer, node, num_tstamped, &mand_offset);
@@ -605,45 +952,71 @@ void garbage_collect(
         mand_offset = std::min(*tstamp_cutoff_upper_bound, mand_offset);
     }
 
+    // We normally move the entries within the node.  But if the prefix changes, some
+    // entries might get larger, so we read them from a copy of the node instead.
+    const leaf_node_t *src = node;
+    scoped_malloc_t<leaf_node_t> old_node;
+    store_key_t new_prefix;
+    if (may_change_prefix
+        && choose_prefix(sizer, node, mand_offset, new_key, &new_prefix)) {
+        old_node = scoped_malloc_t<leaf_node_t>(sizer->block_size().value());
+        memcpy(old_node.get(), node, sizer->block_size().value());
+        src = old_node.get();
+        set_prefix(node, new_prefix.btree_key());
+        memcpy(pair_offsets(node), pair_offsets(src), node->num_pairs * sizeof(uint16_t));
+    }
+    const btree_key_t *prefix = prefix_of(node);
+
+    int live_size = 0;
     int w = sizer->block_size().value();
     int i = node->num_pairs - 1;
     for (; i >= 0; --i) {
-        int offset = node->pair_offsets[indices[i]];
+        int offset = pair_offsets(node)[indices[i]];
 
         if (offset < mand_offset) {
             break;
         }
 
-        entry_t *ent = get_entry(node, offset);
+        const entry_t *ent = get_entry(src, offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
+            int sz = reencoded_entry_size(sizer, src, ent, prefix);
             w -= sz;
-            memmove(get_at_offset(node, w), ent, sz);
-            node->pair_offsets[indices[i]] = w;
+            copy_entry(sizer, src, ent, prefix, get_at_offset(node, w));
+            pair_offsets(node)[indices[i]] = w;
+            live_size += sizeof(uint16_t) + sz;
         } else {
-            node->pair_offsets[indices[i]] = 0;
+            pair_offsets(node)[indices[i]] = 0;
         }
     }
 
-    // Either i < 0 or node->pair_offsets[indices[i]] < mand_offset.
+    // Either i < 0 or pair_offsets(node)[indices[i]] < mand_offset.
 
     node->tstamp_cutpoint = w;
 
     for (; i >= 0; --i) {
-        int offset = node->pair_offsets[indices[i]];
-        entry_t *ent = get_entry(node, offset);
+        int offset = pair_offsets(node)[indices[i]];
+        const entry_t *ent = get_entry(src, offset);
         rassert(!entry_is_skip(ent));
 
-        // Preserve the timestamp.
-        int sz = sizeof(repli_timestamp_t) + entry_size(sizer, ent);
+        // Preserve the timestamp.  (We might overwrite the entry when we move it.)
+        repli_timestamp_t tstamp = get_timestamp(src, offset);
+        bool live = entry_is_live(ent);
+        int sz = reencoded_entry_size(sizer, src, ent, prefix);
 
-        w -= sz;
+        w -= sizeof(repli_timestamp_t) + sz;
 
-        memmove(get_at_offset(node, w), get_at_offset(node, offset), sz);
-        node->pair_offsets[indices[i]] = w;
+        copy_entry(sizer, src, ent, prefix,
+                   get_at_offset(node, w + sizeof(repli_timestamp_t)));
+        *reinterpret_cast<repli_timestamp_t *>(get_at_offset(node, w)) = tstamp;
+        pair_offsets(node)[indices[i]] = w;
+        if (live) {
+            live_size += sizeof(uint16_t) + sz;
+        }
     }
 
     node->frontmost = w;
+    rassert(src != node || node->live_size == live_size);
+    node->live_size = live_size;
 
     // Now squash dead indices.
     int j = 0, k = 0;
@@ -652,8 +1025,8 @@ void garbage_collect(
             *preserved_index = j;
         }
 
-        if (node->pair_offsets[k] != 0) {
-            node->pair_offsets[j] = node->pair_offsets[k];
+        if (pair_offsets(node)[k] != 0) {
+            pair_offsets(node)[j] = pair_offsets(node)[k];
 
             j += 1;
         }
@@ -674,6 +1047,13 @@ void garbage_collect(value_sizer_t *sizer, leaf_node_t *node, int num_tstamped)
     rassert(ignore == 0);
 }
 
+void compact(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *new_key) {
+    int ignore = 0;
+    garbage_collect(sizer, node, MANDATORY_TIMESTAMPS, &ignore,
+                    boost::optional<int>(), true, new_key);
+    rassert(ignore == 0);
+}
+
 void clean_entry(void *p, int sz) {
     rassert(sz > 0);
 
@@ -711,8 +1091,39 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     // this means we have no "skip" entries in tow.
     garbage_collect(sizer, tow, MANDATORY_TIMESTAMPS, &wpoint);
 
+    // An empty tow can take whichever prefix suits the moved keys best.
+    if (tow->num_pairs == 0 && end > beg) {
+        store_key_t first_buffer, last_buffer, prefix;
+        common_prefix(entry_key(fro, get_entry(fro, pair_offsets(fro)[beg]), &first_buffer),
+                      entry_key(fro, get_entry(fro, pair_offsets(fro)[end - 1]), &last_buffer),
+                      &prefix);
+        int fro_prefix_cost = prefix_region_size(prefix_size(fro));
+        int prefix_cost = prefix_region_size(prefix.size());
+        for (int i = beg; i < end; ++i) {
+            int offset = pair_offsets(fro)[i];
+            const entry_t *ent = get_entry(fro, offset);
+            if (offset < fro_mand_offset || entry_is_live(ent)) {
+                fro_prefix_cost += entry_size(sizer, fro, ent);
+                prefix_cost += reencoded_entry_size(sizer, fro, ent, prefix.btree_key());
+            }
+        }
+        set_prefix(tow, prefix_cost < fro_prefix_cost ? prefix.btree_key() : prefix_of(fro));
+    }
+    const btree_key_t *tow_prefix = prefix_of(tow);
+
+    // `fro_copysize` is in terms of fro's encoding of the keys, so account for
+    // the entries that change size when they get encoded with tow's prefix.
+    for (int i = beg; i < end; ++i) {
+        int offset = pair_offsets(fro)[i];
+        const entry_t *ent = get_entry(fro, offset);
+        if (offset < fro_mand_offset || entry_is_live(ent)) {
+            fro_copysize += reencoded_entry_size(sizer, fro, ent, tow_prefix)
+                - entry_size(sizer, fro, ent);
+        }
+    }
+
     // Now resize and move tow's pair_offsets.
-    memmove(tow->pair_offsets + wpoint + (end - beg), tow->pair_offsets + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint));
+    memmove(pair_offsets(tow) + wpoint + (end - beg), pair_offsets(tow) + wpoint, sizeof(uint16_t) * (tow->num_pairs - wpoint));
 
     tow->num_pairs += end - beg;
 
@@ -721,22 +1132,24 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     // Now we're going to do something crazy.  Fill the new hole in
     // the pair offsets with the numbers in [0, end - beg).
     for (int i = 0; i < end - beg; ++i) {
-        tow->pair_offsets[wpoint + i] = i;
+        pair_offsets(tow)[wpoint + i] = i;
     }
 
     // We treat these numbers as indices into [beg, end) in fro, and
     // sort them so that we can access [beg, end) in order by
     // increasing offset.
-    std::sort(tow->pair_offsets + wpoint, tow->pair_offsets + wpoint + (end - beg), indirect_index_comparator_t(fro->pair_offsets + beg));
+    std::sort(pair_offsets(tow) + wpoint, pair_offsets(tow) + wpoint + (end - beg), indirect_index_comparator_t(pair_offsets(fro) + beg));
 
     int tow_offset = tow->frontmost;
 
     // The offset we read from (indirectly pointing to fro's [beg,
-    // end)) in tow->pair_offsets, and the offset at which we stop.
+    // end)) in pair_offsets(tow), and the offset at which we stop.
     int fro_index = wpoint;
     int fro_index_end = wpoint + (end - beg);
 
     const int new_frontmost = tow->frontmost - fro_copysize;
+    guarantee(new_frontmost >= pair_offsets_offset(tow)
+              + static_cast<int>(sizeof(uint16_t)) * tow->num_pairs);
 
     int wri_offset = new_frontmost;
 
@@ -750,7 +1163,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     int livesize = tow->live_size;
 
     for (int i = 0; i < wpoint; ++i) {
-        if (tow->pair_offsets[i] < tow->tstamp_cutpoint) {
+        if (pair_offsets(tow)[i] < tow->tstamp_cutpoint) {
             rassert(num_adjustable_tow_offsets < MANDATORY_TIMESTAMPS);
             adjustable_tow_offsets[num_adjustable_tow_offsets] = i;
             ++num_adjustable_tow_offsets;
@@ -758,7 +1171,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
     }
 
     for (int i = wpoint + (end - beg); i < tow->num_pairs; ++i) {
-        if (tow->pair_offsets[i] < tow->tstamp_cutpoint) {
+        if (pair_offsets(tow)[i] < tow->tstamp_cutpoint) {
             rassert(num_adjustable_tow_offsets < MANDATORY_TIMESTAMPS);
             adjustable_tow_offsets[num_adjustable_tow_offsets] = i;
             ++num_adjustable_tow_offsets;
@@ -774,7 +1187,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             break;
         }
 
-        int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
+        int fro_offset = pair_offsets(fro)[beg + pair_offsets(tow)[fro_index]];
 
         if (fro_offset >= fro_mand_offset) {
             // We have no more timestamped information to push.
@@ -787,36 +1200,38 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         // Greater timestamps go first.
         if (tow_tstamp < fro_tstamp) {
             entry_t *ent = get_entry(fro, fro_offset);
-            int entsz = entry_size(sizer, ent);
+            int fro_entsz = entry_size(sizer, fro, ent);
+            *reinterpret_cast<repli_timestamp_t *>(get_at_offset(tow, wri_offset)) = fro_tstamp;
+            int entsz = copy_entry(sizer, fro, ent, tow_prefix,
+                                   get_at_offset(tow, wri_offset + sizeof(repli_timestamp_t)));
             int sz = sizeof(repli_timestamp_t) + entsz;
-            memmove(get_at_offset(tow, wri_offset), get_at_offset(fro, fro_offset), sz);
 
             if (entry_is_live(ent)) {
                 livesize += entsz + sizeof(uint16_t);
-                fro_live_size_adjustment -= entsz + sizeof(uint16_t);
+                fro_live_size_adjustment -= fro_entsz + sizeof(uint16_t);
             }
 
-            clean_entry(ent, entsz);
+            clean_entry(ent, fro_entsz);
 
             // Update the pair offset in fro to be the offset in tow
             // -- we'll never use the old value again and we'll copy
             // the newer values to tow later.
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
+            pair_offsets(fro)[beg + pair_offsets(tow)[fro_index]] = wri_offset;
 
             wri_offset += sz;
             actually_copied += sz;
             fro_index++;
 
         } else {
-            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, get_entry(tow, tow_offset));
+            int sz = sizeof(repli_timestamp_t) + entry_size(sizer, tow, get_entry(tow, tow_offset));
             memmove(get_at_offset(tow, wri_offset), get_at_offset(tow, tow_offset), sz);
 
             // Update the pair offset of the entry we've moved.
             int i;
             for (i = 0; i < num_adjustable_tow_offsets; ++i) {
                 int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = wri_offset;
+                if (pair_offsets(tow)[j] == tow_offset) {
+                    pair_offsets(tow)[j] = wri_offset;
                     break;
                 }
             }
@@ -833,15 +1248,15 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
 
     // Now we have some untimestamped entries to write.
     for (; fro_index < fro_index_end; ++fro_index) {
-        int fro_offset = fro->pair_offsets[beg + tow->pair_offsets[fro_index]];
+        int fro_offset = pair_offsets(fro)[beg + pair_offsets(tow)[fro_index]];
         entry_t *ent = get_entry(fro, fro_offset);
         if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent);
-            memmove(get_at_offset(tow, wri_offset), ent, sz);
-            clean_entry(ent, sz);
-            fro_live_size_adjustment -= sz + sizeof(uint16_t);
+            int fro_sz = entry_size(sizer, fro, ent);
+            int sz = copy_entry(sizer, fro, ent, tow_prefix, get_at_offset(tow, wri_offset));
+            clean_entry(ent, fro_sz);
+            fro_live_size_adjustment -= fro_sz + sizeof(uint16_t);
 
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = wri_offset;
+            pair_offsets(fro)[beg + pair_offsets(tow)[fro_index]] = wri_offset;
 
             wri_offset += sz;
             livesize += sz + sizeof(uint16_t);
@@ -851,9 +1266,9 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             rassert(entry_is_deletion(ent));
 
             // This is a dead entry.  We'll need to squash this dead entry later.
-            fro->pair_offsets[beg + tow->pair_offsets[fro_index]] = 0;
+            pair_offsets(fro)[beg + pair_offsets(tow)[fro_index]] = 0;
 
-            int sz = entry_size(sizer, ent);
+            int sz = entry_size(sizer, fro, ent);
             clean_entry(ent, sz);
         }
     }
@@ -867,7 +1282,7 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         rassert(wri_offset <= tow_offset);
 
         entry_t *ent = get_entry(tow, tow_offset);
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, tow, ent);
         if (entry_is_live(ent)) {
             memmove(get_at_offset(tow, wri_offset), ent, sz);
 
@@ -875,8 +1290,8 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             int i;
             for (i = 0; i < num_adjustable_tow_offsets; ++i) {
                 int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = wri_offset;
+                if (pair_offsets(tow)[j] == tow_offset) {
+                    pair_offsets(tow)[j] = wri_offset;
                     break;
                 }
             }
@@ -892,8 +1307,8 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
             int i;
             for (i = 0; i < num_adjustable_tow_offsets; ++i) {
                 int j = adjustable_tow_offsets[i];
-                if (tow->pair_offsets[j] == tow_offset) {
-                    tow->pair_offsets[j] = 0;
+                if (pair_offsets(tow)[j] == tow_offset) {
+                    pair_offsets(tow)[j] = 0;
                 }
             }
         }
@@ -915,9 +1330,9 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
 
     // Copy the valid tow offsets from [beg, end) to the wpoint point
     // in tow, and move fro entries.
-    memcpy(tow->pair_offsets + wpoint, fro->pair_offsets + beg,
+    memcpy(pair_offsets(tow) + wpoint, pair_offsets(fro) + beg,
            sizeof(uint16_t) * (end - beg));
-    memmove(fro->pair_offsets + beg, fro->pair_offsets + end, sizeof(uint16_t) * (fro->num_pairs - end));
+    memmove(pair_offsets(fro) + beg, pair_offsets(fro) + end, sizeof(uint16_t) * (fro->num_pairs - end));
     fro->num_pairs -= end - beg;
 
     tow->frontmost = new_frontmost;
@@ -933,13 +1348,13 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         moved_values_out->clear();
         moved_values_out->reserve(end - beg);
         for (int pair_idx = wpoint; pair_idx < wpoint + (end - beg); ++pair_idx) {
-            const int offset = tow->pair_offsets[pair_idx];
+            const int offset = pair_offsets(tow)[pair_idx];
             // Skip dead entries
             if (offset != 0) {
                 const entry_t *entry = get_entry(tow, offset);
                 // Skip deletions
                 if (entry_is_live(entry)) {
-                    moved_values_out->push_back(entry_value(entry));
+                    moved_values_out->push_back(entry_value(tow, entry));
                 }
             }
         }
@@ -950,8 +1365,8 @@ void move_elements(value_sizer_t *sizer, leaf_node_t *fro, int beg, int end,
         // for, and that we removed from tow, as well.
         int j, k;
         for (j = 0, k = 0; k < tow->num_pairs; ++k) {
-            if (tow->pair_offsets[k] != 0) {
-                tow->pair_offsets[j] = tow->pair_offsets[k];
+            if (pair_offsets(tow)[k] != 0) {
+                pair_offsets(tow)[j] = pair_offsets(tow)[k];
 
                 j += 1;
             }
@@ -976,7 +1391,7 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     int prev_rcost = 0;
     int rcost = 0;
     while (i >= 0 && rcost < mandatory / 2) {
-        int offset = node->pair_offsets[i];
+        int offset = pair_offsets(node)[i];
         entry_t *ent = get_entry(node, offset);
 
         // We only take mandatory entries' costs into consideration,
@@ -987,7 +1402,7 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
 
         if (entry_is_live(ent)) {
             prev_rcost = rcost;
-            rcost += entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
 
             ++num_mandatories;
         } else {
@@ -995,7 +1410,7 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
 
             if (offset < tstamp_back_offset) {
                 prev_rcost = rcost;
-                rcost += entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
+                rcost += entry_size(sizer, node, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
 
                 ++num_mandatories;
             }
@@ -1036,7 +1451,8 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
                   tstamp_back_offset, nullptr);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    store_key_t median;
+    keycpy(median_out, entry_key(node, get_entry(node, pair_offsets(node)[s - 1]), &median));
 }
 
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -1048,13 +1464,14 @@ void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
-    int left_copysize = mandatory;
+    // Uncount the key prefix, right's prefix gets used instead.
+    int left_copysize = mandatory - prefix_region_size(prefix_size(left));
     // Uncount the uint16_t cost of mandatory entries.  Sigh.
     // This includes deletion entries *before* the `tstamp_back_offset`, as well
     // as all non-deletion entries.
     for (int i = 0; i < left->num_pairs; ++i) {
-        if (left->pair_offsets[i] < tstamp_back_offset
-            || !entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
+        if (pair_offsets(left)[i] < tstamp_back_offset
+            || !entry_is_deletion(get_entry(left, pair_offsets(left)[i]))) {
             left_copysize -= sizeof(uint16_t);
         }
     }
@@ -1070,9 +1487,9 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
            std::vector<const void *> *moved_values_out) {
     rassert(node != sibling);
 
-    // If sibling were underfull, we'd just merge the nodes.
+    // If sibling were underfull, we'd usually just merge the nodes.  (But not
+    // when their keys get encoded too differently to fit into one node.)
     rassert(is_underfull(sizer, node));
-    rassert(!is_underfull(sizer, sibling));
 
     // First figure out the inclusive range [beg, end] of elements we want to move
     // from sibling.
@@ -1083,7 +1500,10 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     int sibling_weight = mandatory_cost(sizer, sibling, MANDATORY_TIMESTAMPS,
                                         &tstamp_back_offset);
 
-    guarantee(node_weight < sibling_weight);
+    if (node_weight >= sibling_weight || sibling->num_pairs < 2) {
+        return false;
+    }
+    const btree_key_t *node_prefix = prefix_of(node);
 
     if (nodecmp_node_with_sib < 0) {
         // node is to the left of sibling, so we want to move elements
@@ -1109,33 +1529,32 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     int weight_movement = 0;
     int num_mandatories = 0;
     int prev_diff = sizer->block_size().value();  // some impossibly large value
+    bool overflowed = false;
     for (;;) {
-        int offset = sibling->pair_offsets[*w];
+        int offset = pair_offsets(sibling)[*w];
         entry_t *ent = get_entry(sibling, offset);
 
-        // We only take mandatory entries' costs into consideration.
-        if (entry_is_live(ent)) {
-            int sz = entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+        // We only take mandatory entries' costs into consideration.  The entry
+        // weighs what it takes in sibling, but in node its key gets encoded with
+        // node's prefix.
+        if (entry_is_live(ent) || offset < tstamp_back_offset) {
+            rassert(entry_is_live(ent) || entry_is_deletion(ent));
+            int overhead = sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            int sz = entry_size(sizer, sibling, ent) + overhead;
+            int node_sz = reencoded_entry_size(sizer, sibling, ent, node_prefix) + overhead;
+            if (node_weight + node_sz > free_space(sizer)) {
+                // Don't move more than fits into node.
+                *w -= wstep;
+                overflowed = true;
+                break;
+            }
             prev_diff = sibling_weight - node_weight;
             prev_weight_movement = weight_movement;
             weight_movement += sz;
-            node_weight += sz;
+            node_weight += node_sz;
             sibling_weight -= sz;
 
             ++num_mandatories;
-        } else {
-            rassert(entry_is_deletion(ent));
-
-            if (offset < tstamp_back_offset) {
-                int sz = entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
-                prev_diff = sibling_weight - node_weight;
-                prev_weight_movement = weight_movement;
-                weight_movement += sz;
-                node_weight += sz;
-                sibling_weight -= sz;
-
-                ++num_mandatories;
-            }
         }
 
         if (end - beg == sibling->num_pairs - 1 || node_weight >= sibling_weight) {
@@ -1145,9 +1564,12 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
         *w += wstep;
     }
 
-    guarantee(end - beg < sibling->num_pairs - 1);
+    if (end - beg >= sibling->num_pairs - 1) {
+        // We'd have to move (almost) all of sibling's entries.
+        return false;
+    }
 
-    if (prev_diff <= sibling_weight - node_weight) {
+    if (!overflowed && prev_diff <= sibling_weight - node_weight) {
         *w -= wstep;
         --num_mandatories;
         weight_movement = prev_weight_movement;
@@ -1167,17 +1589,46 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     guarantee(node->num_pairs > 0);
     guarantee(sibling->num_pairs > 0);
 
+    store_key_t replacement_key;
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        keycpy(replacement_key_out, entry_key(node, get_entry(node, pair_offsets(node)[node->num_pairs - 1]), &replacement_key));
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        keycpy(replacement_key_out, entry_key(sibling, get_entry(sibling, pair_offsets(sibling)[sibling->num_pairs - 1]), &replacement_key));
     }
 
     return true;
 }
 
 bool is_mergable(value_sizer_t *sizer, const leaf_node_t *node, const leaf_node_t *sibling) {
-    return is_underfull(sizer, node) && is_underfull(sizer, sibling);
+    if (!is_underfull(sizer, node) || !is_underfull(sizer, sibling)) {
+        return false;
+    }
+    if (node->num_pairs == 0 || sibling->num_pairs == 0) {
+        return true;
+    }
+
+    // `merge()` re-encodes left's keys with right's prefix, which can make them
+    // larger.  So we check that they still fit.
+    store_key_t node_buffer, sibling_buffer;
+    const leaf_node_t *left = node;
+    const leaf_node_t *right = sibling;
+    if (btree_key_cmp(entry_key(node, get_entry(node, pair_offsets(node)[0]), &node_buffer),
+                      entry_key(sibling, get_entry(sibling, pair_offsets(sibling)[0]), &sibling_buffer)) > 0) {
+        std::swap(left, right);
+    }
+    int tstamp_back_offset;
+    int cost = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset)
+        - prefix_region_size(prefix_size(left))
+        + mandatory_cost(sizer, right, MANDATORY_TIMESTAMPS);
+    for (int i = 0; i < left->num_pairs; ++i) {
+        int offset = pair_offsets(left)[i];
+        const entry_t *ent = get_entry(left, offset);
+        if (offset < tstamp_back_offset || entry_is_live(ent)) {
+            cost += reencoded_entry_size(sizer, left, ent, prefix_of(right))
+                - entry_size(sizer, left, ent);
+        }
+    }
+    return cost <= free_space(sizer);
 }
 
 // Sets *index_out to the index for the live entry or deletion entry
@@ -1190,13 +1641,13 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    entry_key_comparator_t compare(node, key);
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
-        const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
-
-        int res = btree_key_cmp(key, ek);
+        int res = compare(get_entry(node, pair_offsets(node)[test_point]));
 
         if (res < 0) {
             // key < *test_point.
@@ -1221,9 +1672,9 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
 bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out) {
     int index;
     if (find_key(node, key, &index)) {
-        const entry_t *ent = get_entry(node, node->pair_offsets[index]);
+        const entry_t *ent = get_entry(node, pair_offsets(node)[index]);
         if (entry_is_live(ent)) {
-            const void *val = entry_value(ent);
+            const void *val = entry_value(node, ent);
             memcpy(value_out, val, sizer->size(val));
             return true;
         }
@@ -1243,8 +1694,10 @@ appropriate, and maintaining `frontmost` and `tstamp_cutpoint`. The caller is
 responsible for writing the actual entry itself (including the key) and for
 updating `live_size` if the newly created entry is live.
 
-`new_entry_size` is the total size of the new entry, including key, value,
-and/or code byte, but not including repli timestamp.
+`non_key_size` is the size of the new entry apart from its key, i.e. the size of
+the value and/or code byte, not including repli timestamp.  The caller must
+encode the key with the node's key prefix as it is when this function returns,
+because garbage collection might change the prefix.
 
 It is an error to put a deletion entry after `tstamp_cutpoint`. If the caller
 intends to insert a deletion entry, it should pass `false` for
@@ -1258,7 +1711,7 @@ MUST_USE bool prepare_space_for_new_entry(
         value_sizer_t *sizer,
         leaf_node_t *node,
         const btree_key_t *key,
-        int new_entry_size,
+        int non_key_size,
         repli_timestamp_t tstamp,
         /* Used to derive the highest possible timestamp that non-timestamped
         entries might have. Usually the recency of the buf_t that node is in. */
@@ -1283,6 +1736,8 @@ MUST_USE bool prepare_space_for_new_entry(
     int gc_tstamp_cutoff_upper_bound;
     mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS - 1, &gc_tstamp_cutoff_upper_bound);
 
+    int new_entry_size = encoded_key_size(prefix_of(node), key) + non_key_size;
+
     /* Figure out where in `pair_offsets` to put the offset of the new entry,
     and simultaneously check for an existing entry for this key. If the entry
     already exists, clean it. */
@@ -1291,10 +1746,10 @@ MUST_USE bool prepare_space_for_new_entry(
     bool found = find_key(node, key, &index);
 
     if (found) {
-        int offset = node->pair_offsets[index];
+        int offset = pair_offsets(node)[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
 
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
@@ -1322,7 +1777,7 @@ MUST_USE bool prepare_space_for_new_entry(
     We check for this condition further down, and recover from it by dropping
     all existing timestamps and discarding the delete entry by returning `false`. */
 
-    if (offsetof(leaf_node_t, pair_offsets) +
+    if (pair_offsets_offset(node) +
             sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
             sizeof(repli_timestamp_t) +
             new_entry_size >
@@ -1332,17 +1787,20 @@ MUST_USE bool prepare_space_for_new_entry(
             /* We can't re-use an existing index if we're garbage collecting. */
             found = false;
             memmove(
-                node->pair_offsets + index,
-                node->pair_offsets + index + 1,
+                pair_offsets(node) + index,
+                pair_offsets(node) + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
             --node->num_pairs;
         }
 
         /* Passing `&index` as a parameter to `garbage_collect()`
         guarantees that it will remain valid even as `pair_offsets` entries are
-        moved around. */
+        moved around.  Garbage collection is also when the node picks up a better
+        key prefix, so the new entry's size might change. */
         garbage_collect(sizer, node, MANDATORY_TIMESTAMPS - 1, &index,
-                        boost::make_optional(gc_tstamp_cutoff_upper_bound));
+                        boost::make_optional(gc_tstamp_cutoff_upper_bound),
+                        true, key);
+        new_entry_size = encoded_key_size(prefix_of(node), key) + non_key_size;
 
         /* Make sure that `index` still refers to where the new key should be
         inserted. */
@@ -1401,7 +1859,7 @@ MUST_USE bool prepare_space_for_new_entry(
     bool drop_timestamps = false;
     if (actually_create_entry
         && !allow_after_tstamp_cutpoint
-        && offsetof(leaf_node_t, pair_offsets)
+        && pair_offsets_offset(node)
            + sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1))
            + new_entry_size
            + sizeof(repli_timestamp_t)
@@ -1416,8 +1874,8 @@ MUST_USE bool prepare_space_for_new_entry(
             a new one; close the gap in `pair_offsets`. `index` is the location
             of the open slot. */
             memmove(
-                node->pair_offsets + index,
-                node->pair_offsets + index + 1,
+                pair_offsets(node) + index,
+                pair_offsets(node) + index + 1,
                 sizeof(uint16_t) * (node->num_pairs - index - 1));
             --node->num_pairs;
         }
@@ -1436,8 +1894,8 @@ MUST_USE bool prepare_space_for_new_entry(
 
     if (!found) {
         memmove(
-            node->pair_offsets + index + 1,
-            node->pair_offsets + index,
+            pair_offsets(node) + index + 1,
+            pair_offsets(node) + index,
             sizeof(uint16_t) * (node->num_pairs - index));
         ++node->num_pairs;
     }
@@ -1462,14 +1920,14 @@ MUST_USE bool prepare_space_for_new_entry(
         the entries */
         for (int i = 0; i < node->num_pairs; ++i) {
             if (i == index) continue;
-            if (node->pair_offsets[i] < end_of_where_new_entry_should_go) {
-                node->pair_offsets[i] -= total_space_for_new_entry;
+            if (pair_offsets(node)[i] < end_of_where_new_entry_should_go) {
+                pair_offsets(node)[i] -= total_space_for_new_entry;
             }
         }
     }
 
     node->frontmost -= total_space_for_new_entry;
-    guarantee(offsetof(leaf_node_t, pair_offsets)
+    guarantee(pair_offsets_offset(node)
               + sizeof(uint16_t) * node->num_pairs <= node->frontmost);
 
     /* Write the timestamp if we need one, and update `node->tstamp_cutpoint` if
@@ -1485,7 +1943,7 @@ MUST_USE bool prepare_space_for_new_entry(
 
     /* Record the offset in `pair_offsets` */
 
-    node->pair_offsets[index] = start_of_where_new_entry_should_go;
+    pair_offsets(node)[index] = start_of_where_new_entry_should_go;
 
     /* Fill output variable */
 
@@ -1515,18 +1973,18 @@ void insert(
 
     char *location_to_write_data;
     bool should_write = prepare_space_for_new_entry(sizer, node,
-        key, key->full_size() + sizer->size(value), tstamp, maximum_existing_tstamp,
+        key, sizer->size(value), tstamp, maximum_existing_tstamp,
         true,
         &location_to_write_data);
     guarantee(should_write);
 
     /* Now copy the data into the node itself */
 
-    memcpy(location_to_write_data, key, key->full_size());
-    location_to_write_data += key->full_size();
-    memcpy(location_to_write_data, value, sizer->size(value));
+    char *value_location = encode_key(prefix_of(node), key, location_to_write_data);
+    memcpy(value_location, value, sizer->size(value));
 
-    node->live_size += sizeof(uint16_t) + key->full_size() + sizer->size(value);
+    node->live_size += sizeof(uint16_t) + (value_location - location_to_write_data)
+        + sizer->size(value);
 
     validate(sizer, node);
 }
@@ -1546,14 +2004,14 @@ void remove(
     char *location_to_write_data;
     if (prepare_space_for_new_entry(sizer, node,
             key,
-            1 + key->full_size(),   /* 1 for `DELETE_ENTRY_CODE` */
+            1,   /* for `DELETE_ENTRY_CODE` */
             tstamp,
             maximum_existing_tstamp,
             false,
             &location_to_write_data)) {
         *location_to_write_data = static_cast<char>(DELETE_ENTRY_CODE);
         ++location_to_write_data;
-        memcpy(location_to_write_data, key, key->full_size());
+        encode_key(prefix_of(node), key, location_to_write_data);
     }
 
     validate(sizer, node);
@@ -1564,17 +2022,17 @@ void erase_presence(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *
     int index;
     bool found = find_key(node, key, &index);
     if (found) {
-        int offset = node->pair_offsets[index];
+        int offset = pair_offsets(node)[index];
         entry_t *ent = get_entry(node, offset);
 
-        int sz = entry_size(sizer, ent);
+        int sz = entry_size(sizer, node, ent);
         if (entry_is_live(ent)) {
             node->live_size -= sizeof(uint16_t) + sz;
         }
 
         clean_entry(ent, sz);
 
-        memmove(node->pair_offsets + index, node->pair_offsets + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
+        memmove(pair_offsets(node) + index, pair_offsets(node) + index + 1, (node->num_pairs - (index + 1)) * sizeof(uint16_t));
         node->num_pairs -= 1;
     }
 
@@ -1640,7 +2098,7 @@ void erase_deletions(
         if (entry_is_deletion(ent)) {
             clean_entry(
                 get_at_offset(node, off),
-                sizeof(repli_timestamp_t) + entry_size(sizer, ent));
+                sizeof(repli_timestamp_t) + entry_size(sizer, node, ent));
             deletion_offsets.insert(off);
         } else {
             /* This is the code path for both skip entries and live entries, because skip
@@ -1656,13 +2114,13 @@ void erase_deletions(
     int src = 0, dst = 0;
     int num_deleted = deletion_offsets.size();
     for (; src < node->num_pairs; ++src) {
-        uint16_t off = node->pair_offsets[src];
+        uint16_t off = pair_offsets(node)[src];
         auto it = deletion_offsets.find(off);
         if (it == deletion_offsets.end()) {
             if (off >= new_tstamp_cutpoint && off < old_tstamp_cutpoint) {
                 off += sizeof(repli_timestamp_t);
             }
-            node->pair_offsets[dst++] = off;
+            pair_offsets(node)[dst++] = off;
         } else {
             guarantee(off >= new_tstamp_cutpoint && off < old_tstamp_cutpoint);
             deletion_offsets.erase(it);
@@ -1704,7 +2162,8 @@ continue_bool_t visit_entries(
             continue;
         }
 
-        if (continue_bool_t::ABORT == cb(entry_key(ent), tstamp, entry_value(ent))) {
+        store_key_t buffer;
+        if (continue_bool_t::ABORT == cb(entry_key(node, ent, &buffer), tstamp, entry_value(node, ent))) {
             return continue_bool_t::ABORT;
         }
     }
@@ -1720,8 +2179,8 @@ iterator::iterator(const leaf_node_t *node, int index)
 std::pair<const btree_key_t *, const void *> iterator::operator*() const {
     guarantee(index_ < static_cast<int>(node_->num_pairs));
     guarantee(index_ >= 0);
-    const entry_t *entree = get_entry(node_, node_->pair_offsets[index_]);
-    return std::make_pair(entry_key(entree), entry_value(entree));
+    const entry_t *entree = get_entry(node_, pair_offsets(node_)[index_]);
+    return std::make_pair(entry_key(node_, entree, &key_buffer_), entry_value(node_, entree));
 }
 
 iterator &iterator::operator++() {
@@ -1729,7 +2188,7 @@ iterator &iterator::operator++() {
               "Trying to increment past the end of an iterator.");
     do {
         ++index_;
-    } while (index_ < node_->num_pairs && !entry_is_live(get_entry(node_, node_->pair_offsets[index_])));
+    } while (index_ < node_->num_pairs && !entry_is_live(get_entry(node_, pair_offsets(node_)[index_])));
     return *this;
 }
 
@@ -1737,7 +2196,7 @@ iterator &iterator::operator--() {
     guarantee(index_ > -1, "Trying to decrement past the beginning of an iterator.");
     do {
         --index_;
-    } while (index_ >= 0 && !entry_is_live(get_entry(node_, node_->pair_offsets[index_])));
+    } while (index_ >= 0 && !entry_is_live(get_entry(node_, pair_offsets(node_)[index_])));
     return *this;
 }
 
@@ -1800,7 +2259,7 @@ leaf::iterator inclusive_lower_bound(const btree_key_t *key, const leaf_node_t &
     int index;
     leaf::find_key(&leaf_node, key, &index);
     if (index == leaf_node.num_pairs ||
-        entry_is_live(leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]))) {
+        entry_is_live(leaf::get_entry(&leaf_node, pair_offsets(&leaf_node)[index]))) {
         return leaf_node_t::iterator(&leaf_node, index);
     } else {
         return ++leaf_node_t::iterator(&leaf_node, index);
@@ -1811,10 +2270,9 @@ leaf::reverse_iterator exclusive_upper_bound(const btree_key_t *key, const leaf_
     int index;
     leaf::find_key(&leaf_node, key, &index);
     if (index < leaf_node.num_pairs) {
-        const leaf::entry_t *entry = leaf::get_entry(&leaf_node, leaf_node.pair_offsets[index]);
-        const btree_key_t *ekey = leaf::entry_key(entry);
+        const leaf::entry_t *entry = leaf::get_entry(&leaf_node, pair_offsets(&leaf_node)[index]);
         if (entry_is_live(entry) &&
-            btree_key_cmp(ekey, key) == 0) {
+            entry_key_comparator_t(&leaf_node, key)(entry) == 0) {
             // We have to skip this entry to make the iterator exclusive,
             // hence the ++.
             return ++leaf_node_t::reverse_iterator(&leaf_node, index);
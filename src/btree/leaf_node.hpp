@@ -11,11 +11,11 @@
 #include <boost/optional.hpp>
 
 #include "arch/compiler.hpp"
+#include "btree/keys.hpp"
 #include "btree/types.hpp"
 #include "buffer_cache/types.hpp"
 
 class value_sizer_t;
-struct btree_key_t;
 class repli_timestamp_t;
 
 // TODO: Could key_modification_proof_t not go in this file?
@@ -60,8 +60,8 @@ ATTR_PACKED(struct leaf_node_t {
     // The first offset whose entry is not accompanied by a timestamp.
     uint16_t tstamp_cutpoint;
 
-    // The pair offsets.
-    uint16_t pair_offsets[];
+    // The pair offsets follow, preceded by the key prefix in prefix-compressed
+    // nodes.  Use `leaf::pair_offsets()` to get at them.
 
     //Iteration
     typedef leaf::iterator iterator;
@@ -101,6 +101,24 @@ const int DELETION_RESERVE_FRACTION = 10;
 
 
 
+// Leaf nodes whose keys share a common prefix store that prefix only once, right
+// after the header, and their entries only store the rest of the keys.  Such nodes
+// have the value-type-specific magic with `PREFIXED_LEAF_MAGIC_BIT` set in its last
+// byte.  Nodes without the bit have the original format, which is also what
+// `init()` creates; nodes get converted when they're garbage collected, split or
+// merged and a prefix makes them smaller.
+const char PREFIXED_LEAF_MAGIC_BIT = static_cast<char>(0x80);
+
+bool has_leaf_magic(value_sizer_t *sizer, const leaf_node_t *node);
+
+bool is_prefixed(const leaf_node_t *node);
+
+// The key prefix of a prefix-compressed node, or the empty key.
+store_key_t key_prefix(const leaf_node_t *node);
+
+uint16_t *pair_offsets(leaf_node_t *node);
+const uint16_t *pair_offsets(const leaf_node_t *node);
+
 std::string strprint_leaf(value_sizer_t *sizer, const leaf_node_t *node);
 
 void print(FILE *fp, value_sizer_t *sizer, const leaf_node_t *node);
@@ -127,8 +145,22 @@ void init(value_sizer_t *sizer, leaf_node_t *node);
 
 bool is_empty(const leaf_node_t *node);
 
+// Sets `*key_out` to the greatest key that has an entry (live or deleted) in the
+// node.  Returns false if the node has no entries.
+bool greatest_key(const leaf_node_t *node, store_key_t *key_out);
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value);
 
+// Like `is_full()`, for a value of `value_size` bytes.
+bool is_full_for_value_size(value_sizer_t *sizer, const leaf_node_t *node,
+                            const btree_key_t *key, int value_size);
+
+// Drops old timestamps and re-encodes the keys with the key prefix that makes the
+// node smallest, given that `new_key` is about to be added.  Insertions do this
+// whenever they run out of contiguous space, but a node that gets filled in key
+// order should be compacted before it's considered full.
+void compact(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *new_key);
+
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
 
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
@@ -189,7 +221,8 @@ void erase_deletions(
 
 /* Calls `cb` on every entry in the node, whether a real entry or a deletion. The calls
 will be in order from most recent to least recent. For entries with no timestamp, the
-callback will get `min_deletion_timestamp() - 1`. */
+callback will get `min_deletion_timestamp() - 1`. The key pointer is only valid during
+the call, since keys of prefix-compressed nodes are put together in a buffer. */
 continue_bool_t visit_entries(
     value_sizer_t *sizer,
     const leaf_node_t *node,
@@ -201,6 +234,9 @@ continue_bool_t visit_entries(
         const void *value   /* null for deletion */
         )> &cb);
 
+// The key pointer returned by the iterators' `operator*` is only valid until the
+// iterator is changed or destroyed, since keys of prefix-compressed nodes have to be
+// put together in a buffer of the iterator.
 class iterator {
 public:
     iterator();
@@ -219,6 +255,7 @@ private:
     int cmp(const iterator &other) const;
     const leaf_node_t *node_;
     int index_;
+    mutable store_key_t key_buffer_;
 };
 
 class reverse_iterator {
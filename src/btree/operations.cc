@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "btree/internal_node.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/blob.hpp"
@@ -290,6 +293,7 @@ void check_and_handle_underfull(value_sizer_t *sizer,
                 // node as the new root.
                 // This is why we had detached `buf` from `last_buf` earlier.
                 last_buf->mark_deleted();
+                last_buf->reset_buf_lock();
                 insert_root(buf->block_id(), sb);
             }
         } else {
@@ -473,11 +477,83 @@ void find_keyvalue_location_for_write(
     keyvalue_location_out->buf.swap(buf);
 }
 
+bool can_reuse_keyvalue_location_for_write(
+        keyvalue_location_t *kv_loc,
+        const btree_key_t *key) {
+    if (kv_loc->buf.empty()) {
+        return false;
+    }
+    if (kv_loc->last_buf.empty()) {
+        // The leaf is the root, so every key belongs to it.  We need the superblock
+        // in case the leaf gets split.
+        return kv_loc->superblock != nullptr;
+    }
+    buf_read_t read(&kv_loc->last_buf);
+    auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+    if (internal_node::is_full(parent)) {
+        return false;
+    }
+    if (kv_loc->superblock != nullptr) {
+        // We only hold on to the superblock while the parent is the root.
+        return true;
+    }
+    // The parent doesn't tell us where the range of its last child ends, so the key
+    // might belong to the next parent.  (Keys are ascending, so we don't need to
+    // worry about the first child.)
+    return internal_node::get_offset_index(parent, key) < parent->npairs - 1;
+}
+
+void reuse_keyvalue_location_for_write(
+        value_sizer_t *sizer,
+        const btree_key_t *key,
+        keyvalue_location_t *kv_loc) {
+    rassert(can_reuse_keyvalue_location_for_write(kv_loc, key));
+    kv_loc->there_originally_was_value = false;
+    kv_loc->value.reset();
+
+    if (!kv_loc->last_buf.empty()) {
+        block_id_t node_id;
+        {
+            buf_read_t read(&kv_loc->last_buf);
+            auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+            node_id = internal_node::lookup(parent, key);
+        }
+        if (node_id != kv_loc->buf.block_id()) {
+            kv_loc->buf.reset_buf_lock();
+            kv_loc->buf = buf_lock_t(&kv_loc->last_buf, node_id, access_t::write);
+        }
+    }
+
+    scoped_malloc_t<void> tmp(sizer->max_possible_size());
+    buf_read_t read(&kv_loc->buf);
+    auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+    if (leaf::lookup(sizer, node, key, tmp.get())) {
+        kv_loc->there_originally_was_value = true;
+        kv_loc->value = std::move(tmp);
+    }
+}
+
+size_t max_writes_at_keyvalue_location(keyvalue_location_t *kv_loc) {
+    if (kv_loc->superblock != nullptr) {
+        return std::numeric_limits<size_t>::max();
+    }
+    if (kv_loc->buf.empty() || kv_loc->last_buf.empty()) {
+        return 0;
+    }
+    buf_read_t read(&kv_loc->last_buf);
+    auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+    // Every write can also remove a key from the parent by merging the leaf, and
+    // merging under a doubleton parent would need the superblock.
+    const int until_doubleton = std::max(parent->npairs - 2, 1);
+    return std::min(internal_node::spare_capacity(parent), until_doubleton);
+}
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
-        btree_stats_t *stats, profile::trace_t *trace) {
+        btree_stats_t *stats, profile::trace_t *trace,
+        read_descent_t descent) {
     stats->pm_keys_read.record();
     stats->pm_total_keys_read += 1;
 
@@ -493,8 +569,35 @@ void find_keyvalue_location_for_read(
     buf_lock_t buf;
     {
         PROFILE_STARTER_IF_ENABLED(
-                trace != nullptr, "Acquire a block for read.", trace);;
-        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+                trace != nullptr, "Acquire a block for read.", trace);
+        // Nothing may block from peeking at the nodes until we're in line for the
+        // node we acquire, or a writer could change the path in between.
+        ASSERT_NO_CORO_WAITING;
+        // The first node that we acquire.
+        block_id_t node_id = root_id;
+        if (descent == read_descent_t::OPTIMISTIC) {
+            for (;;) {
+                buf_peek_t peek(superblock->expose_buf(), node_id);
+                if (!peek.has()) {
+                    break;
+                }
+                const node_t *node = static_cast<const node_t *>(peek.get_data_read());
+                if (!node::is_internal(node)) {
+                    break;
+                }
+                node_id = internal_node::lookup(
+                    reinterpret_cast<const internal_node_t *>(node), key);
+                rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+            }
+            if (node_id != root_id) {
+                stats->pm_total_keys_read_optimistically += 1;
+            }
+        }
+
+        // The node might not be a child of the superblock, but since the superblock
+        // is already acquired and isn't snapshotted (otherwise `buf_peek_t` wouldn't
+        // have let us skip anything), this gets us in line without blocking.
+        buf_lock_t tmp(superblock->expose_buf(), node_id, access_t::read);
         superblock->release();
         buf = std::move(tmp);
     }
@@ -66,6 +66,7 @@ public:
           pm_keys_membership(&btree_collection,
               &pm_keys_read, "keys_read",
               &pm_total_keys_read, "total_keys_read",
+              &pm_total_keys_read_optimistically, "total_keys_read_optimistically",
               &pm_keys_set, "keys_set",
               &pm_total_keys_set, "total_keys_set") {
         if (parent != nullptr) {
@@ -93,6 +94,7 @@ public:
         pm_keys_set;
     perfmon_counter_t
         pm_total_keys_read,
+        pm_total_keys_read_optimistically,
         pm_total_keys_set;
     perfmon_multi_membership_t pm_keys_membership;
 };
@@ -205,13 +207,48 @@ void find_keyvalue_location_for_write(
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock = nullptr) THROWS_NOTHING;
 
+/* For batches of writes with the same timestamp and to keys in ascending order.
+`find_keyvalue_location_for_write()` leaves `*keyvalue_location` holding a leaf and
+its parent. If `can_reuse_keyvalue_location_for_write()` returns true, the next key
+of the batch also belongs to a child of that parent, and
+`reuse_keyvalue_location_for_write()` moves `*keyvalue_location` on to it without
+descending from the superblock again. Every write can grow the parent by a key,
+which the descent only makes room for once, so the parent stops being reusable once
+it's full. `max_writes_at_keyvalue_location()` tells how many writes (including the
+first one) are guaranteed to fit. That is unbounded while `*keyvalue_location` still
+holds the superblock, since the caller can then descend again from it whenever
+`can_reuse_keyvalue_location_for_write()` returns false. */
+bool can_reuse_keyvalue_location_for_write(
+        keyvalue_location_t *keyvalue_location,
+        const btree_key_t *key);
+
+void reuse_keyvalue_location_for_write(
+        value_sizer_t *sizer,
+        const btree_key_t *key,
+        keyvalue_location_t *keyvalue_location);
+
+size_t max_writes_at_keyvalue_location(keyvalue_location_t *keyvalue_location);
+
+/* `read_descent_t` says how `find_keyvalue_location_for_read()` gets past the
+internal nodes.  `PESSIMISTIC` acquires every node on the way down, while holding its
+parent.  `OPTIMISTIC` reads the internal nodes that are in memory and not held by a
+writer without acquiring them (see `buf_peek_t`), and only acquires the first node
+that it can't read that way, or the leaf.  So readers don't line up behind each
+other and behind writers on the upper levels of the tree, and they release the
+superblock without waiting for the root.  No coroutine switch can happen between
+reading the root block id and getting in line for the acquired node, which is what
+makes the skipped path valid.  If a node can't be peeked, the descent just falls
+back to acquiring nodes from there on. */
+enum class read_descent_t { OPTIMISTIC, PESSIMISTIC };
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock,
         const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
         btree_stats_t *stats,
-        profile::trace_t *trace);
+        profile::trace_t *trace,
+        read_descent_t descent = read_descent_t::OPTIMISTIC);
 
 /* `delete_mode_t` controls how `apply_keyvalue_change()` acts when `kv_loc->value` is
 empty. */
@@ -181,6 +181,7 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
                              index_type_t index_type)
     : stats(parent,
             (index_type == index_type_t::SECONDARY ? "index-" : "") + identifier),
+      key_dictionary(nullptr),
       cache_(c),
       backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
 
@@ -402,6 +403,9 @@ void get_btree_superblock_and_txn_for_backfilling(
     txn_t *txn = new txn_t(cache_conn, read_access_t::read);
     txn_out->init(txn);
     txn->set_account(backfill_account);
+    // Backfills read every block in their range once, which mustn't evict the
+    // blocks that are used by regular queries.
+    txn->set_access_pattern(page_access_pattern_t::scan);
 
     get_btree_superblock(txn, access_t::read, got_superblock_out);
     (*got_superblock_out)->get()->snapshot_subdag();
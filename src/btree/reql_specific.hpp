@@ -15,6 +15,7 @@ metainfo, which are unrelated to the B-tree but stored on the ReQL primary super
 They should probably be moved out of the `btree/` directory. */
 
 class binary_blob_t;
+class key_dictionary_t;
 
 /* `real_superblock_t` represents the superblock for the primary B-tree of a table. */
 class real_superblock_t : public superblock_t {
@@ -100,6 +101,11 @@ public:
 
     btree_stats_t stats;
 
+    // The key dictionary that the documents in the B-tree may refer to, or null.  The
+    // B-trees of secondary indexes point to the one of their primary B-tree, because
+    // their entries share the blobs of the documents in it.
+    key_dictionary_t *key_dictionary;
+
 private:
     cache_t *cache_;
 
@@ -102,9 +102,10 @@ void alt_txn_throttler_t::inform_memory_limit_change(uint64_t memory_limit,
 
 cache_t::cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 perfmon_collection_t *perfmon_collection)
+                 perfmon_collection_t *perfmon_collection,
+                 alt::page_repl_policy_t page_repl_policy)
     : throttler_(MINIMUM_SOFT_UNWRITTEN_CHANGES_LIMIT),
-      page_cache_(serializer, balancer, &throttler_),
+      page_cache_(serializer, balancer, &throttler_, page_repl_policy),
       stats_(make_scoped<alt_cache_stats_t>(&page_cache_, perfmon_collection)) { }
 
 cache_t::~cache_t() {
@@ -190,6 +191,7 @@ txn_t::txn_t(cache_conn_t *cache_conn,
              read_access_t)
     : cache_(cache_conn->cache()),
       cache_account_(cache_->page_cache_.default_reads_account()),
+      access_pattern_(page_access_pattern_t::normal),
       access_(access_t::read),
       durability_(write_durability_t::SOFT) {
     // Right now, cache_conn is only used to control flushing of write txns.  When we
@@ -204,6 +206,7 @@ txn_t::txn_t(cache_conn_t *cache_conn,
              int64_t expected_change_count)
     : cache_(cache_conn->cache()),
       cache_account_(cache_->page_cache_.default_reads_account()),
+      access_pattern_(page_access_pattern_t::normal),
       access_(access_t::write),
       durability_(durability) {
 
@@ -257,6 +260,10 @@ void txn_t::set_account(cache_account_t *cache_account) {
     cache_account_ = cache_account;
 }
 
+void txn_t::set_access_pattern(page_access_pattern_t access_pattern) {
+    access_pattern_ = access_pattern;
+}
+
 
 alt_snapshot_node_t::alt_snapshot_node_t(scoped_ptr_t<current_page_acq_t> &&acq)
     : current_page_acq_(std::move(acq)), ref_count_(0) { }
@@ -788,13 +795,29 @@ const void *buf_read_t::get_data_read(uint32_t *block_size_out) {
     page_t *page = lock_->get_held_page_for_read();
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
-                       lock_->txn()->account());
+                       lock_->txn()->account(),
+                       lock_->txn()->access_pattern());
     }
     page_acq_.buf_ready_signal()->wait();
     *block_size_out = page_acq_.get_buf_size().value();
     return page_acq_.get_buf_read();
 }
 
+buf_peek_t::buf_peek_t(buf_parent_t parent, block_id_t block_id)
+    : cache_(parent.cache()), data_(nullptr), block_size_(0) {
+    ASSERT_NO_CORO_WAITING;
+    cache_->assert_thread();
+    buf_lock_t *parent_lock = parent.lock_or_null_;
+    if (parent_lock != nullptr) {
+        rassert(parent_lock->read_acq_signal()->is_pulsed());
+        if (parent_lock->is_snapshotted()) {
+            // We'd have to read the version of the snapshot.
+            return;
+        }
+    }
+    data_ = cache_->page_cache_.peek_block_for_read(block_id, &block_size_);
+}
+
 buf_write_t::buf_write_t(buf_lock_t *lock)
     : lock_(lock) {
     guarantee(lock_->access() == access_t::write);
@@ -810,7 +833,8 @@ void *buf_write_t::get_data_write(uint32_t block_size) {
     page_t *page = lock_->get_held_page_for_write();
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
-                       lock_->txn()->account());
+                       lock_->txn()->account(),
+                       lock_->txn()->access_pattern());
     }
     page_acq_.buf_ready_signal()->wait();
     return page_acq_.get_buf_write(block_size_t::make_from_cache(block_size));
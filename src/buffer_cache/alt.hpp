@@ -43,11 +43,17 @@ class cache_t : public home_thread_mixin_t {
 public:
     explicit cache_t(serializer_t *serializer,
                      cache_balancer_t *balancer,
-                     perfmon_collection_t *perfmon_collection);
+                     perfmon_collection_t *perfmon_collection,
+                     alt::page_repl_policy_t page_repl_policy
+                         = alt::page_repl_policy_t::sampling);
     ~cache_t();
 
     max_block_size_t max_block_size() const { return page_cache_.max_block_size(); }
 
+    // The number of bytes the cache may currently keep in memory, as assigned by the
+    // cache balancer.
+    uint64_t memory_limit() { return page_cache_.evicter().memory_limit(); }
+
     // These todos come from the mirrored cache.  The real problem is that whole
     // cache account / priority thing is just one ghetto hack amidst a dozen other
     // throttling systems.  TODO: Come up with a consistent priority scheme,
@@ -58,6 +64,7 @@ public:
 private:
     friend class txn_t;
     friend class buf_read_t;
+    friend class buf_peek_t;
     friend class buf_write_t;
     friend class buf_lock_t;
 
@@ -97,6 +104,11 @@ public:
     void set_account(cache_account_t *cache_account);
     cache_account_t *account() { return cache_account_; }
 
+    // Marks the pages acquired through this transaction as being part of a scan (or
+    // not), so that they don't displace the cache's working set.
+    void set_access_pattern(page_access_pattern_t access_pattern);
+    page_access_pattern_t access_pattern() const { return access_pattern_; }
+
 private:
     // Resets the *throttler_acq parameter.
     static void inform_tracker(cache_t *cache,
@@ -116,6 +128,10 @@ private:
     // set_account().
     cache_account_t *cache_account_;
 
+    // Initialized to page_access_pattern_t::normal, and modified by
+    // set_access_pattern().
+    page_access_pattern_t access_pattern_;
+
     const access_t access_;
 
     // Only applicable if access_ == write.
@@ -310,6 +326,7 @@ public:
 
 private:
     friend class buf_lock_t;
+    friend class buf_peek_t;
     txn_t *txn_;
     buf_lock_t *lock_or_null_;
 };
@@ -334,6 +351,42 @@ private:
     DISABLE_COPYING(buf_read_t);
 };
 
+/* `buf_peek_t` reads the current version of a block without acquiring it, which
+means without getting in line behind the agents that have acquired it.  That is
+only possible if the block is in memory and no write acquirer holds it, and if
+`parent` isn't snapshotted (`parent` must be read-acquired, but the block doesn't
+need to be a child of it).  `has()` tells whether it worked.
+
+Since nothing keeps writers away from the block, the data is only valid until the
+coroutine blocks.  Readers that use it to decide which block to read next have to
+get in line for that block (with a `buf_lock_t`, through a parent that they hold)
+before they block. */
+class buf_peek_t {
+public:
+    buf_peek_t(buf_parent_t parent, block_id_t block_id);
+
+    bool has() const { return data_ != nullptr; }
+
+    const void *get_data_read(uint32_t *block_size_out) const {
+        guarantee(has());
+        *block_size_out = block_size_;
+        return data_;
+    }
+    const void *get_data_read() const {
+        uint32_t block_size;
+        const void *data = get_data_read(&block_size);
+        guarantee(block_size == cache_->max_block_size().value());
+        return data;
+    }
+
+private:
+    cache_t *cache_;
+    const void *data_;
+    uint32_t block_size_;
+
+    DISABLE_COPYING(buf_peek_t);
+};
+
 class buf_write_t {
 public:
     explicit buf_write_t(buf_lock_t *lock);
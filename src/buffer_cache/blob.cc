@@ -7,6 +7,7 @@
 
 #include "buffer_cache/alt.hpp"
 #include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "containers/buffer_group.hpp"
 #include "containers/scoped.hpp"
 #include "math.hpp"
@@ -88,6 +89,19 @@ bool is_small(const char *ref, int maxreflen) {
     return small_size(ref, maxreflen) < maxreflen;
 }
 
+// The small size field value of contiguous blobs.
+int contiguous_marker(int maxreflen) {
+    return maxreflen + 1;
+}
+
+bool supports_contiguous(int maxreflen) {
+    return contiguous_marker(maxreflen) <= (maxreflen <= 255 ? 255 : 65535);
+}
+
+bool is_contiguous(const char *ref, int maxreflen) {
+    return small_size(ref, maxreflen) == contiguous_marker(maxreflen);
+}
+
 char *small_buffer(char *ref, int maxreflen) {
     return ref + big_size_offset(maxreflen);
 }
@@ -171,6 +185,11 @@ ref_info_t ref_info(max_block_size_t block_size, const char *ref, int maxreflen)
         info.refsize = big_size_offset(maxreflen) + smallsize;
         info.levels = 0;
         return info;
+    } else if (smallsize == contiguous_marker(maxreflen)) {
+        ref_info_t info;
+        info.refsize = block_ids_offset(maxreflen) + sizeof(block_id_t);
+        info.levels = 1;
+        return info;
     } else {
         return big_ref_info(block_size, big_size(ref, maxreflen), maxreflen);
     }
@@ -209,7 +228,7 @@ int64_t value_size(const char *ref, int maxreflen) {
     if (smallsize <= maxreflen - big_size_offset(maxreflen)) {
         return smallsize;
     } else {
-        rassert(smallsize == maxreflen);
+        rassert(smallsize == maxreflen || smallsize == contiguous_marker(maxreflen));
         return blob::big_size(ref, maxreflen);
     }
 }
@@ -218,6 +237,7 @@ int64_t value_size(const char *ref, int maxreflen) {
 int btree_maxreflen = 251;
 block_magic_t internal_node_magic = { { 'l', 'a', 'r', 'i' } };
 block_magic_t leaf_node_magic = { { 'l', 'a', 'r', 'l' } };
+block_magic_t contiguous_node_magic = { { 'l', 'a', 'r', 'c' } };
 
 
 int64_t stepsize(max_block_size_t block_size, int levels) {
@@ -295,6 +315,10 @@ void blob_t::detach_subtrees(buf_parent_t root) {
     if (blob::is_small(ref_, maxreflen_)) {
         return;
     }
+    if (blob::is_contiguous(ref_, maxreflen_)) {
+        root.detach_child(blob::block_ids(ref_, maxreflen_)[0]);
+        return;
+    }
 
     int64_t blockid_count;
     blob::big_ref_info(root.cache()->max_block_size(),
@@ -330,6 +354,24 @@ void blob_t::expose_region(buf_parent_t parent, access_t mode,
         rassert(0 <= size && size <= n && offset + size <= n);
 #endif
         buffer_group_out->add_buffer(size, b + offset);
+    } else if (blob::is_contiguous(ref_, maxreflen_)) {
+        rassert(0 <= offset && offset + size <= valuesize());
+        buf_lock_t *buf = new buf_lock_t(parent, blob::block_ids(ref_, maxreflen_)[0],
+                                         mode);
+        void *block;
+        if (mode == access_t::read) {
+            buf_read_t *buf_read = new buf_read_t(buf);
+            uint32_t block_size;
+            block = const_cast<void *>(buf_read->get_data_read(&block_size));
+            rassert(block_size == blob::LEAF_NODE_DATA_OFFSET + valuesize());
+            acq_group_out->add_buf(buf, buf_read);
+        } else {
+            buf_write_t *buf_write = new buf_write_t(buf);
+            block = buf_write->get_data_write(blob::LEAF_NODE_DATA_OFFSET
+                                              + valuesize());
+            acq_group_out->add_buf(buf, buf_write);
+        }
+        buffer_group_out->add_buffer(size, blob::leaf_node_data(block) + offset);
     } else {
         // It's large.
 
@@ -488,7 +530,24 @@ void expose_tree_from_block_ids(buf_parent_t parent, access_t mode,
 
 }  // namespace blob
 
-void blob_t::append_region(buf_parent_t parent, int64_t size) {
+void blob_t::append_region(buf_parent_t parent, int64_t size,
+                           blob::layout_t layout) {
+    if (blob::is_contiguous(ref_, maxreflen_)) {
+        const int64_t new_size = valuesize() + size;
+        if (new_size <= BLOB_MAX_CONTIGUOUS_SIZE) {
+            resize_contiguous(parent, new_size);
+            return;
+        }
+        contiguous_to_tree(parent);
+    } else if (layout == blob::layout_t::contiguous
+               && blob::supports_contiguous(maxreflen_)
+               && valuesize() == 0
+               && !blob::size_would_be_small(size, maxreflen_)
+               && size <= BLOB_MAX_CONTIGUOUS_SIZE) {
+        create_contiguous(parent, size);
+        return;
+    }
+
     const max_block_size_t block_size = parent.cache()->max_block_size();
     int levels = blob::ref_info(block_size, ref_, maxreflen_).levels;
 
@@ -519,6 +578,14 @@ void blob_t::append_region(buf_parent_t parent, int64_t size) {
 }
 
 void blob_t::unappend_region(buf_parent_t parent, int64_t size) {
+    if (blob::is_contiguous(ref_, maxreflen_)) {
+        rassert(size <= valuesize());
+        if (size != 0) {
+            resize_contiguous(parent, valuesize() - size);
+        }
+        return;
+    }
+
     const max_block_size_t block_size = parent.cache()->max_block_size();
     int levels = blob::ref_info(block_size, ref_, maxreflen_).levels;
 
@@ -545,6 +612,69 @@ void blob_t::unappend_region(buf_parent_t parent, int64_t size) {
     }
 }
 
+void blob_t::create_contiguous(buf_parent_t parent, int64_t size) {
+    CT_ASSERT(blob::LEAF_NODE_DATA_OFFSET + BLOB_MAX_CONTIGUOUS_SIZE
+              + sizeof(ls_buf_data_t) <= UINT16_MAX);
+    rassert(valuesize() == 0);
+    buf_lock_t lock(parent, alt_create_t::create, block_type_t::aux);
+    {
+        buf_write_t write(&lock);
+        void *b = write.get_data_write(blob::LEAF_NODE_DATA_OFFSET + size);
+        *static_cast<block_magic_t *>(b) = blob::contiguous_node_magic;
+    }
+    blob::set_small_size_field(ref_, maxreflen_, blob::contiguous_marker(maxreflen_));
+    blob::set_big_size(ref_, maxreflen_, size);
+    blob::block_ids(ref_, maxreflen_)[0] = lock.block_id();
+}
+
+void blob_t::resize_contiguous(buf_parent_t parent, int64_t new_size) {
+    rassert(blob::is_contiguous(ref_, maxreflen_));
+    buf_lock_t lock(parent, blob::block_ids(ref_, maxreflen_)[0], access_t::write);
+    if (blob::size_would_be_small(new_size, maxreflen_)) {
+        // The value fits into the ref again, which overwrites the block id.
+        {
+            buf_read_t read(&lock);
+            uint32_t unused_block_size;
+            const char *data
+                = blob::leaf_node_data(read.get_data_read(&unused_block_size));
+            blob::set_small_size(ref_, maxreflen_, new_size);
+            memcpy(blob::small_buffer(ref_, maxreflen_), data, new_size);
+        }
+        lock.write_acq_signal()->wait_lazily_unordered();
+        lock.mark_deleted();
+    } else {
+        buf_write_t write(&lock);
+        write.get_data_write(blob::LEAF_NODE_DATA_OFFSET + new_size);
+        blob::set_big_size(ref_, maxreflen_, new_size);
+    }
+}
+
+void blob_t::contiguous_to_tree(buf_parent_t parent) {
+    rassert(blob::is_contiguous(ref_, maxreflen_));
+    const int64_t size = valuesize();
+    std::vector<char> data(size);
+    {
+        buf_lock_t lock(parent, blob::block_ids(ref_, maxreflen_)[0],
+                        access_t::write);
+        {
+            buf_read_t read(&lock);
+            uint32_t unused_block_size;
+            memcpy(data.data(),
+                   blob::leaf_node_data(read.get_data_read(&unused_block_size)),
+                   size);
+        }
+        lock.write_acq_signal()->wait_lazily_unordered();
+        lock.mark_deleted();
+    }
+    blob::set_small_size(ref_, maxreflen_, 0);
+    append_region(parent, size, blob::layout_t::tree);
+
+    buffer_group_t dest;
+    blob_acq_t acq;
+    expose_region(parent, access_t::write, 0, size, &dest, &acq);
+    buffer_group_copy_data(&dest, data.data(), size);
+}
+
 void blob_t::clear(buf_parent_t parent) {
     unappend_region(parent, valuesize());
 }
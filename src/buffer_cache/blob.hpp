@@ -56,6 +56,12 @@ memcpy(tmp, ref, blob::ref_size(bs, ref, mrl));
 // The ref size changed because we modified the blob.
 write_blob_ref_to_something(tmp, blob::ref_size(bs, ref, mrl));
 
+   Reading a large value from a tree means acquiring every block of it, which is a
+   serializer read per block if the value isn't cached.  That's why a value can
+   instead be stored in one block of its own size (see blob::layout_t::contiguous),
+   which takes a single read.  The ref of such a value looks like the ref of a big
+   value with a single block id, except that its size field holds maxreflen + 1.
+
  */
 
 class buf_lock_t;
@@ -97,6 +103,18 @@ namespace blob {
 
 struct traverse_helper_t;
 
+// How blob_t::append_region() stores a value that doesn't fit into the blob ref.
+enum class layout_t {
+    // In a tree of blocks of the cache's block size.
+    tree,
+    // In a single block of the value's size, if the blob is empty before the append
+    // and the value is at most BLOB_MAX_CONTIGUOUS_SIZE bytes large.  Appending to a
+    // contiguous blob keeps it contiguous until it outgrows that limit, and then
+    // turns it into a tree.  This isn't supported if maxreflen + 1 doesn't fit into
+    // the size field of the ref, in which case we use a tree.
+    contiguous
+};
+
 // Returns the number of bytes actually used by the blob reference.
 // Returns a value in the range [1, maxreflen].
 int ref_size(max_block_size_t block_size, const char *ref, int maxreflen);
@@ -185,7 +203,8 @@ public:
                     blob_acq_t *acq_group_out);
 
     // Appends size bytes of garbage data to the blob.
-    void append_region(buf_parent_t root, int64_t size);
+    void append_region(buf_parent_t root, int64_t size,
+                       blob::layout_t layout = blob::layout_t::tree);
 
     // Removes size bytes of data from the end of the blob.  size must
     // be <= valuesize().
@@ -217,6 +236,9 @@ private:
                                   int64_t new_size);
     int add_level(buf_parent_t parent, int levels);
     bool remove_level(buf_parent_t parent, int *levels_ref);
+    void create_contiguous(buf_parent_t parent, int64_t size);
+    void resize_contiguous(buf_parent_t parent, int64_t new_size);
+    void contiguous_to_tree(buf_parent_t parent);
 
     char *ref_;
     int maxreflen_;
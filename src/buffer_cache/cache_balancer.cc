@@ -3,6 +3,7 @@
 #include <limits>
 
 #include "buffer_cache/evicter.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/pmap.hpp"
 
@@ -148,51 +149,82 @@ void alt_cache_balancer_t::rebalance_blocking(UNUSED signal_t *interruptor) {
 
     // Calculate new cache sizes
     if (total_evicters > 0) {
-        uint64_t total_new_sizes = 0;
-
-        for (size_t i = 0; i < cache_data.size(); ++i) {
+        // Every NUMA node gets its own share of the total cache size, which is then
+        // balanced between the evicters on that node's threads.  This keeps the
+        // cache of a node from outgrowing the node's memory.  On a single node
+        // machine this is the same as balancing all evicters together.
+        const std::vector<numa_node_t> &nodes = get_numa_nodes();
+        scoped_array_t<size_t> thread_nodes(num_threads);
+        std::vector<size_t> node_evicters(nodes.size(), 0);
+        std::vector<uint64_t> node_bytes_loaded(nodes.size(), 0);
+        for (size_t i = 0; i < num_threads; ++i) {
+            thread_nodes[i] = get_thread_numa_node(threadnum_t(i));
+            node_evicters[thread_nodes[i]] += cache_data[i].size();
             for (size_t j = 0; j < cache_data[i].size(); ++j) {
-                cache_data_t *data = &cache_data[i][j];
-
-                if (total_cache_size > 0) {
-                    double temp = data->old_size;
-                    temp /= static_cast<double>(total_cache_size);
-                    temp *= static_cast<double>(total_bytes_loaded);
-
-                    int64_t new_size = std::max<int64_t>(0, data->bytes_loaded);
-                    new_size -= static_cast<int64_t>(temp);
-                    new_size += data->old_size;
-                    new_size = std::max<int64_t>(new_size, 0);
-
-                    data->new_size = new_size;
-                    total_new_sizes += new_size;
-                } else {
-                    data->new_size = 0;
-                }
+                node_bytes_loaded[thread_nodes[i]]
+                    += std::max<int64_t>(0, cache_data[i][j].bytes_loaded);
             }
         }
+        std::vector<uint64_t> node_cache_sizes
+            = split_cache_size_between_nodes(total_cache_size, nodes, node_evicters);
 
-        // Distribute any rounding error across shards
-        int64_t extra_bytes = total_cache_size - total_new_sizes;
-        while (extra_bytes != 0) {
-            int64_t delta = extra_bytes / static_cast<int64_t>(total_evicters);
-            if (delta == 0) {
-                delta = ((extra_bytes < 0) ? -1 : 1);
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            if (node_evicters[node] == 0) {
+                continue;
             }
-            for (size_t i = 0; i < cache_data.size() && extra_bytes != 0; ++i) {
-                for (size_t j = 0; j < cache_data[i].size() && extra_bytes != 0; ++j) {
+            const uint64_t node_cache_size = node_cache_sizes[node];
+            uint64_t node_new_sizes = 0;
+
+            for (size_t i = 0; i < cache_data.size(); ++i) {
+                if (thread_nodes[i] != node) {
+                    continue;
+                }
+                for (size_t j = 0; j < cache_data[i].size(); ++j) {
                     cache_data_t *data = &cache_data[i][j];
 
-                    // Avoid underflow
-                    if (static_cast<int64_t>(data->new_size) + delta >= 0) {
-                        data->new_size += delta;
-                        extra_bytes -= delta;
+                    if (node_cache_size > 0) {
+                        double temp = data->old_size;
+                        temp /= static_cast<double>(node_cache_size);
+                        temp *= static_cast<double>(node_bytes_loaded[node]);
+
+                        int64_t new_size = std::max<int64_t>(0, data->bytes_loaded);
+                        new_size -= static_cast<int64_t>(temp);
+                        new_size += data->old_size;
+                        new_size = std::max<int64_t>(new_size, 0);
+
+                        data->new_size = new_size;
+                        node_new_sizes += new_size;
                     } else {
-                        extra_bytes += data->new_size;
                         data->new_size = 0;
                     }
                 }
             }
+
+            // Distribute any rounding error across the node's shards
+            int64_t extra_bytes = node_cache_size - node_new_sizes;
+            while (extra_bytes != 0) {
+                int64_t delta = extra_bytes / static_cast<int64_t>(node_evicters[node]);
+                if (delta == 0) {
+                    delta = ((extra_bytes < 0) ? -1 : 1);
+                }
+                for (size_t i = 0; i < cache_data.size() && extra_bytes != 0; ++i) {
+                    if (thread_nodes[i] != node) {
+                        continue;
+                    }
+                    for (size_t j = 0; j < cache_data[i].size() && extra_bytes != 0; ++j) {
+                        cache_data_t *data = &cache_data[i][j];
+
+                        // Avoid underflow
+                        if (static_cast<int64_t>(data->new_size) + delta >= 0) {
+                            data->new_size += delta;
+                            extra_bytes -= delta;
+                        } else {
+                            extra_bytes += data->new_size;
+                            data->new_size = 0;
+                        }
+                    }
+                }
+            }
         }
 
         // Send new cache sizes to each thread
@@ -213,6 +245,50 @@ void alt_cache_balancer_t::rebalance_blocking(UNUSED signal_t *interruptor) {
     }
 }
 
+std::vector<uint64_t> split_cache_size_between_nodes(
+        uint64_t total_cache_size,
+        const std::vector<numa_node_t> &nodes,
+        const std::vector<size_t> &node_evicters) {
+    guarantee(nodes.size() == node_evicters.size());
+    // Nodes are weighted by their memory.  If we don't know the memory of some node
+    // we fall back to equal weights.
+    bool memory_known = true;
+    uint64_t total_weight = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (node_evicters[i] > 0) {
+            memory_known &= (nodes[i].memory_bytes > 0);
+            total_weight += nodes[i].memory_bytes;
+        }
+    }
+
+    std::vector<uint64_t> sizes(nodes.size(), 0);
+    size_t num_nodes_used = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        num_nodes_used += (node_evicters[i] > 0 ? 1 : 0);
+    }
+    if (num_nodes_used == 0) {
+        return sizes;
+    }
+
+    uint64_t remaining = total_cache_size;
+    size_t last_used = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (node_evicters[i] == 0) {
+            continue;
+        }
+        double share = memory_known
+            ? static_cast<double>(nodes[i].memory_bytes) / total_weight
+            : 1.0 / num_nodes_used;
+        sizes[i] = std::min<uint64_t>(
+            remaining, static_cast<uint64_t>(total_cache_size * share));
+        remaining -= sizes[i];
+        last_used = i;
+    }
+    // Hand the rounding error to the last node that has evicters.
+    sizes[last_used] += remaining;
+    return sizes;
+}
+
 void alt_cache_balancer_t::collect_stats_from_thread(
         int index,
         scoped_array_t<std::vector<cache_data_t> > *data_out,
@@ -18,6 +18,16 @@ namespace alt {
 class evicter_t;
 }
 
+struct numa_node_t;
+
+/* Splits the total cache size between the NUMA nodes that have evicters
+(`node_evicters[i] > 0`), in proportion to their memory.  The result sums up to
+`total_cache_size` unless no node has evicters. */
+std::vector<uint64_t> split_cache_size_between_nodes(
+        uint64_t total_cache_size,
+        const std::vector<numa_node_t> &nodes,
+        const std::vector<size_t> &node_evicters);
+
 // Base class so we can have a dummy implementation for tests
 class cache_balancer_t : public home_thread_mixin_t {
 public:
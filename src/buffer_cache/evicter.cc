@@ -1,5 +1,8 @@
 #include "buffer_cache/evicter.hpp"
 
+#include <algorithm>
+#include <atomic>
+
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/page.hpp"
@@ -8,12 +11,24 @@
 
 namespace alt {
 
+static std::atomic<page_repl_policy_t> table_page_repl_policy(
+    page_repl_policy_t::sampling);
+
+void set_table_page_repl_policy(page_repl_policy_t policy) {
+    table_page_repl_policy.store(policy);
+}
+
+page_repl_policy_t get_table_page_repl_policy() {
+    return table_page_repl_policy.load();
+}
+
 evicter_t::evicter_t()
     : initialized_(false),
       page_cache_(nullptr),
       balancer_(nullptr),
       balancer_notify_activity_boolean_(nullptr),
       throttler_(nullptr),
+      policy_(page_repl_policy_t::sampling),
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
@@ -30,12 +45,14 @@ evicter_t::~evicter_t() {
 
 void evicter_t::initialize(page_cache_t *page_cache,
                            cache_balancer_t *balancer,
-                           alt_txn_throttler_t *throttler) {
+                           alt_txn_throttler_t *throttler,
+                           page_repl_policy_t policy) {
     assert_thread();
     guarantee(balancer != nullptr);
     initialized_ = true;  // Can you really say this class is 'initialized_'?
     page_cache_ = page_cache;
     memory_limit_ = balancer->base_mem_per_store();
+    policy_ = policy;
     page_cache_ = page_cache;
     throttler_ = throttler;
     balancer_ = balancer;
@@ -154,7 +171,10 @@ void evicter_t::add_to_evictable_unbacked(page_t *page) {
 void evicter_t::add_to_evictable_disk_backed(page_t *page) {
     assert_thread();
     guarantee(initialized_);
-    evictable_disk_backed_.add(page, page->hypothetical_memory_usage(page_cache_));
+    eviction_bag_t *bag = correct_eviction_category(page);
+    rassert(bag == &evictable_disk_backed_
+            || bag == &evictable_disk_backed_probation_);
+    bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
@@ -166,6 +186,7 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     unevictable_.remove(page, page->hypothetical_memory_usage(page_cache_));
     eviction_bag_t *new_bag = correct_eviction_category(page);
     rassert(new_bag == &evictable_disk_backed_
+            || new_bag == &evictable_disk_backed_probation_
             || new_bag == &evictable_unbacked_);
     new_bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
@@ -190,6 +211,9 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->is_loaded()) {
         return &evicted_;
     } else if (page->is_disk_backed()) {
+        if (policy_ == page_repl_policy_t::two_queue && !page->is_hot()) {
+            return &evictable_disk_backed_probation_;
+        }
         return &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
@@ -209,6 +233,7 @@ uint64_t evicter_t::in_memory_size() const {
     guarantee(initialized_);
     return unevictable_.size()
         + evictable_disk_backed_.size()
+        + evictable_disk_backed_probation_.size()
         + evictable_unbacked_.size();
 }
 
@@ -229,16 +254,44 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
 
     evict_if_necessary_active_ = true;
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
-                                                   page_cache_)) {
+    while (in_memory_size() > memory_limit_ && remove_page_to_evict(&page)) {
         evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
+        page->reset_hotness();
         page->evict_self(page_cache_);
         page_cache_->consider_evicting_current_page(page->block_id());
     }
     evict_if_necessary_active_ = false;
 }
 
+bool evicter_t::remove_page_to_evict(page_t **page_out) {
+    for (;;) {
+        eviction_bag_t *first = &evictable_disk_backed_;
+        eviction_bag_t *second = &evictable_disk_backed_probation_;
+        if (evictable_disk_backed_probation_.size()
+            > memory_limit_ * PAGE_REPL_PROBATION_FRACTION) {
+            std::swap(first, second);
+        }
+        eviction_bag_t *bag = first;
+        if (!bag->remove_oldish(page_out, access_time_counter_, page_cache_)) {
+            bag = second;
+            if (!bag->remove_oldish(page_out, access_time_counter_, page_cache_)) {
+                return false;
+            }
+        }
+        if (policy_ == page_repl_policy_t::two_queue
+            && bag == &evictable_disk_backed_) {
+            // Instead of evicting a hot page, we demote it.  It gets evicted from the
+            // probationary bag unless it's acquired again before that.  This
+            // terminates because every hot page can only be demoted once.
+            (*page_out)->demote();
+            evictable_disk_backed_probation_.add(
+                *page_out, (*page_out)->hypothetical_memory_usage(page_cache_));
+            continue;
+        }
+        return true;
+    }
+}
+
 usage_adjuster_t::usage_adjuster_t(page_cache_t *page_cache, page_t *page)
     : page_cache_(page_cache),
       page_(page),
@@ -18,6 +18,21 @@ namespace alt {
 
 class page_cache_t;
 
+// How the evicter picks the pages to evict.  With `sampling`, it evicts the least
+// recently used of a few randomly sampled evictable pages.  With `two_queue`, pages
+// that have been acquired only once (or only by scans) are kept apart, in a
+// probationary bag, and are evicted first as long as they take up more than
+// PAGE_REPL_PROBATION_FRACTION of the memory limit.  This is the idea of the 2Q
+// algorithm, and it keeps a single large scan from evicting the working set.  Hot
+// pages that the evicter comes across are demoted to the probationary bag, so they
+// have to be acquired again to stay hot.
+enum class page_repl_policy_t { sampling, two_queue };
+
+// The policy of the caches of tables, `sampling` unless it's set otherwise (with
+// `--cache-replacement` on the command line).
+void set_table_page_repl_policy(page_repl_policy_t policy);
+page_repl_policy_t get_table_page_repl_policy();
+
 class evicter_t : public home_thread_mixin_debug_only_t {
 public:
     void add_not_yet_loaded(page_t *page);
@@ -41,7 +56,8 @@ public:
 
     void initialize(page_cache_t *page_cache,
                     cache_balancer_t *balancer,
-                    alt_txn_throttler_t *throttler);
+                    alt_txn_throttler_t *throttler,
+                    page_repl_policy_t policy);
     void update_memory_limit(uint64_t new_memory_limit,
                              int64_t bytes_loaded_accounted_for,
                              uint64_t access_count_accounted_for,
@@ -71,6 +87,10 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    // Picks a page to evict and removes it from its eviction bag.  Returns false if
+    // there are no evictable pages.
+    bool remove_page_to_evict(page_t **page_out);
+
     bool initialized_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
@@ -80,6 +100,8 @@ private:
 
     uint64_t memory_limit_;
 
+    page_repl_policy_t policy_;
+
     // These are updated every time a page is loaded, created, or destroyed, and
     // cleared when cache memory limits are re-evaluated.  This value can go
     // negative, if you keep deleting blocks or suddenly drop a snapshot.
@@ -96,6 +118,9 @@ private:
     // These track every page's eviction status.
     eviction_bag_t unevictable_;
     eviction_bag_t evictable_disk_backed_;
+    // Disk backed pages that are not hot (see page_t::is_hot()), if `policy_` is
+    // `two_queue`.
+    eviction_bag_t evictable_disk_backed_probation_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
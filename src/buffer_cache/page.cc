@@ -56,6 +56,8 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache)
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      was_acquired_(false),
+      is_hot_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_deferred_loaded(this);
 
@@ -70,6 +72,8 @@ page_t::page_t(block_id_t _block_id, page_cache_t *page_cache,
     : block_id_(_block_id),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      was_acquired_(false),
+      is_hot_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
@@ -86,6 +90,8 @@ page_t::page_t(block_id_t _block_id, buf_ptr_t buf,
       loader_(nullptr),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      was_acquired_(false),
+      is_hot_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -100,6 +106,8 @@ page_t::page_t(block_id_t _block_id,
       buf_(std::move(buf)),
       block_token_(_block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      was_acquired_(false),
+      is_hot_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -109,6 +117,8 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
     : block_id_(copyee->block_id_),
       loader_(nullptr),
       access_time_(page_cache->evicter().next_access_time()),
+      was_acquired_(copyee->was_acquired_),
+      is_hot_(copyee->is_hot_),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -146,7 +156,8 @@ void page_t::load_from_copyee(page_t *page, page_t *copyee,
     // Okay, it's safe to block.
     {
         page_acq_t acq;
-        acq.init(copyee, page_cache, account);
+        // Copying the page isn't an access that should make the copyee hot.
+        acq.init(copyee, page_cache, account, page_access_pattern_t::scan);
         acq.buf_ready_signal()->wait();
 
         ASSERT_FINITE_CORO_WAITING;
@@ -414,6 +425,10 @@ void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
     eviction_bag_t *old_bag
         = acq->page_cache()->evicter().correct_eviction_category(this);
     waiters_.push_front(acq);
+    if (acq->access_pattern_ == page_access_pattern_t::normal) {
+        is_hot_ = is_hot_ || was_acquired_;
+        was_acquired_ = true;
+    }
     acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
     if (buf_.has()) {
         acq->buf_ready_signal_.pulse();
@@ -582,16 +597,20 @@ void page_t::init_block_token(counted_t<standard_block_token_t> token,
 
 
 
-page_acq_t::page_acq_t() : page_(nullptr), page_cache_(nullptr) {
+page_acq_t::page_acq_t()
+    : page_(nullptr), page_cache_(nullptr),
+      access_pattern_(page_access_pattern_t::normal) {
 }
 
 void page_acq_t::init(page_t *page, page_cache_t *_page_cache,
-                      cache_account_t *account) {
+                      cache_account_t *account,
+                      page_access_pattern_t access_pattern) {
     rassert(page_ == nullptr);
     rassert(page_cache_ == nullptr);
     rassert(!buf_ready_signal_.is_pulsed());
     page_ = page;
     page_cache_ = _page_cache;
+    access_pattern_ = access_pattern;
     page_->add_waiter(this, account);
 }
 
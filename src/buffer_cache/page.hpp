@@ -3,6 +3,7 @@
 
 #include "concurrency/cond_var.hpp"
 #include "containers/backindex_bag.hpp"
+#include "buffer_cache/types.hpp"
 #include "containers/half_intrusive_list.hpp"
 #include "repli_timestamp.hpp"
 #include "serializer/buf_ptr.hpp"
@@ -56,6 +57,19 @@ public:
     uint32_t hypothetical_memory_usage(page_cache_t *page_cache) const;
     uint64_t access_time() const { return access_time_; }
 
+    // True if the page has been acquired more than once, not counting acquisitions
+    // by scans, since it was loaded or last demoted.  Used by
+    // page_repl_policy_t::two_queue.
+    bool is_hot() const { return is_hot_; }
+    // The page stops being hot, but the next acquisition makes it hot again.
+    void demote() { is_hot_ = false; }
+    // For when the page gets evicted: once it's loaded again, it takes two more
+    // acquisitions to make it hot.
+    void reset_hotness() {
+        was_acquired_ = false;
+        is_hot_ = false;
+    }
+
     bool is_loading() const {
         return loader_ != nullptr && page_t::loader_is_loading(loader_);
     }
@@ -132,6 +146,13 @@ private:
 
     uint64_t access_time_;
 
+    // Whether the page has been acquired (not counting scans), and whether it has
+    // been acquired more than once.  These are set while the page has waiters,
+    // i.e. while it's in the unevictable bag, and cleared by the evicter when it
+    // moves the page between eviction bags.
+    bool was_acquired_;
+    bool is_hot_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -146,7 +167,8 @@ private:
     // if loader_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
     // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_pages_
+    // else if block_token_ is non-null: evictable_disk_backed_pages_ (or the
+    //     probationary bag, if the page isn't hot)
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
     // So, when loader_, waiters_, buf_, or block_token_ is touched, we might
@@ -227,7 +249,8 @@ public:
     page_acq_t();
     ~page_acq_t();
 
-    void init(page_t *page, page_cache_t *page_cache, cache_account_t *account);
+    void init(page_t *page, page_cache_t *page_cache, cache_account_t *account,
+              page_access_pattern_t access_pattern = page_access_pattern_t::normal);
 
     page_cache_t *page_cache() const {
         rassert(page_cache_ != NULL);
@@ -247,6 +270,7 @@ private:
 
     page_t *page_;
     page_cache_t *page_cache_;
+    page_access_pattern_t access_pattern_;
     cond_t buf_ready_signal_;
     DISABLE_COPYING(page_acq_t);
 };
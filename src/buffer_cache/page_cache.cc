@@ -203,7 +203,8 @@ public:
 
 page_cache_t::page_cache_t(serializer_t *_serializer,
                            cache_balancer_t *balancer,
-                           alt_txn_throttler_t *throttler)
+                           alt_txn_throttler_t *throttler,
+                           page_repl_policy_t page_repl_policy)
     : max_block_size_(_serializer->max_block_size()),
       serializer_(_serializer),
       free_list_(_serializer),
@@ -235,7 +236,7 @@ page_cache_t::page_cache_t(serializer_t *_serializer,
     // initialize the read_ahead_cb_ after the evicter_ because that way reentrant
     // usage by the balancer (before page_cache_t construction completes) would be
     // more likely to trip an assertion.
-    evicter_.initialize(this, balancer, throttler);
+    evicter_.initialize(this, balancer, throttler, page_repl_policy);
     read_ahead_cb_ = local_read_ahead_cb;
 }
 
@@ -353,6 +354,21 @@ current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     return page_it->second;
 }
 
+const void *page_cache_t::peek_block_for_read(block_id_t block_id,
+                                              uint32_t *block_size_out) {
+    assert_thread();
+    auto page_it = current_pages_.find(block_id);
+    if (page_it == current_pages_.end()) {
+        return nullptr;
+    }
+    page_t *page = page_it->second->the_page_for_peek();
+    if (page == nullptr) {
+        return nullptr;
+    }
+    *block_size_out = page->get_page_buf_size().value();
+    return page->get_page_buf(this);
+}
+
 current_page_t *page_cache_t::page_for_new_block_id(
         block_type_t block_type,
         block_id_t *block_id_out) {
@@ -931,6 +947,21 @@ page_t *current_page_t::the_page_for_read(current_page_help_t help,
     return page_.get_page_for_read();
 }
 
+page_t *current_page_t::the_page_for_peek() {
+    if (is_deleted_ || !page_.has()) {
+        return nullptr;
+    }
+    // Only the first acquirer can hold write access, and it gets it as soon as it
+    // becomes the first one.  Write acquirers further back in line haven't changed
+    // anything yet.
+    current_page_acq_t *first = acquirers_.head();
+    if (first != nullptr && first->access_ == access_t::write) {
+        return nullptr;
+    }
+    page_t *page = page_.get_page_for_read();
+    return page->is_loaded() ? page : nullptr;
+}
+
 page_t *current_page_t::the_page_for_read_or_deleted(current_page_help_t help) {
     if (is_deleted_) {
         return nullptr;
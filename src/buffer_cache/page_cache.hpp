@@ -123,6 +123,9 @@ private:
     // Returns NULL if the page was deleted.
     page_t *the_page_for_read_or_deleted(current_page_help_t help);
 
+    // Returns NULL unless the page is in memory and no write acquirer holds it.
+    page_t *the_page_for_peek();
+
     // Has access to our fields.
     friend class page_cache_t;
 
@@ -327,7 +330,8 @@ class page_cache_t : public home_thread_mixin_t {
 public:
     page_cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 alt_txn_throttler_t *throttler);
+                 alt_txn_throttler_t *throttler,
+                 page_repl_policy_t page_repl_policy = page_repl_policy_t::sampling);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() (which resets the
@@ -342,6 +346,12 @@ public:
         block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // Returns the current contents of the block if they can be read without getting
+    // in line for the block, that is if the block is in memory and no write acquirer
+    // holds it, or NULL otherwise.  Never blocks.  The contents are only valid until
+    // the caller blocks.
+    const void *peek_block_for_read(block_id_t block_id, uint32_t *block_size_out);
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
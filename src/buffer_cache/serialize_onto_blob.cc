@@ -1,9 +1,9 @@
 #include "buffer_cache/serialize_onto_blob.hpp"
 
 void write_onto_blob(buf_parent_t parent, blob_t *blob,
-                     const write_message_t &wm) {
+                     const write_message_t &wm, blob::layout_t layout) {
     blob->clear(parent);
-    blob->append_region(parent, wm.size());
+    blob->append_region(parent, wm.size(), layout);
 
     blob_acq_t acq;
     buffer_group_t group;
@@ -9,7 +9,8 @@
 #include "version.hpp"
 
 void write_onto_blob(buf_parent_t parent, blob_t *blob,
-                     const write_message_t &wm);
+                     const write_message_t &wm,
+                     blob::layout_t layout = blob::layout_t::tree);
 
 template <cluster_version_t W, class T>
 void serialize_onto_blob(buf_parent_t parent, blob_t *blob,
@@ -14,6 +14,10 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(write_durability_t, int8_t,
                                       write_durability_t::SOFT,
                                       write_durability_t::HARD);
 
+// Tells the cache how a transaction accesses its pages.  Pages acquired by a `scan`
+// (such as a backfill or a full table traversal) are not expected to be accessed
+// again soon, so they don't count as accesses that keep a page in the cache.
+enum class page_access_pattern_t { normal, scan };
 
 typedef uint32_t block_magic_comparison_t;
 
@@ -88,7 +88,7 @@ void jobs_manager_t::on_get_job_reports(
                     }
 
                     auto render = pprint::render_as_javascript(
-                        pair.second->term_storage->root_term());
+                        pair.second->get_term_storage()->root_term());
 
                     query_job_reports_inner.emplace_back(
                         pair.second->job_id,
@@ -41,6 +41,7 @@
 #include "arch/io/disk.hpp"
 #include "arch/io/openssl.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/numa.hpp"
 #include "arch/runtime/starter.hpp"
 #include "arch/filesystem.hpp"
 
@@ -61,6 +62,8 @@
 #include "clustering/administration/persist/migrate/migrate_v1_16.hpp"
 #include "clustering/administration/persist/migrate/migrate_v2_1.hpp"
 #include "clustering/administration/servers/server_metadata.hpp"
+#include "buffer_cache/evicter.hpp"
+#include "containers/block_slab.hpp"
 #include "containers/scoped.hpp"
 #include "crypto/random.hpp"
 #include "logger.hpp"
@@ -1045,6 +1048,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           boost::optional<uint64_t> total_cache_size,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const io_backend_t io_backend,
                           bool *const result_out) {
     server_id_t our_server_id = server_id_t::generate_server_id();
 
@@ -1058,7 +1062,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     server_config.config.cache_size_bytes = total_cache_size;
     server_config.version = 1;
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1139,6 +1143,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          const std::string &initial_password,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const io_backend_t io_backend,
                          const boost::optional<boost::optional<uint64_t> >
                             &total_cache_size,
                          const server_id_t *our_server_id,
@@ -1156,7 +1161,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logNTC("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -1281,6 +1286,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const std::string &initial_password,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const io_backend_t io_backend,
                              const boost::optional<boost::optional<uint64_t> >
                                 &total_cache_size,
                              const bool new_directory,
@@ -1289,7 +1295,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests, total_cache_size,
+                            max_concurrent_io_requests, io_backend, total_cache_size,
                             nullptr, nullptr, nullptr, data_directory_lock,
                             result_out);
     } else {
@@ -1325,7 +1331,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         server_config.version = 1;
 
         run_rethinkdb_serve(base_path, serve_info, initial_password, direct_io_mode,
-                            max_concurrent_io_requests,
+                            max_concurrent_io_requests, io_backend,
                             boost::optional<boost::optional<uint64_t> >(),
                             &our_server_id, &server_config, &cluster_metadata,
                             data_directory_lock, result_out);
@@ -1404,16 +1410,45 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              strprintf("%d", DEFAULT_MAX_CONCURRENT_IO_REQUESTS)));
     help.add("--io-threads n",
              "how many simultaneous I/O operations can happen at the same time");
+    options_out->push_back(options::option_t(options::names_t("--io-backend"),
+                                             options::OPTIONAL,
+                                             "pool"));
+    help.add("--io-backend pool|uring",
+             "how I/O operations are passed to the kernel: 'pool' runs blocking calls "
+             "in a thread pool, 'uring' uses Linux io_uring (falls back to 'pool' if "
+             "unavailable)");
 #ifndef _WIN32
     // TODO WINDOWS: accept this option, but error out if it is passed
     options_out->push_back(options::option_t(options::names_t("--direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--direct-io", "use direct I/O for file access");
 #endif
+    options_out->push_back(options::option_t(options::names_t("--block-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--block-compression none|zlib",
+             "compress the data blocks that get written to table files (files "
+             "written with compression can't be read by older versions)");
     options_out->push_back(options::option_t(options::names_t("--cache-size"),
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process. Can "
         "be 'auto'.");
+    options_out->push_back(options::option_t(options::names_t("--cache-huge-pages"),
+                                             options::OPTIONAL,
+                                             "off"));
+    help.add("--cache-huge-pages off|transparent|explicit",
+             "back the cache with 2 MB huge pages: 'transparent' asks the kernel for "
+             "transparent huge pages, 'explicit' uses the huge pages reserved through "
+             "vm.nr_hugepages (and falls back to transparent huge pages when they run "
+             "out)");
+    options_out->push_back(options::option_t(options::names_t("--cache-replacement"),
+                                             options::OPTIONAL,
+                                             "sampling"));
+    help.add("--cache-replacement sampling|two-queue",
+             "how the cache picks the pages to evict: 'sampling' evicts the least "
+             "recently used of a few random pages, 'two-queue' keeps pages that "
+             "have been used only once apart so that large scans don't evict the "
+             "pages that are used repeatedly");
     return help;
 }
 
@@ -1630,6 +1665,11 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--numa-pinning"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--numa-pinning",
+             "keep each thread on the CPUs of one NUMA node, so that the cache "
+             "memory it uses stays local to it");
     return help;
 }
 
@@ -1896,6 +1936,72 @@ file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, op
         file_direct_io_mode_t::buffered_desired;
 }
 
+MUST_USE bool parse_io_backend_option(const std::map<std::string, options::values_t> &opts,
+                                      io_backend_t *io_backend_out) {
+    const std::string io_backend = get_single_option(opts, "--io-backend");
+    if (io_backend == "pool") {
+        *io_backend_out = io_backend_t::pool;
+    } else if (io_backend == "uring") {
+        *io_backend_out = io_backend_t::uring;
+    } else {
+        fprintf(stderr, "ERROR: io-backend must be either 'pool' or 'uring', got '%s'\n",
+                io_backend.c_str());
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_block_compression_option(
+        const std::map<std::string, options::values_t> &opts,
+        block_codec_t *block_codec_out) {
+    const std::string block_compression
+        = get_single_option(opts, "--block-compression");
+    if (block_compression == "none") {
+        *block_codec_out = block_codec_t::none;
+    } else if (block_compression == "zlib") {
+        *block_codec_out = block_codec_t::zlib;
+    } else {
+        fprintf(stderr, "ERROR: block-compression must be either 'none' or 'zlib', "
+                "got '%s'\n", block_compression.c_str());
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_cache_huge_pages_option(
+        const std::map<std::string, options::values_t> &opts,
+        block_slab_huge_pages_t *huge_pages_out) {
+    const std::string huge_pages = get_single_option(opts, "--cache-huge-pages");
+    if (huge_pages == "off") {
+        *huge_pages_out = block_slab_huge_pages_t::off;
+    } else if (huge_pages == "transparent") {
+        *huge_pages_out = block_slab_huge_pages_t::transparent;
+    } else if (huge_pages == "explicit") {
+        *huge_pages_out = block_slab_huge_pages_t::hugetlb;
+    } else {
+        fprintf(stderr, "ERROR: cache-huge-pages must be 'off', 'transparent' or "
+                "'explicit', got '%s'\n", huge_pages.c_str());
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_cache_replacement_option(
+        const std::map<std::string, options::values_t> &opts,
+        alt::page_repl_policy_t *policy_out) {
+    const std::string policy = get_single_option(opts, "--cache-replacement");
+    if (policy == "sampling") {
+        *policy_out = alt::page_repl_policy_t::sampling;
+    } else if (policy == "two-queue") {
+        *policy_out = alt::page_repl_policy_t::two_queue;
+    } else {
+        fprintf(stderr, "ERROR: cache-replacement must be 'sampling' or 'two-queue', "
+                "got '%s'\n", policy.c_str());
+        return false;
+    }
+    return true;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1926,6 +2032,23 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        block_slab_huge_pages_t cache_huge_pages;
+        if (!parse_cache_huge_pages_option(opts, &cache_huge_pages)) {
+            return EXIT_FAILURE;
+        }
+        set_block_slab_huge_pages(cache_huge_pages);
+
+        alt::page_repl_policy_t cache_replacement;
+        if (!parse_cache_replacement_option(opts, &cache_replacement)) {
+            return EXIT_FAILURE;
+        }
+        alt::set_table_page_repl_policy(cache_replacement);
+
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         const int num_workers = get_cpu_count();
 
         bool is_new_directory = false;
@@ -1955,6 +2078,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      total_cache_size,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -2048,12 +2172,35 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        set_numa_pinning(exists_option(opts, "--numa-pinning"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        block_slab_huge_pages_t cache_huge_pages;
+        if (!parse_cache_huge_pages_option(opts, &cache_huge_pages)) {
+            return EXIT_FAILURE;
+        }
+        set_block_slab_huge_pages(cache_huge_pages);
+
+        alt::page_repl_policy_t cache_replacement;
+        if (!parse_cache_replacement_option(opts, &cache_replacement)) {
+            return EXIT_FAILURE;
+        }
+        alt::set_table_page_repl_policy(cache_replacement);
+
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        block_codec_t block_codec;
+        if (!parse_block_compression_option(opts, &block_codec)) {
+            return EXIT_FAILURE;
+        }
+
         update_check_t do_update_checking = parse_update_checking_option(opts);
 
         boost::optional<boost::optional<uint64_t> > total_cache_size =
@@ -2106,7 +2253,8 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 node_reconnect_timeout_secs
                                     ? node_reconnect_timeout_secs.get()
                                     : cluster_defaults::reconnect_timeout,
-                                tls_configs);
+                                tls_configs,
+                                block_codec);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -2117,6 +2265,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      static_cast<server_id_t*>(nullptr),
                                      static_cast<server_config_versioned_t *>(nullptr),
@@ -2211,7 +2360,8 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 node_reconnect_timeout_secs
                                     ? node_reconnect_timeout_secs.get()
                                     : cluster_defaults::reconnect_timeout,
-                                tls_configs);
+                                tls_configs,
+                                block_codec_t::none);
 
         bool result;
         run_in_thread_pool(
@@ -2323,12 +2473,35 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        set_numa_pinning(exists_option(opts, "--numa-pinning"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        block_slab_huge_pages_t cache_huge_pages;
+        if (!parse_cache_huge_pages_option(opts, &cache_huge_pages)) {
+            return EXIT_FAILURE;
+        }
+        set_block_slab_huge_pages(cache_huge_pages);
+
+        alt::page_repl_policy_t cache_replacement;
+        if (!parse_cache_replacement_option(opts, &cache_replacement)) {
+            return EXIT_FAILURE;
+        }
+        alt::set_table_page_repl_policy(cache_replacement);
+
+        io_backend_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
+        block_codec_t block_codec;
+        if (!parse_block_compression_option(opts, &block_codec)) {
+            return EXIT_FAILURE;
+        }
+
         update_check_t do_update_checking = parse_update_checking_option(opts);
 
         boost::optional<int> join_delay_secs = parse_join_delay_secs_option(opts);
@@ -2403,7 +2576,8 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 node_reconnect_timeout_secs
                                     ? node_reconnect_timeout_secs.get()
                                     : cluster_defaults::reconnect_timeout,
-                                tls_configs);
+                                tls_configs,
+                                block_codec);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -2415,6 +2589,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      initial_password,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      is_new_directory,
                                      &serve_info,
@@ -280,7 +280,11 @@ bool do_serve(io_backender_t *io_backender,
                               nullptr,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              io_backender,
+                              i_am_a_server
+                                  ? boost::make_optional(base_path)
+                                  : boost::none);
         {
             /* Extract a subview of the directory with all the table meta manager
             business cards. */
@@ -306,6 +310,7 @@ bool do_serve(io_backender_t *io_backender,
                 table_persistence_interface.init(
                     new real_table_persistence_interface_t(
                         io_backender,
+                        serve_info.block_codec,
                         cache_balancer.get(),
                         base_path,
                         &rdb_ctx,
@@ -13,6 +13,7 @@
 #include "clustering/administration/main/version_check.hpp"
 #include "arch/address.hpp"
 #include "arch/io/openssl.hpp"
+#include "serializer/log/block_codec.hpp"
 
 class os_signal_cond_t;
 
@@ -120,7 +121,8 @@ public:
                  std::vector<std::string> &&_argv,
                  const int _join_delay_secs,
                  const int _node_reconnect_timeout_secs,
-                 tls_configs_t _tls_configs) :
+                 tls_configs_t _tls_configs,
+                 block_codec_t _block_codec) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
         web_assets(std::move(_web_assets)),
@@ -129,7 +131,8 @@ public:
         config_file(_config_file),
         argv(std::move(_argv)),
         join_delay_secs(_join_delay_secs),
-        node_reconnect_timeout_secs(_node_reconnect_timeout_secs)
+        node_reconnect_timeout_secs(_node_reconnect_timeout_secs),
+        block_codec(_block_codec)
     {
         tls_configs = _tls_configs;
     }
@@ -151,6 +154,8 @@ public:
     int join_delay_secs;
     int node_reconnect_timeout_secs;
     tls_configs_t tls_configs;
+    /* How table files compress the blocks they write. */
+    block_codec_t block_codec;
 };
 
 /* This has been factored out from `command_line.hpp` because it takes a very
@@ -23,6 +23,7 @@ public:
             scoped_ptr_t<real_branch_history_manager_t> &&bhm,
             const base_path_t &base_path,
             io_backender_t *io_backender,
+            block_codec_t block_codec,
             cache_balancer_t *cache_balancer,
             rdb_context_t *rdb_context,
             perfmon_collection_t *perfmon_collection_serializers,
@@ -62,8 +63,10 @@ public:
         // TODO: Could we handle failure when loading the serializer?  Right
         // now, we don't.
 
+        log_serializer_t::dynamic_config_t dynamic_config;
+        dynamic_config.block_codec = block_codec;
         scoped_ptr_t<serializer_t> inner_serializer(new log_serializer_t(
-            log_serializer_t::dynamic_config_t(),
+            dynamic_config,
             &file_opener,
             perfmon_collection_serializers));
         serializer.init(new merger_serializer_t(
@@ -292,6 +295,7 @@ void real_table_persistence_interface_t::load_multistore(
         std::move(bhm),
         base_path,
         io_backender,
+        block_codec,
         cache_balancer,
         rdb_context,
         perfmon_collection_serializers,
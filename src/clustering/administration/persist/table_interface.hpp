@@ -5,6 +5,7 @@
 #include "clustering/administration/perfmon_collection_repo.hpp"
 #include "clustering/administration/persist/raft_storage_interface.hpp"
 #include "clustering/table_manager/table_metadata.hpp"
+#include "serializer/log/block_codec.hpp"
 
 class cache_balancer_t;
 class metadata_file_t;
@@ -16,11 +17,13 @@ class real_table_persistence_interface_t :
 public:
     real_table_persistence_interface_t(
             io_backender_t *_io_backender,
+            block_codec_t _block_codec,
             cache_balancer_t *_cache_balancer,
             const base_path_t &_base_path,
             rdb_context_t *_rdb_context,
             metadata_file_t *_metadata_file) :
         io_backender(_io_backender),
+        block_codec(_block_codec),
         cache_balancer(_cache_balancer),
         base_path(_base_path),
         rdb_context(_rdb_context),
@@ -77,6 +80,9 @@ private:
     threadnum_t pick_thread();
 
     io_backender_t * const io_backender;
+    // How the serializers of the tables compress their blocks.  This only affects
+    // blocks that get written from now on.
+    block_codec_t const block_codec;
     cache_balancer_t * const cache_balancer;
     base_path_t const base_path;
     rdb_context_t * const rdb_context;
@@ -0,0 +1,24 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "concurrency/queue/spilling_queue.hpp"
+
+spill_file_t::spill_file_t(io_backender_t *_io_backender,
+                           const serializer_filepath_t &_filename)
+    : io_backender(_io_backender), filename(_filename) { }
+
+spill_file_t::~spill_file_t() {
+    // The last reference might have been dropped on another thread.
+    if (file.has()) {
+        on_thread_t th(home_thread());
+        file.reset();
+    }
+}
+
+disk_backed_queue_file_t *spill_file_t::get() {
+    assert_thread();
+    new_mutex_acq_t acq(&mutex);
+    if (!file.has()) {
+        file.init(new disk_backed_queue_file_t(
+            io_backender, filename, &perfmon_collection));
+    }
+    return file.get();
+}
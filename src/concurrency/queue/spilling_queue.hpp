@@ -0,0 +1,249 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_QUEUE_SPILLING_QUEUE_HPP_
+#define CONCURRENCY_QUEUE_SPILLING_QUEUE_HPP_
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/counted.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "perfmon/core.hpp"
+#include "threading.hpp"
+
+/* The file that a group of `spilling_queue_t`s spill to, so that they don't each need
+a file, serializer and cache of their own.  The file is created on the home thread
+the first time one of the queues spills, and removed once the last reference to it
+goes away. */
+class spill_file_t :
+    public home_thread_mixin_t,
+    public slow_atomic_countable_t<spill_file_t> {
+public:
+    spill_file_t(io_backender_t *io_backender, const serializer_filepath_t &filename);
+    ~spill_file_t();
+
+    // Creates the file if it doesn't exist yet.  Must be called on the home thread.
+    disk_backed_queue_file_t *get();
+
+private:
+    io_backender_t *const io_backender;
+    const serializer_filepath_t filename;
+    perfmon_collection_t perfmon_collection;
+
+    new_mutex_t mutex;
+    scoped_ptr_t<disk_backed_queue_file_t> file;
+
+    DISABLE_COPYING(spill_file_t);
+};
+
+// The most values `spilling_queue_t::load` moves per trip to the file's thread.
+const size_t SPILLING_QUEUE_LOAD_BATCH_SIZE = 64;
+
+/* A queue that keeps at most about `memory_budget` bytes of values in memory, and moves
+the others to a queue in a `spill_file_t`.  `push` and `pop` never block.  Values are
+moved to disk by a coroutine that `push` spawns, and moved back by `load`, which
+the consumer calls before it waits for values.
+
+The values are kept in order in three parts: `head` (the oldest ones, loaded back
+from disk), the disk queue, and `tail` (the newest ones).  While anything is on disk
+or on its way there, only `head` can be popped.  `clear` can't touch the disk, so it
+just counts the values on disk as ones to drop when they're loaded.  Spilling and
+loading hold `disk_mutex`, so `load` waits for values on their way to disk.
+
+`memory_size` estimates how much memory a value takes.  It's only called when a
+value is pushed; values loaded back from disk are sized by their serialization.
+Values are serialized and deserialized on the queue's thread, and only their bytes
+go to the file's thread. */
+template <class T>
+class spilling_queue_t {
+public:
+    spilling_queue_t(size_t _memory_budget,
+                     std::function<size_t(const T &)> _memory_size,
+                     counted_t<spill_file_t> _file)
+        : memory_budget(_memory_budget),
+          memory_size(std::move(_memory_size)),
+          file(std::move(_file)),
+          memory_bytes(0),
+          on_disk(0),
+          in_flight(0),
+          to_drop(0),
+          generation(0),
+          spilling(false) {
+        guarantee(file.has());
+    }
+
+    ~spilling_queue_t() {
+        drainer.drain();
+        if (disk_queue.has()) {
+            on_thread_t th(file->home_thread());
+            disk_queue.reset();
+        }
+    }
+
+    void push(T value) {
+        const size_t value_size = memory_size(value);
+        memory_bytes += value_size;
+        tail.push_back(std::make_pair(std::move(value), value_size));
+        if (memory_bytes > memory_budget && !spilling) {
+            spilling = true;
+            coro_t::spawn_sometime(
+                std::bind(&spilling_queue_t<T>::spill, this, drainer.lock()));
+        }
+    }
+
+    size_t size() const {
+        return head.size() + on_disk + in_flight + tail.size();
+    }
+
+    // The number of values that can be popped without calling `load`.
+    size_t available() const {
+        return head.size() + (on_disk == 0 && in_flight == 0 ? tail.size() : 0);
+    }
+
+    void clear() {
+        head.clear();
+        tail.clear();
+        memory_bytes = 0;
+        to_drop += on_disk;
+        on_disk = 0;
+        // The values on their way to disk are dropped once they get there.
+        in_flight = 0;
+        ++generation;
+    }
+
+    const T &peek() const {
+        guarantee(available() != 0);
+        return head.size() != 0 ? head.front().first : tail.front().first;
+    }
+
+    T pop() {
+        guarantee(available() != 0);
+        std::deque<std::pair<T, size_t> > *queue = head.size() != 0 ? &head : &tail;
+        T ret = std::move(queue->front().first);
+        memory_bytes -= queue->front().second;
+        queue->pop_front();
+        return ret;
+    }
+
+    // Blocks until at least one value is available, if any are on disk.
+    void load() {
+        if (head.size() != 0 || (on_disk == 0 && in_flight == 0)) {
+            return;
+        }
+        new_mutex_acq_t acq(&disk_mutex);
+        // We always load at least one value, since `tail` can't be popped until
+        // the disk is empty.
+        while (to_drop != 0
+               || (on_disk != 0
+                   && (head.size() == 0 || memory_bytes < memory_budget / 2))) {
+            guarantee(disk_queue.has());
+            const uint64_t start_generation = generation;
+            const size_t dropping = std::min<size_t>(
+                to_drop, SPILLING_QUEUE_LOAD_BATCH_SIZE);
+            const size_t batch_size = std::min<size_t>(
+                to_drop + on_disk, SPILLING_QUEUE_LOAD_BATCH_SIZE);
+            std::vector<write_message_t> wms(batch_size);
+            {
+                on_thread_t th(file->home_thread());
+                for (size_t i = 0; i < batch_size; ++i) {
+                    copying_viewer_t viewer(&wms[i]);
+                    disk_queue->pop(&viewer);
+                }
+            }
+            if (generation != start_generation) {
+                // We were cleared while popping, so `clear` counted the values we
+                // popped in `to_drop`.
+                guarantee(to_drop >= batch_size);
+                to_drop -= batch_size;
+                continue;
+            }
+            to_drop -= dropping;
+            guarantee(on_disk >= batch_size - dropping);
+            on_disk -= batch_size - dropping;
+            for (size_t i = dropping; i < batch_size; ++i) {
+                const size_t value_size = sizeof(T) + wms[i].size();
+                vector_stream_t stream;
+                stream.reserve(wms[i].size());
+                int res = send_write_message(&stream, &wms[i]);
+                guarantee(res == 0);
+                std::vector<char> data;
+                stream.swap(&data);
+                vector_read_stream_t rstream(std::move(data));
+                T value;
+                archive_result_t dres =
+                    deserialize<cluster_version_t::LATEST_OVERALL>(&rstream, &value);
+                guarantee_deserialization(dres, "spilling queue");
+                memory_bytes += value_size;
+                head.push_back(std::make_pair(std::move(value), value_size));
+            }
+        }
+    }
+
+private:
+    void spill(auto_drainer_t::lock_t keepalive) {
+        keepalive.assert_is_holding(&drainer);
+        new_mutex_acq_t acq(&disk_mutex);
+        // We move the oldest values in `tail` to disk until we're down to half of
+        // our memory budget, so that we don't spill again right away.
+        while (memory_bytes > memory_budget / 2 && tail.size() != 0) {
+            std::vector<T> batch;
+            while (memory_bytes > memory_budget / 2 && tail.size() != 0) {
+                memory_bytes -= tail.front().second;
+                batch.push_back(std::move(tail.front().first));
+                tail.pop_front();
+            }
+            // Despite that we are serializing this *to disk*, spill files are not
+            // intended to persist across restarts, so using
+            // `cluster_version_t::LATEST_OVERALL` is safe.
+            scoped_array_t<write_message_t> wms(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                serialize<cluster_version_t::LATEST_OVERALL>(&wms[i], batch[i]);
+            }
+            batch.clear();
+            const uint64_t start_generation = generation;
+            in_flight += wms.size();
+            {
+                on_thread_t th(file->home_thread());
+                if (!disk_queue.has()) {
+                    disk_queue.init(new internal_disk_backed_queue_t(file->get()));
+                }
+                disk_queue->push(wms);
+            }
+            if (generation == start_generation) {
+                in_flight -= wms.size();
+                on_disk += wms.size();
+            } else {
+                to_drop += wms.size();
+            }
+        }
+        spilling = false;
+    }
+
+    const size_t memory_budget;
+    const std::function<size_t(const T &)> memory_size;
+    const counted_t<spill_file_t> file;
+
+    // Each value is kept with its `memory_size`.
+    std::deque<std::pair<T, size_t> > head, tail;
+    size_t memory_bytes;
+    size_t on_disk, in_flight, to_drop;
+    // Incremented by `clear`, so that blocking operations can tell whether the
+    // values they're moving were dropped in the meantime.
+    uint64_t generation;
+    bool spilling;
+
+    new_mutex_t disk_mutex;
+    // Only used on the file's thread.
+    scoped_ptr_t<internal_disk_backed_queue_t> disk_queue;
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(spilling_queue_t);
+};
+
+#endif /* CONCURRENCY_QUEUE_SPILLING_QUEUE_HPP_ */
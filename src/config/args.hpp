@@ -66,18 +66,56 @@
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// Secondary index post construction splits the primary key range into up to this
+// many parts of about the same size, and constructs them in parallel
+#define SINDEX_POST_CONSTRUCTION_PARALLELISM      4
+
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
+// Device block aligned buffers up to this size (in bytes) are allocated from the
+// slabs of containers/block_slab.hpp.  Larger buffers come from the system allocator.
+#define BLOCK_SLAB_MAX_SIZE                       (16 * KILOBYTE)
+
+// Size of the chunks that the block slabs are carved from (in bytes)
+#define BLOCK_SLAB_CHUNK_SIZE                     (2 * MEGABYTE)
+
+// Address space reserved for the block slabs (in bytes).  Nothing is committed
+// until a chunk gets used.
+#define BLOCK_SLAB_ARENA_SIZE                     (1 * TERABYTE)
+
+// Free slab buffers that a thread keeps for itself, per buffer size (in bytes).
+// Beyond that, freed buffers are handed back to a shared pool.
+#define BLOCK_SLAB_THREAD_CACHE_SIZE              (1 * MEGABYTE)
+
 // Size of the metablock (in bytes)
 #define METABLOCK_SIZE                            (4 * KILOBYTE)
 
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
+// Blob values of up to this size (in bytes) can be stored in a single block of their
+// own size instead of a tree of blocks (see blob::layout_t::contiguous).  The
+// in-memory LBA index stores block sizes in 16 bits, so the block, including its
+// headers, must stay below 64 KB.
+#define BLOB_MAX_CONTIGUOUS_SIZE                  (60 * KILOBYTE)
+
+// A field name gets an id in the key dictionary of a table (see
+// rdb_protocol/key_dictionary.hpp) once writes have come across it this many times.
+#define KEY_DICTIONARY_PROMOTION_THRESHOLD        16
+
+// The key dictionary of a table holds up to this many field names, of up to
+// KEY_DICTIONARY_MAX_KEY_SIZE bytes each.
+#define KEY_DICTIONARY_MAX_SIZE                   1024
+#define KEY_DICTIONARY_MAX_KEY_SIZE               64
+
+// How many field names without an id the key dictionary counts at a time.  When there
+// are more, it starts counting from scratch.
+#define KEY_DICTIONARY_MAX_CANDIDATES             4096
+
 // Size of each extent (in bytes)
 // This should not be too small, or garbage collection will become
 // inefficient (especially on rotational drives).
@@ -111,6 +149,11 @@
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// The fraction of a cache's memory limit that pages which have only been accessed
+// once can occupy before they get evicted in preference to pages that have been
+// accessed repeatedly (see page_repl_policy_t::two_queue).
+#define PAGE_REPL_PROBATION_FRACTION              0.25
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -151,6 +194,11 @@
 // block infos.
 #define LBA_RECONSTRUCTION_BATCH_SIZE             1024
 
+// How often the serializer tries to write a snapshot of the in-memory LBA index, so
+// that a server which crashes after having been idle for a while doesn't need to replay
+// all of the LBA extents when it restarts.  A snapshot is also written on clean shutdown.
+#define LBA_SNAPSHOT_INTERVAL_MS                  (10 * 60 * 1000)
+
 #define COROUTINE_STACK_SIZE                      131072
 
 
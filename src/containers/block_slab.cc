@@ -0,0 +1,693 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/block_slab.hpp"
+
+#include <errno.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arch/compiler.hpp"
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "math.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+#ifdef __linux__
+// Older headers lack these.
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+#endif  // __linux__
+
+namespace {
+
+std::atomic<block_slab_huge_pages_t> huge_pages_mode(block_slab_huge_pages_t::off);
+
+const size_t num_size_classes = BLOCK_SLAB_MAX_SIZE / DEVICE_BLOCK_SIZE;
+static_assert(BLOCK_SLAB_CHUNK_SIZE == 2 * MEGABYTE,
+              "slab chunks must match the size of a huge page");
+static_assert(num_size_classes < 256, "chunk size classes must fit into a uint8_t");
+static_assert(BLOCK_SLAB_CHUNK_SIZE % BLOCK_SLAB_MAX_SIZE == 0,
+              "BLOCK_SLAB_CHUNK_SIZE must be a multiple of BLOCK_SLAB_MAX_SIZE");
+
+size_t size_class_of(size_t size) {
+    return ceil_divide(size, static_cast<size_t>(DEVICE_BLOCK_SIZE)) - 1;
+}
+
+size_t size_class_buf_size(size_t size_class) {
+    return (size_class + 1) * DEVICE_BLOCK_SIZE;
+}
+
+size_t bufs_per_chunk(size_t size_class) {
+    return BLOCK_SLAB_CHUNK_SIZE / size_class_buf_size(size_class);
+}
+
+// Set in the size class table entry of chunks that are mapped from explicit huge
+// pages.
+const uint8_t hugetlb_chunk_flag = 0x80;
+static_assert(num_size_classes < hugetlb_chunk_flag,
+              "chunk size classes must leave room for hugetlb_chunk_flag");
+
+// Free buffers are linked through their first bytes.
+struct free_buf_t {
+    free_buf_t *next;
+};
+
+class free_list_t {
+public:
+    free_list_t() : head_(nullptr), count_(0) { }
+
+    void push(void *buf) {
+        free_buf_t *b = static_cast<free_buf_t *>(buf);
+        b->next = head_;
+        head_ = b;
+        ++count_;
+    }
+
+    void *pop() {
+        rassert(count_ > 0);
+        free_buf_t *b = head_;
+        head_ = b->next;
+        --count_;
+        return b;
+    }
+
+    // Moves up to `count` buffers to `other`, returns how many were moved.
+    size_t move_to(free_list_t *other, size_t count) {
+        size_t moved = 0;
+        while (moved < count && count_ > 0) {
+            other->push(pop());
+            ++moved;
+        }
+        return moved;
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    free_buf_t *head_;
+    size_t count_;
+
+    DISABLE_COPYING(free_list_t);
+};
+
+class block_slab_thread_cache_t {
+public:
+    block_slab_thread_cache_t() : bytes_in_use(0) {
+        for (size_t i = 0; i < num_size_classes; ++i) {
+            carve_pos[i] = nullptr;
+            carve_end[i] = nullptr;
+        }
+    }
+
+    free_list_t free_bufs[num_size_classes];
+    // The part of this thread's current chunk for each size class that hasn't been
+    // handed out yet.  We don't link up the buffers of a new chunk up front, so that
+    // its memory only gets touched when it gets used.
+    char *carve_pos[num_size_classes];
+    char *carve_end[num_size_classes];
+    // Only this thread modifies `bytes_in_use`.  It's atomic so that
+    // `get_block_slab_stats` can read it from other threads.  Because buffers can be
+    // freed on other threads than they were allocated on, the value of a single
+    // thread can be negative.
+    std::atomic<int64_t> bytes_in_use;
+
+    DISABLE_COPYING(block_slab_thread_cache_t);
+};
+
+class block_slab_arena_t;
+block_slab_arena_t *get_arena();
+void drain_thread_cache(void *cache);
+
+class block_slab_arena_t {
+public:
+    // Returns nullptr if we can't (or don't want to) use slabs.
+    static block_slab_arena_t *create() {
+#if defined(_WIN32) || defined(VALGRIND)
+        // Under Valgrind we want to track every single buffer.
+        return nullptr;
+#else
+        // We reserve one chunk more than we need, so that we can align the arena.
+        const size_t reserve_size = BLOCK_SLAB_ARENA_SIZE + BLOCK_SLAB_CHUNK_SIZE;
+        void *res = mmap(nullptr, reserve_size, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (res == MAP_FAILED) {
+            return nullptr;
+        }
+        char *base = reinterpret_cast<char *>(
+            ceil_aligned(reinterpret_cast<uintptr_t>(res), BLOCK_SLAB_CHUNK_SIZE));
+        const size_t num_chunks = BLOCK_SLAB_ARENA_SIZE / BLOCK_SLAB_CHUNK_SIZE;
+        // The first chunks of the arena hold the size class of every chunk, and
+        // the counters that `reclaim` uses.
+        const size_t table_chunks = ceil_divide(
+            num_chunks * (sizeof(uint8_t) + sizeof(uint16_t)), BLOCK_SLAB_CHUNK_SIZE);
+        if (mprotect(base, table_chunks * BLOCK_SLAB_CHUNK_SIZE,
+                     PROT_READ | PROT_WRITE) != 0) {
+            munmap(res, reserve_size);
+            return nullptr;
+        }
+        return new block_slab_arena_t(base, num_chunks, table_chunks);
+#endif
+    }
+
+    // Returns true and the buffer's size class if `ptr` is a slab buffer.
+    bool get_size_class(const void *ptr, size_t *size_class_out) const {
+        const char *p = static_cast<const char *>(ptr);
+        if (p < base_ || p >= base_ + num_chunks_ * BLOCK_SLAB_CHUNK_SIZE) {
+            return false;
+        }
+        const uint8_t entry = chunk_classes_[(p - base_) / BLOCK_SLAB_CHUNK_SIZE];
+        if (entry == 0) {
+            return false;
+        }
+        *size_class_out = (entry & ~hugetlb_chunk_flag) - 1;
+        return true;
+    }
+
+    // Returns a fresh chunk for buffers of the given size class, or nullptr if the
+    // arena is exhausted.
+    char *new_chunk(size_t size_class) {
+        for (;;) {
+            size_t chunk;
+            if (!take_released_chunk(&chunk)) {
+                chunk = next_chunk_.fetch_add(1);
+                if (chunk >= num_chunks_) {
+                    return nullptr;
+                }
+            }
+            char *start = base_ + chunk * BLOCK_SLAB_CHUNK_SIZE;
+            const chunk_mapping_t mapping = map_chunk(start);
+            if (mapping == chunk_mapping_t::lost) {
+                // Some other mapping took the chunk's address range.  Its table
+                // entry stays 0, so `block_slab_free` won't mistake its memory for
+                // ours.
+                continue;
+            }
+            uint8_t entry = static_cast<uint8_t>(size_class + 1);
+            bytes_reserved_.fetch_add(BLOCK_SLAB_CHUNK_SIZE);
+            if (mapping == chunk_mapping_t::hugetlb) {
+                entry |= hugetlb_chunk_flag;
+                bytes_hugetlb_.fetch_add(BLOCK_SLAB_CHUNK_SIZE);
+            }
+            chunk_classes_[chunk] = entry;
+            return start;
+        }
+    }
+
+    // Moves up to `count` buffers of the shared pool into `list`.
+    size_t take_shared(size_t size_class, free_list_t *list, size_t count) {
+        spinlock_acq_t acq(&lock_);
+        return shared_bufs_[size_class].move_to(list, count);
+    }
+
+    void give_shared(size_t size_class, free_list_t *list, size_t count) {
+        bool should_reclaim;
+        {
+            spinlock_acq_t acq(&lock_);
+            list->move_to(&shared_bufs_[size_class], count);
+            should_reclaim =
+                shared_bufs_[size_class].size() >= reclaim_thresholds_[size_class];
+        }
+        if (should_reclaim) {
+            reclaim(size_class);
+        }
+    }
+
+    // The part of a chunk that an exited thread hadn't carved up yet.
+    void give_orphaned_carve(size_t size_class, char *pos, char *end) {
+        spinlock_acq_t acq(&lock_);
+        orphaned_carves_[size_class].push_back(std::make_pair(pos, end));
+    }
+
+    bool take_orphaned_carve(size_t size_class, char **pos_out, char **end_out) {
+        spinlock_acq_t acq(&lock_);
+        if (orphaned_carves_[size_class].empty()) {
+            return false;
+        }
+        *pos_out = orphaned_carves_[size_class].back().first;
+        *end_out = orphaned_carves_[size_class].back().second;
+        orphaned_carves_[size_class].pop_back();
+        return true;
+    }
+
+    /* Releases the memory of the chunks whose buffers have all ended up in the
+    shared pool, so that the chunks can be used again for any size class.  This runs
+    whenever the shared pool of a size class has doubled since the last time, so it
+    takes amortized constant time per freed buffer. */
+    void reclaim(size_t size_class) {
+        bool expected = false;
+        if (!reclaiming_.compare_exchange_strong(expected, true)) {
+            // Another thread is at it.  It's fine to leave this one for later.
+            return;
+        }
+        // We go through the buffers without holding the lock, so that we don't hold
+        // up other threads.  They won't find anything in the shared pool meanwhile.
+        free_list_t bufs;
+        {
+            spinlock_acq_t acq(&lock_);
+            shared_bufs_[size_class].move_to(&bufs, shared_bufs_[size_class].size());
+        }
+
+        // First we count the free buffers of each chunk ...
+        const uint16_t full = static_cast<uint16_t>(bufs_per_chunk(size_class));
+        const uint16_t released = std::numeric_limits<uint16_t>::max();
+        static_assert(BLOCK_SLAB_CHUNK_SIZE / DEVICE_BLOCK_SIZE
+                      < std::numeric_limits<uint16_t>::max(),
+                      "the free buffers of a chunk must fit into a uint16_t");
+        free_list_t counted;
+        while (bufs.size() > 0) {
+            void *buf = bufs.pop();
+            ++chunk_free_counts_[chunk_of(buf)];
+            counted.push(buf);
+        }
+        // ... then we drop the buffers of the chunks that are entirely free, and
+        // reset the counters of the others.  We can't release the chunks before
+        // we've gone through all buffers, since the list runs through them.
+        free_list_t kept;
+        std::vector<size_t> chunks_to_release;
+        while (counted.size() > 0) {
+            void *buf = counted.pop();
+            uint16_t *count = &chunk_free_counts_[chunk_of(buf)];
+            if (*count == full) {
+                chunks_to_release.push_back(chunk_of(buf));
+                *count = released;
+            } else if (*count != released) {
+                *count = 0;
+                kept.push(buf);
+            }
+        }
+        for (size_t chunk : chunks_to_release) {
+            chunk_free_counts_[chunk] = 0;
+            release_chunk(chunk);
+        }
+
+        {
+            spinlock_acq_t acq(&lock_);
+            kept.move_to(&shared_bufs_[size_class], kept.size());
+            released_chunks_.insert(released_chunks_.end(),
+                                    chunks_to_release.begin(), chunks_to_release.end());
+            reclaim_thresholds_[size_class] = std::max(
+                min_reclaim_threshold(size_class), 2 * shared_bufs_[size_class].size());
+        }
+        reclaiming_.store(false);
+    }
+
+    void register_thread_cache(block_slab_thread_cache_t *cache) {
+        {
+            spinlock_acq_t acq(&lock_);
+            thread_caches_.push_back(cache);
+        }
+#ifndef _WIN32
+        // So that `drain_thread_cache` gets called when the thread exits.
+        guarantee_xerr(pthread_setspecific(thread_exit_key_, cache) == 0, errno,
+                       "pthread_setspecific failed");
+#endif
+    }
+
+    block_slab_stats_t get_stats() {
+        block_slab_stats_t stats;
+        stats.bytes_reserved = bytes_reserved_.load();
+        stats.bytes_hugetlb = bytes_hugetlb_.load();
+        stats.bytes_transparent_huge_pages =
+            transparent_huge_pages_advised_.load() ? read_transparent_huge_page_bytes() : 0;
+        stats.bytes_in_use = 0;
+        spinlock_acq_t acq(&lock_);
+        for (block_slab_thread_cache_t *cache : thread_caches_) {
+            stats.bytes_in_use += cache->bytes_in_use.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    enum class chunk_mapping_t { regular, hugetlb, lost };
+
+    block_slab_arena_t(char *base, size_t num_chunks, size_t table_chunks)
+        : base_(base),
+          num_chunks_(num_chunks),
+          chunk_classes_(reinterpret_cast<uint8_t *>(base)),
+          chunk_free_counts_(reinterpret_cast<uint16_t *>(base + num_chunks)),
+          next_chunk_(table_chunks),
+          bytes_reserved_(0),
+          bytes_hugetlb_(0),
+          transparent_huge_pages_advised_(false),
+          reclaiming_(false) {
+        for (size_t i = 0; i < num_size_classes; ++i) {
+            reclaim_thresholds_[i] = min_reclaim_threshold(i);
+        }
+#ifndef _WIN32
+        const int res = pthread_key_create(&thread_exit_key_, &drain_thread_cache);
+        guarantee_xerr(res == 0, res, "pthread_key_create failed");
+#endif
+    }
+
+    // We don't bother to reclaim anything while the shared pool of a size class holds
+    // less than two chunks' worth of buffers.
+    static size_t min_reclaim_threshold(size_t size_class) {
+        return 2 * bufs_per_chunk(size_class);
+    }
+
+    size_t chunk_of(const void *buf) const {
+        return (static_cast<const char *>(buf) - base_) / BLOCK_SLAB_CHUNK_SIZE;
+    }
+
+    bool take_released_chunk(size_t *chunk_out) {
+        spinlock_acq_t acq(&lock_);
+        if (released_chunks_.empty()) {
+            return false;
+        }
+        *chunk_out = released_chunks_.back();
+        released_chunks_.pop_back();
+        return true;
+    }
+
+    // Gives the memory of a chunk back to the system, and turns its address range
+    // back into a reservation that `map_chunk` can map again.
+    void release_chunk(size_t chunk) {
+#ifdef _WIN32
+        (void)chunk;
+        unreachable();
+#else
+        char *start = base_ + chunk * BLOCK_SLAB_CHUNK_SIZE;
+        const bool hugetlb = (chunk_classes_[chunk] & hugetlb_chunk_flag) != 0;
+        chunk_classes_[chunk] = 0;
+        // Mapping over our own mapping with MAP_FIXED replaces it atomically, so
+        // nothing else can take the address range in between.
+        void *res = mmap(start, BLOCK_SLAB_CHUNK_SIZE, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        guarantee_err(res == start, "mmap failed to release a block slab chunk");
+        bytes_reserved_.fetch_sub(BLOCK_SLAB_CHUNK_SIZE);
+        if (hugetlb) {
+            bytes_hugetlb_.fetch_sub(BLOCK_SLAB_CHUNK_SIZE);
+        }
+#endif  // _WIN32
+    }
+
+    // Turns the reserved address range of a chunk into usable memory.
+    chunk_mapping_t map_chunk(char *start) {
+#ifdef _WIN32
+        (void)start;
+        unreachable();
+#else
+        const block_slab_huge_pages_t mode = huge_pages_mode.load();
+#ifdef __linux__
+        if (mode == block_slab_huge_pages_t::hugetlb) {
+            // If mmapping huge pages over the reservation with MAP_FIXED fails, the
+            // kernel may already have removed the reservation, and another mapping
+            // could take its place before we restore it.  So we remove the
+            // reservation ourselves and then only map into the range if it's still
+            // free.
+            guarantee_err(munmap(start, BLOCK_SLAB_CHUNK_SIZE) == 0,
+                          "munmap failed on a block slab chunk");
+            if (map_free_range(start, MAP_HUGETLB | MAP_HUGE_2MB)) {
+                return chunk_mapping_t::hugetlb;
+            }
+            // We ran out of explicit huge pages, fall back to transparent ones.
+            if (!map_free_range(start, 0)) {
+                if (get_errno() == ENOMEM) {
+                    crash_oom();
+                }
+                return chunk_mapping_t::lost;
+            }
+            advise_transparent_huge_pages(start);
+            return chunk_mapping_t::regular;
+        }
+#endif  // __linux__
+        if (mprotect(start, BLOCK_SLAB_CHUNK_SIZE, PROT_READ | PROT_WRITE) != 0) {
+            if (get_errno() == ENOMEM) {
+                crash_oom();
+            }
+            crash_or_trap("mprotect failed on a block slab chunk: %d.", get_errno());
+        }
+        if (mode != block_slab_huge_pages_t::off) {
+            advise_transparent_huge_pages(start);
+        }
+        return chunk_mapping_t::regular;
+#endif  // _WIN32
+    }
+
+#ifdef __linux__
+    // Maps a chunk at `start` unless something else is mapped there already.
+    static bool map_free_range(char *start, int extra_flags) {
+        void *res = mmap(start, BLOCK_SLAB_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | extra_flags,
+                         -1, 0);
+        if (res == MAP_FAILED) {
+            return false;
+        }
+        if (res != start) {
+            // Kernels before 4.17 treat MAP_FIXED_NOREPLACE as a mere hint.
+            guarantee_err(munmap(res, BLOCK_SLAB_CHUNK_SIZE) == 0,
+                          "munmap failed on a misplaced block slab chunk");
+            set_errno(EEXIST);
+            return false;
+        }
+        return true;
+    }
+#endif  // __linux__
+
+    void advise_transparent_huge_pages(UNUSED char *start) {
+#ifdef MADV_HUGEPAGE
+        // This fails if the kernel doesn't support transparent huge pages, in which
+        // case we just use regular pages.
+        if (madvise(start, BLOCK_SLAB_CHUNK_SIZE, MADV_HUGEPAGE) == 0) {
+            transparent_huge_pages_advised_.store(true);
+        }
+#endif
+    }
+
+    // Sums up the transparent huge pages in the arena's mappings.
+    int64_t read_transparent_huge_page_bytes() const {
+        int64_t bytes = 0;
+#ifdef __linux__
+        std::string smaps;
+        if (!blocking_read_file("/proc/self/smaps", &smaps)) {
+            return 0;
+        }
+        const uintptr_t arena_begin = reinterpret_cast<uintptr_t>(base_);
+        const uintptr_t arena_end = arena_begin + num_chunks_ * BLOCK_SLAB_CHUNK_SIZE;
+        bool in_arena = false;
+        size_t line_begin = 0;
+        while (line_begin < smaps.size()) {
+            size_t line_end = smaps.find('\n', line_begin);
+            if (line_end == std::string::npos) {
+                line_end = smaps.size();
+            }
+            const std::string line = smaps.substr(line_begin, line_end - line_begin);
+            line_begin = line_end + 1;
+
+            // Mappings start with a line like "7f0000000000-7f0000200000 rw-p ...",
+            // followed by "Field:  value" lines.
+            const size_t dash = line.find('-');
+            const size_t colon = line.find(':');
+            if (dash != std::string::npos
+                && (colon == std::string::npos || dash < colon)) {
+                uint64_t mapping_begin;
+                in_arena = strtou64_strict(line.substr(0, dash), 16, &mapping_begin)
+                    && mapping_begin >= arena_begin && mapping_begin < arena_end;
+            } else if (in_arena && line.compare(0, 14, "AnonHugePages:") == 0) {
+                const size_t number_begin = line.find_first_not_of(' ', 14);
+                const size_t number_end = line.find(' ', number_begin);
+                uint64_t kilobytes;
+                if (number_begin != std::string::npos
+                    && number_end != std::string::npos
+                    && strtou64_strict(line.substr(number_begin,
+                                                   number_end - number_begin),
+                                       10, &kilobytes)) {
+                    bytes += kilobytes * KILOBYTE;
+                }
+            }
+        }
+#endif  // __linux__
+        return bytes;
+    }
+
+    char *const base_;
+    const size_t num_chunks_;
+    // The size class plus one of every chunk (or'ed with `hugetlb_chunk_flag` if
+    // it's mapped from explicit huge pages), or 0 if the chunk isn't in use.
+    uint8_t *const chunk_classes_;
+    // Scratch space for `reclaim`, all zeroes in between.
+    uint16_t *const chunk_free_counts_;
+    std::atomic<size_t> next_chunk_;
+    std::atomic<int64_t> bytes_reserved_;
+    std::atomic<int64_t> bytes_hugetlb_;
+    std::atomic<bool> transparent_huge_pages_advised_;
+    std::atomic<bool> reclaiming_;
+#ifndef _WIN32
+    pthread_key_t thread_exit_key_;
+#endif
+
+    spinlock_t lock_;
+    free_list_t shared_bufs_[num_size_classes];
+    // How many buffers the shared pool of each size class has to hold before we try
+    // to reclaim chunks.
+    size_t reclaim_thresholds_[num_size_classes];
+    // Chunks whose memory has been released, to be used before any new ones.
+    std::vector<size_t> released_chunks_;
+    std::vector<std::pair<char *, char *> > orphaned_carves_[num_size_classes];
+    // Thread caches are never destroyed, since their `bytes_in_use` counters still
+    // count towards the total after their thread has exited.
+    std::vector<block_slab_thread_cache_t *> thread_caches_;
+
+    DISABLE_COPYING(block_slab_arena_t);
+};
+
+block_slab_arena_t *get_arena() {
+    // The arena lives until the process exits, since buffers can get freed during
+    // static destruction.
+    static block_slab_arena_t *const arena = block_slab_arena_t::create();
+    return arena;
+}
+
+THREAD_LOCAL block_slab_thread_cache_t *thread_cache = nullptr;
+
+// Called when a thread that has a thread cache exits.  Hands its free buffers and the
+// rest of its chunks to other threads, so that they don't sit around unused forever.
+void drain_thread_cache(void *cache_ptr) {
+    block_slab_thread_cache_t *cache =
+        static_cast<block_slab_thread_cache_t *>(cache_ptr);
+    block_slab_arena_t *arena = get_arena();
+    for (size_t size_class = 0; size_class < num_size_classes; ++size_class) {
+        free_list_t *free_bufs = &cache->free_bufs[size_class];
+        if (free_bufs->size() > 0) {
+            arena->give_shared(size_class, free_bufs, free_bufs->size());
+            arena->reclaim(size_class);
+        }
+        if (cache->carve_pos[size_class] != cache->carve_end[size_class]) {
+            arena->give_orphaned_carve(size_class, cache->carve_pos[size_class],
+                                       cache->carve_end[size_class]);
+            cache->carve_pos[size_class] = nullptr;
+            cache->carve_end[size_class] = nullptr;
+        }
+    }
+}
+
+// See the comment at the top of thread_local.hpp for why this must not be inlined.
+NOINLINE block_slab_thread_cache_t *get_thread_cache(block_slab_arena_t *arena) {
+    if (thread_cache == nullptr) {
+        thread_cache = new block_slab_thread_cache_t;
+        arena->register_thread_cache(thread_cache);
+    }
+    return thread_cache;
+}
+
+// How many buffers of a size class a thread moves from or to the shared pool at once.
+size_t batch_size(size_t size_class) {
+    return std::max<size_t>(
+        1, BLOCK_SLAB_THREAD_CACHE_SIZE / 2 / size_class_buf_size(size_class));
+}
+
+void *slab_allocate(block_slab_arena_t *arena, size_t size_class) {
+    block_slab_thread_cache_t *cache = get_thread_cache(arena);
+    const size_t buf_size = size_class_buf_size(size_class);
+    free_list_t *free_bufs = &cache->free_bufs[size_class];
+
+    void *buf;
+    if (free_bufs->size() > 0
+        || arena->take_shared(size_class, free_bufs, batch_size(size_class)) > 0) {
+        buf = free_bufs->pop();
+    } else {
+        if (cache->carve_pos[size_class] == cache->carve_end[size_class]
+            && !arena->take_orphaned_carve(size_class, &cache->carve_pos[size_class],
+                                           &cache->carve_end[size_class])) {
+            char *chunk = arena->new_chunk(size_class);
+            if (chunk == nullptr) {
+                return nullptr;
+            }
+            cache->carve_pos[size_class] = chunk;
+            cache->carve_end[size_class] = chunk + floor_aligned(
+                static_cast<size_t>(BLOCK_SLAB_CHUNK_SIZE), buf_size);
+        }
+        buf = cache->carve_pos[size_class];
+        cache->carve_pos[size_class] += buf_size;
+    }
+    cache->bytes_in_use.store(
+        cache->bytes_in_use.load(std::memory_order_relaxed) + buf_size,
+        std::memory_order_relaxed);
+    return buf;
+}
+
+void slab_free(block_slab_arena_t *arena, size_t size_class, void *ptr) {
+    block_slab_thread_cache_t *cache = get_thread_cache(arena);
+    const size_t buf_size = size_class_buf_size(size_class);
+    free_list_t *free_bufs = &cache->free_bufs[size_class];
+
+    free_bufs->push(ptr);
+    if (free_bufs->size() * buf_size > BLOCK_SLAB_THREAD_CACHE_SIZE) {
+        arena->give_shared(size_class, free_bufs, batch_size(size_class));
+    }
+    cache->bytes_in_use.store(
+        cache->bytes_in_use.load(std::memory_order_relaxed) - buf_size,
+        std::memory_order_relaxed);
+}
+
+}  // namespace
+
+void *block_slab_malloc(size_t size) {
+    block_slab_arena_t *arena = get_arena();
+    if (arena != nullptr && size > 0 && size <= BLOCK_SLAB_MAX_SIZE) {
+        void *buf = slab_allocate(arena, size_class_of(size));
+        if (buf != nullptr) {
+            return buf;
+        }
+    }
+    return raw_malloc_aligned(size, DEVICE_BLOCK_SIZE);
+}
+
+void block_slab_free(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    block_slab_arena_t *arena = get_arena();
+    size_t size_class;
+    if (arena != nullptr && arena->get_size_class(ptr, &size_class)) {
+        slab_free(arena, size_class, ptr);
+    } else {
+        raw_free_aligned(ptr);
+    }
+}
+
+void set_block_slab_huge_pages(block_slab_huge_pages_t mode) {
+    huge_pages_mode.store(mode);
+}
+
+block_slab_stats_t get_block_slab_stats() {
+    block_slab_arena_t *arena = get_arena();
+    if (arena == nullptr) {
+        block_slab_stats_t stats;
+        stats.bytes_reserved = 0;
+        stats.bytes_in_use = 0;
+        stats.bytes_hugetlb = 0;
+        stats.bytes_transparent_huge_pages = 0;
+        return stats;
+    }
+    return arena->get_stats();
+}
+
+static perfmon_function_t pm_block_slab_bytes_reserved(
+    []() { return get_block_slab_stats().bytes_reserved; });
+static perfmon_function_t pm_block_slab_bytes_in_use(
+    []() { return get_block_slab_stats().bytes_in_use; });
+static perfmon_function_t pm_block_slab_bytes_huge_pages(
+    []() {
+        const block_slab_stats_t stats = get_block_slab_stats();
+        return stats.bytes_hugetlb + stats.bytes_transparent_huge_pages;
+    });
+static perfmon_multi_membership_t pm_block_slab_membership(
+    &get_global_perfmon_collection(),
+    &pm_block_slab_bytes_reserved, "block_slab_bytes_reserved",
+    &pm_block_slab_bytes_in_use, "block_slab_bytes_in_use",
+    &pm_block_slab_bytes_huge_pages, "block_slab_bytes_huge_pages");
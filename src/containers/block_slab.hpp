@@ -0,0 +1,59 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_BLOCK_SLAB_HPP_
+#define CONTAINERS_BLOCK_SLAB_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The allocator behind `scoped_device_block_aligned_ptr_t`, i.e. behind the block
+buffers of the serializer and the pages of the buffer cache.  It returns
+DEVICE_BLOCK_SIZE-aligned buffers.
+
+Buffers of up to BLOCK_SLAB_MAX_SIZE bytes come from slabs.  A slab is a chunk of
+BLOCK_SLAB_CHUNK_SIZE bytes that holds buffers of a single size, and all chunks are
+carved out of one reserved range of address space (which is how `block_slab_free`
+recognizes slab buffers).  Every thread keeps its own free lists and carves its own
+chunks, so that its buffers are local to its NUMA node.  Freed buffers beyond
+BLOCK_SLAB_THREAD_CACHE_SIZE per size go to a shared pool from which other threads
+can take them.  Because buffers only get reused for buffers of the same size, the
+churn of the cache doesn't fragment the heap.  Once all the buffers of a chunk have
+ended up in the shared pool, the chunk's memory is given back to the system and the
+chunk can be used for any size.  When a thread exits, its free buffers go to the
+shared pool and the rest of its chunks to the other threads.
+
+Larger buffers, and all buffers on platforms where we can't reserve the address
+space, come from `raw_malloc_aligned`. */
+
+void *block_slab_malloc(size_t size);
+void block_slab_free(void *ptr);
+
+/* Slab chunks have the size and alignment of a 2 MB huge page, so they can be backed
+by huge pages to cut down on TLB misses when the cache is large. */
+enum class block_slab_huge_pages_t {
+    // Chunks use regular pages.
+    off,
+    // Chunks ask for transparent huge pages (with `madvise(MADV_HUGEPAGE)`).  The
+    // kernel may ignore that, for example if it's configured not to use them.
+    transparent,
+    // Chunks are mapped from the kernel's pool of explicit huge pages (see
+    // `vm.nr_hugepages`).  Once the pool runs out, we fall back to `transparent`.
+    hugetlb
+};
+
+/* Applies to chunks that get mapped after the call. */
+void set_block_slab_huge_pages(block_slab_huge_pages_t mode);
+
+struct block_slab_stats_t {
+    // The size of all the chunks that are in use by the slabs.
+    int64_t bytes_reserved;
+    // The size of the slab buffers that are currently allocated.
+    int64_t bytes_in_use;
+    // How much of the chunks is backed by explicit huge pages ...
+    int64_t bytes_hugetlb;
+    // ... and by transparent huge pages.
+    int64_t bytes_transparent_huge_pages;
+};
+
+block_slab_stats_t get_block_slab_stats();
+
+#endif  // CONTAINERS_BLOCK_SLAB_HPP_
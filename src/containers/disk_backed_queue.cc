@@ -11,14 +11,11 @@
 
 #define DBQ_MAX_REF_SIZE 251
 
-internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
-                                                           const serializer_filepath_t &filename,
-                                                           perfmon_collection_t *stats_parent)
+disk_backed_queue_file_t::disk_backed_queue_file_t(io_backender_t *io_backender,
+                                                   const serializer_filepath_t &filename,
+                                                   perfmon_collection_t *stats_parent)
     : perfmon_membership(stats_parent, &perfmon_collection,
                          filename.permanent_path().c_str()),
-      queue_size(0),
-      head_block_id(NULL_BLOCK_ID),
-      tail_block_id(NULL_BLOCK_ID),
       file_opener(new filepath_file_opener_t(filename, io_backender)) {
     log_serializer_t::create(file_opener.get(),
                                   log_serializer_t::static_config_t());
@@ -39,7 +36,7 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
     memset(buf, 0, block_size.value());
 }
 
-internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
+disk_backed_queue_file_t::~disk_backed_queue_file_t() {
     /* First destroy the serializer, then remove the temporary file.
     This avoids issues with certain file systems (specifically VirtualBox
     shared folders), see https://github.com/rethinkdb/rethinkdb/issues/3791. */
@@ -51,11 +48,61 @@ internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
     file_opener->unlink_serializer_file();
 }
 
+internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
+                                                           const serializer_filepath_t &filename,
+                                                           perfmon_collection_t *stats_parent)
+    : queue_size(0),
+      head_block_id(NULL_BLOCK_ID),
+      tail_block_id(NULL_BLOCK_ID),
+      own_file(new disk_backed_queue_file_t(io_backender, filename, stats_parent)),
+      file(own_file.get()) { }
+
+internal_disk_backed_queue_t::internal_disk_backed_queue_t(
+        disk_backed_queue_file_t *_file)
+    : queue_size(0),
+      head_block_id(NULL_BLOCK_ID),
+      tail_block_id(NULL_BLOCK_ID),
+      file(_file) { }
+
+internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
+    if (own_file.has() || tail_block_id == NULL_BLOCK_ID) {
+        return;
+    }
+    // The other queues in the file can use our blocks once we free them.
+    mutex_t::acq_t mutex_acq(&mutex);
+    txn_t txn(file->cache_conn.get(), write_durability_t::SOFT, 2);
+    const max_block_size_t block_size = file->cache->max_block_size();
+    while (tail_block_id != NULL_BLOCK_ID) {
+        {
+            buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+            std::vector<char> refs;
+            {
+                buf_read_t read(&_tail);
+                const queue_block_t *tail
+                    = static_cast<const queue_block_t *>(read.get_data_read());
+                refs.assign(tail->data + tail->live_data_offset,
+                            tail->data + tail->data_size);
+            }
+            size_t offset = 0;
+            while (offset < refs.size()) {
+                char buffer[DBQ_MAX_REF_SIZE];
+                const int ref_size = blob::ref_size(
+                    block_size, refs.data() + offset, DBQ_MAX_REF_SIZE);
+                memcpy(buffer, refs.data() + offset, ref_size);
+                blob_t blob(block_size, buffer, DBQ_MAX_REF_SIZE);
+                blob.clear(buf_parent_t(&_tail));
+                offset += ref_size;
+            }
+        }
+        remove_block_from_tail(&txn);
+    }
+}
+
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     mutex_t::acq_t mutex_acq(&mutex);
 
     // There's no need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT, 2);
+    txn_t txn(file->cache_conn.get(), write_durability_t::SOFT, 2);
 
     push_single(&txn, wm);
 }
@@ -64,7 +111,7 @@ void internal_disk_backed_queue_t::push(const scoped_array_t<write_message_t> &w
     mutex_t::acq_t mutex_acq(&mutex);
 
     // There's no need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT, 2);
+    txn_t txn(file->cache_conn.get(), write_durability_t::SOFT, 2);
 
     for (size_t i = 0; i < wms.size(); ++i) {
         push_single(&txn, wms[i]);
@@ -84,11 +131,14 @@ void internal_disk_backed_queue_t::push_single(txn_t *txn, const write_message_t
     char buffer[DBQ_MAX_REF_SIZE];
     memset(buffer, 0, DBQ_MAX_REF_SIZE);
 
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
+    blob_t blob(file->cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
 
     write_onto_blob(buf_parent_t(_head.get()), &blob, wm);
 
-    if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->max_block_size()) > cache->max_block_size().value()) {
+    if (static_cast<size_t>(
+                (head->data + head->data_size) - reinterpret_cast<char *>(head))
+            + blob.refsize(file->cache->max_block_size())
+        > file->cache->max_block_size().value()) {
         // The data won't fit in our current head block, so it's time to make a new one.
         head = nullptr;
         write.reset();
@@ -101,8 +151,8 @@ void internal_disk_backed_queue_t::push_single(txn_t *txn, const write_message_t
     }
 
     memcpy(head->data + head->data_size, buffer,
-           blob.refsize(cache->max_block_size()));
-    head->data_size += blob.refsize(cache->max_block_size());
+           blob.refsize(file->cache->max_block_size()));
+    head->data_size += blob.refsize(file->cache->max_block_size());
 
     queue_size++;
 }
@@ -113,7 +163,7 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
 
     char buffer[DBQ_MAX_REF_SIZE];
     // No need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT, 2);
+    txn_t txn(file->cache_conn.get(), write_durability_t::SOFT, 2);
 
     buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
 
@@ -124,7 +174,7 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
             = static_cast<const queue_block_t *>(read.get_data_read());
         rassert(tail->data_size != tail->live_data_offset);
         memcpy(buffer, tail->data + tail->live_data_offset,
-               blob::ref_size(cache->max_block_size(),
+               blob::ref_size(file->cache->max_block_size(),
                               tail->data + tail->live_data_offset,
                               DBQ_MAX_REF_SIZE));
     }
@@ -133,7 +183,7 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
 
     std::vector<char> data_vec;
 
-    blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
+    blob_t blob(file->cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
     {
         blob_acq_t acq_group;
         buffer_group_t blob_group;
@@ -149,7 +199,7 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
         buf_write_t write(&_tail);
         queue_block_t *tail = static_cast<queue_block_t *>(write.get_data_write());
         /* Record how far along in the blob we are. */
-        tail->live_data_offset += blob.refsize(cache->max_block_size());
+        tail->live_data_offset += blob.refsize(file->cache->max_block_size());
         data_size = tail->data_size;
         live_data_offset = tail->live_data_offset;
     }
@@ -40,9 +40,37 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* The file, serializer and cache behind one or more `internal_disk_backed_queue_t`s.
+The file is removed when this is destroyed. */
+class disk_backed_queue_file_t {
+public:
+    disk_backed_queue_file_t(io_backender_t *io_backender,
+                             const serializer_filepath_t &filename,
+                             perfmon_collection_t *stats_parent);
+    ~disk_backed_queue_file_t();
+
+private:
+    friend class internal_disk_backed_queue_t;
+
+    perfmon_collection_t perfmon_collection;
+    perfmon_membership_t perfmon_membership;
+
+    scoped_ptr_t<serializer_file_opener_t> file_opener;
+    scoped_ptr_t<log_serializer_t> serializer;
+    scoped_ptr_t<cache_balancer_t> balancer;
+    scoped_ptr_t<cache_t> cache;
+    scoped_ptr_t<cache_conn_t> cache_conn;
+
+    DISABLE_COPYING(disk_backed_queue_file_t);
+};
+
 class internal_disk_backed_queue_t {
 public:
     internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
+    // Keeps the queue in `file`, which other queues may be using too.  The queue
+    // frees its blocks when it's destroyed, which has to happen on the file's
+    // thread and before the file is destroyed.
+    explicit internal_disk_backed_queue_t(disk_backed_queue_file_t *file);
     ~internal_disk_backed_queue_t();
 
     void push(const write_message_t &value);
@@ -63,8 +91,6 @@ private:
 
     // Serves more as sanity-checking for the cache than this type's ordering.
     order_source_t cache_order_source;
-    perfmon_collection_t perfmon_collection;
-    perfmon_membership_t perfmon_membership;
 
     int64_t queue_size;
 
@@ -73,11 +99,9 @@ private:
     // The end we pop from.
     block_id_t tail_block_id;
 
-    scoped_ptr_t<serializer_file_opener_t> file_opener;
-    scoped_ptr_t<log_serializer_t> serializer;
-    scoped_ptr_t<cache_balancer_t> balancer;
-    scoped_ptr_t<cache_t> cache;
-    scoped_ptr_t<cache_conn_t> cache_conn;
+    // Only set if the queue has a file of its own.
+    scoped_ptr_t<disk_backed_queue_file_t> own_file;
+    disk_backed_queue_file_t *const file;
 
     DISABLE_COPYING(internal_disk_backed_queue_t);
 };
@@ -142,6 +166,15 @@ public:
         internal_.push(wm);
     }
 
+    // Pushes all of `ts` in a single transaction.
+    void push(const std::vector<T> &ts) {
+        scoped_array_t<write_message_t> wms(ts.size());
+        for (size_t i = 0; i < ts.size(); ++i) {
+            serialize<cluster_version_t::LATEST_OVERALL>(&wms[i], ts[i]);
+        }
+        internal_.push(wms);
+    }
+
     void pop(T *out) {
         deserializing_viewer_t<T> viewer(out);
         internal_.pop(&viewer);
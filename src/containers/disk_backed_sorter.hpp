@@ -0,0 +1,280 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_DISK_BACKED_SORTER_HPP_
+#define CONTAINERS_DISK_BACKED_SORTER_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "containers/disk_backed_queue.hpp"
+#include "containers/scoped.hpp"
+
+/* The number of bytes a value takes up in a `disk_backed_sorter_t`. Values that own
+memory outside of themselves need a function of their own that counts it. */
+template <class T>
+struct sizeof_memory_usage_t {
+    size_t operator()(const T &) const {
+        return sizeof(T);
+    }
+};
+
+/* `disk_backed_sorter_t` sorts more values than fit into memory. Values are collected
+in memory until they would take up more than `max_memory_usage` bytes, as counted by
+`memory_usage_t`. Before that happens, the ones in memory get sorted and written to a
+`disk_backed_queue_t` of their own as a sorted run. Once all values have been pushed, `pop()` merges the runs and
+returns the values in ascending order. If all values fit into memory, no file gets
+created.
+
+Every run has its own file and its own small cache, so we never keep more than
+`max_runs_merged` runs of the same size around: whenever that many runs of the same
+size have been written, they get merged into a single bigger run. The number of open
+runs therefore only grows with the logarithm of the number of values, and every value
+gets written `log(num_runs) / log(max_runs_merged)` times. */
+template <class T,
+          class less_t = std::less<T>,
+          class memory_usage_t = sizeof_memory_usage_t<T> >
+class disk_backed_sorter_t {
+public:
+    disk_backed_sorter_t(
+            io_backender_t *io_backender,
+            const std::function<serializer_filepath_t(size_t)> &run_filepath,
+            perfmon_collection_t *stats_parent,
+            size_t max_memory_usage,
+            size_t max_runs_merged = 16,
+            const less_t &less = less_t())
+        : io_backender_(io_backender),
+          run_filepath_(run_filepath),
+          stats_parent_(stats_parent),
+          max_memory_usage_(max_memory_usage),
+          max_runs_merged_(max_runs_merged),
+          less_(less),
+          merging_(false),
+          size_(0),
+          values_memory_usage_(0),
+          next_value_(0),
+          num_runs_(0),
+          max_open_runs_(0) {
+        guarantee(max_memory_usage_ > 0);
+        guarantee(max_runs_merged_ >= 2);
+    }
+
+    // Must not be called after the first call to `pop()`.
+    void push(T &&value) {
+        guarantee(!merging_);
+        // A run always gets at least one value, however big it is.
+        const size_t value_memory_usage = memory_usage_t()(value);
+        if (!values_.empty()
+            && values_memory_usage_ + value_memory_usage > max_memory_usage_) {
+            write_run();
+        }
+        values_.push_back(std::move(value));
+        values_memory_usage_ += value_memory_usage;
+        ++size_;
+    }
+
+    // The number of values that have been pushed and not popped yet.
+    int64_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Returns the smallest of the remaining values.
+    void pop(T *out) {
+        guarantee(!empty());
+        if (!merging_) {
+            start_merging();
+        }
+        --size_;
+        if (!merger_.has()) {
+            *out = std::move(values_[next_value_]);
+            ++next_value_;
+            return;
+        }
+        merger_->pop(out);
+    }
+
+    // The number of runs that have been written to disk, including the ones written
+    // by merging other runs.
+    size_t num_runs() const {
+        return num_runs_;
+    }
+
+    // The largest number of runs that existed at the same time.
+    size_t max_open_runs() const {
+        return max_open_runs_;
+    }
+
+private:
+    typedef disk_backed_queue_t<T> run_t;
+
+    // Merges a set of runs, returning the smallest remaining value on every call to
+    // `pop()`.
+    class merger_t {
+    public:
+        merger_t(std::vector<scoped_ptr_t<run_t> > &&runs, const less_t *less)
+            : runs_(std::move(runs)), less_(less), heads_(runs_.size()) {
+            for (size_t run = 0; run < runs_.size(); ++run) {
+                if (!runs_[run]->empty()) {
+                    runs_[run]->pop(&heads_[run]);
+                    heap_.push_back(run);
+                }
+            }
+            std::make_heap(heap_.begin(), heap_.end(), heap_less_t(this));
+        }
+
+        bool empty() const {
+            return heap_.empty();
+        }
+
+        void pop(T *out) {
+            guarantee(!empty());
+            std::pop_heap(heap_.begin(), heap_.end(), heap_less_t(this));
+            const size_t run = heap_.back();
+            *out = std::move(heads_[run]);
+            if (!runs_[run]->empty()) {
+                runs_[run]->pop(&heads_[run]);
+                std::push_heap(heap_.begin(), heap_.end(), heap_less_t(this));
+            } else {
+                heap_.pop_back();
+            }
+        }
+
+    private:
+        // Orders the runs in `heap_` so that the one with the smallest head is on
+        // top.
+        class heap_less_t {
+        public:
+            explicit heap_less_t(const merger_t *parent) : parent_(parent) { }
+            bool operator()(size_t a, size_t b) const {
+                return (*parent_->less_)(parent_->heads_[b], parent_->heads_[a]);
+            }
+        private:
+            const merger_t *parent_;
+        };
+
+        std::vector<scoped_ptr_t<run_t> > runs_;
+        const less_t *less_;
+        // The smallest value of every run that hasn't been returned yet ...
+        std::vector<T> heads_;
+        // ... and the runs that still have one, as a heap.
+        std::vector<size_t> heap_;
+
+        DISABLE_COPYING(merger_t);
+    };
+
+    scoped_ptr_t<run_t> new_run() {
+        scoped_ptr_t<run_t> run = make_scoped<run_t>(
+            io_backender_, run_filepath_(num_runs_), stats_parent_);
+        ++num_runs_;
+        max_open_runs_ = std::max(max_open_runs_, runs_.size() + 1);
+        return run;
+    }
+
+    void write_run() {
+        // Pushing the whole run in one transaction would make all of its blocks dirty
+        // at the same time, so we push it in batches.
+        static const size_t VALUES_PER_BATCH = 256;
+        std::sort(values_.begin(), values_.end(), less_);
+        scoped_ptr_t<run_t> run = new_run();
+        std::vector<T> batch;
+        for (size_t i = 0; i < values_.size(); i += VALUES_PER_BATCH) {
+            const size_t end = std::min(i + VALUES_PER_BATCH, values_.size());
+            batch.assign(std::make_move_iterator(values_.begin() + i),
+                         std::make_move_iterator(values_.begin() + end));
+            run->push(batch);
+        }
+        values_.clear();
+        values_memory_usage_ = 0;
+        runs_.push_back(std::make_pair(std::move(run), 0));
+        // Like carrying in a counter with base `max_runs_merged_`.
+        while (runs_.size() >= max_runs_merged_
+               && runs_[runs_.size() - max_runs_merged_].second
+                  == runs_.back().second) {
+            merge_last_runs(max_runs_merged_);
+        }
+    }
+
+    // Replaces the last `count` runs with a single run that has all of their values.
+    void merge_last_runs(size_t count) {
+        static const size_t VALUES_PER_BATCH = 256;
+        guarantee(count <= runs_.size());
+        const size_t level = runs_.back().second + 1;
+        scoped_ptr_t<run_t> run = new_run();
+        std::vector<scoped_ptr_t<run_t> > inputs;
+        for (size_t i = runs_.size() - count; i < runs_.size(); ++i) {
+            inputs.push_back(std::move(runs_[i].first));
+        }
+        runs_.resize(runs_.size() - count);
+        {
+            // The input runs get deleted as soon as we're done with them.
+            merger_t merger(std::move(inputs), &less_);
+            std::vector<T> batch;
+            while (!merger.empty()) {
+                batch.emplace_back();
+                merger.pop(&batch.back());
+                if (batch.size() == VALUES_PER_BATCH || merger.empty()) {
+                    run->push(batch);
+                    batch.clear();
+                }
+            }
+        }
+        runs_.push_back(std::make_pair(std::move(run), level));
+    }
+
+    void start_merging() {
+        merging_ = true;
+        if (runs_.empty()) {
+            std::sort(values_.begin(), values_.end(), less_);
+            return;
+        }
+        if (!values_.empty()) {
+            write_run();
+        }
+        // The runs at the end are the smallest ones, so merging them first keeps the
+        // extra work down.
+        while (runs_.size() > max_runs_merged_) {
+            merge_last_runs(max_runs_merged_);
+        }
+        std::vector<scoped_ptr_t<run_t> > runs;
+        for (auto &&pair : runs_) {
+            runs.push_back(std::move(pair.first));
+        }
+        runs_.clear();
+        merger_.init(new merger_t(std::move(runs), &less_));
+    }
+
+    io_backender_t *const io_backender_;
+    const std::function<serializer_filepath_t(size_t)> run_filepath_;
+    perfmon_collection_t *const stats_parent_;
+    const size_t max_memory_usage_;
+    const size_t max_runs_merged_;
+    const less_t less_;
+
+    bool merging_;
+    int64_t size_;
+
+    // The values that haven't been written to a run yet, and the memory they take up.
+    // If everything fits into memory, we return them from here, starting at
+    // `next_value_`.
+    std::vector<T> values_;
+    size_t values_memory_usage_;
+    size_t next_value_;
+
+    // The runs that haven't been merged yet, each with the number of times its values
+    // have been merged.  The levels never increase towards the back.
+    std::vector<std::pair<scoped_ptr_t<run_t>, size_t> > runs_;
+    size_t num_runs_;
+    size_t max_open_runs_;
+
+    // Merges the remaining runs once we've started popping values.
+    scoped_ptr_t<merger_t> merger_;
+
+    DISABLE_COPYING(disk_backed_sorter_t);
+};
+
+#endif  // CONTAINERS_DISK_BACKED_SORTER_HPP_
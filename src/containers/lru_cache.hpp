@@ -93,7 +93,8 @@ private:
     }
     V &insert(K &&key) {
         cache_list_.push_front(std::make_pair(std::move(key), V()));
-        cache_map_[key] = cache_list_.begin();
+        // `key` has been moved from, so we have to use the copy in the list.
+        cache_map_[cache_list_.begin()->first] = cache_list_.begin();
         if (cache_list_.size() > _max) {
             cache_map_.erase(cache_list_.back().first);
             cache_list_.pop_back();
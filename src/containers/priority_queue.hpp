@@ -54,6 +54,12 @@ public:
     void remove(entry_t *);
     T pop();
     void update(int);
+    /* \brief Calls `fun` on the data of every entry, then restores the heap
+     * order.  Cheaper than calling update() on each entry individually when
+     * the priorities of many entries have changed.
+     */
+    template <class callable_t>
+    void update_all(const callable_t &fun);
 public:
     void validate();
 
@@ -145,6 +145,17 @@ void priority_queue_t<T, Less>::update(int index) {
     bubble_down(&i);
 }
 
+template<class T, class Less>
+template <class callable_t>
+void priority_queue_t<T, Less>::update_all(const callable_t &fun) {
+    for (unsigned int i = 0; i < heap.size(); i++) {
+        fun(heap[i]->data);
+    }
+    for (int i = static_cast<int>(heap.size() / 2) - 1; i >= 0; i--) {
+        bubble_down(i);
+    }
+}
+
 template<class T, class Less>
 void priority_queue_t<T, Less>::validate() {
     for (unsigned int i = 0; i < heap.size(); i++) {
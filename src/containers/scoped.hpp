@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "config/args.hpp"
+#include "containers/block_slab.hpp"
 #include "errors.hpp"
 #include "utils.hpp"
 
@@ -364,8 +365,9 @@ template <class T>
 TEMPLATE_ALIAS(scoped_page_aligned_ptr_t, scoped_alloc_t<T, raw_malloc_page_aligned, raw_free_aligned>);
 #endif
 
-// A type for device-block-aligned pointers
+// A type for device-block-aligned pointers, such as block buffers.  These come from
+// the slab allocator in containers/block_slab.hpp.
 template <class T>
-TEMPLATE_ALIAS(scoped_device_block_aligned_ptr_t, scoped_alloc_t<T, raw_malloc_aligned<DEVICE_BLOCK_SIZE>, raw_free_aligned>);
+TEMPLATE_ALIAS(scoped_device_block_aligned_ptr_t, scoped_alloc_t<T, block_slab_malloc, block_slab_free>);
 
 #endif  // CONTAINERS_SCOPED_HPP_
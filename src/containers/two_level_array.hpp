@@ -21,12 +21,14 @@ about value_t:
 2. value_t has a good equality operator, where value_t() == value_t(), and
    distinguishable values don't compare equal.
 
+Memory is allocated in chunks of `chunk_size` values.
+
 */
 
-template <class value_t>
+template <class value_t, size_t chunk_size = (1 << 14)>
 class two_level_array_t {
 private:
-    static const size_t CHUNK_SIZE = 1 << 14;
+    static const size_t CHUNK_SIZE = chunk_size;
 
     struct chunk_t {
         chunk_t()
@@ -48,9 +50,15 @@ private:
 public:
     two_level_array_t() { }
     ~two_level_array_t() {
+        clear();
+    }
+
+    // Resets every value to value_t().
+    void clear() {
         for (auto it = chunks.begin(); it != chunks.end(); ++it) {
             delete *it;
         }
+        chunks.clear();
     }
 
     value_t get(size_t key) const {
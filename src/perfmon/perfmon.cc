@@ -301,6 +301,19 @@ ql::datum_t perfmon_rate_monitor_t::output_stat(const double &stat) {
     return ql::datum_t(stat / ticks_to_secs(length));
 }
 
+perfmon_function_t::perfmon_function_t(std::function<int64_t()> _fn)
+    : fn(std::move(_fn)) { }
+
+void *perfmon_function_t::begin_stats() {
+    return nullptr;
+}
+
+void perfmon_function_t::visit_stats(void *) { }
+
+ql::datum_t perfmon_function_t::end_stats(void *) {
+    return ql::datum_t(static_cast<double>(fn()));
+}
+
 perfmon_duration_sampler_t::perfmon_duration_sampler_t(ticks_t length, bool _ignore_global_full_perfmon)
     : stat(), active(), total(), recent(length, true),
       active_membership(&stat, &active, "active_count"),
@@ -9,6 +9,7 @@
 #define PERFMON_PERFMON_HPP_
 
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <string>
 #include <map>
@@ -215,6 +216,25 @@ public:
     void record(double value = 1.0);
 };
 
+/* `perfmon_function_t` reports the value that a function returns at the time the
+ * stats are collected. It is meant for values that are tracked outside of the
+ * perfmon system, for example by allocators that are used from threads that
+ * aren't part of the thread pool.
+ */
+struct perfmon_function_t : public perfmon_t {
+public:
+    explicit perfmon_function_t(std::function<int64_t()> _fn);
+
+    void *begin_stats();
+    void visit_stats(void *data);
+    ql::datum_t end_stats(void *data);
+
+private:
+    std::function<int64_t()> fn;
+
+    DISABLE_COPYING(perfmon_function_t);
+};
+
 /* perfmon_duration_sampler_t is a perfmon_t that monitors events that have a
  * starting and ending time. When something starts, call begin(); when
  * something ends, call end() with the same value as begin. It will produce
@@ -20,7 +20,8 @@ void cfeed_artificial_table_backend_t::machinery_t::send_all_change(
                 index_vals_t(),
                 pkey,
                 old_val,
-                new_val}));
+                new_val,
+                boost::none}));
 }
 
 void cfeed_artificial_table_backend_t::machinery_t::send_all_stop() {
@@ -72,10 +73,13 @@ bool cfeed_artificial_table_backend_t::read_changes(
         bool operator()(const ql::changefeed::keyspec_t::empty_t &) const {
             return true;
         }
+        bool operator()(const ql::changefeed::keyspec_t::aggregate_t &) const {
+            return false;
+        }
     };
     if (!boost::apply_visitor(visitor_t(), ss.spec)) {
         *error_out = admin_err_t{
-            "System tables don't support changefeeds on `.limit()`.",
+            "System tables don't support changefeeds on `.limit()` or aggregations.",
             query_state_t::FAILED};
         return false;
     }
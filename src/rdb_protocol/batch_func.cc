@@ -0,0 +1,352 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/batch_func.hpp"
+
+#include <utility>
+
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/term_storage.hpp"
+#include "utils.hpp"
+
+namespace ql {
+
+class batch_expr_t {
+public:
+    virtual ~batch_expr_t() { }
+
+    // Sets `*out` to the values of the term for `rows`, or to empty datums for the
+    // rows that have to be evaluated by the interpreter.
+    virtual void eval(const std::vector<datum_t> &rows,
+                      std::vector<datum_t> *out) const = 0;
+};
+
+namespace {
+
+typedef std::vector<scoped_ptr_t<batch_expr_t> > batch_exprs_t;
+
+// The function's argument, i.e. the rows themselves.
+class row_expr_t : public batch_expr_t {
+public:
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        *out = rows;
+    }
+};
+
+class constant_expr_t : public batch_expr_t {
+public:
+    explicit constant_expr_t(datum_t &&value) : value_(std::move(value)) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        out->assign(rows.size(), value_);
+    }
+private:
+    const datum_t value_;
+};
+
+// `GET_FIELD` and `BRACKET` with a constant field name.  Anything but a plain object
+// that has the field (sequences, pseudo-types, missing fields) goes to the
+// interpreter.
+class get_field_expr_t : public batch_expr_t {
+public:
+    get_field_expr_t(scoped_ptr_t<batch_expr_t> &&object, const datum_string_t &name)
+        : object_(std::move(object)), name_(name) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        object_->eval(rows, out);
+        for (datum_t &value : *out) {
+            if (!value.has()) {
+                continue;
+            }
+            if (value.get_type() == datum_t::R_OBJECT && !value.is_ptype()) {
+                value = value.get_field(name_, NOTHROW);
+            } else {
+                value = datum_t();
+            }
+        }
+    }
+private:
+    const scoped_ptr_t<batch_expr_t> object_;
+    const datum_string_t name_;
+};
+
+double batch_add(double lhs, double rhs) { return lhs + rhs; }
+double batch_sub(double lhs, double rhs) { return lhs - rhs; }
+double batch_mul(double lhs, double rhs) { return lhs * rhs; }
+// Division by zero doesn't give a finite result, so we don't have to check for it.
+double batch_div(double lhs, double rhs) { return lhs / rhs; }
+
+// `ADD`, `SUB`, `MUL` and `DIV` on numbers.  Times, strings and arrays go to the
+// interpreter.
+class arith_expr_t : public batch_expr_t {
+public:
+    arith_expr_t(double (*op)(double, double), batch_exprs_t &&args)
+        : op_(op), args_(std::move(args)) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        args_[0]->eval(rows, out);
+        std::vector<datum_t> rhs;
+        for (size_t i = 1; i < args_.size(); ++i) {
+            args_[i]->eval(rows, &rhs);
+            for (size_t j = 0; j < out->size(); ++j) {
+                datum_t *lhs = &(*out)[j];
+                if (!lhs->has()) {
+                    continue;
+                }
+                if (!rhs[j].has()
+                    || lhs->get_type() != datum_t::R_NUM
+                    || rhs[j].get_type() != datum_t::R_NUM) {
+                    *lhs = datum_t();
+                    continue;
+                }
+                const double res = (*op_)(lhs->as_num(), rhs[j].as_num());
+                *lhs = risfinite(res) ? datum_t(res) : datum_t();
+            }
+        }
+    }
+private:
+    double (*const op_)(double, double);
+    const batch_exprs_t args_;
+};
+
+bool batch_eq(const datum_t &lhs, const datum_t &rhs) { return lhs == rhs; }
+bool batch_lt(const datum_t &lhs, const datum_t &rhs) { return lhs.cmp(rhs) < 0; }
+bool batch_le(const datum_t &lhs, const datum_t &rhs) { return lhs.cmp(rhs) <= 0; }
+bool batch_gt(const datum_t &lhs, const datum_t &rhs) { return lhs.cmp(rhs) > 0; }
+bool batch_ge(const datum_t &lhs, const datum_t &rhs) { return lhs.cmp(rhs) >= 0; }
+
+// `EQ`, `NE`, `LT`, `LE`, `GT` and `GE`, which like in `predicate_term_t` compare
+// each argument with the next one and stop at the first comparison that fails.
+class compare_expr_t : public batch_expr_t {
+public:
+    compare_expr_t(bool (*pred)(const datum_t &, const datum_t &), bool invert,
+                   batch_exprs_t &&args)
+        : pred_(pred), invert_(invert), args_(std::move(args)) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        std::vector<datum_t> lhs;
+        args_[0]->eval(rows, &lhs);
+        out->assign(rows.size(), datum_t());
+        // Rows whose result is already known.
+        std::vector<bool> done(rows.size(), false);
+        size_t num_done = 0;
+        std::vector<datum_t> rhs;
+        for (size_t i = 1; i < args_.size() && num_done < rows.size(); ++i) {
+            args_[i]->eval(rows, &rhs);
+            for (size_t j = 0; j < rows.size(); ++j) {
+                if (done[j]) {
+                    continue;
+                }
+                if (!lhs[j].has() || !rhs[j].has()) {
+                    done[j] = true;
+                    ++num_done;
+                    continue;
+                }
+                try {
+                    if (!(*pred_)(lhs[j], rhs[j])) {
+                        (*out)[j] = datum_t::boolean(invert_);
+                        done[j] = true;
+                        ++num_done;
+                    }
+                } catch (const base_exc_t &) {
+                    done[j] = true;
+                    ++num_done;
+                }
+                lhs[j] = std::move(rhs[j]);
+            }
+        }
+        for (size_t j = 0; j < rows.size(); ++j) {
+            if (!done[j]) {
+                (*out)[j] = datum_t::boolean(!invert_);
+            }
+        }
+    }
+private:
+    bool (*const pred_)(const datum_t &, const datum_t &);
+    const bool invert_;
+    const batch_exprs_t args_;
+};
+
+// `AND` and `OR`, which return the first argument that decides the result, or the
+// last argument.
+class and_or_expr_t : public batch_expr_t {
+public:
+    and_or_expr_t(bool is_and, batch_exprs_t &&args)
+        : is_and_(is_and), args_(std::move(args)) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        out->assign(rows.size(), datum_t::boolean(is_and_));
+        std::vector<bool> done(rows.size(), false);
+        size_t num_done = 0;
+        std::vector<datum_t> values;
+        for (size_t i = 0; i < args_.size() && num_done < rows.size(); ++i) {
+            args_[i]->eval(rows, &values);
+            for (size_t j = 0; j < rows.size(); ++j) {
+                if (done[j]) {
+                    continue;
+                }
+                (*out)[j] = std::move(values[j]);
+                if (!(*out)[j].has() || (*out)[j].as_bool() != is_and_) {
+                    done[j] = true;
+                    ++num_done;
+                }
+            }
+        }
+    }
+private:
+    const bool is_and_;
+    const batch_exprs_t args_;
+};
+
+class not_expr_t : public batch_expr_t {
+public:
+    explicit not_expr_t(scoped_ptr_t<batch_expr_t> &&arg) : arg_(std::move(arg)) { }
+    void eval(const std::vector<datum_t> &rows, std::vector<datum_t> *out) const {
+        arg_->eval(rows, out);
+        for (datum_t &value : *out) {
+            if (value.has()) {
+                value = datum_t::boolean(!value.as_bool());
+            }
+        }
+    }
+private:
+    const scoped_ptr_t<batch_expr_t> arg_;
+};
+
+scoped_ptr_t<batch_expr_t> compile_expr(const std::vector<sym_t> &arg_names,
+                                        const raw_term_t &term);
+
+bool compile_args(const std::vector<sym_t> &arg_names,
+                  const raw_term_t &term,
+                  size_t min_args,
+                  batch_exprs_t *args_out) {
+    if (term.num_args() < min_args || term.num_optargs() != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < term.num_args(); ++i) {
+        scoped_ptr_t<batch_expr_t> arg = compile_expr(arg_names, term.arg(i));
+        if (!arg.has()) {
+            return false;
+        }
+        args_out->push_back(std::move(arg));
+    }
+    return true;
+}
+
+scoped_ptr_t<batch_expr_t> make_arith_expr(const std::vector<sym_t> &arg_names,
+                                           const raw_term_t &term,
+                                           double (*op)(double, double)) {
+    batch_exprs_t args;
+    if (!compile_args(arg_names, term, 1, &args)) {
+        return scoped_ptr_t<batch_expr_t>();
+    }
+    return make_scoped<arith_expr_t>(op, std::move(args));
+}
+
+scoped_ptr_t<batch_expr_t> make_compare_expr(
+        const std::vector<sym_t> &arg_names,
+        const raw_term_t &term,
+        bool (*pred)(const datum_t &, const datum_t &),
+        bool invert) {
+    batch_exprs_t args;
+    if (!compile_args(arg_names, term, 2, &args)) {
+        return scoped_ptr_t<batch_expr_t>();
+    }
+    return make_scoped<compare_expr_t>(pred, invert, std::move(args));
+}
+
+scoped_ptr_t<batch_expr_t> make_and_or_expr(const std::vector<sym_t> &arg_names,
+                                            const raw_term_t &term,
+                                            bool is_and) {
+    batch_exprs_t args;
+    if (!compile_args(arg_names, term, 0, &args)) {
+        return scoped_ptr_t<batch_expr_t>();
+    }
+    return make_scoped<and_or_expr_t>(is_and, std::move(args));
+}
+
+scoped_ptr_t<batch_expr_t> compile_expr(const std::vector<sym_t> &arg_names,
+                                        const raw_term_t &term) {
+    switch (static_cast<int>(term.type())) {
+    case Term::DATUM:
+        return make_scoped<constant_expr_t>(
+            term.datum(configured_limits_t::unlimited, reql_version_t::LATEST));
+    case Term::VAR: {
+        // Variables other than the argument come from the captured scope.
+        if (term.num_args() != 1 || term.arg(0).type() != Term::DATUM) {
+            break;
+        }
+        datum_t varname = term.arg(0).datum();
+        if (varname.get_type() != datum_t::R_NUM
+            || varname.as_int() != arg_names[0].value) {
+            break;
+        }
+        return make_scoped<row_expr_t>();
+    }
+    case Term::IMPLICIT_VAR:
+        if (!function_emits_implicit_variable(arg_names)) {
+            break;
+        }
+        return make_scoped<row_expr_t>();
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term.num_args() != 2 || term.num_optargs() != 0
+            || term.arg(1).type() != Term::DATUM) {
+            break;
+        }
+        datum_t name = term.arg(1).datum();
+        if (name.get_type() != datum_t::R_STR) {
+            break;
+        }
+        scoped_ptr_t<batch_expr_t> object = compile_expr(arg_names, term.arg(0));
+        if (!object.has()) {
+            break;
+        }
+        return make_scoped<get_field_expr_t>(std::move(object), name.as_str());
+    }
+    case Term::ADD: return make_arith_expr(arg_names, term, &batch_add);
+    case Term::SUB: return make_arith_expr(arg_names, term, &batch_sub);
+    case Term::MUL: return make_arith_expr(arg_names, term, &batch_mul);
+    case Term::DIV: return make_arith_expr(arg_names, term, &batch_div);
+    case Term::EQ: return make_compare_expr(arg_names, term, &batch_eq, false);
+    case Term::NE: return make_compare_expr(arg_names, term, &batch_eq, true);
+    case Term::LT: return make_compare_expr(arg_names, term, &batch_lt, false);
+    case Term::LE: return make_compare_expr(arg_names, term, &batch_le, false);
+    case Term::GT: return make_compare_expr(arg_names, term, &batch_gt, false);
+    case Term::GE: return make_compare_expr(arg_names, term, &batch_ge, false);
+    case Term::AND: return make_and_or_expr(arg_names, term, true);
+    case Term::OR: return make_and_or_expr(arg_names, term, false);
+    case Term::NOT: {
+        batch_exprs_t args;
+        if (!compile_args(arg_names, term, 1, &args) || args.size() != 1) {
+            break;
+        }
+        return make_scoped<not_expr_t>(std::move(args[0]));
+    }
+    default:
+        break;
+    }
+    return scoped_ptr_t<batch_expr_t>();
+}
+
+}  // namespace
+
+batch_func_t::batch_func_t(scoped_ptr_t<batch_expr_t> &&root)
+    : root_(std::move(root)) { }
+
+batch_func_t::~batch_func_t() { }
+
+scoped_ptr_t<batch_func_t> batch_func_t::compile(const std::vector<sym_t> &arg_names,
+                                                 const raw_term_t &body) {
+    if (arg_names.size() != 1) {
+        return scoped_ptr_t<batch_func_t>();
+    }
+    scoped_ptr_t<batch_expr_t> root = compile_expr(arg_names, body);
+    if (!root.has()) {
+        return scoped_ptr_t<batch_func_t>();
+    }
+    return scoped_ptr_t<batch_func_t>(new batch_func_t(std::move(root)));
+}
+
+void batch_func_t::eval(const std::vector<datum_t> &rows,
+                        std::vector<datum_t> *results_out) const {
+    root_->eval(rows, results_out);
+    rassert(results_out->size() == rows.size());
+}
+
+}  // namespace ql
@@ -0,0 +1,53 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_BATCH_FUNC_HPP_
+#define RDB_PROTOCOL_BATCH_FUNC_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sym.hpp"
+
+namespace ql {
+
+class batch_expr_t;
+class raw_term_t;
+
+/* Evaluating a function term by term for every row has a lot of overhead compared
+to the work that simple functions like `r.row('a').mul(2)` or `r.row('x').gt(5)` do.
+A `batch_func_t` evaluates such a function for a whole batch of rows at once, one
+term at a time: every term computes its value for all of the rows before the term
+above it looks at any of them.
+
+Only functions of one argument whose bodies consist of the argument, constants,
+field accesses, arithmetic, comparisons and boolean operations can be compiled.
+Terms never fail for a row.  Instead, whenever a row leads to anything but the
+common case (a missing field, a type mismatch, division by zero, a non-finite
+result, ...), its result is left empty, and the caller evaluates the function for
+that row with the regular interpreter.  That way we don't have to duplicate the
+interpreter's error handling. */
+class batch_func_t {
+public:
+    // Returns an empty pointer if the body can't be evaluated a batch at a time.
+    static scoped_ptr_t<batch_func_t> compile(const std::vector<sym_t> &arg_names,
+                                              const raw_term_t &body);
+
+    ~batch_func_t();
+
+    // Resizes `*results_out` to the size of `rows`.  Each result is either the value
+    // of the function for the corresponding row, or an empty datum if the row has to
+    // be evaluated by the interpreter.
+    void eval(const std::vector<datum_t> &rows,
+              std::vector<datum_t> *results_out) const;
+
+private:
+    explicit batch_func_t(scoped_ptr_t<batch_expr_t> &&root);
+
+    scoped_ptr_t<batch_expr_t> root_;
+
+    DISABLE_COPYING(batch_func_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_BATCH_FUNC_HPP_
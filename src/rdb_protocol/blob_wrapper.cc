@@ -19,7 +19,7 @@ rdb_blob_wrapper_t::rdb_blob_wrapper_t(
         rassert(*it == 0);
     }
 #endif
-    internal.append_region(parent, data.size());
+    internal.append_region(parent, data.size(), blob::layout_t::contiguous);
     internal.write_from_string(data, parent, 0);
 }
 
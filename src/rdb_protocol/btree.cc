@@ -11,6 +11,7 @@
 #include "errors.hpp"
 #include <boost/optional.hpp>
 
+#include "btree/bulk_load.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/get_distribution.hpp"
 #include "btree/operations.hpp"
@@ -24,6 +25,7 @@
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/distribution_progress.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/indexing.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
@@ -102,7 +104,8 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
         response->data = ql::datum_t::null();
     } else {
         response->data = get_data(static_cast<rdb_value_t *>(kv_location.value.get()),
-                                  buf_parent_t(&kv_location.buf));
+                                  buf_parent_t(&kv_location.buf),
+                                  slice->key_dictionary);
     }
 }
 
@@ -144,6 +147,7 @@ kv_location_set(keyvalue_location_t *kv_location,
                 ql::datum_t data,
                 repli_timestamp_t timestamp,
                 const deletion_context_t *deletion_context,
+                const key_encoder_t &key_encoder,
                 rdb_modification_info_t *mod_info_out) THROWS_NOTHING {
     scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
     memset(new_value.get(), 0, blob::btree_maxreflen);
@@ -153,7 +157,7 @@ kv_location_set(keyvalue_location_t *kv_location,
         blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
         ql::serialization_result_t res
             = datum_serialize_onto_blob(buf_parent_t(&kv_location->buf),
-                                        &blob, data);
+                                        &blob, data, key_encoder);
         if (bad(res)) return res;
     }
 
@@ -212,38 +216,30 @@ kv_location_set(keyvalue_location_t *kv_location,
     return ql::serialization_result_t::SUCCESS;
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+/* Replaces the row at `*kv_location`, which must have been found for `key`. */
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t &btree,
+    const store_key_t &key,
     const btree_point_replacer_t *replacer,
     const deletion_context_t *deletion_context,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace) {
+    keyvalue_location_t *kv_location,
+    rdb_modification_info_t *mod_info_out) {
     const return_changes_t return_changes = replacer->should_return_changes();
-    const datum_string_t &primary_key = info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const datum_string_t &primary_key = btree.primary_key;
 
     try {
-        keyvalue_location_t kv_location;
-        rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
-        find_keyvalue_location_for_write(&sizer, info.superblock,
-                                         info.key->btree_key(),
-                                         info.btree->timestamp,
-                                         deletion_context->balancing_detacher(),
-                                         &kv_location,
-                                         trace,
-                                         superblock_promise);
-        info.btree->slice->stats.pm_keys_set.record();
-        info.btree->slice->stats.pm_total_keys_set += 1;
+        btree.slice->stats.pm_keys_set.record();
+        btree.slice->stats.pm_total_keys_set += 1;
 
         ql::datum_t old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
             old_val = ql::datum_t::null();
         } else {
             // Otherwise pass the entry with this key to the function.
-            old_val = get_data(kv_location.value_as<rdb_value_t>(),
-                               buf_parent_t(&kv_location.buf));
+            old_val = get_data(kv_location->value_as<rdb_value_t>(),
+                               buf_parent_t(&kv_location->buf),
+                               btree.slice->key_dictionary);
             guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
         }
         guarantee(old_val.has());
@@ -267,15 +263,15 @@ batched_replace_response_t rdb_replace_and_return_superblock(
 
             /* Now that the change has passed validation, write it to disk */
             if (new_val.get_type() == ql::datum_t::R_NULL) {
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
+                kv_location_delete(kv_location, key, btree.timestamp,
                                    deletion_context, delete_mode_t::REGULAR_QUERY,
                                    mod_info_out);
             } else {
                 r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
                 ql::serialization_result_t res =
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp, deletion_context,
-                                    mod_info_out);
+                    kv_location_set(kv_location, key, new_val,
+                                    btree.timestamp, deletion_context,
+                                    btree.key_encoder, mod_info_out);
                 if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
                     rfail_typed_target(&new_val, "Array too large for disk writes "
                                        "(limit 100,000 elements).");
@@ -335,12 +331,35 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+/* Takes the superblock back from `*kv_location` or from `*superblock_promise`,
+whichever `find_keyvalue_location_for_write()` left it in. */
+superblock_t *take_superblock_from_location(
+        keyvalue_location_t *kv_location,
+        promise_t<superblock_t *> *superblock_promise) {
+    superblock_t *superblock = kv_location->superblock;
+    if (superblock != nullptr) {
+        kv_location->superblock = nullptr;
+    } else {
+        superblock = superblock_promise->assert_get_value();
+    }
+    return superblock;
+}
+
+/* Performs the replaces of a run of keys from `sorted_indices`, starting at
+`run_begin`. The run is made of the keys that can be written without descending the
+btree again, and its end gets pulsed on `run_end_promise` before the superblock gets
+passed on to `superblock_promise`. */
+void do_a_run_of_replaces_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *btree,
+    real_superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *sorted_indices,
+    size_t run_begin,
+    promise_t<size_t> *run_end_promise,
+    const btree_batched_replacer_t *replacer,
     const ql::configured_limits_t &limits,
     promise_t<superblock_t *> *superblock_promise,
     rdb_modification_report_cb_t *mod_cb,
@@ -351,25 +370,98 @@ void do_a_replace_from_batched_replace(
 
     fifo_enforcer_sink_t::exit_write_t exiter(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
-    // We need to get in line for this while still holding the superblock so
-    // that stamp read operations can't queue-skip.
-    info.superblock->get()->write_acq_signal()->wait_lazily_unordered();
-    rwlock_in_line_t stamp_spot = mod_cb->get_in_line_for_cfeed_stamp();
+    superblock->get()->write_acq_signal()->wait_lazily_unordered();
 
     rdb_live_deletion_context_t deletion_context;
-    rdb_modification_report_t mod_report(*info.key);
-    ql::datum_t res = rdb_replace_and_return_superblock(
-        info, &one_replace, &deletion_context, superblock_promise, &mod_report.info,
-        trace);
-    *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    std::vector<rdb_modification_report_t> mod_reports;
+    std::vector<rwlock_in_line_t> stamp_spots;
+    {
+        // While the btree is so shallow that the leaf's parent is the root, we can't
+        // pass on the superblock before we're done. In exchange we can descend again
+        // from it whenever the leaf's parent fills up.
+        scoped_ptr_t<promise_t<superblock_t *> > held_superblock
+            = make_scoped<promise_t<superblock_t *> >();
+        scoped_ptr_t<keyvalue_location_t> kv_location
+            = make_scoped<keyvalue_location_t>();
+        find_keyvalue_location_for_write(
+            &sizer, superblock,
+            (*keys)[(*sorted_indices)[run_begin]].btree_key(),
+            btree->timestamp, deletion_context.balancing_detacher(),
+            kv_location.get(), trace, held_superblock.get());
+
+        const size_t max_run_size = max_writes_at_keyvalue_location(kv_location.get());
+        size_t run_end = run_begin + 1;
+        while (run_end < sorted_indices->size()
+               && run_end - run_begin < max_run_size
+               && can_reuse_keyvalue_location_for_write(
+                   kv_location.get(),
+                   (*keys)[(*sorted_indices)[run_end]].btree_key())) {
+            ++run_end;
+        }
+
+        // We need to get in line for this while still holding the superblock so
+        // that stamp read operations can't queue-skip.
+        stamp_spots.reserve(run_end - run_begin);
+        for (size_t i = run_begin; i < run_end; ++i) {
+            stamp_spots.push_back(mod_cb->get_in_line_for_cfeed_stamp());
+        }
+        run_end_promise->pulse(run_end);
+        if (held_superblock->is_pulsed()) {
+            superblock_promise->pulse(held_superblock->assert_get_value());
+            kv_location->pass_back_superblock = nullptr;
+            held_superblock.reset();
+        }
+
+        mod_reports.reserve(run_end - run_begin);
+        for (size_t i = run_begin; i < run_end; ++i) {
+            const size_t index = (*sorted_indices)[i];
+            const store_key_t &key = (*keys)[index];
+            if (i != run_begin) {
+                if (can_reuse_keyvalue_location_for_write(
+                        kv_location.get(), key.btree_key())) {
+                    reuse_keyvalue_location_for_write(
+                        &sizer, key.btree_key(), kv_location.get());
+                } else {
+                    // `max_run_size` rules this out unless we hold the superblock.
+                    guarantee(held_superblock.has());
+                    superblock_t *sb = take_superblock_from_location(
+                        kv_location.get(), held_superblock.get());
+                    kv_location = make_scoped<keyvalue_location_t>();
+                    held_superblock = make_scoped<promise_t<superblock_t *> >();
+                    find_keyvalue_location_for_write(
+                        &sizer, sb, key.btree_key(),
+                        btree->timestamp, deletion_context.balancing_detacher(),
+                        kv_location.get(), trace, held_superblock.get());
+                }
+            }
+
+            mod_reports.push_back(rdb_modification_report_t(key));
+            one_replace_t one_replace(replacer, index);
+            ql::datum_t res = rdb_replace_at_location(
+                *btree, key, &one_replace, &deletion_context, kv_location.get(),
+                &mod_reports.back().info);
+            *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+        }
+
+        if (held_superblock.has()) {
+            superblock_t *sb = take_superblock_from_location(
+                kv_location.get(), held_superblock.get());
+            kv_location.reset();
+            superblock_promise->pulse(sb);
+        }
+    }
 
     // We wait to make sure we acquire `acq` in the same order we were
     // originally called.
     exiter.wait();
-    new_mutex_in_line_t sindex_spot = mod_cb->get_in_line_for_sindex();
-
-    mod_cb->on_mod_report(
-        mod_report, update_pkey_cfeeds, &sindex_spot, &stamp_spot);
+    for (size_t i = 0; i < mod_reports.size(); ++i) {
+        new_mutex_in_line_t sindex_spot = mod_cb->get_in_line_for_sindex();
+        mod_cb->on_mod_report(
+            mod_reports[i], update_pkey_cfeeds, &sindex_spot, &stamp_spots[i]);
+        // The next key's stamp spot only comes up once we leave this one.
+        stamp_spots[i].reset();
+    }
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -415,18 +507,34 @@ batched_replace_response_t rdb_batched_replace(
         // write operations depending on the presence of limit changefeeds.
         scoped_ptr_t<real_superblock_t> current_superblock(superblock->release());
         bool update_pkey_cfeeds = sindex_cb->has_pkey_cfeeds(keys);
+        // We write the keys in ascending order, so that consecutive keys that go to
+        // the same leaf node can share one descent of the btree. The sort is stable
+        // because the replacer must see repeated keys in their original order.
+        std::vector<size_t> sorted_indices(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sorted_indices[i] = i;
+        }
+        std::stable_sort(sorted_indices.begin(), sorted_indices.end(),
+                         [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
         {
             auto_drainer_t drainer;
-            for (size_t i = 0; i < keys.size(); ++i) {
+            size_t run_begin = 0;
+            while (run_begin < sorted_indices.size()) {
                 promise_t<superblock_t *> superblock_promise;
+                promise_t<size_t> run_end_promise;
                 coro_queue.push(
                     std::bind(
-                        &do_a_replace_from_batched_replace,
+                        &do_a_run_of_replaces_from_batched_replace,
                         auto_drainer_t::lock_t(&drainer),
                         &sink,
                         source.enter_write(),
-                        btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                        one_replace_t(replacer, i),
+                        &info,
+                        current_superblock.release(),
+                        &keys,
+                        &sorted_indices,
+                        run_begin,
+                        &run_end_promise,
+                        replacer,
                         limits,
                         &superblock_promise,
                         sindex_cb,
@@ -436,6 +544,7 @@ batched_replace_response_t rdb_batched_replace(
                         &conditions));
                 current_superblock.init(
                     static_cast<real_superblock_t *>(superblock_promise.wait()));
+                run_begin = run_end_promise.assert_get_value();
             }
             if (!update_pkey_cfeeds) {
                 current_superblock.reset(); // Release the superblock early if
@@ -464,7 +573,8 @@ void rdb_set(const store_key_t &key,
              point_write_response_t *response_out,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace,
-             promise_t<superblock_t *> *pass_back_superblock) {
+             promise_t<superblock_t *> *pass_back_superblock,
+             const key_encoder_t &key_encoder) {
     keyvalue_location_t kv_location;
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(), timestamp,
@@ -477,7 +587,8 @@ void rdb_set(const store_key_t &key,
     /* update the modification report */
     if (kv_location.value.has()) {
         mod_info->deleted.first = get_data(kv_location.value_as<rdb_value_t>(),
-                                           buf_parent_t(&kv_location.buf));
+                                           buf_parent_t(&kv_location.buf),
+                                           slice->key_dictionary);
     }
 
     mod_info->added.first = data;
@@ -485,7 +596,7 @@ void rdb_set(const store_key_t &key,
     if (overwrite || !had_value) {
         ql::serialization_result_t res =
             kv_location_set(&kv_location, key, data, timestamp, deletion_context,
-                            mod_info);
+                            key_encoder, mod_info);
         if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
             rfail_typed_target(&data, "Array too large for disk writes "
                                "(limit 100,000 elements).");
@@ -501,6 +612,41 @@ void rdb_set(const store_key_t &key,
         (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
 }
 
+void rdb_bulk_load(const store_key_t &key,
+                   ql::datum_t data,
+                   btree_slice_t *slice,
+                   repli_timestamp_t timestamp,
+                   btree_bulk_loader_t *loader,
+                   rdb_modification_info_t *mod_info) {
+    slice->stats.pm_keys_set.record();
+    slice->stats.pm_total_keys_set += 1;
+
+    // The value's blob has to go under the leaf that the value goes to.
+    const buf_parent_t leaf = loader->prepare_append(key.btree_key());
+    const max_block_size_t block_size = leaf.cache()->max_block_size();
+    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
+    memset(new_value.get(), 0, blob::btree_maxreflen);
+    {
+        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
+        ql::serialization_result_t res
+            = datum_serialize_onto_blob(leaf, &blob, data);
+        if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
+            rfail_typed_target(&data, "Array too large for disk writes "
+                               "(limit 100,000 elements).");
+        } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
+            rfail_typed_target(&data, "`r.minval` and `r.maxval` cannot be "
+                               "written to disk.");
+        }
+        r_sanity_check(!ql::bad(res));
+    }
+
+    mod_info->added.first = data;
+    mod_info->added.second.assign(new_value->value_ref(),
+        new_value->value_ref() + new_value->inline_size(block_size));
+
+    loader->append(key.btree_key(), new_value.get(), timestamp);
+}
+
 void rdb_delete(const store_key_t &key, btree_slice_t *slice,
                 repli_timestamp_t timestamp,
                 real_superblock_t *superblock,
@@ -522,7 +668,8 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice,
     /* Update the modification report. */
     if (exists) {
         mod_info->deleted.first = get_data(kv_location.value_as<rdb_value_t>(),
-                                           buf_parent_t(&kv_location.buf));
+                                           buf_parent_t(&kv_location.buf),
+                                           slice->key_dictionary);
         kv_location_delete(&kv_location, key, timestamp, deletion_context,
             delete_mode, mod_info);
         guarantee(!mod_info->deleted.second.empty() && mod_info->added.second.empty());
@@ -731,7 +878,7 @@ continue_bool_t rget_cb_t::handle_pair(
         return continue_bool_t::CONTINUE;
     }
     lazy_btree_val_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
-                         keyvalue.expose_buf());
+                         keyvalue.expose_buf(), io.slice->key_dictionary);
     ql::datum_t val;
     // Count stats whether or not we deserialize the value
     io.slice->stats.pm_keys_read.record();
@@ -1388,7 +1535,8 @@ void rdb_modification_report_cb_t::on_mod_report(
                         new_cfeed_keys,
                         report.primary_key,
                         report.info.deleted.first,
-                        report.info.added.first}),
+                        report.info.added.first,
+                        boost::none}),
                 report.primary_key,
                 cfeed_stamp_spot,
                 cserver.second);
@@ -1903,8 +2051,8 @@ void rdb_update_sindexes(
         for (const auto &sindex : sindexes) {
             // Update only indexes that have been post-constructed for the relevant
             // range.
-            if (!sindex->sindex.needs_post_construction_range.contains_key(
-                    modification->primary_key)) {
+            if (!store->sindex_needs_post_construction(
+                    sindex->sindex, modification->primary_key)) {
                 ++counter;
                 // If the index isn't done constructing yet, we must use a noop deletion
                 // context. The reason is that such an index might have pointers to
@@ -1993,7 +2141,8 @@ public:
             keyvalue.expose_buf().cache()->max_block_size();
         mod_report.info.added
             = std::make_pair(
-                get_data(rdb_value, buf_parent_t(keyvalue.expose_buf())),
+                get_data(rdb_value, buf_parent_t(keyvalue.expose_buf()),
+                         store_->btree->key_dictionary),
                 std::vector<char>(rdb_value->value_ref(),
                     rdb_value->value_ref() + rdb_value->inline_size(block_size)));
 
@@ -2190,6 +2339,7 @@ void post_construct_secondary_index_range(
     cache_account
         = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
     txn->set_account(&cache_account);
+    txn->set_access_pattern(page_access_pattern_t::scan);
 
     continue_bool_t cont = btree_concurrent_traversal(
         superblock.get(),
@@ -2207,12 +2357,252 @@ void post_construct_secondary_index_range(
         // The construction is done. Set the remaining range to empty.
         *construction_range_inout = key_range_t::empty();
     } else {
-        // (the key_range_t construction below needs to be updated if the right bound can
-        //  be bounded. For now we assume it's unbounded.)
-        guarantee(construction_range_inout->right.unbounded);
-        *construction_range_inout = key_range_t(
+        key_range_t remaining(
             key_range_t::bound_t::open, traversal_cb.get_traversed_right_bound(),
             key_range_t::bound_t::none, store_key_t());
+        remaining.right = construction_range_inout->right;
+        *construction_range_inout = remaining;
+    }
+}
+
+/* Collects the secondary index entries of every row in the sorter of
+`post_construct_secondary_index_sorted()`. */
+class sorted_build_traversal_helper_t : public concurrent_traversal_callback_t {
+public:
+    sorted_build_traversal_helper_t(
+            store_t *store,
+            const sindex_disk_info_t &sindex_info,
+            sindex_entry_sorter_t *sorter,
+            const std::function<void(const store_key_t &)> &on_traversed,
+            signal_t *interruptor)
+        : store_(store),
+          sindex_info_(sindex_info),
+          sorter_(sorter),
+          on_traversed_(on_traversed),
+          interruptor_(interruptor) { }
+
+    continue_bool_t handle_pair(
+            scoped_key_value_t &&keyvalue,
+            concurrent_traversal_fifo_enforcer_signal_t waiter)
+            THROWS_ONLY(interrupted_exc_t) {
+        if (interruptor_->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+
+        store_->btree->stats.pm_keys_read.record();
+        store_->btree->stats.pm_total_keys_read += 1;
+
+        const store_key_t primary_key(keyvalue.key());
+        const rdb_value_t *rdb_value =
+            static_cast<const rdb_value_t *>(keyvalue.value());
+        const max_block_size_t block_size =
+            keyvalue.expose_buf().cache()->max_block_size();
+        // Like in `rdb_update_single_sindex()`, index entries refer to the blob of the
+        // row in the primary index.
+        const std::vector<char> value_ref(
+            rdb_value->value_ref(),
+            rdb_value->value_ref() + rdb_value->inline_size(block_size));
+        std::vector<std::pair<store_key_t, ql::datum_t> > keys;
+        try {
+            compute_keys(primary_key,
+                         get_data(rdb_value, buf_parent_t(keyvalue.expose_buf()),
+                                  store_->btree->key_dictionary),
+                         sindex_info_, &keys, nullptr);
+        } catch (const ql::base_exc_t &) {
+            // The row doesn't go into the index.
+        }
+
+        {
+            // Writing a run to disk blocks, and only one coroutine can do that at a
+            // time.
+            new_mutex_acq_t sorter_acq(&sorter_lock_, interruptor_);
+            for (auto &&pair : keys) {
+                sorter_->push(std::make_pair(std::move(pair.first), value_ref));
+            }
+        }
+
+        waiter.wait();
+        on_traversed_(primary_key);
+        return continue_bool_t::CONTINUE;
+    }
+
+private:
+    store_t *store_;
+    const sindex_disk_info_t &sindex_info_;
+    sindex_entry_sorter_t *sorter_;
+    std::function<void(const store_key_t &)> on_traversed_;
+    signal_t *interruptor_;
+    new_mutex_t sorter_lock_;
+};
+
+void post_construct_secondary_index_sorted(
+        store_t *store,
+        const uuid_u &sindex_id,
+        const std::function<void(double)> &on_progress,
+        const distribution_progress_estimator_t &progress_estimator,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    // The entries we sort in memory may take up a quarter of what the table's cache
+    // is allowed to use, so a build on a table with a small cache doesn't take a lot
+    // more memory than the table itself.  Below the minimum, the runs would get so
+    // short that merging them takes more passes than it's worth.
+    static const uint64_t SORTER_CACHE_FRACTION_DIVISOR = 4;
+    static const uint64_t MIN_SORTER_MEMORY = 4 * MEGABYTE;
+    // Appending to the right edge of the index only makes a few leaves dirty, so we
+    // can afford a lot more entries per transaction than
+    // `post_construct_traversal_helper_t`.
+    static const int64_t ENTRIES_PER_TXN = 1024;
+
+    const uuid_u sorter_id = generate_uuid();
+    sindex_entry_sorter_t sorter(
+        store->io_backender_,
+        [&](size_t run) {
+            return serializer_filepath_t(
+                store->base_path_,
+                strprintf("sindex_build_%s_%zu", uuid_to_str(sorter_id).c_str(), run));
+        },
+        &store->perfmon_collection,
+        std::max(MIN_SORTER_MEMORY,
+                 store->cache->memory_limit() / SORTER_CACHE_FRACTION_DIVISOR));
+
+    /* Collect the index entries of every row from a snapshot of the primary index. We
+    count this as the first half of the progress. */
+    {
+        sindex_disk_info_t sindex_info;
+        {
+            read_token_t token;
+            store->new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            store->acquire_superblock_for_read(
+                &token, &txn, &superblock, interruptor, false /* USE_SNAPSHOT */);
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::read);
+            superblock.reset();
+            secondary_index_t sindex;
+            if (!get_secondary_index(&sindex_block, sindex_id, &sindex)
+                || sindex.being_deleted) {
+                throw interrupted_exc_t();
+            }
+            deserialize_sindex_info_or_crash(sindex.opaque_definition, &sindex_info);
+        }
+
+        // Mind the destructor ordering, like in
+        // `post_construct_secondary_index_range()`.
+        cache_account_t cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        read_token_t read_token;
+        store->new_read_token(&read_token);
+        store->acquire_superblock_for_read(
+            &read_token, &txn, &superblock, interruptor, true /* USE_SNAPSHOT */);
+        cache_account = txn->cache()->create_cache_account(
+            SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        txn->set_account(&cache_account);
+        txn->set_access_pattern(page_access_pattern_t::scan);
+
+        sorted_build_traversal_helper_t traversal_cb(
+            store,
+            sindex_info,
+            &sorter,
+            [&](const store_key_t &traversed) {
+                on_progress(0.5 * progress_estimator.estimate_progress(traversed));
+            },
+            interruptor);
+        continue_bool_t cont = btree_concurrent_traversal(
+            superblock.get(),
+            key_range_t::universe(),
+            &traversal_cb,
+            direction_t::FORWARD,
+            release_superblock_t::RELEASE);
+        if (cont == continue_bool_t::ABORT) {
+            throw interrupted_exc_t();
+        }
+    }
+
+    /* Load the sorted entries into the index from left to right. The index is empty
+    apart from what the caller's queue has yet to apply, so the entries normally go past
+    its end. The exception are entries that show up more than once, which we insert
+    like any other write. */
+    const int64_t total_entries = sorter.size();
+    rdb_value_sizer_t sizer(store->cache->max_block_size());
+    const rdb_post_construction_deletion_context_t deletion_context;
+    std::set<uuid_u> sindex_ids;
+    sindex_ids.insert(sindex_id);
+    while (!sorter.empty()) {
+        write_token_t token;
+        store->new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        // We use HARD durability for the same reason as
+        // `post_construct_traversal_helper_t`.
+        store->acquire_superblock_for_write(
+            2 + ENTRIES_PER_TXN,
+            write_durability_t::HARD,
+            &token,
+            &txn,
+            &superblock,
+            interruptor);
+        store_t::sindex_access_vector_t sindexes;
+        {
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::write);
+            superblock.reset();
+            store->acquire_sindex_superblocks_for_write(
+                sindex_ids, &sindex_block, &sindexes);
+        }
+        if (sindexes.empty() || sindexes[0]->sindex.being_deleted) {
+            throw interrupted_exc_t();
+        }
+        superblock_t *sindex_superblock = sindexes[0]->superblock.get();
+
+        scoped_ptr_t<btree_bulk_loader_t> loader;
+        for (int64_t i = 0; i < ENTRIES_PER_TXN && !sorter.empty(); ++i) {
+            if (interruptor->is_pulsed()) {
+                throw interrupted_exc_t();
+            }
+            sindex_entry_t entry;
+            sorter.pop(&entry);
+            if (!loader.has()) {
+                loader.init(new btree_bulk_loader_t(&sizer, sindex_superblock));
+            }
+            if (loader->can_append(entry.first.btree_key())) {
+                loader->prepare_append(entry.first.btree_key());
+                loader->append(entry.first.btree_key(), entry.second.data(),
+                               repli_timestamp_t::distant_past);
+            } else {
+                // The loader holds the right edge of the index, which the regular
+                // write might need.
+                loader.reset();
+                promise_t<superblock_t *> pass_back_superblock;
+                {
+                    keyvalue_location_t kv_location;
+                    find_keyvalue_location_for_write(
+                        &sizer,
+                        sindex_superblock,
+                        entry.first.btree_key(),
+                        repli_timestamp_t::distant_past,
+                        deletion_context.balancing_detacher(),
+                        &kv_location,
+                        nullptr,
+                        &pass_back_superblock);
+                    ql::serialization_result_t res =
+                        kv_location_set(&kv_location, entry.first, entry.second,
+                                        repli_timestamp_t::distant_past,
+                                        &deletion_context);
+                    guarantee(!bad(res));
+                }
+                sindex_superblock = pass_back_superblock.wait();
+            }
+            store->btree->stats.pm_keys_set.record();
+            store->btree->stats.pm_total_keys_set += 1;
+        }
+        loader.reset();
+
+        on_progress(0.5 + 0.5 * static_cast<double>(total_entries - sorter.size())
+                        / static_cast<double>(total_entries));
     }
 }
 
@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_BTREE_HPP_
 #define RDB_PROTOCOL_BTREE_HPP_
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -10,13 +11,17 @@
 
 #include "btree/types.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "containers/disk_backed_sorter.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/key_dictionary.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/store.hpp"
 
+class btree_bulk_loader_t;
 class btree_slice_t;
 enum class delete_mode_t;
 class deletion_context_t;
+class distribution_progress_estimator_t;
 class key_tester_t;
 template <class> class promise_t;
 struct rdb_value_t;
@@ -66,14 +71,16 @@ void rdb_get(
 struct btree_info_t {
     btree_info_t(btree_slice_t *_slice,
                  repli_timestamp_t _timestamp,
-                 const datum_string_t &_primary_key)
+                 const datum_string_t &_primary_key,
+                 const key_encoder_t &_key_encoder)
         : slice(_slice), timestamp(_timestamp),
-          primary_key(_primary_key) {
+          primary_key(_primary_key), key_encoder(_key_encoder) {
         guarantee(slice != NULL);
     }
     btree_slice_t *const slice;
     const repli_timestamp_t timestamp;
     const datum_string_t primary_key;
+    const key_encoder_t key_encoder;
 };
 
 struct btree_loc_info_t {
@@ -121,7 +128,8 @@ void rdb_set(const store_key_t &key, ql::datum_t data,
              point_write_response_t *response,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace,
-             promise_t<superblock_t *> *pass_back_superblock = nullptr);
+             promise_t<superblock_t *> *pass_back_superblock = nullptr,
+             const key_encoder_t &key_encoder = key_encoder_t());
 
 void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 timestamp, real_superblock_t *superblock,
@@ -132,6 +140,13 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 profile::trace_t *trace,
                 promise_t<superblock_t *> *pass_back_superblock = nullptr);
 
+/* Like `rdb_set()` for a key that goes past the end of the B-tree, which
+`loader->can_append(key)` must confirm. */
+void rdb_bulk_load(const store_key_t &key, ql::datum_t data,
+                   btree_slice_t *slice, repli_timestamp_t timestamp,
+                   btree_bulk_loader_t *loader,
+                   rdb_modification_info_t *mod_info);
+
 void rdb_rget_slice(
     btree_slice_t *slice,
     const region_t &shard,
@@ -337,6 +352,34 @@ void post_construct_secondary_index_range(
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
+/* The entries of a secondary index, i.e. the index key and a reference to the row's
+blob in the primary index, in index key order. */
+typedef std::pair<store_key_t, std::vector<char> > sindex_entry_t;
+
+struct sindex_entry_memory_usage_t {
+    size_t operator()(const sindex_entry_t &entry) const {
+        return sizeof(entry) + entry.second.capacity();
+    }
+};
+
+typedef disk_backed_sorter_t<sindex_entry_t,
+                             std::less<sindex_entry_t>,
+                             sindex_entry_memory_usage_t> sindex_entry_sorter_t;
+
+/* Constructs all of a secondary index that's still empty in one go, rather than in
+passes of `post_construct_secondary_index_range()`. We compute the entries of all rows
+in a snapshot of the primary index, sort them with an external merge sort and then
+bulk-load them into the index. This writes the index sequentially instead of at
+random places, and leaves its leaves full. Writes to the table must go into a queue for
+the whole time, and be applied by the caller afterwards. */
+void post_construct_secondary_index_sorted(
+        store_t *store,
+        const uuid_u &sindex_id,
+        const std::function<void(double)> &on_progress,
+        const distribution_progress_estimator_t &progress_estimator,
+        signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
 /* This deleter actually deletes the value and all associated blocks. */
 class rdb_value_deleter_t : public value_deleter_t {
 public:
@@ -95,7 +95,8 @@ store_t::store_t(const region_t &_region,
       table_id(_table_id),
       write_superblock_acq_semaphore(WRITE_SUPERBLOCK_ACQ_WAITERS_LIMIT)
 {
-    cache.init(new cache_t(serializer, balancer, &perfmon_collection));
+    cache.init(new cache_t(serializer, balancer, &perfmon_collection,
+                           alt::get_table_page_repl_policy()));
     general_cache_conn.init(new cache_conn_t(cache.get()));
 
     if (create) {
@@ -139,6 +140,7 @@ store_t::store_t(const region_t &_region,
                                     false /* don't use snapshot */ );
 
         metainfo.init(new store_metainfo_manager_t(superblock.get()));
+        btree->key_dictionary = metainfo->key_dictionary();
 
         buf_lock_t sindex_block(superblock->expose_buf(),
                                 superblock->get_sindex_block_id(),
@@ -157,6 +159,7 @@ store_t::store_t(const region_t &_region,
                                                     pc,
                                                     it->first.name,
                                                     index_type_t::SECONDARY);
+            slice->key_dictionary = metainfo->key_dictionary();
             secondary_index_slices.insert(std::make_pair(it->second.id,
                                                          std::move(slice)));
         }
@@ -610,12 +613,12 @@ boost::optional<uuid_u> store_t::add_sindex_internal(
             btree_slice_t::init_sindex_superblock(&superblock);
         }
 
-        secondary_index_slices.insert(
-                std::make_pair(sindex.id,
-                               make_scoped<btree_slice_t>(cache.get(),
-                                                          &perfmon_collection,
-                                                          name.name,
-                                                          index_type_t::SECONDARY)));
+        auto slice = make_scoped<btree_slice_t>(cache.get(),
+                                                &perfmon_collection,
+                                                name.name,
+                                                index_type_t::SECONDARY);
+        slice->key_dictionary = metainfo->key_dictionary();
+        secondary_index_slices.insert(std::make_pair(sindex.id, std::move(slice)));
 
         sindex.needs_post_construction_range = key_range_t::universe();
 
@@ -942,6 +945,32 @@ bool store_t::mark_index_up_to_date(uuid_u id,
     return found;
 }
 
+bool store_t::mark_index_part_up_to_date(
+        uuid_u id,
+        buf_lock_t *sindex_block,
+        size_t part,
+        const key_range_t &except_for_remaining_range_of_part)
+    THROWS_NOTHING {
+    auto parts = sindex_postcon_parts.find(id);
+    guarantee(parts != sindex_postcon_parts.end());
+    guarantee(part < parts->second.size());
+    parts->second[part] = except_for_remaining_range_of_part;
+
+    // The parts are in key order, so this covers the remaining range of every part.
+    key_range_t remaining_range = key_range_t::empty();
+    for (const key_range_t &remaining_range_of_part : parts->second) {
+        if (remaining_range_of_part.is_empty()) {
+            continue;
+        }
+        if (remaining_range.is_empty()) {
+            remaining_range = remaining_range_of_part;
+        } else {
+            remaining_range.right = remaining_range_of_part.right;
+        }
+    }
+    return mark_index_up_to_date(id, sindex_block, remaining_range);
+}
+
 MUST_USE bool store_t::mark_secondary_index_deleted(
         buf_lock_t *sindex_block,
         const sindex_name_t &name) {
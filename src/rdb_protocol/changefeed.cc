@@ -9,7 +9,9 @@
 #include "clustering/table_manager/table_meta_client.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
+#include "concurrency/queue/spilling_queue.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
@@ -27,6 +29,8 @@ namespace ql {
 namespace changefeed {
 
 struct indexed_datum_t {
+    // For deserialization.
+    indexed_datum_t() { }
     indexed_datum_t(
             datum_t _val,
             boost::optional<std::string> _btree_index_key)
@@ -40,6 +44,7 @@ struct indexed_datum_t {
     // well in optionals.
     // MOVABLE_BUT_NOT_COPYABLE(indexed_datum_t);
 };
+RDB_MAKE_SERIALIZABLE_2(indexed_datum_t, val, btree_index_key);
 
 struct stamped_range_t {
     explicit stamped_range_t(uint64_t _next_expected_stamp)
@@ -68,6 +73,8 @@ void debug_print(printf_buffer_t *buf, const stamped_range_t &rng) {
 }
 
 struct change_val_t {
+    // For deserialization.
+    change_val_t() { }
     change_val_t(std::pair<uuid_u, uint64_t> _source_stamp,
                  store_key_t _pkey,
                  boost::optional<indexed_datum_t> _old_val,
@@ -93,6 +100,9 @@ struct change_val_t {
     // well in optionals.
     // MOVABLE_BUT_NOT_COPYABLE(change_val_t);
 };
+// The debug-only `sindex` is lost when a change is spilled to disk, which is fine
+// because it's only there to be printed.
+RDB_MAKE_SERIALIZABLE_4(change_val_t, source_stamp, pkey, old_val, new_val);
 
 namespace debug {
 std::string print(const uuid_u &u) {
@@ -178,6 +188,11 @@ public:
     virtual change_val_t pop() = 0;
     virtual const change_val_t &peek() = 0;
     virtual void purge_below(std::map<uuid_u, uint64_t> stamps) = 0;
+    // The number of changes that can be popped without blocking.  This is less
+    // than `size()` while some of the changes are on disk.
+    virtual size_t available() const { return size(); }
+    // Moves changes from disk back into memory so that they can be popped.  Blocks.
+    virtual void load() { }
 };
 
 class nonsquashing_queue_t final : public maybe_squashing_queue_t {
@@ -282,6 +297,40 @@ private:
     std::list<store_key_t> queue_order;
 };
 
+size_t change_val_memory_size(const change_val_t &cv) {
+    size_t size = sizeof(change_val_t) + cv.pkey.size();
+    if (cv.old_val) {
+        size += serialized_size<cluster_version_t::CLUSTER>(cv.old_val->val);
+    }
+    if (cv.new_val) {
+        size += serialized_size<cluster_version_t::CLUSTER>(cv.new_val->val);
+    }
+    return size;
+}
+
+// A nonsquashing queue that spills the changes past the subscription's
+// `changefeed_queue_memory` limit to its feed's spill file.
+class spilling_change_queue_t final : public maybe_squashing_queue_t {
+public:
+    spilling_change_queue_t(size_t memory_budget, counted_t<spill_file_t> file)
+        : queue(memory_budget, &change_val_memory_size, std::move(file)) { }
+
+    void add(change_val_t change_val) final { queue.push(std::move(change_val)); }
+    size_t size() const final { return queue.size(); }
+    size_t available() const final { return queue.available(); }
+    void clear() final { queue.clear(); }
+    const change_val_t &peek() final { return queue.peek(); }
+    change_val_t pop() final { return queue.pop(); }
+    void purge_below(std::map<uuid_u, uint64_t>) final {
+        // Subscriptions only start spilling once they've purged their queue.
+        r_sanity_fail();
+    }
+    void load() final { queue.load(); }
+
+private:
+    spilling_queue_t<change_val_t> queue;
+};
+
 boost::optional<datum_t> apply_ops(
     const datum_t &val,
     const std::vector<scoped_ptr_t<op_t> > &ops,
@@ -314,10 +363,364 @@ boost::optional<datum_t> apply_ops(
     }
 }
 
+// The part of a `range_sub_t` that a `server_t` evaluates before sending it a
+// change.  It accepts a superset of the changes the subscription itself accepts
+// (e.g. it doesn't know about `intersect_geometry`), so the subscription still
+// checks everything it's sent.
+class server_t::range_filter_t {
+public:
+    range_filter_t(rdb_context_t *ctx,
+                   keyspec_t::range_t _spec,
+                   global_optargs_t optargs,
+                   auth::user_context_t user_context)
+        : spec(std::move(_spec)) {
+        // This is to support the unit tests, which don't have a context.
+        env = ctx == nullptr
+            ? make_scoped<env_t>(&interruptor,
+                                 return_empty_normal_batches_t::NO,
+                                 reql_version_t::LATEST)
+            : make_scoped<env_t>(ctx,
+                                 return_empty_normal_batches_t::NO,
+                                 &interruptor,
+                                 std::move(optargs),
+                                 std::move(user_context),
+                                 nullptr/*don't profile*/);
+        for (const auto &transform : spec.transforms) {
+            ops.push_back(make_op(transform));
+        }
+        if (!spec.sindex) {
+            store_keys = spec.datumspec.primary_key_map();
+            if (!store_keys) {
+                store_key_range = spec.datumspec.covering_range().to_primary_keyrange();
+            }
+        }
+    }
+
+    bool has_ops() const { return ops.size() != 0; }
+
+    // Returns whether the subscription might produce anything for `change`.  If we
+    // have transforms and it does, the transformed values are stored in `*old_out`
+    // and `*new_out` (as empty datums if the transforms dropped the row).
+    bool matches(const msg_t::change_t &change, datum_t *old_out, datum_t *new_out) {
+        if (!matches_keys(change)) {
+            return false;
+        }
+        if (!has_ops()) {
+            return true;
+        }
+        if (change.old_val.has()) {
+            if (boost::optional<datum_t> d =
+                    apply_ops(change.old_val, ops, env.get(), datum_t())) {
+                *old_out = *d;
+            }
+        }
+        if (change.new_val.has()) {
+            if (boost::optional<datum_t> d =
+                    apply_ops(change.new_val, ops, env.get(), datum_t())) {
+                *new_out = *d;
+            }
+        }
+        if (spec.sindex) {
+            return old_out->has() || new_out->has();
+        } else {
+            // The subscription drops changes whose transformed values are equal,
+            // treating dropped rows as `null`.
+            datum_t null = datum_t::null();
+            return (old_out->has() ? *old_out : null) != (new_out->has() ? *new_out : null);
+        }
+    }
+
+    bool is_sindex() const { return static_cast<bool>(spec.sindex); }
+
+private:
+    bool matches_keys(const msg_t::change_t &change) const {
+        if (spec.sindex) {
+            for (const index_vals_t *vals : {&change.old_indexes, &change.new_indexes}) {
+                auto it = vals->find(*spec.sindex);
+                if (it != vals->end()) {
+                    for (const auto &idx : it->second) {
+                        if (spec.datumspec.copies(idx.first) != 0) {
+                            return true;
+                        }
+                    }
+                }
+            }
+            return false;
+        } else if (store_keys) {
+            auto it = store_keys->find(change.pkey);
+            return it != store_keys->end() && it->second != 0;
+        } else {
+            guarantee(store_key_range);
+            return store_key_range->contains_key(change.pkey);
+        }
+    }
+
+    keyspec_t::range_t spec;
+    std::vector<scoped_ptr_t<op_t> > ops;
+    boost::optional<std::map<store_key_t, uint64_t> > store_keys;
+    boost::optional<key_range_t> store_key_range;
+    // We ban non-deterministic terms in `ops`, and no deterministic terms block, so
+    // nothing ever interrupts the evaluation.
+    cond_t interruptor;
+    scoped_ptr_t<env_t> env;
+
+    DISABLE_COPYING(range_filter_t);
+};
+
+class add_aggregate_result_visitor_t : public boost::static_visitor<void> {
+public:
+    add_aggregate_result_visitor_t(double _sign, std::map<datum_t, double> *_out)
+        : sign(_sign), out(_out) { }
+    void operator()(const grouped_t<uint64_t> &counts) const {
+        add(*counts.get_underlying_map());
+    }
+    void operator()(const grouped_t<double> &sums) const {
+        add(*sums.get_underlying_map());
+    }
+    template<class T>
+    NORETURN void operator()(const T &) const {
+        unreachable();
+    }
+private:
+    template<class T>
+    void add(const std::map<datum_t, T, optional_datum_less_t> &groups) const {
+        for (const auto &pair : groups) {
+            datum_t group = pair.first.has() ? pair.first : datum_t::null();
+            (*out)[group] += sign * static_cast<double>(pair.second);
+        }
+    }
+    double sign;
+    std::map<datum_t, double> *out;
+};
+
+void add_aggregate_result(const result_t &res,
+                          double sign,
+                          std::map<datum_t, double> *values_out) {
+    boost::apply_visitor(add_aggregate_result_visitor_t(sign, values_out), res);
+}
+
+aggregate_values_t::aggregate_values_t(bool _grouped)
+    : grouped(_grouped), started(false) {
+    if (!grouped) {
+        current[datum_t::null()] = 0;
+    }
+}
+
+void aggregate_values_t::add(const std::map<datum_t, double> &deltas) {
+    for (const auto &pair : deltas) {
+        auto it = current.insert(std::make_pair(pair.first, 0.0)).first;
+        it->second += pair.second;
+        // A group with no rows left disappears.  (Grouped `sum`s are banned
+        // because a group can sum to 0 and still have rows.)
+        if (grouped && it->second == 0) {
+            current.erase(it);
+        }
+        if (started) {
+            dirty.insert(pair.first);
+        }
+    }
+}
+
+const std::map<datum_t, double> &aggregate_values_t::start() {
+    guarantee(!started);
+    started = true;
+    reported = current;
+    dirty.clear();
+    return current;
+}
+
+std::vector<aggregate_values_t::change_t> aggregate_values_t::take_changes() {
+    std::vector<change_t> changes;
+    for (const auto &group : dirty) {
+        auto old_it = reported.find(group);
+        auto new_it = current.find(group);
+        datum_t old_val = old_it == reported.end()
+            ? datum_t::null()
+            : datum_t(old_it->second);
+        datum_t new_val = new_it == current.end()
+            ? datum_t::null()
+            : datum_t(new_it->second);
+        if (old_val == new_val) {
+            continue;
+        }
+        if (new_it == current.end()) {
+            reported.erase(group);
+        } else {
+            reported[group] = new_it->second;
+        }
+        changes.push_back(change_t{group, std::move(old_val), std::move(new_val)});
+    }
+    dirty.clear();
+    return changes;
+}
+
+class aggregate_terminal_visitor_t
+    : public boost::static_visitor<terminal_variant_t> {
+public:
+    template<class T>
+    terminal_variant_t operator()(const T &terminal) const {
+        return terminal_variant_t(terminal);
+    }
+};
+
+terminal_variant_t make_aggregate_terminal(const keyspec_t::aggregate_t &spec) {
+    return boost::apply_visitor(aggregate_terminal_visitor_t(), spec.terminal);
+}
+
+// Keeps an aggregate changefeed up to date with the writes to one shard.  Rather
+// than keeping the aggregated values around, it evaluates the aggregation on the
+// old and new values of each changed row and sends the client the difference.
+class server_t::aggregate_manager_t {
+public:
+    aggregate_manager_t(rdb_context_t *ctx,
+                        uuid_u _sub,
+                        region_t _region,
+                        keyspec_t::aggregate_t _spec,
+                        global_optargs_t optargs,
+                        auth::user_context_t user_context)
+        : sub(std::move(_sub)),
+          region(std::move(_region)),
+          spec(std::move(_spec)),
+          stopped(false) {
+        // This is to support the unit tests, which don't have a context.
+        env = ctx == nullptr
+            ? make_scoped<env_t>(&interruptor,
+                                 return_empty_normal_batches_t::NO,
+                                 reql_version_t::LATEST)
+            : make_scoped<env_t>(ctx,
+                                 return_empty_normal_batches_t::NO,
+                                 &interruptor,
+                                 std::move(optargs),
+                                 std::move(user_context),
+                                 nullptr/*don't profile*/);
+        for (const auto &transform : spec.range.transforms) {
+            ops.push_back(make_op(transform));
+        }
+        if (!spec.range.sindex) {
+            store_keys = spec.range.datumspec.primary_key_map();
+        }
+    }
+
+    // Returns the message to send the client for `change`, if there is one.  If
+    // evaluating the aggregation fails the subscription is stopped, since a read
+    // of it would fail as well.
+    boost::optional<msg_t> note_change(const msg_t::change_t &change) {
+        if (stopped || !region_contains_key(region, change.pkey)) {
+            return boost::none;
+        }
+        try {
+            std::map<datum_t, double> deltas;
+            add_aggregate(change.old_val, change.old_indexes, change.pkey, -1, &deltas);
+            add_aggregate(change.new_val, change.new_indexes, change.pkey, 1, &deltas);
+            for (auto it = deltas.begin(); it != deltas.end();) {
+                if (it->second == 0) {
+                    deltas.erase(it++);
+                } else {
+                    ++it;
+                }
+            }
+            if (deltas.empty()) {
+                return boost::none;
+            }
+            return msg_t(msg_t::aggregate_change_t{sub, std::move(deltas)});
+        } catch (const exc_t &e) {
+            stopped = true;
+            return msg_t(msg_t::aggregate_stop_t{sub, e});
+        } catch (const datum_exc_t &e) {
+            stopped = true;
+            return msg_t(msg_t::aggregate_stop_t{
+                    sub, exc_t(e, backtrace_id_t::empty())});
+        }
+    }
+
+    const uuid_u sub;
+
+private:
+    // Adds `sign` times the aggregation of the copies of `val` in the range.
+    void add_aggregate(const datum_t &val,
+                       const index_vals_t &indexes,
+                       const store_key_t &pkey,
+                       double sign,
+                       std::map<datum_t, double> *deltas_out) {
+        if (!val.has()) {
+            return;
+        }
+        scoped_ptr_t<accumulator_t> acc = make_terminal(make_aggregate_terminal(spec));
+        if (spec.range.sindex) {
+            auto it = indexes.find(*spec.range.sindex);
+            if (it == indexes.end()) {
+                return;
+            }
+            for (const auto &idx : it->second) {
+                for (uint64_t i = spec.range.datumspec.copies(idx.first); i > 0; --i) {
+                    accumulate(acc.get(), val, pkey, idx.first);
+                }
+            }
+        } else if (store_keys) {
+            auto it = store_keys->find(pkey);
+            for (uint64_t i = it == store_keys->end() ? 0 : it->second; i > 0; --i) {
+                accumulate(acc.get(), val, pkey, datum_t());
+            }
+        } else {
+            // `region` is already restricted to the range.
+            accumulate(acc.get(), val, pkey, datum_t());
+        }
+        result_t res;
+        acc->finish(continue_bool_t::CONTINUE, &res);
+        add_aggregate_result(res, sign, deltas_out);
+    }
+
+    void accumulate(accumulator_t *acc,
+                    const datum_t &val,
+                    const store_key_t &pkey,
+                    const datum_t &sindex_val) {
+        groups_t groups;
+        groups[datum_t()] = std::vector<datum_t>{val};
+        for (const auto &op : ops) {
+            (*op)(env.get(), &groups, [&]() { return sindex_val; });
+        }
+        (*acc)(env.get(), &groups, pkey, [&]() { return sindex_val; });
+    }
+
+    region_t region;
+    keyspec_t::aggregate_t spec;
+    std::vector<scoped_ptr_t<op_t> > ops;
+    boost::optional<std::map<store_key_t, uint64_t> > store_keys;
+    bool stopped;
+    // We ban non-deterministic terms in `ops`, and no deterministic terms block, so
+    // nothing ever interrupts the evaluation.
+    cond_t interruptor;
+    scoped_ptr_t<env_t> env;
+
+    DISABLE_COPYING(aggregate_manager_t);
+};
+
 server_t::client_info_t::client_info_t()
-    : limit_clients(&opt_lt<std::string>),
+    : filtered(false),
+      limit_clients(&opt_lt<std::string>),
       limit_clients_lock(new rwlock_t()) { }
 
+void server_t::client_info_t::remove_filter(const uuid_u &sub) {
+    auto it = point_filters.find(sub);
+    if (it != point_filters.end()) {
+        auto key_it = point_filter_keys.find(it->second);
+        guarantee(key_it != point_filter_keys.end());
+        if (--key_it->second == 0) {
+            point_filter_keys.erase(key_it);
+        }
+        point_filters.erase(it);
+    }
+    auto sub_it = range_filter_subs.find(sub);
+    if (sub_it != range_filter_subs.end()) {
+        auto filter_it = range_filters.find(sub_it->second);
+        guarantee(filter_it != range_filters.end());
+        if (--filter_it->second.second == 0) {
+            range_filters.erase(filter_it);
+        }
+        range_filter_subs.erase(sub_it);
+    }
+}
+
 server_t::server_t(mailbox_manager_t *_manager, store_t *_parent)
     : uuid(generate_uuid()),
       manager(_manager),
@@ -325,7 +728,9 @@ server_t::server_t(mailbox_manager_t *_manager, store_t *_parent)
       stop_mailbox(manager,
                    std::bind(&server_t::stop_mailbox_cb, this, ph::_1, ph::_2)),
       limit_stop_mailbox(manager, std::bind(&server_t::limit_stop_mailbox_cb,
-                                            this, ph::_1, ph::_2, ph::_3, ph::_4)) { }
+                                            this, ph::_1, ph::_2, ph::_3, ph::_4)),
+      filter_stop_mailbox(manager, std::bind(&server_t::filter_stop_mailbox_cb,
+                                             this, ph::_1, ph::_2, ph::_3)) { }
 
 server_t::~server_t() { }
 
@@ -348,6 +753,9 @@ void server_t::limit_stop_mailbox_cb(signal_t *,
                                      uuid_u limit_uuid) {
     std::vector<scoped_ptr_t<limit_manager_t> > destroyable_lms;
     auto_drainer_t::lock_t lock(&drainer);
+    if (remove_aggregate_client(addr, limit_uuid)) {
+        return;
+    }
     rwlock_in_line_t spot(&clients_lock, access_t::read);
     spot.read_signal()->wait_lazily_unordered();
     auto it = clients.find(addr);
@@ -391,6 +799,22 @@ void server_t::limit_stop_mailbox_cb(signal_t *,
     }
 }
 
+void server_t::filter_stop_mailbox_cb(signal_t *,
+                                      client_t::addr_t addr,
+                                      std::vector<uuid_u> subs) {
+    auto_drainer_t::lock_t lock(&drainer);
+    rwlock_in_line_t spot(&clients_lock, access_t::write);
+    spot.write_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    // The client might have already been removed, like in `stop_mailbox_cb`.  If we
+    // have multiple shards per btree, removing the filters again is a no-op.
+    if (it != clients.end()) {
+        for (const uuid_u &sub : subs) {
+            it->second.remove_filter(sub);
+        }
+    }
+}
+
 void server_t::add_client(
         const client_t::addr_t &addr,
         region_t region,
@@ -425,6 +849,45 @@ void server_t::add_client(
     }
 }
 
+void server_t::update_filters(
+        const client_t::addr_t &addr,
+        rdb_context_t *ctx,
+        const filter_update_t &update,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    scoped_ptr_t<range_filter_t> range_filter;
+    boost::optional<store_key_t> point_key;
+    if (auto *range = boost::get<keyspec_t::range_t>(&update.spec)) {
+        range_filter = make_scoped<range_filter_t>(
+            ctx, *range, update.optargs, update.user_context);
+    } else if (auto *point = boost::get<keyspec_t::point_t>(&update.spec)) {
+        point_key = store_key_t(point->key.print_primary());
+    }
+
+    rwlock_in_line_t spot(&clients_lock, access_t::write);
+    spot.write_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    // The client might have been removed already (e.g. if the peer disconnected).
+    if (it == clients.end()) {
+        return;
+    }
+    client_info_t *info = &it->second;
+    info->filtered = true;
+    // If we have multiple shards per btree we get the same update more than once.
+    info->remove_filter(update.sub);
+    if (range_filter.has()) {
+        auto *entry = &info->range_filters[update.filter];
+        if (!entry->first.has()) {
+            entry->first = std::move(range_filter);
+        }
+        entry->second += 1;
+        info->range_filter_subs[update.sub] = update.filter;
+    } else if (point_key) {
+        info->point_filters[update.sub] = *point_key;
+        info->point_filter_keys[*point_key] += 1;
+    }
+}
+
 void server_t::add_limit_client(
         const client_t::addr_t &addr,
         const region_t &region,
@@ -465,6 +928,71 @@ void server_t::add_limit_client(
     }
 }
 
+void server_t::add_aggregate_client(
+        const client_t::addr_t &addr,
+        const region_t &region,
+        rdb_context_t *ctx,
+        global_optargs_t optargs,
+        auth::user_context_t user_context,
+        const uuid_u &client_uuid,
+        const keyspec_t::aggregate_t &spec,
+        rwlock_in_line_t *stamp_spot,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    stamp_spot->guarantee_is_for_lock(&parent->cfeed_stamp_lock);
+    auto am = make_scoped<aggregate_manager_t>(
+        ctx, client_uuid, region, spec, std::move(optargs), std::move(user_context));
+    // Once we have the stamp lock, the writes that got in line before us have been
+    // stamped and the ones after us haven't, so the manager sees exactly the writes
+    // the initial read doesn't.
+    stamp_spot->read_signal()->wait_lazily_unordered();
+    rwlock_in_line_t spot(&clients_lock, access_t::write);
+    spot.write_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+
+    // It's entirely possible the peer disconnected by the time we got here.
+    if (it != clients.end()) {
+        it->second.aggregates.push_back(std::move(am));
+    }
+}
+
+void server_t::send_aggregate_start(
+        const client_t::addr_t &addr,
+        const uuid_u &client_uuid,
+        std::map<datum_t, double> &&start_data,
+        const auto_drainer_t::lock_t &keepalive) {
+    keepalive.assert_is_holding(&drainer);
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    if (it != clients.end()) {
+        send_one_with_lock(
+            &*it,
+            msg_t(msg_t::aggregate_start_t{client_uuid, std::move(start_data)}),
+            keepalive);
+    }
+}
+
+bool server_t::remove_aggregate_client(const client_t::addr_t &addr,
+                                       const uuid_u &sub) {
+    scoped_ptr_t<aggregate_manager_t> destroyable_am;
+    rwlock_in_line_t spot(&clients_lock, access_t::write);
+    spot.write_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    if (it != clients.end()) {
+        auto *aggregates = &it->second.aggregates;
+        for (auto am_it = aggregates->begin(); am_it != aggregates->end(); ++am_it) {
+            if ((*am_it)->sub == sub) {
+                destroyable_am = std::move(*am_it);
+                aggregates->erase(am_it);
+                break;
+            }
+        }
+    }
+    // `destroyable_am` is destroyed after we release `spot`.
+    return destroyable_am.has();
+}
+
 void server_t::add_client_cb(
         signal_t *stopped,
         client_t::addr_t addr,
@@ -490,18 +1018,7 @@ void server_t::add_client_cb(
     guarantee(erased == 1);
 }
 
-struct stamped_msg_t {
-    stamped_msg_t() { }
-    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
-        : server_uuid(std::move(_server_uuid)),
-          stamp(_stamp),
-          submsg(std::move(_submsg)) { }
-    uuid_u server_uuid;
-    uint64_t stamp;
-    msg_t submsg;
-};
-
-RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(stamped_msg_t, server_uuid, stamp, submsg);
 
 // This function takes a `lock_t` to make sure you have one.  (We can't just
 // always acquire a drainer lock before sending because we sometimes send a
@@ -522,6 +1039,51 @@ void server_t::send_one_with_lock(
     send(manager, client->first, stamped_msg_t(uuid, stamp, std::move(msg)));
 }
 
+bool server_t::filter_msg(const client_info_t &client,
+                          const msg_t &msg,
+                          boost::optional<msg_t> *projected_out) {
+    const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op);
+    if (!client.filtered || change == nullptr) {
+        return true;
+    }
+    // Point subscriptions want the whole rows, so there's nothing to project.
+    if (client.point_filter_keys.count(change->pkey) != 0) {
+        return true;
+    }
+    const uuid_u *match = nullptr;
+    range_filter_t *match_filter = nullptr;
+    datum_t old_val, new_val;
+    for (const auto &pair : client.range_filters) {
+        datum_t filter_old_val, filter_new_val;
+        if (pair.second.first->matches(*change, &filter_old_val, &filter_new_val)) {
+            if (match != nullptr) {
+                // The filters share the message, so it has to be sent whole.
+                return true;
+            }
+            match = &pair.first;
+            match_filter = pair.second.first.get();
+            old_val = std::move(filter_old_val);
+            new_val = std::move(filter_new_val);
+        }
+    }
+    if (match == nullptr) {
+        return false;
+    }
+    if (match_filter->has_ops()) {
+        msg_t::change_t projected;
+        if (match_filter->is_sindex()) {
+            projected.old_indexes = change->old_indexes;
+            projected.new_indexes = change->new_indexes;
+        }
+        projected.pkey = change->pkey;
+        projected.old_val = std::move(old_val);
+        projected.new_val = std::move(new_val);
+        projected.transformed_for = *match;
+        *projected_out = msg_t(std::move(projected));
+    }
+    return true;
+}
+
 void server_t::send_all(
         const msg_t &msg,
         const store_key_t &key,
@@ -532,21 +1094,44 @@ void server_t::send_all(
     stamp_spot->write_signal()->wait_lazily_unordered();
 
     rwlock_acq_t acq(&clients_lock, access_t::read);
-    std::map<client_t::addr_t, uint64_t> stamps;
+    // Evaluating the filters can block, so we pick the recipients before stamping.
+    // Clients that don't get the message don't use up a stamp.
+    std::vector<std::pair<std::pair<const client_t::addr_t, client_info_t> *,
+                          boost::optional<msg_t> > > recipients;
     for (auto &&pair : clients) {
-        // We don't need a write lock as long as we make sure the coroutine
-        // doesn't block between reading and updating the stamp.
-        ASSERT_NO_CORO_WAITING;
         if (std::any_of(pair.second.regions.begin(),
                         pair.second.regions.end(),
                         std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
-            stamps[pair.first] = pair.second.stamp++;
+            boost::optional<msg_t> projected;
+            if (filter_msg(pair.second, msg, &projected)) {
+                recipients.push_back(std::make_pair(&pair, std::move(projected)));
+            }
+            if (const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op)) {
+                for (const auto &am : pair.second.aggregates) {
+                    if (boost::optional<msg_t> agg_msg = am->note_change(*change)) {
+                        recipients.push_back(std::make_pair(&pair, std::move(agg_msg)));
+                    }
+                }
+            }
         }
     }
+    std::vector<std::pair<client_t::addr_t, uint64_t> > stamps;
+    stamps.reserve(recipients.size());
+    for (const auto &recipient : recipients) {
+        // We don't need a write lock as long as we make sure the coroutine
+        // doesn't block between reading and updating the stamp.
+        ASSERT_NO_CORO_WAITING;
+        stamps.push_back(
+            std::make_pair(recipient.first->first, recipient.first->second.stamp++));
+    }
     acq.reset();
     stamp_spot->reset(); // Done stamping, no need to hold onto it while we send.
-    for (const auto &pair : stamps) {
-        send(manager, pair.first, stamped_msg_t(uuid, pair.second, msg));
+    for (size_t i = 0; i < stamps.size(); ++i) {
+        send(manager,
+             stamps[i].first,
+             stamped_msg_t(uuid,
+                           stamps[i].second,
+                           recipients[i].second ? *recipients[i].second : msg));
     }
 }
 
@@ -558,6 +1143,10 @@ server_t::limit_addr_t server_t::get_limit_stop_addr() {
     return limit_stop_mailbox.get_address();
 }
 
+server_t::filter_stop_addr_t server_t::get_filter_stop_addr() {
+    return filter_stop_mailbox.get_address();
+}
+
 boost::optional<uint64_t> server_t::get_stamp(
         const client_t::addr_t &addr,
         const auto_drainer_t::lock_t &keepalive) {
@@ -860,6 +1449,8 @@ limit_manager_t::limit_manager_t(
       spec(std::move(_spec)),
       gt(std::move(_gt)),
       item_queue(gt),
+      margin(gt),
+      margin_complete(false),
       aborted(false) {
     guarantee(clients_lock->read_signal()->is_pulsed());
 
@@ -877,12 +1468,46 @@ limit_manager_t::limit_manager_t(
         ops.push_back(make_op(transform));
     }
 
+    // The initial read includes the margin.
+    margin_complete = item_vec.size() < spec.limit + limit_margin_size(spec.limit);
     guarantee(item_queue.size() == 0);
     for (const auto &pair : item_vec) {
         bool inserted = item_queue.insert(pair).second;
         guarantee(inserted);
     }
-    send(msg_t(msg_t::limit_start_t(uuid, std::move(item_vec))));
+    std::vector<std::string> truncated = truncate_to_margin();
+    std::set<std::string> in_margin(truncated.begin(), truncated.end());
+    std::vector<item_t> start_data;
+    start_data.reserve(item_queue.size());
+    for (auto &&pair : item_vec) {
+        if (in_margin.count(pair.first) == 0) {
+            start_data.push_back(std::move(pair));
+        }
+    }
+    send(msg_t(msg_t::limit_start_t(uuid, std::move(start_data))));
+}
+
+size_t limit_margin_size(size_t limit) {
+    // Big enough that a burst of evictions from a small limit doesn't drain it, but
+    // capped so that big limits don't double their memory use.
+    return std::min<size_t>(std::max<size_t>(limit, 16), 1024);
+}
+
+std::vector<std::string> limit_manager_t::truncate_to_margin() {
+    std::vector<std::string> ret;
+    while (item_queue.size() > spec.limit) {
+        auto it = item_queue.begin();
+        ret.push_back((*it)->first);
+        bool inserted = margin.insert(**it).second;
+        guarantee(inserted);
+        item_queue.erase(it);
+    }
+    size_t margin_size = limit_margin_size(spec.limit);
+    if (margin.size() > margin_size) {
+        margin.truncate_top(margin_size);
+        margin_complete = false;
+    }
+    return ret;
 }
 
 void limit_manager_t::add(
@@ -930,14 +1555,18 @@ public:
                   const keyspec_t::limit_t *_spec,
                   sorting_t _sorting,
                   boost::optional<item_t> _start,
-                  const item_queue_t *_item_queue)
+                  size_t _n,
+                  const item_queue_t *_item_queue,
+                  bool *_exhausted_out)
         : env(_env),
           ops(_ops),
           pk_range(_pk_range),
           spec(_spec),
           sorting(_sorting),
           start(std::move(_start)),
-          item_queue(_item_queue) { }
+          n(_n),
+          item_queue(_item_queue),
+          exhausted_out(_exhausted_out) { }
 
     std::vector<item_t> operator()(const primary_ref_t &ref) {
         rget_read_response_t resp;
@@ -960,7 +1589,6 @@ public:
         case sorting_t::UNORDERED: // fallthru
         default: unreachable();
         }
-        size_t n = spec->limit - item_queue->size();
         rdb_rget_slice(
             ref.btree,
             region_t(),
@@ -1003,6 +1631,7 @@ public:
         } else {
             guarantee(item_vec.size() == 0);
         }
+        *exhausted_out = item_vec.size() < n;
         return item_vec;
     }
 
@@ -1015,7 +1644,7 @@ public:
                 [](const datum_range_t &) { return true; },
                 [](const std::map<datum_t, uint64_t> &) { return false; }));
         datum_range_t srange = spec->range.datumspec.covering_range();
-        size_t n = spec->limit - item_queue->size();
+        size_t read_n = n;
         if (start) {
             datum_t dstart = start->second.first;
             switch (sorting) {
@@ -1034,7 +1663,7 @@ public:
                 if (pair->second.first != dstart) {
                     break;
                 }
-                n += 1;
+                read_n += 1;
             }
         }
         reql_version_t reql_version =
@@ -1050,7 +1679,7 @@ public:
             std::vector<transform_variant_t>(),
             boost::optional<terminal_variant_t>(limit_read_t{
                     is_primary_t::NO,
-                    n,
+                    read_n,
                     // This code uses the same generic code path as a normal
                     // read, and a normal read needs to keep track of the
                     // region and last seen key for unsharding, but we
@@ -1078,10 +1707,11 @@ public:
         if (stream.substreams.size() == 1) {
             raw_stream_t *raw_stream = &stream.substreams.begin()->second.stream;
             item_vec = mangle_sort_truncate_stream(
-                std::move(*raw_stream), is_primary_t::NO, sorting, n);
+                std::move(*raw_stream), is_primary_t::NO, sorting, read_n);
         } else {
             guarantee(item_vec.size() == 0);
         }
+        *exhausted_out = item_vec.size() < read_n;
         return item_vec;
     }
 
@@ -1092,15 +1722,22 @@ private:
     const keyspec_t::limit_t *spec;
     sorting_t sorting;
     boost::optional<item_t> start;
+    size_t n;
     const item_queue_t *item_queue;
+    bool *exhausted_out;
 };
 
 std::vector<item_t> limit_manager_t::read_more(
     const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-    const boost::optional<item_t> &start) {
+    const boost::optional<item_t> &start,
+    size_t n,
+    bool *exhausted_out) {
     guarantee(item_queue.size() < spec.limit);
+    // The visitor only looks at `item_queue` to find the rows it will read again.
+    guarantee(margin.size() == 0);
     ref_visitor_t visitor(
-        env.get(), &ops, &region.inner, &spec, spec.range.sorting, start, &item_queue);
+        env.get(), &ops, &region.inner, &spec, spec.range.sorting, start, n,
+        &item_queue, exhausted_out);
     return boost::apply_visitor(visitor, ref);
 }
 
@@ -1112,15 +1749,21 @@ void limit_manager_t::commit(
         return;
     }
 
-    // Before we delete anything, we get the boundary between the active set and
-    // the data that didn't make it into the set.  Anything <= that according to
-    // our ordering could never be kicked out of the set because of a read from
-    // disk.
+    // Before we delete anything, we get the boundaries between the active set, the
+    // margin, and the data that didn't make it into either.  Anything <= the active
+    // boundary according to our ordering could never be kicked out of the set
+    // because of a read from disk, and we know about everything <= the margin
+    // boundary.
     boost::optional<item_t> active_boundary;
     auto item_queue_it = item_queue.begin();
     if (item_queue_it != item_queue.end()) {
         active_boundary = **item_queue_it;
     }
+    boost::optional<item_t> margin_boundary = active_boundary;
+    auto margin_it = margin.begin();
+    if (margin_it != margin.end()) {
+        margin_boundary = **margin_it;
+    }
 
     item_queue_t real_added(gt);
     std::set<std::string> real_deleted;
@@ -1129,10 +1772,12 @@ void limit_manager_t::commit(
         if (data_deleted) {
             bool inserted = real_deleted.insert(id).second;
             guarantee(inserted);
+        } else {
+            // The client never saw rows in the margin, so they go away silently.
+            UNUSED bool margin_deleted = margin.del_id(id);
         }
     }
     deleted.clear();
-    bool added_on_disk = false;
     for (const auto &pair : added) {
         // We only add to the set if we know we beat anything that might be read
         // off of disk below.  This is fine because if the resulting set is
@@ -1145,29 +1790,50 @@ void limit_manager_t::commit(
             guarantee(inserted);
             inserted = real_added.insert(pair).second;
             guarantee(inserted);
-        } else {
-            added_on_disk = true;
+        } else if (margin_complete || !gt(item_t(pair), *margin_boundary)) {
+            bool inserted = margin.insert(pair).second;
+            guarantee(inserted);
         }
+        // Anything else stays on disk until we read past the margin.
     }
     added.clear();
 
-    std::vector<std::string> truncated = item_queue.truncate_top(spec.limit);
-    for (auto &&id : truncated) {
-        auto it = real_added.find_id(id);
-        if (it != real_added.end()) {
-            real_added.erase(it);
-        } else {
-            bool inserted = real_deleted.insert(std::move(id)).second;
+    auto note_truncated = [&](std::vector<std::string> &&truncated) {
+        for (auto &&id : truncated) {
+            auto it = real_added.find_id(id);
+            if (it != real_added.end()) {
+                real_added.erase(it);
+            } else {
+                bool inserted = real_deleted.insert(std::move(id)).second;
+                guarantee(inserted);
+            }
+        }
+    };
+    // Rows leaving the active set are replaced by the best rows of the margin, so
+    // we only go to disk once the margin runs out.
+    auto fill_from_margin = [&]() {
+        while (item_queue.size() < spec.limit && margin.size() != 0) {
+            auto it = std::prev(margin.end());
+            item_t pair = **it;
+            margin.erase(it);
+            bool inserted = item_queue.insert(pair).second;
+            guarantee(inserted);
+            inserted = real_added.insert(std::move(pair)).second;
             guarantee(inserted);
         }
-    }
+    };
+    note_truncated(truncate_to_margin());
+    fill_from_margin();
 
-    bool anything_on_disk = real_deleted.size() != 0 || added_on_disk;
-    if (item_queue.size() < spec.limit && anything_on_disk) {
+    if (item_queue.size() < spec.limit && !margin_complete) {
+        // We read the margin back in along with the rows we're missing, so that
+        // the next few evictions don't have to read again.
+        size_t n = spec.limit - item_queue.size() + limit_margin_size(spec.limit);
         std::vector<item_t> s;
+        bool exhausted = false;
         boost::optional<exc_t> exc;
         try {
-            s = read_more(sindex_ref, active_boundary);
+            s = read_more(sindex_ref, margin_boundary, n, &exhausted);
         } catch (const exc_t &e) {
             exc = e;
         }
@@ -1177,26 +1843,17 @@ void limit_manager_t::commit(
             abort(*exc);
             return;
         }
+        margin_complete = exhausted;
         for (auto &&pair : s) {
-            bool inserted = item_queue.insert(pair).second;
             // Reading duplicates from disk is fine.
-            if (inserted) {
-                bool added_insert = real_added.insert(pair).second;
-                guarantee(added_insert);
+            if (item_queue.find_id(pair.first) == item_queue.end()) {
+                UNUSED bool inserted = margin.insert(std::move(pair)).second;
             }
         }
+        fill_from_margin();
         // We need to truncate again because `read_more` may read too much in
         // the secondary index case.
-        std::vector<std::string> read_trunc = item_queue.truncate_top(spec.limit);
-        for (auto &&id : read_trunc) {
-            auto it = real_added.find_id(id);
-            if (it != real_added.end()) {
-                real_added.erase(it);
-            } else {
-                bool inserted = real_deleted.insert(std::move(id)).second;
-                guarantee(inserted);
-            }
-        }
+        note_truncated(truncate_to_margin());
     }
     std::set<std::string> remaining_deleted;
     for (auto &&id : real_deleted) {
@@ -1247,9 +1904,15 @@ RDB_IMPL_SERIALIZABLE_3(msg_t::limit_change_t, sub, old_key, new_val);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_change_t);
 RDB_IMPL_SERIALIZABLE_2(msg_t::limit_stop_t, sub, exc);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_stop_t);
-RDB_IMPL_SERIALIZABLE_5(
+RDB_IMPL_SERIALIZABLE_2(msg_t::aggregate_start_t, sub, start_data);
+INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::aggregate_start_t);
+RDB_IMPL_SERIALIZABLE_2(msg_t::aggregate_change_t, sub, deltas);
+INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::aggregate_change_t);
+RDB_IMPL_SERIALIZABLE_2(msg_t::aggregate_stop_t, sub, exc);
+INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::aggregate_stop_t);
+RDB_IMPL_SERIALIZABLE_6(
     msg_t::change_t,
-    old_indexes, new_indexes, pkey, old_val, new_val);
+    old_indexes, new_indexes, pkey, old_val, new_val, transformed_for);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::change_t);
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(msg_t::stop_t);
 
@@ -1530,6 +2193,7 @@ public:
     template<class... Args>
     explicit flat_sub_t(init_squashing_queue_t init_squashing_queue, Args &&... args)
         : subscription_t(std::forward<Args>(args)...),
+          uuid(generate_uuid()),
           last_stamp(std::make_pair(nil_uuid(), std::numeric_limits<uint64_t>::max())) {
         if (init_squashing_queue == init_squashing_queue_t::YES && squash) {
             queue = make_scoped<squashing_queue_t>();
@@ -1573,16 +2237,32 @@ public:
             maybe_signal_cond();
         }
     }
-    bool has_change_val() { return queue->size() != 0; }
+    bool has_change_val() { return queue->available() != 0; }
     change_val_t pop_change_val() { return queue->pop(); }
     const change_val_t &peek_change_val() { return queue->peek(); }
     bool active() { return !exc; }
+    const uuid_u &get_uuid() const { return uuid; }
 protected:
+    // Tells the servers of our feed which changes we're interested in (see
+    // `filter_update_t`).  This has to finish before we read our start stamps,
+    // since the servers may drop the changes we want until then.
+    void register_filter(env_t *env,
+                         namespace_interface_t *nif,
+                         const client_t::addr_t &addr,
+                         keyspec_t::spec_t spec,
+                         const uuid_u &filter);
+
+    // Called once we've started (which might purge `queue`).  Squashing queues
+    // hold at most one change per row, so we only spill nonsquashing ones.
+    void maybe_enable_spilling();
+
     // The queue of changes we've accumulated since the last time we were read from.
     scoped_ptr_t<maybe_squashing_queue_t> queue;
 private:
+    const uuid_u uuid;
     std::pair<uuid_u, uint64_t> last_stamp;
-    virtual void apply_queued_changes() { } // Changes are never queued.
+    // Changes are never queued, but some of them might be on disk.
+    void apply_queued_changes() final { queue->load(); }
     virtual bool update_stamp(const uuid_u &uuid, uint64_t new_stamp) = 0;
 };
 
@@ -1590,10 +2270,13 @@ class range_sub_t;
 class empty_sub_t;
 class point_sub_t;
 class limit_sub_t;
+class aggregate_sub_t;
 
 class feed_t : public home_thread_mixin_t, public slow_atomic_countable_t<feed_t> {
 public:
-    feed_t(namespace_id_t const &, table_meta_client_t *);
+    feed_t(namespace_id_t const &,
+           table_meta_client_t *,
+           counted_t<spill_file_t> spill_file);
     virtual ~feed_t();
 
     void add_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING;
@@ -1608,6 +2291,9 @@ public:
     void add_limit_sub(limit_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
     void del_limit_sub(limit_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
 
+    void add_aggregate_sub(aggregate_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
+    void del_aggregate_sub(aggregate_sub_t *sub, const uuid_u &uuid) THROWS_NOTHING;
+
     void each_range_sub(const auto_drainer_t::lock_t &lock,
                         const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
     void update_stamps(uuid_u server_uuid, uint64_t stamp);
@@ -1620,9 +2306,17 @@ public:
         const uuid_u &uuid,
         const auto_drainer_t::lock_t &lock,
         const std::function<void(limit_sub_t *)> &f) THROWS_NOTHING;
+    void on_aggregate_sub(
+        const uuid_u &uuid,
+        const auto_drainer_t::lock_t &lock,
+        const std::function<void(aggregate_sub_t *)> &f) THROWS_NOTHING;
 
     bool can_be_removed();
 
+    // Real feeds tell their servers to drop the filter of a point or range
+    // subscription once it stops (see `filter_update_t`).  Called on the home thread.
+    virtual void note_stopped_filter(const uuid_u &) { }
+
     virtual void abort_feed() = 0;
     void stop_subs(const auto_drainer_t::lock_t &lock);
     void mark_detached() { detached = true; }
@@ -1637,12 +2331,19 @@ public:
     table_meta_client_t *get_table_meta_client() const {
         return table_meta_client;
     }
+
+    // The file our subscriptions' queues spill to, shared by all of them, or an
+    // empty pointer if they don't spill.  Can be called on any thread.
+    counted_t<spill_file_t> get_spill_file() const {
+        return spill_file;
+    }
 protected:
     bool detached;
     int64_t num_subs;
 private:
     virtual void maybe_remove_feed() = 0;
     virtual void stop_limit_sub(limit_sub_t *sub) = 0;
+    virtual void stop_aggregate_sub(aggregate_sub_t *sub) = 0;
 
     void add_sub_with_lock(
         rwlock_t *rwlock, const std::function<void()> &f) THROWS_NOTHING;
@@ -1668,6 +2369,10 @@ private:
     void each_limit_sub_with_lock(
         rwlock_in_line_t *spot,
         const std::function<void(limit_sub_t *)> &f) THROWS_NOTHING;
+    void each_aggregate_sub_cb(const std::function<void(aggregate_sub_t *)> &f, int i);
+    void each_aggregate_sub_with_lock(
+        rwlock_in_line_t *spot,
+        const std::function<void(aggregate_sub_t *)> &f) THROWS_NOTHING;
 
     std::map<store_key_t, std::vector<std::set<point_sub_t *> > > point_subs;
     rwlock_t point_subs_lock;
@@ -1677,6 +2382,8 @@ private:
     rwlock_t range_subs_lock;
     std::map<uuid_u, std::vector<std::set<limit_sub_t *> > > limit_subs;
     rwlock_t limit_subs_lock;
+    std::map<uuid_u, std::vector<std::set<aggregate_sub_t *> > > aggregate_subs;
+    rwlock_t aggregate_subs_lock;
 
     // This stores the latest stamps we've received.  It's OK for this to
     // be a tiny bit behind what we've sent the subs.
@@ -1691,8 +2398,25 @@ private:
 
     namespace_id_t table_id;
     table_meta_client_t *table_meta_client;
+    const counted_t<spill_file_t> spill_file;
 };
 
+void flat_sub_t::maybe_enable_spilling() {
+    if (squash || feed == nullptr) {
+        return;
+    }
+    counted_t<spill_file_t> spill_file = feed->get_spill_file();
+    if (!spill_file.has()) {
+        return;
+    }
+    scoped_ptr_t<maybe_squashing_queue_t> old_queue = std::move(queue);
+    queue = make_scoped<spilling_change_queue_t>(
+        limits.changefeed_queue_memory(), std::move(spill_file));
+    while (old_queue->size() != 0) {
+        queue->add(old_queue->pop());
+    }
+}
+
 void feed_t::update_stamps(uuid_u server_uuid, uint64_t stamp) {
     pmap(get_num_threads(),
          [&](int thread) {
@@ -1719,18 +2443,22 @@ public:
                 namespace_interface_t *ns_if,
                 namespace_id_t const &table_id,
                 signal_t *interruptor,
-                table_meta_client_t *table_meta_client);
+                table_meta_client_t *table_meta_client,
+                counted_t<spill_file_t> spill_file);
     ~real_feed_t();
 
     client_t::addr_t get_addr() const;
+    void note_stopped_filter(const uuid_u &sub) final;
     void abort_feed() final { aborted.pulse_if_not_already_pulsed(); }
     virtual auto_drainer_t::lock_t get_drainer_lock() { return drainer.lock(); }
 private:
     virtual void maybe_remove_feed() { client->maybe_remove_feed(client_lock, table_id); }
     virtual void stop_limit_sub(limit_sub_t *sub);
+    virtual void stop_aggregate_sub(aggregate_sub_t *sub);
 
     void mailbox_cb(signal_t *interruptor, stamped_msg_t msg);
     void constructor_cb();
+    void send_stopped_filters(auto_drainer_t::lock_t lock);
 
     auto_drainer_t::lock_t client_lock;
     client_t *client;
@@ -1738,6 +2466,7 @@ private:
     mailbox_manager_t *manager;
     mailbox_t<void(stamped_msg_t)> mailbox;
     std::vector<server_t::addr_t> stop_addrs;
+    std::vector<server_t::filter_stop_addr_t> filter_stop_addrs;
     std::vector<scoped_ptr_t<disconnect_watcher_t> > disconnect_watchers;
 
     struct queue_t {
@@ -1759,6 +2488,10 @@ private:
     // Used to abort the feed when we get a `msg_t::stop_t`.
     cond_t aborted;
 
+    // The subscriptions that stopped since we last told the servers, which we do
+    // from a coroutine so that subscriptions which stop together share a message.
+    std::vector<uuid_u> stopped_filters;
+
     auto_drainer_t drainer;
 };
 
@@ -1769,8 +2502,9 @@ real_feed_t::real_feed_t(auto_drainer_t::lock_t _client_lock,
                          namespace_interface_t *ns_if,
                          namespace_id_t const &_table_id,
                          signal_t *interruptor,
-                         table_meta_client_t *_table_meta_client)
-    : feed_t(_table_id, _table_meta_client),
+                         table_meta_client_t *_table_meta_client,
+                         counted_t<spill_file_t> _spill_file)
+    : feed_t(_table_id, _table_meta_client, std::move(_spill_file)),
       client_lock(std::move(_client_lock)),
       client(_client),
       table_id(_table_id),
@@ -1793,6 +2527,8 @@ real_feed_t::real_feed_t(auto_drainer_t::lock_t _client_lock,
         for (auto it = resp->addrs.begin(); it != resp->addrs.end(); ++it) {
             stop_addrs.push_back(std::move(*it));
         }
+        filter_stop_addrs.assign(resp->filter_stop_addrs.begin(),
+                                 resp->filter_stop_addrs.end());
 
         std::set<peer_id_t> peers;
         for (auto it = stop_addrs.begin(); it != stop_addrs.end(); ++it) {
@@ -1843,6 +2579,25 @@ client_t::addr_t real_feed_t::get_addr() const {
     return mailbox.get_address();
 }
 
+void real_feed_t::note_stopped_filter(const uuid_u &sub) {
+    assert_thread();
+    if (stopped_filters.empty()) {
+        // Our caller holds a drainer lock, so we aren't draining yet.
+        coro_t::spawn_sometime(
+            std::bind(&real_feed_t::send_stopped_filters, this, drainer.lock()));
+    }
+    stopped_filters.push_back(sub);
+}
+
+void real_feed_t::send_stopped_filters(auto_drainer_t::lock_t) {
+    assert_thread();
+    std::vector<uuid_u> subs;
+    subs.swap(stopped_filters);
+    for (const auto &addr : filter_stop_addrs) {
+        send(manager, addr, mailbox.get_address(), subs);
+    }
+}
+
 void real_feed_t::constructor_cb() {
     auto lock = make_scoped<auto_drainer_t::lock_t>(&drainer);
     {
@@ -1874,6 +2629,29 @@ void real_feed_t::constructor_cb() {
     }
 }
 
+void flat_sub_t::register_filter(
+        env_t *env,
+        namespace_interface_t *nif,
+        const client_t::addr_t &addr,
+        keyspec_t::spec_t spec,
+        const uuid_u &filter) {
+    read_response_t read_resp;
+    nif->read(
+        env->get_user_context(),
+        read_t(changefeed_subscribe_t(
+                   addr,
+                   filter_update_t{uuid,
+                                   filter,
+                                   std::move(spec),
+                                   env->get_all_optargs(),
+                                   env->get_user_context()}),
+               profile_bool_t::DONT_PROFILE,
+               read_mode_t::SINGLE),
+        &read_resp,
+        order_token_t::ignore,
+        env->interruptor);
+}
+
 class empty_sub_t : public flat_sub_t {
 public:
     empty_sub_t(rdb_context_t *_rdb_context,
@@ -2048,6 +2826,8 @@ public:
             state = state_t::READY;
         }
 
+        register_filter(env, nif, addr, keyspec_t::point_t{pkey}, nil_uuid());
+
         read_response_t read_resp;
         nif->read(
             env->get_user_context(),
@@ -2085,6 +2865,7 @@ public:
                 }
             }
         }
+        maybe_enable_spilling();
         started = true;
 
         return make_counted<stream_t<subscription_t> >(std::move(self), bt);
@@ -2135,6 +2916,64 @@ private:
     auto_drainer_t drainer;
 };
 
+const uuid_u base_range_filter_id =
+    str_to_uuid("0c3a3d5e-6f0b-4b8e-9a44-51d4a7e2c6f1");
+
+// Writes the transforms of a range subscription so that functions that only differ in
+// their variable ids are written the same way.
+class canonical_transform_visitor_t : public boost::static_visitor<void> {
+public:
+    explicit canonical_transform_visitor_t(write_message_t *_wm) : wm(_wm) { }
+    void operator()(const map_wire_func_t &f) const {
+        serialize_canonical_func(wm, f);
+    }
+    void operator()(const filter_wire_func_t &f) const {
+        serialize_canonical_func(wm, f.filter_func);
+        serialize<cluster_version_t::CLUSTER>(
+            wm, static_cast<bool>(f.default_filter_val));
+        if (f.default_filter_val) {
+            serialize_canonical_func(wm, *f.default_filter_val);
+        }
+    }
+    void operator()(const concatmap_wire_func_t &f) const {
+        serialize_canonical_func(wm, f);
+        serialize<cluster_version_t::CLUSTER>(
+            wm, static_cast<int8_t>(f.result_hint));
+    }
+    template<class T>
+    void operator()(const T &t) const {
+        serialize<cluster_version_t::CLUSTER>(wm, t);
+    }
+private:
+    write_message_t *wm;
+};
+
+// Identical range subscriptions on a node share a filter on the servers (see
+// `filter_update_t`).  Functions are written with their variables renumbered, so
+// that subscriptions that only differ in variable ids share a filter too.
+uuid_u range_filter_id(const keyspec_t::range_t &spec, const env_t &env) {
+    write_message_t wm;
+    serialize<cluster_version_t::CLUSTER>(&wm, spec.transforms.size());
+    for (const transform_variant_t &transform : spec.transforms) {
+        serialize<cluster_version_t::CLUSTER>(
+            &wm, static_cast<int32_t>(transform.which()));
+        boost::apply_visitor(canonical_transform_visitor_t(&wm), transform);
+    }
+    serialize<cluster_version_t::CLUSTER>(&wm, spec.sindex);
+    serialize<cluster_version_t::CLUSTER>(&wm, static_cast<int8_t>(spec.sorting));
+    serialize<cluster_version_t::CLUSTER>(&wm, spec.datumspec);
+    serialize<cluster_version_t::CLUSTER>(&wm, spec.intersect_geometry);
+    serialize<cluster_version_t::CLUSTER>(&wm, env.get_all_optargs());
+    serialize<cluster_version_t::CLUSTER>(&wm, env.get_user_context());
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    return uuid_u::from_hash(
+        base_range_filter_id,
+        std::string(stream.vector().begin(), stream.vector().end()));
+}
+
 // This gets around some class ordering issues; `range_sub_t` needs to know how
 // to construct a `splice_stream_t` and `splice_stream_t` needs to know about
 // `range_sub_t`.
@@ -2171,6 +3010,7 @@ public:
           sent_state(state_t::NONE),
           artificial_include_initial(false) {
         env = make_env(outer_env);
+        filter_id = range_filter_id(spec, *outer_env);
         for (const auto &transform : spec.transforms) {
             ops.push_back(make_op(transform));
         }
@@ -2185,6 +3025,7 @@ public:
         destructor_cleanup(std::bind(&feed_t::del_range_sub, feed, this));
     }
     boost::optional<std::string> sindex() const { return spec.sindex; }
+    const uuid_u &get_filter_id() const { return filter_id; }
     size_t copies(const datum_t &sindex_key) const {
         guarantee(spec.sindex);
         if (spec.intersect_geometry) {
@@ -2280,6 +3121,8 @@ public:
             while (old_queue->size() != 0) {
                 queue->add(old_queue->pop());
             }
+        } else {
+            maybe_enable_spilling();
         }
     }
 
@@ -2294,6 +3137,8 @@ public:
         assert_thread();
         r_sanity_check(self.get() == this);
 
+        register_filter(outer_env, nif, addr, spec, filter_id);
+
         read_response_t read_resp;
         // Note that we use the `outer_env`'s interruptor for the read.
         nif->read(
@@ -2389,6 +3234,7 @@ private:
 
     scoped_ptr_t<env_t> env;
     std::vector<scoped_ptr_t<op_t> > ops;
+    uuid_u filter_id;
 
     // The stamp (see `stamped_msg_t`) associated with our `changefeed_stamp_t`
     // read.  We use these to make sure we don't see changes from writes before
@@ -2800,6 +3646,196 @@ void real_feed_t::stop_limit_sub(limit_sub_t *sub) {
     }
 }
 
+// The servers send us how much each write changed the aggregated values of their
+// shards, so all we have to do is add those up.  Ungrouped aggregations have a
+// single `null` group.
+class aggregate_sub_t : public subscription_t {
+public:
+    // Throws QL exceptions.
+    aggregate_sub_t(rdb_context_t *_rdb_context,
+                    const auth::user_context_t &_user_context,
+                    feed_t *_feed,
+                    configured_limits_t _limits,
+                    const datum_t &_squash,
+                    bool _include_states,
+                    bool _include_types,
+                    keyspec_t::aggregate_t _spec)
+        : subscription_t(_rdb_context,
+                         _user_context,
+                         _feed,
+                         _limits,
+                         _squash,
+                         _include_states,
+                         _include_types),
+          uuid(generate_uuid()),
+          need_init(-1),
+          got_init(0),
+          spec(std::move(_spec)),
+          grouped(std::any_of(
+                      spec.range.transforms.begin(),
+                      spec.range.transforms.end(),
+                      [](const transform_variant_t &t) {
+                          return boost::get<group_wire_func_t>(&t) != nullptr;
+                      })),
+          include_initial(false),
+          started(false),
+          values(grouped) {
+        _feed->add_aggregate_sub(this, uuid);
+    }
+
+    virtual ~aggregate_sub_t() {
+        destructor_cleanup(std::bind(&feed_t::del_aggregate_sub, feed, this, uuid));
+    }
+
+    feed_type_t cfeed_type() const final {
+        return grouped ? feed_type_t::stream : feed_type_t::point;
+    }
+
+    void init(const std::map<datum_t, double> &start_data) {
+        got_init += 1;
+        note_change(start_data);
+    }
+
+    void note_change(const std::map<datum_t, double> &deltas) {
+        ASSERT_NO_CORO_WAITING;
+        // The changes of a shard can arrive before its initial values, but we
+        // only add them up, so the order doesn't matter.
+        values.add(deltas);
+        if (need_init == got_init) {
+            if (!started) {
+                start();
+            } else {
+                if (!squash) {
+                    apply_queued_changes();
+                }
+                maybe_signal_cond();
+            }
+        }
+    }
+
+    // We only send the values the user hasn't seen yet, so squashing is just a
+    // matter of not doing this until our timer is up.
+    virtual void apply_queued_changes() {
+        ASSERT_NO_CORO_WAITING;
+        for (auto &&change : values.take_changes()) {
+            datum_t el = vals_to_change(
+                std::move(change.old_val), std::move(change.new_val),
+                false, false, include_types);
+            els.push_back(grouped ? add_group(el, change.group) : std::move(el));
+        }
+    }
+
+    virtual bool has_el() { return els.size() != 0; }
+    virtual datum_t pop_el() {
+        guarantee(has_el());
+        datum_t ret = std::move(els.front());
+        els.pop_front();
+        return ret;
+    }
+
+    counted_t<datum_stream_t> to_stream(
+        env_t *env,
+        std::string table,
+        namespace_interface_t *nif,
+        const client_t::addr_t &addr,
+        counted_t<datum_stream_t> maybe_src,
+        scoped_ptr_t<subscription_t> &&self,
+        backtrace_id_t bt) final {
+        assert_thread();
+        r_sanity_check(self.get() == this);
+        include_initial = maybe_src.has();
+        read_response_t read_resp;
+        nif->read(
+            env->get_user_context(),
+            read_t(changefeed_aggregate_subscribe_t(
+                       addr,
+                       uuid,
+                       spec,
+                       std::move(table),
+                       env->get_all_optargs(),
+                       env->get_user_context(),
+                       spec.range.sindex
+                           ? region_t::universe()
+                           : region_t(
+                               spec.range.datumspec.covering_range().to_primary_keyrange())),
+                   profile_bool_t::DONT_PROFILE,
+                   read_mode_t::SINGLE),
+            &read_resp,
+            order_token_t::ignore,
+            env->interruptor);
+        auto resp = boost::get<changefeed_limit_subscribe_response_t>(
+            &read_resp.response);
+        if (resp == NULL) {
+            auto err_resp = boost::get<rget_read_response_t>(&read_resp.response);
+            guarantee(err_resp != NULL);
+            auto err = boost::get<exc_t>(&err_resp->result);
+            guarantee(err != NULL);
+            throw *err;
+        }
+        guarantee(need_init == -1);
+        need_init = resp->shards;
+        stop_addrs = std::move(resp->limit_addrs);
+        guarantee(need_init > 0);
+        if (need_init == got_init) {
+            start();
+        }
+        return make_counted<stream_t<subscription_t> >(std::move(self), bt);
+    }
+    NORETURN virtual counted_t<datum_stream_t> to_artificial_stream(
+        const uuid_u &, const std::string &, const std::vector<datum_t> &,
+        bool, scoped_ptr_t<subscription_t> &&, backtrace_id_t) {
+        crash("Cannot start an aggregate subscription on an artificial table.");
+    }
+
+    uuid_u uuid;
+    int64_t need_init, got_init;
+    keyspec_t::aggregate_t spec;
+    std::vector<server_t::limit_addr_t> stop_addrs;
+
+private:
+    void start() {
+        ASSERT_NO_CORO_WAITING;
+        guarantee(need_init == got_init && !started);
+        started = true;
+        const std::map<datum_t, double> &current = values.start();
+        if (include_initial) {
+            if (include_states) els.push_back(maybe_add_type(initializing_datum(),
+                                                             change_type_t::STATE));
+            for (const auto &pair : current) {
+                datum_t el = vals_to_change(
+                    datum_t::null(), datum_t(pair.second), true, false, include_types);
+                els.push_back(grouped ? add_group(el, pair.first) : std::move(el));
+            }
+        }
+        if (include_states) els.push_back(maybe_add_type(ready_datum(),
+                                                         change_type_t::STATE));
+        maybe_signal_cond();
+    }
+
+    static datum_t add_group(const datum_t &el, const datum_t &group) {
+        return el.merge(datum_t(std::map<datum_string_t, datum_t>{
+                    { datum_string_t("group"), group }}));
+    }
+
+    const bool grouped;
+    bool include_initial;
+    // Whether every shard sent us its initial values.  Until then we don't send
+    // the user anything.
+    bool started;
+    aggregate_values_t values;
+    std::deque<datum_t> els;
+
+    auto_drainer_t *get_drainer() final { return &drainer; }
+    auto_drainer_t drainer;
+};
+
+void real_feed_t::stop_aggregate_sub(aggregate_sub_t *sub) {
+    for (const auto &addr : sub->stop_addrs) {
+        send(manager, addr,
+             mailbox.get_address(), sub->spec.range.sindex, sub->uuid);
+    }
+}
+
 class msg_visitor_t : public boost::static_visitor<void> {
 public:
     msg_visitor_t(feed_t *_feed, const auto_drainer_t::lock_t *_lock,
@@ -2826,6 +3862,23 @@ public:
                 sub->stop(std::make_exception_ptr(msg.exc), detach_t::NO);
             });
     }
+    void operator()(const msg_t::aggregate_start_t &msg) const {
+        feed->on_aggregate_sub(
+            msg.sub, *lock,
+            [&msg](aggregate_sub_t *sub) { sub->init(msg.start_data); });
+    }
+    void operator()(const msg_t::aggregate_change_t &msg) const {
+        feed->on_aggregate_sub(
+            msg.sub, *lock,
+            [&msg](aggregate_sub_t *sub) { sub->note_change(msg.deltas); });
+    }
+    void operator()(const msg_t::aggregate_stop_t &msg) const {
+        feed->on_aggregate_sub(
+            msg.sub, *lock,
+            [&msg](aggregate_sub_t *sub) {
+                sub->stop(std::make_exception_ptr(msg.exc), detach_t::NO);
+            });
+    }
     void operator()(const msg_t::change_t &change) const {
         datum_t null = datum_t::null();
 
@@ -2833,7 +3886,19 @@ public:
             datum_t new_val = null, old_val = null;
             if (!sub->active()) return;
             bool trivial = false;
-            if (sub->has_ops()) {
+            if (change.transformed_for) {
+                // The server already did our work for us, and only the
+                // subscriptions sharing our filter are interested in the change.
+                if (sub->get_filter_id() != *change.transformed_for) return;
+                guarantee(sub->has_ops());
+                if (change.new_val.has()) {
+                    new_val = change.new_val;
+                }
+                if (change.old_val.has()) {
+                    old_val = change.old_val;
+                }
+                trivial = (new_val == old_val);
+            } else if (sub->has_ops()) {
                 if (change.new_val.has()) {
                     if (boost::optional<datum_t> d = sub->apply_ops(change.new_val)) {
                         new_val = *d;
@@ -2916,6 +3981,9 @@ public:
                 }
             }
         });
+        if (change.transformed_for) {
+            return;
+        }
         feed->on_point_sub(
             change.pkey,
             *lock,
@@ -3417,6 +4485,9 @@ RDB_MAKE_SERIALIZABLE_4_FOR_CLUSTER(
 RDB_MAKE_SERIALIZABLE_0_FOR_CLUSTER(keyspec_t::empty_t);
 RDB_MAKE_SERIALIZABLE_2_FOR_CLUSTER(keyspec_t::limit_t, range, limit);
 RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(keyspec_t::point_t, key);
+RDB_MAKE_SERIALIZABLE_2_FOR_CLUSTER(keyspec_t::aggregate_t, range, terminal);
+RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
+    filter_update_t, sub, filter, spec, optargs, user_context);
 
 void feed_t::add_sub_with_lock(
     rwlock_t *rwlock, const std::function<void()> &f) THROWS_NOTHING {
@@ -3502,6 +4573,7 @@ void feed_t::add_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTH
 // Can't throw because it's called in a destructor.
 void feed_t::del_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTHING {
     del_sub_with_lock(&point_subs_lock, [this, sub, &key]() {
+            note_stopped_filter(sub->get_uuid());
             return map_del_sub(&point_subs, key, sub);
         });
 }
@@ -3517,6 +4589,7 @@ void feed_t::add_range_sub(range_sub_t *sub) THROWS_NOTHING {
 // Can't throw because it's called in a destructor.
 void feed_t::del_range_sub(range_sub_t *sub) THROWS_NOTHING {
     del_sub_with_lock(&range_subs_lock, [this, sub]() {
+            note_stopped_filter(sub->get_uuid());
             return range_subs[sub->home_thread().threadnum].erase(sub);
         });
 }
@@ -3551,6 +4624,23 @@ void feed_t::del_limit_sub(limit_sub_t *sub, const uuid_u &sub_uuid) THROWS_NOTH
         });
 }
 
+// If this throws we might leak the increment to `num_subs`.
+void feed_t::add_aggregate_sub(aggregate_sub_t *sub,
+                               const uuid_u &sub_uuid) THROWS_NOTHING {
+    add_sub_with_lock(&aggregate_subs_lock, [this, sub, &sub_uuid]() {
+            map_add_sub(&aggregate_subs, sub_uuid, sub);
+        });
+}
+
+// Can't throw because it's called in a destructor.
+void feed_t::del_aggregate_sub(aggregate_sub_t *sub,
+                               const uuid_u &sub_uuid) THROWS_NOTHING {
+    del_sub_with_lock(&aggregate_subs_lock, [this, sub, &sub_uuid]() {
+            stop_aggregate_sub(sub);
+            return map_del_sub(&aggregate_subs, sub_uuid, sub);
+        });
+}
+
 template<class Sub>
 void feed_t::each_sub_in_vec(
     const std::vector<std::set<Sub *> > &vec,
@@ -3626,6 +4716,27 @@ void feed_t::each_limit_sub_with_lock(
 
 }
 
+void feed_t::each_aggregate_sub_cb(
+    const std::function<void(aggregate_sub_t *)> &f, int i) {
+    on_thread_t th((threadnum_t(i)));
+    for (auto const &pair : aggregate_subs) {
+        for (aggregate_sub_t *sub : pair.second[i]) {
+            f(sub);
+        }
+    }
+}
+
+void feed_t::each_aggregate_sub_with_lock(
+    rwlock_in_line_t *spot,
+    const std::function<void(aggregate_sub_t *)> &f) THROWS_NOTHING {
+    spot->read_signal()->wait_lazily_unordered();
+    pmap(get_num_threads(),
+         std::bind(&feed_t::each_aggregate_sub_cb,
+                   this,
+                   std::cref(f),
+                   ph::_1));
+}
+
 void feed_t::on_point_sub(
     store_key_t key,
     const auto_drainer_t::lock_t &lock,
@@ -3656,6 +4767,21 @@ void feed_t::on_limit_sub(
     }
 }
 
+void feed_t::on_aggregate_sub(
+    const uuid_u &sub_uuid,
+    const auto_drainer_t::lock_t &lock,
+    const std::function<void(aggregate_sub_t *)> &f) THROWS_NOTHING {
+    assert_thread();
+    guarantee(lock.has_lock());
+    rwlock_in_line_t spot(&aggregate_subs_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+
+    auto aggregate_sub = aggregate_subs.find(sub_uuid);
+    if (aggregate_sub != aggregate_subs.end()) {
+        each_sub_in_vec(aggregate_sub->second, &spot, lock, f);
+    }
+}
+
 bool feed_t::can_be_removed() {
     assert_thread();
     return num_subs == 0;
@@ -3712,16 +4838,30 @@ void feed_t::stop_subs(const auto_drainer_t::lock_t &lock) {
         }
         limit_subs.clear();
     }
+    {
+        rwlock_in_line_t spot(&aggregate_subs_lock, access_t::write);
+        spot.write_signal()->wait_lazily_unordered();
+        each_aggregate_sub_with_lock(&spot, f);
+        for (auto &&pair : aggregate_subs) {
+            for (auto &&set : pair.second) {
+                num_subs -= set.size();
+            }
+        }
+        aggregate_subs.clear();
+    }
     guarantee(num_subs == 0);
 }
 
-feed_t::feed_t(namespace_id_t const &_table_id, table_meta_client_t *_table_meta_client)
+feed_t::feed_t(namespace_id_t const &_table_id,
+               table_meta_client_t *_table_meta_client,
+               counted_t<spill_file_t> _spill_file)
   : detached(false),
     num_subs(0),
     empty_subs(get_num_threads()),
     range_subs(get_num_threads()),
     table_id(_table_id),
-    table_meta_client(_table_meta_client) { }
+    table_meta_client(_table_meta_client),
+    spill_file(std::move(_spill_file)) { }
 
 feed_t::~feed_t() {
     guarantee(num_subs == 0);
@@ -3800,6 +4940,19 @@ scoped_ptr_t<subscription_t> new_sub(
                 ss->include_types,
                 point.key);
         }
+        subscription_t *operator()(const keyspec_t::aggregate_t &aggregate) const {
+            rcheck_datum(!ss->include_offsets, base_exc_t::LOGIC,
+                         "Cannot include offsets for aggregate subs.");
+            return new aggregate_sub_t(
+                env->get_rdb_ctx(),
+                env->get_user_context(),
+                feed,
+                ss->limits,
+                ss->squash,
+                ss->include_states,
+                ss->include_types,
+                aggregate);
+        }
         env_t *env;
         feed_t *feed;
         const streamspec_t *ss;
@@ -3876,9 +5029,18 @@ counted_t<datum_stream_t> client_t::new_stream(
                     // users may share a feed_t, and this code path will
                     // only be run for the first one.  Rather than mess
                     // about, just use the defaults.
+                    counted_t<spill_file_t> spill_file;
+                    rdb_context_t *ctx = env->get_rdb_ctx();
+                    if (ctx != nullptr && ctx->changefeed_spill_path) {
+                        spill_file = make_counted<spill_file_t>(
+                            ctx->io_backender,
+                            serializer_filepath_t(
+                                *ctx->changefeed_spill_path,
+                                "changefeed_queue_" + uuid_to_str(generate_uuid())));
+                    }
                     auto val = make_scoped<real_feed_t>(
                         lock, this, manager, access.get(), table_id, &interruptor,
-                        table_meta_client);
+                        table_meta_client, std::move(spill_file));
                     feed_it = feeds.insert(
                         std::make_pair(table_id, std::move(val))).first;
                 }
@@ -3962,7 +5124,7 @@ scoped_ptr_t<real_feed_t> client_t::detach_feed(
 class artificial_feed_t : public feed_t {
 public:
     explicit artificial_feed_t(artificial_t *_parent)
-        : feed_t(nil_uuid(), nullptr),
+        : feed_t(nil_uuid(), nullptr, counted_t<spill_file_t>()),
           parent(_parent) { }
     ~artificial_feed_t() { detached = true; }
     virtual auto_drainer_t::lock_t get_drainer_lock() { return drainer.lock(); }
@@ -3976,6 +5138,9 @@ public:
     NORETURN virtual void stop_limit_sub(limit_sub_t *) {
         crash("Limit subscriptions are not supported on artificial feeds.");
     }
+    NORETURN virtual void stop_aggregate_sub(aggregate_sub_t *) {
+        crash("Aggregate subscriptions are not supported on artificial feeds.");
+    }
 private:
     artificial_t *parent;
     auto_drainer_t drainer;
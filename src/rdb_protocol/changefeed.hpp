@@ -6,6 +6,7 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <utility>
@@ -23,6 +24,7 @@
 #include "protocol_api.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datumspec.hpp"
+#include "rdb_protocol/optargs.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "region/region.hpp"
 #include "repli_timestamp.hpp"
@@ -65,6 +67,10 @@ typedef std::pair<const std::string, std::pair<datum_t, datum_t> > const_item_t;
 std::vector<item_t> mangle_sort_truncate_stream(
     raw_stream_t &&stream, is_primary_t is_primary, sorting_t sorting, size_t n);
 
+// The number of rows past the top `limit` that a `limit_manager_t` keeps in memory,
+// so that a row leaving the top `limit` can usually be replaced without reading.
+size_t limit_margin_size(size_t limit);
+
 boost::optional<datum_t> apply_ops(
     const datum_t &val,
     const std::vector<scoped_ptr_t<op_t> > &ops,
@@ -91,12 +97,34 @@ struct msg_t {
         exc_t exc;
         RDB_DECLARE_ME_SERIALIZABLE(limit_stop_t);
     };
+    struct aggregate_start_t {
+        uuid_u sub;
+        // The values of the groups, with `null` standing for the only group of an
+        // ungrouped aggregation.
+        std::map<datum_t, double> start_data;
+        RDB_DECLARE_ME_SERIALIZABLE(aggregate_start_t);
+    };
+    struct aggregate_change_t {
+        uuid_u sub;
+        // How much the values of the groups changed by.
+        std::map<datum_t, double> deltas;
+        RDB_DECLARE_ME_SERIALIZABLE(aggregate_change_t);
+    };
+    struct aggregate_stop_t {
+        uuid_u sub;
+        exc_t exc;
+        RDB_DECLARE_ME_SERIALIZABLE(aggregate_stop_t);
+    };
     struct change_t {
         index_vals_t old_indexes, new_indexes;
         store_key_t pkey;
         /* For a newly-created row, `old_val` is an empty `datum_t`. For a deleted row,
         `new_val` is an empty `datum_t`. */
         datum_t old_val, new_val;
+        /* If the `server_t` already applied the transforms of the only filter of the
+        feed that's interested in the change, this is that filter, and `old_val` and
+        `new_val` are the transformed values.  See `filter_update_t`. */
+        boost::optional<uuid_u> transformed_for;
         RDB_DECLARE_ME_SERIALIZABLE(change_t);
     };
     struct stop_t {
@@ -113,7 +141,10 @@ struct msg_t {
                            change_t,
                            limit_start_t,
                            limit_change_t,
-                           limit_stop_t> op_t;
+                           limit_stop_t,
+                           aggregate_start_t,
+                           aggregate_change_t,
+                           aggregate_stop_t> op_t;
     op_t op;
 
     // Accursed reference collapsing!
@@ -124,7 +155,21 @@ struct msg_t {
 RDB_DECLARE_SERIALIZABLE(msg_t);
 
 class real_feed_t;
-struct stamped_msg_t;
+
+// What a `server_t` sends a client.  Each server stamps the messages it sends a
+// client with consecutive numbers, so that the client can put them back in order.
+struct stamped_msg_t {
+    stamped_msg_t() { }
+    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
+        : server_uuid(std::move(_server_uuid)),
+          stamp(_stamp),
+          submsg(std::move(_submsg)) { }
+    uuid_u server_uuid;
+    uint64_t stamp;
+    msg_t submsg;
+};
+
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(stamped_msg_t);
 
 typedef mailbox_addr_t<void(stamped_msg_t)> client_addr_t;
 
@@ -144,6 +189,14 @@ struct keyspec_t {
     struct point_t {
         datum_t key;
     };
+    // A `count` or a `sum` of a range, which the servers keep up to date as the
+    // rows in the range change.  Grouped `sum`s aren't supported, since we
+    // couldn't tell when a group disappears.
+    struct aggregate_t {
+        typedef boost::variant<count_wire_func_t, sum_wire_func_t> terminal_t;
+        range_t range;
+        terminal_t terminal;
+    };
 
     keyspec_t(keyspec_t &&other) noexcept
         : spec(std::move(other.spec)),
@@ -165,7 +218,7 @@ struct keyspec_t {
     keyspec_t(const keyspec_t &) = default;
     keyspec_t &operator=(const keyspec_t &) = default;
 
-    typedef boost::variant<range_t, empty_t, limit_t, point_t> spec_t;
+    typedef boost::variant<range_t, empty_t, limit_t, point_t, aggregate_t> spec_t;
     spec_t spec;
     counted_t<base_table_t> table;
     std::string table_name;
@@ -195,6 +248,80 @@ RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::range_t);
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::empty_t);
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::limit_t);
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::point_t);
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::aggregate_t);
+
+// The terminal that computes the aggregation of `spec` on its range.
+terminal_variant_t make_aggregate_terminal(const keyspec_t::aggregate_t &spec);
+
+// Adds `sign` times the values of the groups of the result of a `count` or `sum`
+// to `*values_out`, with `null` standing for the group of an ungrouped result.
+// The result mustn't be an error.
+void add_aggregate_result(const result_t &res,
+                          double sign,
+                          std::map<datum_t, double> *values_out);
+
+/* The values of the groups of an aggregate changefeed on the node that runs it: the
+ones the user has been sent, and the ones they'll be sent next.  The initial values
+of the shards and the deltas of their changes can be added in any order.  Ungrouped
+aggregations have a single `null` group which always exists; a group of a grouped
+aggregation disappears when it drops to 0.
+
+The values are running totals of `double` deltas, so an ungrouped `sum` of
+fractional numbers can drift by rounding errors from what a fresh `.sum()` returns
+after many changes.  Counts are exact up to 2^53. */
+class aggregate_values_t {
+public:
+    struct change_t {
+        datum_t group;
+        // `null` if the group didn't exist or doesn't exist anymore.
+        datum_t old_val, new_val;
+    };
+
+    explicit aggregate_values_t(bool _grouped);
+
+    // Adds the initial values of a shard or the deltas of one of its changes.
+    void add(const std::map<datum_t, double> &deltas);
+    // Marks the current values as sent to the user and returns them.  Until this is
+    // called there are no changes to take.
+    const std::map<datum_t, double> &start();
+    // Returns the groups whose values changed since they were last sent to the
+    // user, and marks the new values as sent.
+    std::vector<change_t> take_changes();
+
+private:
+    const bool grouped;
+    bool started;
+    std::map<datum_t, double> reported, current;
+    // The groups whose values may have changed since we last reported them.
+    std::set<datum_t> dirty;
+};
+
+/* A `real_feed_t` sends one of these to its `server_t`s (inside a
+`changefeed_subscribe_t`) whenever a point or range subscription starts, so that the
+servers only send it the changes that at least one of its subscriptions is
+interested in.  When a subscription stops, the feed sends the servers its uuid (see
+`server_t::filter_stop_addr_t`).  Clients which never send one get every change.  Range
+subscriptions' transforms are evaluated by the server; if only one filter is
+interested in a change, the server sends the transformed values instead of the
+whole rows.
+
+Range subscriptions with the same spec, optargs and user share a filter, so that
+any number of identical subscriptions on a node cost the servers one evaluation per
+change and still get projected changes. */
+struct filter_update_t {
+    uuid_u sub;
+    // Only meaningful for range subscriptions.
+    uuid_u filter;
+    // Either a `keyspec_t::point_t` or a `keyspec_t::range_t`.
+    keyspec_t::spec_t spec;
+    global_optargs_t optargs;
+    auth::user_context_t user_context;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(filter_update_t);
+
+// The id of the filter that range subscriptions with this spec share.  Functions
+// that only differ in their variable ids get the same id.
+uuid_u range_filter_id(const keyspec_t::range_t &spec, const env_t &env);
 
 // The `client_t` exists on the server handling the changefeed query, in the
 // `rdb_context_t`.  When a query subscribes to the changes on a table, it
@@ -426,10 +553,17 @@ public:
     const std::string table;
     const uuid_u uuid;
 private:
-    // Can throw `exc_t` exceptions if an error occurs while reading from disk.
+    // Reads up to `n` rows past `start`.  Sets `*exhausted_out` if there are no
+    // more rows after the ones returned.  Can throw `exc_t` exceptions if an error
+    // occurs while reading from disk.
     std::vector<item_t> read_more(
         const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-        const boost::optional<item_t> &start);
+        const boost::optional<item_t> &start,
+        size_t n,
+        bool *exhausted_out);
+    // Moves the rows that don't fit into `item_queue` to `margin` and returns their
+    // ids, and the rows that don't fit into `margin` out of memory.
+    std::vector<std::string> truncate_to_margin();
     void send(msg_t &&msg);
 
     scoped_ptr_t<env_t> env;
@@ -441,7 +575,13 @@ private:
     std::vector<scoped_ptr_t<op_t> > ops;
 
     limit_order_t gt;
+    // The top `spec.limit` rows, which are what the client sees.
     item_queue_t item_queue;
+    // The rows right after the ones in `item_queue`.  Every row that sorts before
+    // the last row of `margin` is either here or in `item_queue`.
+    item_queue_t margin;
+    // Whether `item_queue` and `margin` hold every row in the range.
+    bool margin_complete;
 
     std::map<std::string, std::pair<datum_t, datum_t> > added;
     std::set<std::string> deleted;
@@ -460,12 +600,19 @@ public:
     typedef server_addr_t addr_t;
     typedef mailbox_addr_t<void(client_t::addr_t, boost::optional<std::string>, uuid_u)>
         limit_addr_t;
+    typedef mailbox_addr_t<void(client_t::addr_t, std::vector<uuid_u>)>
+        filter_stop_addr_t;
     explicit server_t(mailbox_manager_t *_manager, store_t *_parent);
     ~server_t();
     void add_client(
         const client_t::addr_t &addr,
         region_t region,
         const auto_drainer_t::lock_t &keepalive);
+    void update_filters(
+        const client_t::addr_t &addr,
+        rdb_context_t *ctx,
+        const filter_update_t &update,
+        const auto_drainer_t::lock_t &keepalive);
     void add_limit_client(
         const client_t::addr_t &addr,
         const region_t &region,
@@ -478,6 +625,31 @@ public:
         limit_order_t lt,
         std::vector<item_t> &&start_data,
         const auto_drainer_t::lock_t &keepalive);
+    // Starts sending the client the changes to the aggregation of `spec`.
+    // `stamp_spot` has to be a read spot on the store's changefeed stamp lock,
+    // which we got in line for while holding the superblock that the initial
+    // values are read with.  That way the changes the client is sent are exactly
+    // the ones the initial read doesn't see.  The caller can release `stamp_spot`
+    // and the superblock as soon as this returns, and send the initial values with
+    // `send_aggregate_start` once it has them.  The client adds the changes to the
+    // initial values in whatever order they arrive.
+    void add_aggregate_client(
+        const client_t::addr_t &addr,
+        const region_t &region,
+        rdb_context_t *ctx,
+        global_optargs_t optargs,
+        auth::user_context_t user_context,
+        const uuid_u &client_uuid,
+        const keyspec_t::aggregate_t &spec,
+        rwlock_in_line_t *stamp_spot,
+        const auto_drainer_t::lock_t &keepalive);
+    void send_aggregate_start(
+        const client_t::addr_t &addr,
+        const uuid_u &client_uuid,
+        std::map<datum_t, double> &&start_data,
+        const auto_drainer_t::lock_t &keepalive);
+    // Returns whether `sub` was an aggregate changefeed of `addr`.
+    bool remove_aggregate_client(const client_t::addr_t &addr, const uuid_u &sub);
     // `key` should be non-NULL if there is a key associated with the message.
     void send_all(
         const msg_t &msg,
@@ -486,6 +658,7 @@ public:
         const auto_drainer_t::lock_t &keepalive);
     addr_t get_stop_addr();
     limit_addr_t get_limit_stop_addr();
+    filter_stop_addr_t get_filter_stop_addr();
     boost::optional<uint64_t> get_stamp(
         const client_t::addr_t &addr,
         const auto_drainer_t::lock_t &keepalive);
@@ -511,6 +684,9 @@ private:
                                client_t::addr_t addr,
                                boost::optional<std::string> sindex,
                                uuid_u uuid);
+    void filter_stop_mailbox_cb(signal_t *interruptor,
+                                client_t::addr_t addr,
+                                std::vector<uuid_u> subs);
     void add_client_cb(
         signal_t *stopped,
         client_t::addr_t addr,
@@ -522,11 +698,23 @@ private:
     const uuid_u uuid;
     mailbox_manager_t *const manager;
 
+    class range_filter_t;
+    class aggregate_manager_t;
     struct client_info_t {
         client_info_t();
+        void remove_filter(const uuid_u &sub);
         scoped_ptr_t<cond_t> cond;
         uint64_t stamp;
         std::vector<region_t> regions;
+        // Whether the client has sent us a `filter_update_t`.  If it hasn't, it
+        // gets every change in its regions.
+        bool filtered;
+        std::map<uuid_u, store_key_t> point_filters;
+        std::map<store_key_t, size_t> point_filter_keys;
+        // Maps subscriptions to the filters they share.
+        std::map<uuid_u, uuid_u> range_filter_subs;
+        std::map<uuid_u, std::pair<scoped_ptr_t<range_filter_t>, size_t> >
+            range_filters;
         std::map<boost::optional<std::string>,
                  std::vector<scoped_ptr_t<limit_manager_t> >,
                  // Be careful not to remove this, since optionals are
@@ -535,6 +723,8 @@ private:
                      bool(const boost::optional<std::string> &,
                           const boost::optional<std::string> &)> > limit_clients;
         scoped_ptr_t<rwlock_t> limit_clients_lock;
+        // Only modified while holding a write lock on `clients_lock`.
+        std::vector<scoped_ptr_t<aggregate_manager_t> > aggregates;
     };
     std::map<client_t::addr_t, client_info_t> clients;
 
@@ -545,6 +735,13 @@ private:
         boost::optional<std::string> sindex,
         size_t offset);
 
+    // Returns whether `client` should be sent `msg`.  If the client should get a
+    // projected version of `msg` instead, it's stored in `*projected_out`.  Can
+    // block, since it evaluates the transforms of the client's range filters.
+    bool filter_msg(const client_info_t &client,
+                    const msg_t &msg,
+                    boost::optional<msg_t> *projected_out);
+
     void send_one_with_lock(std::pair<const client_t::addr_t, client_info_t> *client,
                             msg_t msg,
                             const auto_drainer_t::lock_t &lock);
@@ -568,10 +765,13 @@ private:
     // to unsubscribe.  The callback of this mailbox acquires the drainer, so it
     // has to be destroyed first.
     mailbox_t<void(client_t::addr_t)> stop_mailbox;
-    // Clients send a message to this mailbox to unsubscribe a particular limit
-    // changefeed.
+    // Clients send a message to this mailbox to unsubscribe a particular limit or
+    // aggregate changefeed.
     mailbox_t<void(client_t::addr_t, boost::optional<std::string>, uuid_u)>
         limit_stop_mailbox;
+    // Clients send a message to this mailbox with the uuids of the point and range
+    // subscriptions that stopped, so that we drop their filters.
+    mailbox_t<void(client_t::addr_t, std::vector<uuid_u>)> filter_stop_mailbox;
 };
 
 class artificial_feed_t;
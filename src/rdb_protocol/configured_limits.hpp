@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include "config/args.hpp"
 #include "rpc/serialize_macros.hpp"
 
 class rdb_context_t;
@@ -17,20 +18,30 @@ class configured_limits_t {
 public:
     configured_limits_t() :
         changefeed_queue_size_(default_changefeed_queue_size),
-        array_size_limit_(default_array_size_limit) {}
-    configured_limits_t(size_t _changefeed_queue_size, size_t _array_size_limit)
+        array_size_limit_(default_array_size_limit),
+        changefeed_queue_memory_(default_changefeed_queue_memory) {}
+    configured_limits_t(size_t _changefeed_queue_size, size_t _array_size_limit,
+                        size_t _changefeed_queue_memory
+                            = default_changefeed_queue_memory)
         : changefeed_queue_size_(_changefeed_queue_size),
-          array_size_limit_(_array_size_limit) {}
+          array_size_limit_(_array_size_limit),
+          changefeed_queue_memory_(_changefeed_queue_memory) {}
 
     static const size_t default_changefeed_queue_size = 100000;
     static const size_t default_array_size_limit = 100000;
+    static const size_t default_changefeed_queue_memory = 4 * MEGABYTE;
     static const configured_limits_t unlimited;
 
     size_t changefeed_queue_size() const { return changefeed_queue_size_; }
     size_t array_size_limit() const { return array_size_limit_; }
+    size_t changefeed_queue_memory() const { return changefeed_queue_memory_; }
 private:
     size_t changefeed_queue_size_;
     size_t array_size_limit_;
+    // How many bytes of changes a changefeed keeps in memory before it spills the
+    // rest to disk.  It only matters on the server that runs the changefeed, so it
+    // isn't serialized.
+    size_t changefeed_queue_memory_;
     RDB_DECLARE_ME_SERIALIZABLE(configured_limits_t);
 };
 
@@ -47,6 +47,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 class auth_semilattice_metadata_t;
 class ellipsoid_spec_t;
 class extproc_pool_t;
+class io_backender_t;
 class name_string_t;
 class namespace_interface_t;
 template <class> class cross_thread_watchable_variable_t;
@@ -435,7 +436,9 @@ public:
         boost::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t>>
             auth_semilattice_view,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy);
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        boost::optional<base_path_t> _changefeed_spill_path);
 
     ~rdb_context_t();
 
@@ -446,6 +449,12 @@ public:
 
     const std::string reql_http_proxy;
 
+    // Changefeed subscriptions spill their queued changes to disk here when they
+    // fall behind.  This is `boost::none` on proxies, which don't have a data
+    // directory, and in the unit tests.
+    io_backender_t *const io_backender;
+    const boost::optional<base_path_t> changefeed_spill_path;
+
     class stats_t {
     public:
         explicit stats_t(perfmon_collection_t *global_stats);
@@ -460,6 +469,10 @@ public:
         perfmon_membership_t queries_per_sec_membership;
         perfmon_counter_t queries_total;
         perfmon_membership_t queries_total_membership;
+        perfmon_counter_t query_plan_cache_hits;
+        perfmon_membership_t query_plan_cache_hits_membership;
+        perfmon_counter_t query_plan_cache_misses;
+        perfmon_membership_t query_plan_cache_misses_membership;
     private:
         DISABLE_COPYING(stats_t);
     } stats;
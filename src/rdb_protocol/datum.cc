@@ -1481,18 +1481,31 @@ std::pair<datum_string_t, datum_t> datum_t::unchecked_get_pair(size_t index) con
 }
 
 datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
-    // Use binary search on top of unchecked_get_pair()
+    // Use binary search, since the fields are sorted by key
     size_t range_beg = 0;
     // The obj_size() also makes sure that this has the right type (R_OBJECT)
     size_t range_end = obj_size();
+    const bool is_buf = data.get_internal_type() == internal_type_t::BUF_R_OBJECT;
     while (range_beg < range_end) {
         const size_t center = range_beg + ((range_end - range_beg) / 2);
-        auto center_pair = unchecked_get_pair(center);
-        const int cmp_res = key.compare(center_pair.first);
-        if (cmp_res == 0) {
-            // Found it
-            return center_pair.second;
-        } else if (cmp_res < 0) {
+        int cmp_res;
+        if (is_buf) {
+            // We only look at the keys in the buffer, and deserialize nothing but
+            // the value of the field we're looking for.
+            const size_t offset = datum_get_element_offset(data.buf_ref, center);
+            cmp_res = datum_compare_key_in_buf(data.buf_ref, offset, key);
+            if (cmp_res == 0) {
+                return datum_deserialize_pair_value_from_buf(data.buf_ref, offset);
+            }
+        } else {
+            const std::pair<datum_string_t, datum_t> &center_pair
+                = (*data.r_object)[center];
+            cmp_res = key.compare(center_pair.first);
+            if (cmp_res == 0) {
+                return center_pair.second;
+            }
+        }
+        if (cmp_res < 0) {
             range_end = center;
         } else {
             range_beg = center + 1;
@@ -2215,6 +2215,9 @@ map_datum_stream_t::map_datum_stream_t(
         is_infinite_map &= stream->is_infinite();
         cache.push_back(std::deque<datum_t>());
     }
+    if (streams.size() == 1) {
+        batch_func = func->compile_batch();
+    }
 }
 
 std::vector<datum_t>
@@ -2234,11 +2237,19 @@ map_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
         batchspec_inner = batchspec_t::default_for(batch_type_t::NORMAL);
     }
     while (!is_exhausted()) {
+        datum_t batch_result;
         while (args.size() < streams.size()) {
             if (cache[args.size()].size() == 0) {
                 std::vector<datum_t> new_items = streams[args.size()]->next_batch(
                     env,
                     batchspec_inner);
+                if (batch_func.has()) {
+                    std::vector<datum_t> results;
+                    batch_func->eval(new_items, &results);
+                    for (auto it = results.begin(); it != results.end(); ++it) {
+                        batch_results.push_back(std::move(*it));
+                    }
+                }
                 for (auto it = new_items.begin(); it != new_items.end(); ++it) {
                     cache[args.size()].push_back(std::move(*it));
                 }
@@ -2253,8 +2264,14 @@ map_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
             }
             args.push_back(std::move(cache[args.size()].front()));
             cache[args.size() - 1].pop_front();
+            if (batch_func.has()) {
+                batch_result = std::move(batch_results.front());
+                batch_results.pop_front();
+            }
         }
-        datum_t datum = func->call(env, args)->as_datum();
+        datum_t datum = batch_result.has()
+            ? std::move(batch_result)
+            : func->call(env, args)->as_datum();
         r_sanity_check(datum.has());
         args.clear();
         batcher.note_el(datum);
@@ -19,6 +19,7 @@
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/batch_func.hpp"
 #include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/context.hpp"
 #include "rdb_protocol/math_utils.hpp"
@@ -452,6 +453,13 @@ private:
     // of a changefeed stream.)
     std::vector<std::deque<datum_t> > cache;
     std::vector<datum_t> args;
+
+    // If there's a single stream and `func` is simple enough, the cached elements are
+    // mapped by `batch_func` as soon as they arrive.  `batch_results` holds the
+    // results for the elements in `cache[0]`, which are empty if `func` has to be
+    // called for the element after all.
+    scoped_ptr_t<batch_func_t> batch_func;
+    std::deque<datum_t> batch_results;
 };
 
 class fold_datum_stream_t : public eager_datum_stream_t {
@@ -50,6 +50,57 @@ double distribution_progress_estimator_t::estimate_progress(
     }
 }
 
+std::vector<key_range_t> distribution_progress_estimator_t::split_range(
+        const key_range_t &range, size_t max_parts) const {
+    /* `distribution_counts` maps the first key of every bucket to the number of keys
+    up to the end of the bucket, so a bucket's first key is preceded by the count of the
+    previous bucket. The first keys of the buckets inside `range` are our candidates for
+    splitting it. */
+    std::vector<std::pair<store_key_t, int64_t> > candidates;
+    int64_t keys_before_range = -1;
+    int64_t keys_before_end = distribution_counts_sum;
+    int64_t keys_before_bucket = 0;
+    for (const auto &pair : distribution_counts) {
+        if (range.contains_key(pair.first)) {
+            if (keys_before_range == -1) {
+                keys_before_range = keys_before_bucket;
+            }
+            if (pair.first != range.left) {
+                candidates.push_back(std::make_pair(pair.first, keys_before_bucket));
+            }
+        } else if (keys_before_range != -1) {
+            keys_before_end = keys_before_bucket;
+            break;
+        }
+        keys_before_bucket = pair.second;
+    }
+
+    std::vector<key_range_t> parts;
+    key_range_t current = range;
+    if (keys_before_range != -1 && max_parts > 1) {
+        const int64_t keys_in_range = keys_before_end - keys_before_range;
+        auto candidate = candidates.begin();
+        for (size_t i = 1; i < max_parts && candidate != candidates.end(); ++i) {
+            const int64_t target = keys_before_range
+                + keys_in_range * static_cast<int64_t>(i)
+                    / static_cast<int64_t>(max_parts);
+            while (candidate != candidates.end() && candidate->second < target) {
+                ++candidate;
+            }
+            if (candidate == candidates.end()) {
+                break;
+            }
+            key_range_t part = current;
+            part.right = key_range_t::right_bound_t(candidate->first);
+            parts.push_back(part);
+            current.left = candidate->first;
+            ++candidate;
+        }
+    }
+    parts.push_back(current);
+    return parts;
+}
+
 RDB_IMPL_SERIALIZABLE_2(distribution_progress_estimator_t,
     distribution_counts, distribution_counts_sum);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(distribution_progress_estimator_t);
@@ -3,6 +3,7 @@
 #define RDB_PROTOCOL_DISTRIBUTION_PROGRESS_HPP_
 
 #include <map>
+#include <vector>
 
 #include "btree/keys.hpp"
 #include "rpc/serialize_macros.hpp"
@@ -27,6 +28,12 @@ public:
     // Returns a value between 0.0 and 1.0
     double estimate_progress(const store_key_t &bound) const;
 
+    // Splits `range` into at most `max_parts` consecutive, non-empty ranges that hold
+    // about the same number of keys each. Returns fewer parts if the distribution is
+    // too coarse, and just `range` if it's empty.
+    std::vector<key_range_t> split_range(
+        const key_range_t &range, size_t max_parts) const;
+
     RDB_DECLARE_ME_SERIALIZABLE(distribution_progress_estimator_t);
 
 private:
@@ -77,6 +77,7 @@ env_t::env_t(rdb_context_t *ctx,
       limits_(from_optargs(ctx, _interruptor, &global_optargs_)),
       reql_version_(reql_version_t::LATEST),
       regex_cache_(LRU_CACHE_SIZE),
+      plan_params_(nullptr),
       return_empty_normal_batches(_return_empty_normal_batches),
       interruptor(_interruptor),
       trace(_trace),
@@ -97,6 +98,7 @@ env_t::env_t(signal_t *_interruptor,
         auth::user_context_t(auth::permissions_t(false, false, false, false))),
       reql_version_(_reql_version),
       regex_cache_(LRU_CACHE_SIZE),
+      plan_params_(nullptr),
       return_empty_normal_batches(_return_empty_normal_batches),
       interruptor(_interruptor),
       trace(NULL),
@@ -108,6 +110,11 @@ env_t::env_t(signal_t *_interruptor,
 
 env_t::~env_t() { }
 
+const datum_t &env_t::get_plan_param(size_t index) const {
+    r_sanity_check(plan_params_ != nullptr && index < plan_params_->size());
+    return (*plan_params_)[index];
+}
+
 void env_t::maybe_yield() {
     if (++evals_since_yield_ > EVALS_BEFORE_YIELD) {
         evals_since_yield_ = 0;
@@ -103,22 +103,32 @@ public:
         return limits_;
     }
 
-    configured_limits_t limits_with_changefeed_queue_size(
-        scoped_ptr_t<val_t> changefeed_queue_size) {
-        if (changefeed_queue_size.has()) {
-            return configured_limits_t(
-                check_limit("changefeed queue size",
-                            changefeed_queue_size->as_int()),
-                limits_.array_size_limit());
-        } else {
-            return limits_;
-        }
+    configured_limits_t limits_with_changefeed_queue_optargs(
+        scoped_ptr_t<val_t> changefeed_queue_size,
+        scoped_ptr_t<val_t> changefeed_queue_memory) {
+        return configured_limits_t(
+            changefeed_queue_size.has()
+                ? check_limit("changefeed queue size",
+                              changefeed_queue_size->as_int())
+                : limits_.changefeed_queue_size(),
+            limits_.array_size_limit(),
+            changefeed_queue_memory.has()
+                ? check_limit("changefeed queue memory",
+                              changefeed_queue_memory->as_int())
+                : limits_.changefeed_queue_memory());
     }
 
     regex_cache_t &regex_cache() { return regex_cache_; }
 
     reql_version_t reql_version() const { return reql_version_; }
 
+    // The values of the literals that the term tree being evaluated was compiled with
+    // placeholders for, see `query_plan_cache_t`.
+    void set_plan_params(const std::vector<datum_t> *plan_params) {
+        plan_params_ = plan_params;
+    }
+    const datum_t &get_plan_param(size_t index) const;
+
 private:
     // The global optargs values passed to .run(...) in the Python, Ruby, and JS
     // drivers.
@@ -138,6 +148,8 @@ private:
     // query specific cache parameters; for example match regexes.
     regex_cache_t regex_cache_;
 
+    const std::vector<datum_t> *plan_params_;
+
 public:
     const return_empty_normal_batches_t return_empty_normal_batches;
 
@@ -164,13 +176,21 @@ private:
     DISABLE_COPYING(env_t);
 };
 
+// Maps the `DATUM` terms of a query that a cached plan is compiled with placeholders
+// for to the index of their value in the plan's parameters.
+typedef std::map<const rapidjson::Value *, size_t> plan_param_indexes_t;
+
 // An environment in which expressions are compiled.  Since compilation doesn't
 // evaluate anything, it doesn't need an env_t *.
 class compile_env_t {
 public:
-    explicit compile_env_t(var_visibility_t &&_visibility)
-        : visibility(std::move(_visibility)) { }
+    explicit compile_env_t(var_visibility_t &&_visibility,
+                           const plan_param_indexes_t *_plan_params = nullptr)
+        : visibility(std::move(_visibility)), plan_params(_plan_params) { }
     var_visibility_t visibility;
+    // The `DATUM` terms that are compiled to take their value from the parameters of
+    // the `env_t` instead.  This isn't passed on into functions.
+    const plan_param_indexes_t *plan_params;
 };
 
 // This is an environment for evaluating things that use variables in scope.  It
@@ -130,7 +130,8 @@ continue_bool_t rdb_erase_small_range(
             // Get the full data
             const rdb_value_t *rdb_value = kv_location.value_as<rdb_value_t>();
             mod_report.info.deleted.first = get_data(rdb_value,
-                                                     buf_parent_t(&kv_location.buf));
+                                                     buf_parent_t(&kv_location.buf),
+                                                     btree_slice->key_dictionary);
             // Get the inline value
             mod_report.info.deleted.second.assign(rdb_value->value_ref(),
                 rdb_value->value_ref() + rdb_value->inline_size(max_block_size));
@@ -3,6 +3,7 @@
 
 #include "pprint/js_pprint.hpp"
 #include "pprint/pprint.hpp"
+#include "rdb_protocol/batch_func.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
@@ -16,6 +17,10 @@ func_t::func_t(backtrace_id_t _bt)
   : bt_rcheckable_t(_bt) { }
 func_t::~func_t() { }
 
+scoped_ptr_t<batch_func_t> func_t::compile_batch() const {
+    return scoped_ptr_t<batch_func_t>();
+}
+
 scoped_ptr_t<val_t> func_t::call(env_t *env, eval_flags_t eval_flags) const {
     return call(env, std::vector<datum_t>(), eval_flags);
 }
@@ -99,6 +104,12 @@ bool reql_func_t::is_simple_selector() const {
     return body->is_simple_selector();
 }
 
+scoped_ptr_t<batch_func_t> reql_func_t::compile_batch() const {
+    // The captured scope doesn't matter, `batch_func_t` only handles functions
+    // that don't refer to it.
+    return batch_func_t::compile(arg_names, body->get_src());
+}
+
 js_func_t::js_func_t(const std::string &_js_source,
                      uint64_t timeout_ms,
                      backtrace_id_t _backtrace)
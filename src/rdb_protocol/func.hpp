@@ -25,6 +25,7 @@ class js_runner_t;
 
 namespace ql {
 
+class batch_func_t;
 class func_visitor_t;
 
 class func_t : public slow_atomic_countable_t<func_t>, public bt_rcheckable_t {
@@ -70,6 +71,10 @@ public:
         return false;
     }
 
+    // Returns an empty pointer unless the function can be evaluated a batch of rows
+    // at a time (see batch_func.hpp).
+    virtual scoped_ptr_t<batch_func_t> compile_batch() const;
+
 protected:
     explicit func_t(backtrace_id_t bt);
 
@@ -110,8 +115,11 @@ public:
 
     bool is_simple_selector() const final;
 
+    scoped_ptr_t<batch_func_t> compile_batch() const final;
+
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
+    friend class canonical_func_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
 
     // Only contains the parts of the scope that `body` uses.
@@ -0,0 +1,263 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/key_dictionary.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "buffer_cache/alt.hpp"
+#include "buffer_cache/blob.hpp"
+#include "buffer_cache/serialize_onto_blob.hpp"
+#include "config/args.hpp"
+#include "containers/archive/buffer_group_stream.hpp"
+#include "containers/archive/buffer_stream.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/archive/versioned.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+ATTR_PACKED(struct key_dictionary_block_t {
+    static const int DICTIONARY_BLOB_MAXREFLEN = 4076;
+
+    block_magic_t magic;
+    char dictionary_blob[DICTIONARY_BLOB_MAXREFLEN];
+});
+
+static const block_magic_t key_dictionary_block_magic = { { 'k', 'd', 'i', 'c' } };
+
+static const char escaped_key_prefix[2] = { '\xFF', '\x00' };
+
+static bool is_encoded_key(const char *key, size_t size) {
+    return size != 0 && static_cast<uint8_t>(key[0]) == KEY_DICTIONARY_ENCODED_TAG;
+}
+
+key_dictionary_t::key_dictionary_t() : has_hot_keys_(false) { }
+
+bool key_dictionary_t::encode(const char *serialized, size_t size, size_t num_ids,
+                              std::vector<char> *encoded_out) {
+    assert_thread();
+    return ql::datum_rename_keys_in_buf(
+        serialized, size,
+        [&](const char *key, size_t key_size, std::string *renamed_out) {
+            if (is_encoded_key(key, key_size)) {
+                renamed_out->assign(escaped_key_prefix, sizeof(escaped_key_prefix));
+                renamed_out->append(key, key_size);
+                return true;
+            }
+            std::string name(key, key_size);
+            auto it = ids_.find(name);
+            if (it == ids_.end()) {
+                note_candidate(std::move(name));
+                return false;
+            } else if (it->second < num_ids) {
+                *renamed_out = encoded_names_[it->second];
+                return true;
+            }
+            return false;
+        },
+        encoded_out);
+}
+
+bool key_dictionary_t::decode(const char *serialized, size_t size,
+                              std::vector<char> *decoded_out) const {
+    assert_thread();
+    return ql::datum_rename_keys_in_buf(
+        serialized, size,
+        [&](const char *key, size_t key_size, std::string *renamed_out) {
+            if (!is_encoded_key(key, key_size)) {
+                return false;
+            }
+            decode_key(key, key_size, renamed_out);
+            return true;
+        },
+        decoded_out);
+}
+
+void key_dictionary_t::decode_key(const char *key, size_t size,
+                                  std::string *name_out) const {
+    rassert(is_encoded_key(key, size));
+    if (size >= sizeof(escaped_key_prefix) && key[1] == escaped_key_prefix[1]) {
+        name_out->assign(key + sizeof(escaped_key_prefix),
+                         size - sizeof(escaped_key_prefix));
+        return;
+    }
+    buffer_read_stream_t stream(key + 1, size - 1);
+    uint64_t id_plus_one;
+    archive_result_t res = deserialize_varint_uint64(&stream, &id_plus_one);
+    guarantee_deserialization(res, "key dictionary id");
+    guarantee(id_plus_one >= 1 && id_plus_one <= names_.size(),
+              "A document refers to a field name that isn't in the key dictionary.");
+    *name_out = names_[id_plus_one - 1];
+}
+
+void key_dictionary_t::note_candidate(std::string &&name) {
+    // Ids are at least two bytes long, so shorter keys wouldn't get any shorter.
+    if (name.size() <= 2 || name.size() > KEY_DICTIONARY_MAX_KEY_SIZE
+        || names_.size() >= KEY_DICTIONARY_MAX_SIZE) {
+        return;
+    }
+    auto it = candidates_.find(name);
+    if (it == candidates_.end()) {
+        if (candidates_.size() >= KEY_DICTIONARY_MAX_CANDIDATES) {
+            // Most of these are probably not going to show up again (for example,
+            // because they're from objects that are used as maps).
+            candidates_.clear();
+        }
+        it = candidates_.insert(std::make_pair(std::move(name), 0)).first;
+    }
+    ++it->second;
+    if (it->second >= KEY_DICTIONARY_PROMOTION_THRESHOLD) {
+        has_hot_keys_ = true;
+    }
+}
+
+bool key_dictionary_t::promote_hot_keys() {
+    assert_thread();
+    if (!has_hot_keys_) {
+        return false;
+    }
+    has_hot_keys_ = false;
+    bool changed = false;
+    for (auto it = candidates_.begin(); it != candidates_.end();) {
+        if (it->second >= KEY_DICTIONARY_PROMOTION_THRESHOLD
+            && names_.size() < KEY_DICTIONARY_MAX_SIZE) {
+            add(it->first);
+            changed = true;
+            it = candidates_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return changed;
+}
+
+void key_dictionary_t::add(const std::string &name) {
+    const size_t id = names_.size();
+    uint8_t encoded[1 + 10];
+    encoded[0] = KEY_DICTIONARY_ENCODED_TAG;
+    rassert(varint_uint64_serialized_size(id + 1) <= sizeof(encoded) - 1);
+    const size_t varint_size = serialize_varint_uint64_into_buf(id + 1, encoded + 1);
+    names_.push_back(name);
+    encoded_names_.push_back(std::string(
+        reinterpret_cast<const char *>(encoded), 1 + varint_size));
+    ids_.insert(std::make_pair(name, id));
+}
+
+void key_dictionary_t::init_block(buf_lock_t *block) const {
+    {
+        buf_write_t write(block);
+        key_dictionary_block_t *data
+            = static_cast<key_dictionary_block_t *>(write.get_data_write());
+        data->magic = key_dictionary_block_magic;
+        memset(data->dictionary_blob, 0,
+               key_dictionary_block_t::DICTIONARY_BLOB_MAXREFLEN);
+    }
+    write_to_block(block);
+}
+
+void key_dictionary_t::write_to_block(buf_lock_t *block) const {
+    assert_thread();
+    buf_write_t write(block);
+    key_dictionary_block_t *data
+        = static_cast<key_dictionary_block_t *>(write.get_data_write());
+    guarantee(data->magic == key_dictionary_block_magic);
+    blob_t blob(block->cache()->max_block_size(),
+                data->dictionary_blob,
+                key_dictionary_block_t::DICTIONARY_BLOB_MAXREFLEN);
+    serialize_onto_blob<cluster_version_t::LATEST_DISK>(
+        buf_parent_t(block), &blob, names_);
+}
+
+void key_dictionary_t::read_from_block(buf_lock_t *block) {
+    assert_thread();
+    guarantee(names_.empty());
+    std::vector<std::string> names;
+    {
+        buf_read_t read(block);
+        const key_dictionary_block_t *data
+            = static_cast<const key_dictionary_block_t *>(read.get_data_read());
+        guarantee(data->magic == key_dictionary_block_magic,
+                  "Unexpected magic in key_dictionary_block_t.");
+        // The const cast is okay because we only read from the blob.
+        blob_t blob(block->cache()->max_block_size(),
+                    const_cast<char *>(data->dictionary_blob),
+                    key_dictionary_block_t::DICTIONARY_BLOB_MAXREFLEN);
+        deserialize_for_version_from_blob(cluster_version_t::LATEST_DISK,
+                                          buf_parent_t(block), &blob, &names);
+    }
+    for (const std::string &name : names) {
+        add(name);
+    }
+}
+
+bool key_encoder_t::encode(const write_message_t &serialized,
+                           write_message_t *encoded_out) const {
+    if (dictionary_ == nullptr) {
+        return false;
+    }
+    vector_stream_t stream;
+    stream.reserve(serialized.size());
+    DEBUG_VAR int res = send_write_message(&stream, &serialized);
+    rassert(res == 0);
+    std::vector<char> encoded;
+    if (!dictionary_->encode(stream.vector().data(), stream.vector().size(), num_ids_,
+                             &encoded)) {
+        return false;
+    }
+    serialize_universal(encoded_out, KEY_DICTIONARY_ENCODED_TAG);
+    encoded_out->append(encoded.data(), encoded.size());
+    return true;
+}
+
+void decode_stored_datum(const const_buffer_group_t *group,
+                         const key_dictionary_t *dictionary,
+                         std::vector<char> *serialized_out) {
+    guarantee(dictionary != nullptr,
+              "Found a document that refers to a key dictionary, but there is "
+              "no key dictionary.");
+    // Documents are stored in one block when possible, so usually we don't have to
+    // copy them before decoding them.
+    std::vector<char> flattened;
+    const char *data;
+    size_t size;
+    if (group->num_buffers() == 1) {
+        data = static_cast<const char *>(group->get_buffer(0).data);
+        size = group->get_buffer(0).size;
+    } else {
+        flattened.reserve(group->get_size());
+        for (size_t i = 0; i < group->num_buffers(); ++i) {
+            const char *buffer = static_cast<const char *>(group->get_buffer(i).data);
+            flattened.insert(flattened.end(),
+                             buffer, buffer + group->get_buffer(i).size);
+        }
+        data = flattened.data();
+        size = flattened.size();
+    }
+    guarantee(size != 0
+              && static_cast<uint8_t>(data[0]) == KEY_DICTIONARY_ENCODED_TAG);
+    if (!dictionary->decode(data + 1, size - 1, serialized_out)) {
+        serialized_out->assign(data + 1, data + size);
+    }
+}
+
+ql::datum_t deserialize_stored_datum(const const_buffer_group_t *group,
+                                     const key_dictionary_t *dictionary) {
+    const bool encoded = group->num_buffers() != 0
+        && group->get_buffer(0).size != 0
+        && *static_cast<const uint8_t *>(group->get_buffer(0).data)
+            == KEY_DICTIONARY_ENCODED_TAG;
+
+    ql::datum_t data;
+    if (encoded) {
+        std::vector<char> decoded;
+        decode_stored_datum(group, dictionary, &decoded);
+        buffer_read_stream_t stream(decoded.data(), decoded.size());
+        archive_result_t res = datum_deserialize(&stream, &data);
+        guarantee_deserialization(res, "rdb value");
+    } else {
+        buffer_group_read_stream_t stream(group);
+        archive_result_t res = datum_deserialize(&stream, &data);
+        guarantee_deserialization(res, "rdb value");
+    }
+    return data;
+}
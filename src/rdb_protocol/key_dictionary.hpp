@@ -0,0 +1,121 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_KEY_DICTIONARY_HPP_
+#define RDB_PROTOCOL_KEY_DICTIONARY_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "threading.hpp"
+
+class buf_lock_t;
+class const_buffer_group_t;
+class write_message_t;
+
+/* A table's documents tend to share most of their field names, and in small documents
+the field names often take up more space than the values.  The key dictionary of a
+table assigns ids to the field names that show up most often, and documents are stored
+with the ids in place of those field names.
+
+The dictionary only ever grows.  A field name becomes a candidate the first time a
+write comes across it, and it gets an id once writes have come across it
+KEY_DICTIONARY_PROMOTION_THRESHOLD times.  Promotions happen while the superblock is
+acquired for write, in the same transaction that writes the dictionary to disk (see
+`store_metainfo_manager_t`).  Since a write can only become durable after the writes
+that acquired the superblock before it, a write may refer to all of the ids that
+existed when it acquired the superblock, but not to the ones that were added after
+that (see `key_encoder_t`).
+
+An id is stored as a key that consists of the byte 0xFF followed by the varint encoding
+of the id plus one.  0xFF never shows up in UTF-8, but since we don't check object keys
+for that, keys that start with 0xFF are escaped by prefixing them with 0xFF 0x00.
+Objects that are pseudo-types are stored unchanged, because their fields are checked
+when they're constructed.  A stored document that refers to the dictionary (or that
+has escaped keys) starts with KEY_DICTIONARY_ENCODED_TAG, so that documents that
+don't refer to it can be loaded without looking at their keys. */
+class key_dictionary_t : public home_thread_mixin_debug_only_t {
+public:
+    key_dictionary_t();
+
+    size_t size() const { return names_.size(); }
+
+    // Rewrites the serialized datum `serialized` with the keys that have ids below
+    // `num_ids` replaced with their ids.  Returns false and leaves `*encoded_out`
+    // alone if that doesn't change anything.  Also counts the keys that don't have an
+    // id yet for `promote_hot_keys()`.
+    bool encode(const char *serialized, size_t size, size_t num_ids,
+                std::vector<char> *encoded_out);
+
+    // Inverse of `encode()`.  The result is a serialized datum as well, so the objects
+    // of a decoded document stay backed by a buffer.
+    bool decode(const char *serialized, size_t size,
+                std::vector<char> *decoded_out) const;
+
+    // Returns true if `promote_hot_keys()` would add something to the dictionary.
+    bool has_hot_keys() const { return has_hot_keys_; }
+
+    // Assigns ids to the candidates that have been seen often enough.  Returns true
+    // if the dictionary changed.
+    bool promote_hot_keys();
+
+    // The dictionary is stored in a block of its own.
+    void init_block(buf_lock_t *block) const;
+    void write_to_block(buf_lock_t *block) const;
+    void read_from_block(buf_lock_t *block);
+
+private:
+    void decode_key(const char *key, size_t size, std::string *name_out) const;
+    void add(const std::string &name);
+    void note_candidate(std::string &&name);
+
+    std::vector<std::string> names_;
+    // The encoded form of each name, indexed by id.
+    std::vector<std::string> encoded_names_;
+    std::map<std::string, size_t> ids_;
+
+    // How many writes have come across each name that doesn't have an id yet.
+    std::map<std::string, uint64_t> candidates_;
+    bool has_hot_keys_;
+
+    DISABLE_COPYING(key_dictionary_t);
+};
+
+/* Encodes the documents of a single write with the ids that were in the dictionary
+when the write acquired the superblock.  A default-constructed `key_encoder_t` leaves
+the documents unchanged. */
+class key_encoder_t {
+public:
+    key_encoder_t() : dictionary_(nullptr), num_ids_(0) { }
+    explicit key_encoder_t(key_dictionary_t *dictionary)
+        : dictionary_(dictionary),
+          num_ids_(dictionary == nullptr ? 0 : dictionary->size()) { }
+
+    // `serialized` is a serialized document.  Returns false and leaves
+    // `*encoded_out` alone if the document should be stored as it is.
+    bool encode(const write_message_t &serialized, write_message_t *encoded_out) const;
+
+private:
+    key_dictionary_t *dictionary_;
+    size_t num_ids_;
+};
+
+// The first byte of a stored document that was encoded with a key dictionary.  The
+// type tags of serialized datums are all small positive numbers.
+const uint8_t KEY_DICTIONARY_ENCODED_TAG = 0xFF;
+
+/* Deserializes a stored document, which may have been encoded with `dictionary`.
+`dictionary` may be null if the documents can't refer to a dictionary. */
+ql::datum_t deserialize_stored_datum(const const_buffer_group_t *group,
+                                     const key_dictionary_t *dictionary);
+
+/* Copies a stored document that starts with KEY_DICTIONARY_ENCODED_TAG to
+`serialized_out` as a plain serialized datum, with the field names that the ids stand
+for. */
+void decode_stored_datum(const const_buffer_group_t *group,
+                         const key_dictionary_t *dictionary,
+                         std::vector<char> *serialized_out);
+
+#endif  // RDB_PROTOCOL_KEY_DICTIONARY_HPP_
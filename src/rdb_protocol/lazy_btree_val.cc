@@ -1,35 +1,30 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/lazy_btree_val.hpp"
 
-#include "containers/archive/buffer_group_stream.hpp"
-#include "containers/archive/versioned.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/key_dictionary.hpp"
 
-ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
+ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent,
+                     const key_dictionary_t *key_dictionary) {
     // TODO: Just use deserialize_from_blob?
     rdb_blob_wrapper_t blob(parent.cache()->max_block_size(),
                             const_cast<rdb_value_t *>(value)->value_ref(),
                             blob::btree_maxreflen);
 
-    ql::datum_t data;
-
     blob_acq_t acq_group;
     buffer_group_t buffer_group;
     blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
-    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
-    archive_result_t res
-        = datum_deserialize(&read_stream, &data);
-    guarantee_deserialization(res, "rdb value");
-
-    return data;
+    return deserialize_stored_datum(const_view(&buffer_group), key_dictionary);
 }
 
 const ql::datum_t &lazy_btree_val_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
-        pointee->ptr = get_data(pointee->rdb_value, pointee->parent);
+        pointee->ptr = get_data(pointee->rdb_value, pointee->parent,
+                                pointee->key_dictionary);
         pointee->rdb_value = NULL;
         pointee->parent = buf_parent_t();
+        pointee->key_dictionary = NULL;
     }
     return pointee->ptr;
 }
@@ -6,6 +6,8 @@
 #include "buffer_cache/blob.hpp"
 #include "rdb_protocol/datum.hpp"
 
+class key_dictionary_t;
+
 struct rdb_value_t {
     char contents[1];
 
@@ -27,18 +29,22 @@ public:
     }
 };
 
+// `key_dictionary` is the dictionary that the value may refer to (see
+// `btree_slice_t::key_dictionary`).
 ql::datum_t get_data(const rdb_value_t *value,
-                     buf_parent_t parent);
+                     buf_parent_t parent,
+                     const key_dictionary_t *key_dictionary);
 
 class lazy_btree_val_pointee_t
         : public single_threaded_countable_t<lazy_btree_val_pointee_t> {
-    lazy_btree_val_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
-        : rdb_value(_rdb_value), parent(_parent) {
+    lazy_btree_val_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent,
+                             const key_dictionary_t *_key_dictionary)
+        : rdb_value(_rdb_value), parent(_parent), key_dictionary(_key_dictionary) {
         guarantee(rdb_value != NULL);
     }
 
     explicit lazy_btree_val_pointee_t(const ql::datum_t &_ptr)
-        : ptr(_ptr), rdb_value(NULL), parent() {
+        : ptr(_ptr), rdb_value(NULL), parent(), key_dictionary(NULL) {
         guarantee(ptr.has());
     }
 
@@ -51,6 +57,7 @@ class lazy_btree_val_pointee_t
     // the transaction with which to load it.  Non-NULL only if ptr is empty.
     const rdb_value_t *rdb_value;
     buf_parent_t parent;
+    const key_dictionary_t *key_dictionary;
 
     DISABLE_COPYING(lazy_btree_val_pointee_t);
 };
@@ -60,8 +67,9 @@ public:
     explicit lazy_btree_val_t(const ql::datum_t &ptr)
         : pointee(new lazy_btree_val_pointee_t(ptr)) { }
 
-    lazy_btree_val_t(const rdb_value_t *rdb_value, buf_parent_t parent)
-        : pointee(new lazy_btree_val_pointee_t(rdb_value, parent)) { }
+    lazy_btree_val_t(const rdb_value_t *rdb_value, buf_parent_t parent,
+                     const key_dictionary_t *key_dictionary)
+        : pointee(new lazy_btree_val_pointee_t(rdb_value, parent, key_dictionary)) { }
 
     const ql::datum_t &get() const;
     bool references_parent() const;
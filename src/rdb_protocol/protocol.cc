@@ -11,6 +11,7 @@
 #include "btree/reql_specific.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/pmap.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/disk_backed_queue.hpp"
 #include "rdb_protocol/btree.hpp"
@@ -32,13 +33,24 @@ namespace rdb_protocol {
 void post_construct_and_drain_queue(
         auto_drainer_t::lock_t lock,
         uuid_u sindex_id_to_bring_up_to_date,
+        size_t part,
         key_range_t *construction_range_inout,
         int64_t max_pairs_to_construct,
+        const std::function<void(signal_t *)> &build_sorted,
         store_t *store,
         scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> >
             &&mod_queue)
     THROWS_NOTHING;
 
+void construct_sindex_part(
+        const uuid_u &sindex_to_construct,
+        size_t part,
+        const key_range_t &part_range,
+        const std::function<void(signal_t *)> &build_sorted,
+        store_t *store,
+        auto_drainer_t::lock_t store_keepalive,
+        const std::function<void(const key_range_t &)> &on_progress) THROWS_NOTHING;
+
 /* Creates a queue of operations for the sindex, runs a post construction for
  * the data already in the btree and finally drains the queue. */
 void resume_construct_sindex(
@@ -92,16 +104,95 @@ void resume_construct_sindex(
         return;
     }
 
-    uuid_u post_construct_id = generate_uuid();
-
     /* Secondary indexes are constructed in multiple passes, moving through the primary
     key range from the smallest key to the largest one. In each pass, we handle a
     certain number of primary keys and put the corresponding entries into the secondary
     index. While this happens, we use a queue to keep track of any writes to the range
     we're constructing. We then drain the queue and atomically delete it, before we
-    start the next pass. */
+    start the next pass.
+
+    A single sequence of passes mostly waits for the primary btree to be read from
+    disk, so we split the range into parts with about the same number of keys and give
+    each part its own sequence of passes and its own queue. Until all parts are done,
+    the range that we store for the index only tells which keys might not be
+    constructed yet. The exact ranges that remain go into the store's
+    `sindex_postcon_parts` map. If we get interrupted, the next post construction starts
+    over on the stored range, after clearing it above.
+
+    A new index is built in one go instead, since its range is still the whole key
+    space. See `post_construct_secondary_index_sorted()`. */
+    const bool sorted = construct_range == key_range_t::universe();
+    const std::vector<key_range_t> parts = sorted
+        ? std::vector<key_range_t>(1, construct_range)
+        : progress_estimator.split_range(
+            construct_range, SINDEX_POST_CONSTRUCTION_PARALLELISM);
+    std::function<void(signal_t *)> build_sorted;
+    if (sorted) {
+        build_sorted = [&](signal_t *interruptor) {
+            post_construct_secondary_index_sorted(
+                store,
+                sindex_to_construct,
+                [&](double progress) { current_progress = progress; },
+                progress_estimator,
+                interruptor);
+        };
+    }
+    map_insertion_sentry_t<
+        store_t::sindex_postcon_parts_map_t::key_type,
+        store_t::sindex_postcon_parts_map_t::mapped_type> sindex_postcon_parts_sentry(
+            store->get_sindex_postcon_parts_map(),
+            sindex_to_construct,
+            parts);
+
+    // The progress of every part, as the fraction of the whole table that has been
+    // constructed in it.
+    const double initial_progress = current_progress;
+    std::vector<double> parts_progress(parts.size(), 0.0);
+    pmap(parts.size(), [&](int64_t i) {
+        construct_sindex_part(
+            sindex_to_construct,
+            i,
+            parts[i],
+            build_sorted,
+            store,
+            store_keepalive,
+            [&](const key_range_t &remaining_range) {
+                double progress_end;
+                if (!remaining_range.is_empty()) {
+                    progress_end =
+                        progress_estimator.estimate_progress(remaining_range.left);
+                } else if (!parts[i].right.unbounded) {
+                    progress_end =
+                        progress_estimator.estimate_progress(parts[i].right.key());
+                } else {
+                    progress_end = 1.0;
+                }
+                parts_progress[i] = progress_end
+                    - progress_estimator.estimate_progress(parts[i].left);
+                current_progress = initial_progress;
+                for (double part_progress : parts_progress) {
+                    current_progress += part_progress;
+                }
+            });
+    });
+}
+
+/* Constructs the part `part_range` of the secondary index, which is part number
+`part` of the ones in `store->get_sindex_postcon_parts_map()`. Calls `on_progress`
+with the remaining range after every pass. See `post_construct_and_drain_queue()` for
+`build_sorted`. */
+void construct_sindex_part(
+        const uuid_u &sindex_to_construct,
+        size_t part,
+        const key_range_t &part_range,
+        const std::function<void(signal_t *)> &build_sorted,
+        store_t *store,
+        auto_drainer_t::lock_t store_keepalive,
+        const std::function<void(const key_range_t &)> &on_progress) THROWS_NOTHING {
+    uuid_u post_construct_id = generate_uuid();
+
     const int64_t PAIRS_TO_CONSTRUCT_PER_PASS = 512;
-    key_range_t remaining_range = construct_range;
+    key_range_t remaining_range = part_range;
     while (!remaining_range.is_empty()) {
         scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> > mod_queue;
         {
@@ -162,24 +253,28 @@ void resume_construct_sindex(
         post_construct_and_drain_queue(
             store_keepalive,
             sindex_to_construct,
+            part,
             &remaining_range,
             PAIRS_TO_CONSTRUCT_PER_PASS,
+            build_sorted,
             store,
             std::move(mod_queue));
 
-        // Update the progress value
-        current_progress = progress_estimator.estimate_progress(remaining_range.left);
+        on_progress(remaining_range);
     }
 }
 
 /* This function is used by resume_construct_sindex. It traverses the primary btree
-and creates entries in the given secondary index. It then applies outstanding changes
-from the mod_queue and deregisters it. */
+and creates entries in the given secondary index, or has `build_sorted` construct all
+of it if that's set. It then applies outstanding changes from the mod_queue and
+deregisters it. */
 void post_construct_and_drain_queue(
         auto_drainer_t::lock_t lock,
         uuid_u sindex_id_to_bring_up_to_date,
+        size_t part,
         key_range_t *construction_range_inout,
         int64_t max_pairs_to_construct,
+        const std::function<void(signal_t *)> &build_sorted,
         store_t *store,
         scoped_ptr_t<disk_backed_queue_wrapper_t<rdb_modification_report_t> >
             &&mod_queue)
@@ -193,23 +288,34 @@ void post_construct_and_drain_queue(
     sindexes_to_bring_up_to_date.insert(sindex_id_to_bring_up_to_date);
 
     try {
-        const size_t MOD_QUEUE_SIZE_LIMIT = 16;
-        // This constructs a part of the index and updates `construction_range_inout`
-        // to the range that's still remaining.
-        post_construct_secondary_index_range(
-            store,
-            sindexes_to_bring_up_to_date,
-            construction_range_inout,
-            // Abort if the mod_queue gets larger than the `MOD_QUEUE_SIZE_LIMIT`, or
-            // we've constructed `max_pairs_to_construct` pairs.
-            [&](int64_t pairs_constructed) {
-                return pairs_constructed >= max_pairs_to_construct
-                    || mod_queue->size() > MOD_QUEUE_SIZE_LIMIT;
-            },
-            lock.get_drain_signal());
-
-        // Drain the queue.
-        {
+        if (build_sorted) {
+            // This constructs all of the index.
+            build_sorted(lock.get_drain_signal());
+            *construction_range_inout = key_range_t::empty();
+        } else {
+            const size_t MOD_QUEUE_SIZE_LIMIT = 16;
+            // This constructs a part of the index and updates `construction_range_inout`
+            // to the range that's still remaining.
+            post_construct_secondary_index_range(
+                store,
+                sindexes_to_bring_up_to_date,
+                construction_range_inout,
+                // Abort if the mod_queue gets larger than the `MOD_QUEUE_SIZE_LIMIT`, or
+                // we've constructed `max_pairs_to_construct` pairs.
+                [&](int64_t pairs_constructed) {
+                    return pairs_constructed >= max_pairs_to_construct
+                        || mod_queue->size() > MOD_QUEUE_SIZE_LIMIT;
+                },
+                lock.get_drain_signal());
+        }
+
+        // Drain the queue. Usually it's short, but after a sorted build it holds the
+        // writes from the whole build. Applying those while we hold the sindex block
+        // would block writes to the table for a long time, so we apply them in
+        // batches with a transaction each, until the rest fits into the last batch.
+        // That one also marks the index and deregisters the queue.
+        const size_t MOD_QUEUE_DRAIN_BATCH_SIZE = 1024;
+        for (;;) {
             write_token_t token;
             store->new_write_token(&token);
 
@@ -223,7 +329,7 @@ void post_construct_and_drain_queue(
             // Other than that, the hard durability guarantee is not actually
             // needed here.
             store->acquire_superblock_for_write(
-                2 + mod_queue->size(),
+                2 + std::min(mod_queue->size(), MOD_QUEUE_DRAIN_BATCH_SIZE),
                 write_durability_t::HARD,
                 &token,
                 &queue_txn,
@@ -266,7 +372,11 @@ void post_construct_and_drain_queue(
                 store->get_in_line_for_sindex_queue(&queue_sindex_block);
             acq.acq_signal()->wait_lazily_unordered();
 
-            while (mod_queue->size() > 0) {
+            const bool last_batch = mod_queue->size() <= MOD_QUEUE_DRAIN_BATCH_SIZE;
+            for (size_t applied = 0;
+                 mod_queue->size() > 0
+                     && (last_batch || applied < MOD_QUEUE_DRAIN_BATCH_SIZE);
+                 ++applied) {
                 if (lock.get_drain_signal()->is_pulsed()) {
                     throw interrupted_exc_t();
                 }
@@ -309,11 +419,16 @@ void post_construct_and_drain_queue(
                 }
             }
 
+            if (!last_batch) {
+                continue;
+            }
+
             // Mark parts of the index up to date (except for what remains in
-            // `construction_range_inout`).
-            store->mark_index_up_to_date(sindex_id_to_bring_up_to_date,
-                                         &queue_sindex_block,
-                                         *construction_range_inout);
+            // `construction_range_inout`, and in the other parts).
+            store->mark_index_part_up_to_date(sindex_id_to_bring_up_to_date,
+                                              &queue_sindex_block,
+                                              part,
+                                              *construction_range_inout);
             store->deregister_sindex_queue(mod_queue.get(), &acq);
             return;
         }
@@ -450,6 +565,10 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
         return s.region;
     }
 
+    region_t operator()(const changefeed_aggregate_subscribe_t &s) const {
+        return s.region;
+    }
+
     region_t operator()(const changefeed_stamp_t &t) const {
         return t.region;
     }
@@ -523,6 +642,15 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return do_read;
     }
 
+    bool operator()(const changefeed_aggregate_subscribe_t &s) const {
+        bool do_read = rangey_read(s);
+        if (do_read) {
+            auto *out = boost::get<changefeed_aggregate_subscribe_t>(payload_out);
+            out->current_shard = region;
+        }
+        return do_read;
+    }
+
     bool operator()(const changefeed_stamp_t &t) const {
         return rangey_read(t);
     }
@@ -685,6 +813,7 @@ public:
     void operator()(const distribution_read_t &rg);
     void operator()(const changefeed_subscribe_t &);
     void operator()(const changefeed_limit_subscribe_t &);
+    void operator()(const changefeed_aggregate_subscribe_t &);
     void operator()(const changefeed_stamp_t &);
     void operator()(const changefeed_point_stamp_t &);
     void operator()(const dummy_read_t &);
@@ -693,6 +822,8 @@ private:
     // Shared by rget_read_t and intersecting_geo_read_t operators
     template<class query_response_t, class query_t>
     void unshard_range_batch(const query_t &q, sorting_t sorting);
+    // Shared by the limit and aggregate changefeed subscriptions
+    void unshard_limit_subscribe();
 
     const profile_bool_t profile;
     read_response_t *const responses; // Cannibalized for efficiency.
@@ -711,6 +842,8 @@ void rdb_r_unshard_visitor_t::operator()(const changefeed_subscribe_t &) {
         for (auto it = res->addrs.begin(); it != res->addrs.end(); ++it) {
             out->addrs.insert(std::move(*it));
         }
+        out->filter_stop_addrs.insert(res->filter_stop_addrs.begin(),
+                                      res->filter_stop_addrs.end());
         for (auto it = res->server_uuids.begin();
              it != res->server_uuids.end(); ++it) {
             out->server_uuids.insert(std::move(*it));
@@ -719,6 +852,14 @@ void rdb_r_unshard_visitor_t::operator()(const changefeed_subscribe_t &) {
 }
 
 void rdb_r_unshard_visitor_t::operator()(const changefeed_limit_subscribe_t &) {
+    unshard_limit_subscribe();
+}
+
+void rdb_r_unshard_visitor_t::operator()(const changefeed_aggregate_subscribe_t &) {
+    unshard_limit_subscribe();
+}
+
+void rdb_r_unshard_visitor_t::unshard_limit_subscribe() {
     int64_t shards = 0;
     std::vector<ql::changefeed::server_t::limit_addr_t> limit_addrs;
     for (size_t i = 0; i < count; ++i) {
@@ -1050,6 +1191,11 @@ struct use_snapshot_visitor_t : public boost::static_visitor<bool> {
         return !static_cast<bool>(geo_read.stamp);
     }
 
+    // Same for aggregate changefeeds, which read all of their range.
+    bool operator()(const changefeed_aggregate_subscribe_t &) const {
+        return false;
+    }
+
     bool operator()(const nearest_geo_read_t &) const {           return true;  }
     bool operator()(const changefeed_subscribe_t &) const {       return false; }
     bool operator()(const changefeed_limit_subscribe_t &) const { return false; }
@@ -1078,6 +1224,9 @@ struct route_to_primary_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const nearest_geo_read_t &) const {           return false; }
     bool operator()(const changefeed_subscribe_t &) const {       return true;  }
     bool operator()(const changefeed_limit_subscribe_t &) const { return true;  }
+    bool operator()(const changefeed_aggregate_subscribe_t &) const {
+        return true;
+    }
     bool operator()(const changefeed_stamp_t &) const {           return true;  }
     bool operator()(const changefeed_point_stamp_t &) const {     return true;  }
     bool operator()(const distribution_read_t &) const {          return false; }
@@ -1437,8 +1586,8 @@ RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
     rget_read_response_t, stamp_response, result, reql_version);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(nearest_geo_read_response_t, results_or_error);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(distribution_read_response_t, region, key_counts);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
-    changefeed_subscribe_response_t, server_uuids, addrs);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
+    changefeed_subscribe_response_t, server_uuids, addrs, filter_stop_addrs);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_limit_subscribe_response_t, shards, limit_addrs);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
@@ -1506,7 +1655,8 @@ RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
         distribution_read_t, max_depth, result_limit, region);
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_subscribe_t, addr, shard_region);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
+    changefeed_subscribe_t, addr, filter_update, shard_region);
 RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
     changefeed_limit_subscribe_t,
     addr,
@@ -1517,6 +1667,16 @@ RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
     m_user_context,
     region,
     current_shard);
+RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
+    changefeed_aggregate_subscribe_t,
+    addr,
+    uuid,
+    spec,
+    table,
+    optargs,
+    m_user_context,
+    region,
+    current_shard);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_stamp_t, addr, region);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_point_stamp_t, addr, key);
 
@@ -169,6 +169,7 @@ struct changefeed_subscribe_response_t {
     changefeed_subscribe_response_t() { }
     std::set<uuid_u> server_uuids;
     std::set<ql::changefeed::server_t::addr_t> addrs;
+    std::set<ql::changefeed::server_t::filter_stop_addr_t> filter_stop_addrs;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_subscribe_response_t);
 
@@ -437,7 +438,15 @@ struct changefeed_subscribe_t {
     changefeed_subscribe_t() { }
     explicit changefeed_subscribe_t(ql::changefeed::client_t::addr_t _addr)
         : addr(_addr), shard_region(region_t::universe()) { }
+    changefeed_subscribe_t(ql::changefeed::client_t::addr_t _addr,
+                           ql::changefeed::filter_update_t _filter_update)
+        : addr(_addr),
+          filter_update(std::move(_filter_update)),
+          shard_region(region_t::universe()) { }
     ql::changefeed::client_t::addr_t addr;
+    // If this is set, the client has already subscribed and is only telling the
+    // servers which changes it's interested in.
+    boost::optional<ql::changefeed::filter_update_t> filter_update;
     region_t shard_region;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_subscribe_t);
@@ -470,6 +479,36 @@ struct changefeed_limit_subscribe_t {
 };
 RDB_DECLARE_SERIALIZABLE(changefeed_limit_subscribe_t);
 
+// Responded to with a `changefeed_limit_subscribe_response_t`, since aggregate
+// changefeeds are stopped through the same mailbox as limit changefeeds.
+struct changefeed_aggregate_subscribe_t {
+    changefeed_aggregate_subscribe_t() { }
+    explicit changefeed_aggregate_subscribe_t(
+        ql::changefeed::client_t::addr_t _addr,
+        uuid_u _uuid,
+        ql::changefeed::keyspec_t::aggregate_t _spec,
+        std::string _table,
+        ql::global_optargs_t _optargs,
+        auth::user_context_t user_context,
+        region_t pkey_region)
+        : addr(std::move(_addr)),
+          uuid(std::move(_uuid)),
+          spec(std::move(_spec)),
+          table(std::move(_table)),
+          optargs(std::move(_optargs)),
+          m_user_context(std::move(user_context)),
+          region(std::move(pkey_region)) { }
+    ql::changefeed::client_t::addr_t addr;
+    uuid_u uuid;
+    ql::changefeed::keyspec_t::aggregate_t spec;
+    std::string table;
+    ql::global_optargs_t optargs;
+    auth::user_context_t m_user_context;
+    region_t region;
+    boost::optional<region_t> current_shard;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_aggregate_subscribe_t);
+
 // This is a separate class because it needs to shard and unshard differently.
 struct changefeed_point_stamp_t {
     ql::changefeed::client_t::addr_t addr;
@@ -487,7 +526,8 @@ struct read_t {
                            changefeed_limit_subscribe_t,
                            changefeed_point_stamp_t,
                            distribution_read_t,
-                           dummy_read_t> variant_t;
+                           dummy_read_t,
+                           changefeed_aggregate_subscribe_t> variant_t;
 
     variant_t read;
     profile_bool_t profile;
@@ -17,6 +17,7 @@ query_cache_t::query_cache_t(
         client_addr_port(_client_addr_port),
         return_empty_normal_batches(_return_empty_normal_batches),
         user_context(std::move(_user_context)),
+        plan_cache(_rdb_ctx),
         next_query_id(0),
         oldest_outstanding_query_id(0) {
     auto res = rdb_ctx->get_query_caches_for_this_thread()->insert(this);
@@ -47,13 +48,13 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(query_params_t *query_p
     }
 
     global_optargs_t global_optargs;
-    counted_t<const term_t> term_tree;
+    counted_t<const query_plan_t> plan;
+    std::vector<datum_t> plan_params;
     try {
         query_params->term_storage->preprocess();
         global_optargs = query_params->term_storage->global_optargs();
 
-        compile_env_t compile_env((var_visibility_t()));
-        term_tree = compile_term(&compile_env, query_params->term_storage->root_term());
+        plan = plan_cache.compile(&query_params->term_storage, &plan_params);
 
     } catch (const exc_t &e) {
         throw bt_exc_t(Response::COMPILE_ERROR,
@@ -68,7 +69,8 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(query_params_t *query_p
     }
     scoped_ptr_t<entry_t> entry(new entry_t(query_params,
                                             std::move(global_optargs),
-                                            std::move(term_tree)));
+                                            std::move(plan),
+                                            std::move(plan_params)));
 
     scoped_ptr_t<ref_t> ref(new ref_t(this,
                                       query_params->token,
@@ -204,6 +206,7 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
             entry->global_optargs,
             query_cache->get_user_context(),
             trace.get_or_null());
+        env.set_plan_params(&entry->plan_params);
 
         if (entry->state == entry_t::state_t::START) {
             run(&env, res);
@@ -251,13 +254,13 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(ex));
+                       entry->get_term_storage()->backtrace_registry().datum_backtrace(ex));
     } catch (const datum_exc_t &ex) {
         query_cache->terminate_internal(entry);
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(
+                       entry->get_term_storage()->backtrace_registry().datum_backtrace(
                             backtrace_id_t::empty(), 0));
     } catch (const std::exception &ex) {
         query_cache->terminate_internal(entry);
@@ -357,7 +360,8 @@ void query_cache_t::ref_t::serve(env_t *env, response_t *res) {
 
 query_cache_t::entry_t::entry_t(query_params_t *query_params,
                                 global_optargs_t &&_global_optargs,
-                                counted_t<const term_t> &&_term_tree) :
+                                counted_t<const query_plan_t> &&_plan,
+                                std::vector<datum_t> &&_plan_params) :
         state(state_t::START),
         interrupt_reason(interrupt_reason_t::UNKNOWN),
         job_id(generate_uuid()),
@@ -365,11 +369,17 @@ query_cache_t::entry_t::entry_t(query_params_t *query_params,
         profile(query_params->profile ? profile_bool_t::PROFILE :
                                         profile_bool_t::DONT_PROFILE),
         term_storage(std::move(query_params->term_storage)),
+        plan(std::move(_plan)),
+        plan_params(std::move(_plan_params)),
         global_optargs(std::move(_global_optargs)),
         start_time(current_microtime()),
-        term_tree(std::move(_term_tree)),
+        term_tree(plan->term_tree),
         has_sent_batch(false) { }
 
 query_cache_t::entry_t::~entry_t() { }
 
+const term_storage_t *query_cache_t::entry_t::get_term_storage() const {
+    return term_storage.has() ? term_storage.get() : plan->term_storage.get();
+}
+
 } // namespace ql
@@ -26,6 +26,7 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/ql2.pb.h"
 #include "rdb_protocol/query_params.hpp"
+#include "rdb_protocol/query_plan_cache.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/term_storage.hpp"
 #include "rdb_protocol/wire_func.hpp"
@@ -106,7 +107,8 @@ private:
     public:
         entry_t(query_params_t *query_params,
                 global_optargs_t &&_global_optargs,
-                counted_t<const term_t> &&_term_tree);
+                counted_t<const query_plan_t> &&_plan,
+                std::vector<datum_t> &&_plan_params);
         ~entry_t();
 
         enum class state_t { START, STREAM, DONE, DELETING } state;
@@ -115,7 +117,13 @@ private:
         const uuid_u job_id;
         const bool noreply;
         const profile_bool_t profile;
+        // The query as it was received from the client.  Queries of the same shape
+        // share a plan, which owns the term storage of the first one of them.
+        const term_storage_t *get_term_storage() const;
+
         const scoped_ptr_t<const term_storage_t> term_storage;
+        const counted_t<const query_plan_t> plan;
+        const std::vector<datum_t> plan_params;
         const global_optargs_t global_optargs;
         const microtime_t start_time;
 
@@ -145,6 +153,7 @@ private:
     return_empty_normal_batches_t return_empty_normal_batches;
     auth::user_context_t user_context;
     std::map<int64_t, scoped_ptr_t<entry_t> > queries;
+    query_plan_cache_t plan_cache;
 
     // Used for noreply waiting, this contains all allocated-but-incomplete query ids
     friend class query_params_t::query_id_t;
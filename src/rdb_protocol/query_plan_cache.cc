@@ -0,0 +1,198 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_plan_cache.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/env.hpp"
+
+namespace ql {
+
+// The number of query shapes whose plans a connection keeps around.
+const size_t QUERY_PLAN_CACHE_SIZE = 64;
+
+// Big queries are usually one-off writes of a lot of data, and the key of their
+// shape would be about as expensive to build as the plan, so we don't cache them.
+const size_t MAX_CACHED_PLAN_TERMS = 256;
+
+// A cached plan keeps its whole query alive, including the literals that it doesn't
+// use, so we don't cache the plans of queries that take up more memory than this.
+const size_t MAX_CACHED_PLAN_QUERY_SIZE = 16 * KILOBYTE;
+
+const size_t MIN_SHAPE_STACK_SPACE = 16 * KILOBYTE;
+
+// Whether the `index`th argument of a term of type `type` is only ever looked at by
+// evaluating it, so that a literal in it can be bound at run time.
+bool arg_is_bindable(Term::TermType type, size_t index) {
+    // We switch on an `int` because there are far too many term types to list.
+    switch (static_cast<int>(type)) {
+    case Term::MAKE_ARRAY:
+    case Term::DB:
+    case Term::TABLE:
+    case Term::GET:
+    case Term::GET_ALL:
+    case Term::BETWEEN:
+    case Term::INSERT:
+    case Term::DELETE:
+    case Term::LIMIT:
+    case Term::SKIP:
+    case Term::EQ:
+    case Term::NE:
+    case Term::LT:
+    case Term::LE:
+    case Term::GT:
+    case Term::GE:
+    case Term::NOT:
+    case Term::AND:
+    case Term::OR:
+    case Term::ADD:
+    case Term::SUB:
+    case Term::MUL:
+    case Term::DIV:
+        return true;
+    // The other arguments of these terms may be copied into functions.
+    case Term::BRACKET:
+    case Term::GET_FIELD:
+    case Term::PLUCK:
+    case Term::UPDATE:
+    case Term::REPLACE:
+        return index == 0;
+    default:
+        return false;
+    }
+}
+
+// Builds the cache key of a query's shape, and collects the literals that are bound
+// at run time along the way.
+class plan_shape_t {
+public:
+    plan_shape_t() : writer(buffer), num_terms(0) { }
+
+    // Returns false if the query shouldn't be cached.
+    bool add_term(const raw_term_t &term, bool bindable) {
+        if (++num_terms > MAX_CACHED_PLAN_TERMS) {
+            return false;
+        }
+        term_variant_t src = term.get_src();
+        const rapidjson::Value *const *json = boost::get<const rapidjson::Value *>(&src);
+        if (json == nullptr) {
+            return false;
+        }
+
+        if (term.type() == Term::DATUM) {
+            // A preprocessed datum term is `[DATUM, <value>, <backtrace>]`.  Arrays
+            // are walked as arguments by the preprocessing, so they don't count as
+            // a single literal.
+            if (bindable && (*json)->Size() == 3 && !(**json)[1].IsArray()) {
+                // Terms are written as arrays, so a string is unambiguous.
+                writer.String(rapidjson_typestr((**json)[1].GetType()));
+                params.push_back(*json);
+            } else {
+                (*json)->Accept(writer);
+            }
+            return true;
+        }
+
+        bool ok = true;
+        writer.StartArray();
+        writer.Int(term.type());
+        writer.StartArray();
+        for (size_t i = 0; ok && i < term.num_args(); ++i) {
+            call_with_enough_stack([&]() {
+                    ok = add_term(term.arg(i),
+                                  bindable && arg_is_bindable(term.type(), i));
+                }, MIN_SHAPE_STACK_SPACE);
+        }
+        writer.EndArray();
+        writer.StartObject();
+        term.each_optarg([&](const raw_term_t &optarg, const std::string &name) {
+                if (!ok) {
+                    return;
+                }
+                writer.Key(name.c_str(), name.size(), true);
+                // The fields of an object are the only optargs that are evaluated
+                // like arguments.
+                call_with_enough_stack([&]() {
+                        ok = add_term(optarg, bindable && term.type() == Term::MAKE_OBJ);
+                    }, MIN_SHAPE_STACK_SPACE);
+            });
+        if (!ok) {
+            return false;
+        }
+        writer.EndObject();
+        writer.EndArray();
+        return true;
+    }
+
+    std::string key() const {
+        return std::string(buffer.GetString(), buffer.GetSize());
+    }
+
+    // The datum terms to take the parameters of the plan from, in the order they
+    // appear in the query.
+    std::vector<const rapidjson::Value *> params;
+
+private:
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer;
+    size_t num_terms;
+
+    DISABLE_COPYING(plan_shape_t);
+};
+
+query_plan_t::query_plan_t(scoped_ptr_t<term_storage_t> &&_term_storage,
+                           counted_t<const term_t> &&_term_tree) :
+    term_storage(std::move(_term_storage)),
+    term_tree(std::move(_term_tree)) { }
+
+query_plan_cache_t::query_plan_cache_t(rdb_context_t *_rdb_ctx) :
+    rdb_ctx(_rdb_ctx),
+    plans(QUERY_PLAN_CACHE_SIZE) { }
+
+counted_t<const query_plan_t> query_plan_cache_t::compile(
+        scoped_ptr_t<term_storage_t> *term_storage,
+        std::vector<datum_t> *params_out) {
+    const raw_term_t root = (*term_storage)->root_term();
+    params_out->clear();
+
+    plan_shape_t shape;
+    if ((*term_storage)->memory_usage() > MAX_CACHED_PLAN_QUERY_SIZE
+        || !shape.add_term(root, true)) {
+        compile_env_t compile_env((var_visibility_t()));
+        counted_t<const term_t> term_tree = compile_term(&compile_env, root);
+        return make_counted<query_plan_t>(std::move(*term_storage),
+                                          std::move(term_tree));
+    }
+
+    params_out->reserve(shape.params.size());
+    for (const rapidjson::Value *param : shape.params) {
+        params_out->push_back(raw_term_t(param).datum(configured_limits_t::unlimited,
+                                                      reql_version_t::LATEST));
+    }
+
+    const std::string key = shape.key();
+    auto it = plans.find(key);
+    if (it != plans.end()) {
+        if (rdb_ctx != nullptr) {
+            ++rdb_ctx->stats.query_plan_cache_hits;
+        }
+        return it->second;
+    }
+    if (rdb_ctx != nullptr) {
+        ++rdb_ctx->stats.query_plan_cache_misses;
+    }
+
+    plan_param_indexes_t param_indexes;
+    for (size_t i = 0; i < shape.params.size(); ++i) {
+        param_indexes.insert(std::make_pair(shape.params[i], i));
+    }
+    compile_env_t compile_env(var_visibility_t(), &param_indexes);
+    counted_t<const term_t> term_tree = compile_term(&compile_env, root);
+    counted_t<const query_plan_t> plan =
+        make_counted<query_plan_t>(std::move(*term_storage), std::move(term_tree));
+    plans[key] = plan;
+    return plan;
+}
+
+}  // namespace ql
@@ -0,0 +1,67 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_PLAN_CACHE_HPP_
+#define RDB_PROTOCOL_QUERY_PLAN_CACHE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "containers/lru_cache.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/term.hpp"
+#include "rdb_protocol/term_storage.hpp"
+
+class rdb_context_t;
+
+namespace ql {
+
+// A compiled term tree, along with the query it was compiled from.  The terms of the
+// tree point into that query, so it has to stay alive as long as the tree does.
+class query_plan_t : public single_threaded_countable_t<query_plan_t> {
+public:
+    query_plan_t(scoped_ptr_t<term_storage_t> &&_term_storage,
+                 counted_t<const term_t> &&_term_tree);
+
+    const scoped_ptr_t<const term_storage_t> term_storage;
+    const counted_t<const term_t> term_tree;
+
+private:
+    DISABLE_COPYING(query_plan_t);
+};
+
+/* Clients tend to send the same few queries over and over, differing only in some
+of their literal values, e.g. `r.table('users').get(<id>)`.  The plan cache keeps the
+compiled term trees of the most recently used query shapes of a connection around,
+so that such a query can reuse the tree instead of compiling its own.
+
+The shape of a query is its preprocessed term tree with the literal values that are
+bound at run time replaced by placeholders.  A literal is only turned into a
+parameter if nothing can look at its raw value before the query is evaluated.  That
+rules out literals in functions (which are serialized and sent to the shards as
+they were written), in optargs, and in the arguments of most terms that aren't
+plain arithmetic, comparisons, constructors or single-row writes -- see
+`arg_is_bindable`.  All other literals are part of the shape, so queries that only
+differ in them don't share a plan.  Backtrace ids are assigned by walking the term
+tree, so queries of the same shape also have the same backtrace registry. */
+class query_plan_cache_t {
+public:
+    explicit query_plan_cache_t(rdb_context_t *_rdb_ctx);
+
+    // Compiles the root term of the preprocessed `*term_storage`, or reuses the plan
+    // of an earlier query of the same shape.  The values to evaluate the plan with
+    // are stored in `*params_out`.  If a new plan is compiled, it takes over
+    // `*term_storage`.  Throws the usual compilation errors.
+    counted_t<const query_plan_t> compile(scoped_ptr_t<term_storage_t> *term_storage,
+                                          std::vector<datum_t> *params_out);
+
+private:
+    rdb_context_t *const rdb_ctx;
+    lru_cache_t<std::string, counted_t<const query_plan_t> > plans;
+
+    DISABLE_COPYING(query_plan_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_PLAN_CACHE_HPP_
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/serialize_datum.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <limits>
@@ -10,6 +11,8 @@
 #include "arch/runtime/coroutines.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "containers/archive/versioned.hpp"
 #include "containers/counted.hpp"
 #include "containers/shared_buffer.hpp"
@@ -866,6 +869,28 @@ std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
     return std::make_pair(std::move(key), std::move(value));
 }
 
+/* An object field is stored as its key (a `datum_string_t`, i.e. a varint size
+followed by the characters) directly followed by its value. */
+int datum_compare_key_in_buf(const shared_buf_ref_t<char> &buf, size_t at_offset,
+                             const datum_string_t &key) {
+    return key.compare(datum_string_t(buf.make_child(at_offset)));
+}
+
+datum_t datum_deserialize_pair_value_from_buf(
+        const shared_buf_ref_t<char> &buf, size_t at_offset) {
+    buf.guarantee_in_boundary(at_offset);
+    buffer_read_stream_t read_stream(buf.get() + at_offset,
+                                     buf.get_safety_boundary() - at_offset);
+    uint64_t key_size;
+    guarantee_deserialization(deserialize_varint_uint64(&read_stream, &key_size),
+                              "object key size");
+    guarantee(key_size <= std::numeric_limits<size_t>::max());
+    return datum_deserialize_from_buf(
+        buf,
+        at_offset + static_cast<size_t>(read_stream.tell())
+        + static_cast<size_t>(key_size));
+}
+
 /* The format of `array` is:
      varint ser_size
      varint num_elements
@@ -1006,4 +1031,243 @@ MUST_USE archive_result_t datum_deserialize(
     return archive_result_t::SUCCESS;
 }
 
+/* Returns the size of the serialized datum (including its type tag) at `in`. */
+static size_t datum_serialized_size_in_buf(const char *in, size_t in_size) {
+    buffer_read_stream_t s(in, in_size);
+    datum_serialized_type_t type = datum_serialized_type_t::R_NULL;
+    guarantee_deserialization(datum_deserialize(&s, &type), "datum type");
+    uint64_t data_size = 0;
+    switch (type) {
+    case datum_serialized_type_t::R_NULL: // fallthru
+    case datum_serialized_type_t::MINVAL: // fallthru
+    case datum_serialized_type_t::MAXVAL: // fallthru
+    case datum_serialized_type_t::UNINITIALIZED:
+        break;
+    case datum_serialized_type_t::R_BOOL:
+        data_size = serialize_universal_size_t<bool>::value;
+        break;
+    case datum_serialized_type_t::DOUBLE:
+        data_size = serialize_universal_size_t<double>::value;
+        break;
+    case datum_serialized_type_t::INT_NEGATIVE: // fallthru
+    case datum_serialized_type_t::INT_POSITIVE: {
+        uint64_t value;
+        guarantee_deserialization(deserialize_varint_uint64(&s, &value),
+                                  "datum integer");
+    } break;
+    case datum_serialized_type_t::R_STR: // fallthru
+    case datum_serialized_type_t::R_BINARY: // fallthru
+    case datum_serialized_type_t::BUF_R_ARRAY: // fallthru
+    case datum_serialized_type_t::BUF_R_OBJECT:
+        guarantee_deserialization(deserialize_varint_uint64(&s, &data_size),
+                                  "datum size");
+        break;
+    case datum_serialized_type_t::R_ARRAY: // fallthru
+    case datum_serialized_type_t::R_OBJECT:
+        // Nothing has written these since before arrays and objects got offset
+        // tables.
+        crash("Unexpected legacy array or object in a datum buffer.");
+    default:
+        unreachable();
+    }
+    const size_t header_size = static_cast<size_t>(s.tell());
+    guarantee(data_size <= in_size - header_size, "Corrupted datum buffer.");
+    return header_size + static_cast<size_t>(data_size);
+}
+
+static size_t serialized_offset_size(datum_offset_size_t offset_size) {
+    switch (offset_size) {
+    case datum_offset_size_t::U8BIT: return serialize_universal_size_t<uint8_t>::value;
+    case datum_offset_size_t::U16BIT: return serialize_universal_size_t<uint16_t>::value;
+    case datum_offset_size_t::U32BIT: return serialize_universal_size_t<uint32_t>::value;
+    case datum_offset_size_t::U64BIT: return serialize_universal_size_t<uint64_t>::value;
+    default: unreachable();
+    }
+}
+
+static void append_varint(uint64_t value, std::vector<char> *out) {
+    uint8_t buf[10];
+    rassert(varint_uint64_serialized_size(value) <= sizeof(buf));
+    const size_t size = serialize_varint_uint64_into_buf(value, buf);
+    out->insert(out->end(), buf, buf + size);
+}
+
+// An element of an array, or a field of an object, in `datum_rename_keys_in_buf`.
+struct renamed_element_t {
+    const char *key_data() const {
+        return key_renamed
+            ? new_key.data()
+            : serialized_key + serialized_key_size - key_size;
+    }
+    size_t final_key_size() const {
+        return key_renamed ? new_key.size() : key_size;
+    }
+    size_t final_serialized_key_size() const {
+        return key_renamed
+            ? varint_uint64_serialized_size(new_key.size()) + new_key.size()
+            : serialized_key_size;
+    }
+    size_t final_value_size() const {
+        return value_renamed ? new_value.size() : value_size;
+    }
+
+    // Objects only.  The key as it is serialized, that is with its size in front.
+    const char *serialized_key;
+    size_t serialized_key_size;
+    size_t key_size;
+    bool key_renamed;
+    std::string new_key;
+
+    const char *value;
+    size_t value_size;
+    bool value_renamed;
+    std::vector<char> new_value;
+};
+
+// Keep in sync with datum_object_serialize and datum_array_serialize.
+bool datum_rename_keys_in_buf(const char *in, size_t in_size,
+                              const datum_key_renamer_t &rename_key,
+                              std::vector<char> *out) {
+    buffer_read_stream_t s(in, in_size);
+    datum_serialized_type_t type = datum_serialized_type_t::R_NULL;
+    guarantee_deserialization(datum_deserialize(&s, &type), "datum type");
+    if (type != datum_serialized_type_t::BUF_R_ARRAY
+        && type != datum_serialized_type_t::BUF_R_OBJECT) {
+        return false;
+    }
+    const bool is_object = type == datum_serialized_type_t::BUF_R_OBJECT;
+
+    uint64_t inner_size;
+    guarantee_deserialization(deserialize_varint_uint64(&s, &inner_size), "datum size");
+    const size_t inner_start = static_cast<size_t>(s.tell());
+    guarantee(inner_size <= in_size - inner_start, "Corrupted datum buffer.");
+    const size_t inner_end = inner_start + static_cast<size_t>(inner_size);
+    uint64_t num_elements;
+    guarantee_deserialization(deserialize_varint_uint64(&s, &num_elements),
+                              "datum number of elements");
+    guarantee(num_elements <= inner_size, "Corrupted datum buffer.");
+
+    // We skip the offset table, since we go through all the elements in order.
+    size_t pos = static_cast<size_t>(s.tell());
+    if (num_elements > 1) {
+        pos += (num_elements - 1)
+            * serialized_offset_size(get_offset_size_from_inner_size(inner_size));
+    }
+
+    std::vector<renamed_element_t> elements(static_cast<size_t>(num_elements));
+    for (renamed_element_t &element : elements) {
+        guarantee(pos <= inner_end, "Corrupted datum buffer.");
+        if (is_object) {
+            buffer_read_stream_t key_stream(in + pos, inner_end - pos);
+            uint64_t raw_key_size;
+            guarantee_deserialization(
+                deserialize_varint_uint64(&key_stream, &raw_key_size), "object key");
+            const size_t key_data_offset = static_cast<size_t>(key_stream.tell());
+            guarantee(raw_key_size <= inner_end - pos - key_data_offset,
+                      "Corrupted datum buffer.");
+            element.serialized_key = in + pos;
+            element.key_size = static_cast<size_t>(raw_key_size);
+            element.serialized_key_size = key_data_offset + element.key_size;
+            // The fields of pseudo-types are checked when they are constructed, so
+            // they don't get renamed.
+            const datum_string_t &reql_type = datum_t::reql_type_string;
+            if (element.key_size == reql_type.size()
+                && memcmp(in + pos + key_data_offset, reql_type.data(),
+                          reql_type.size()) == 0) {
+                return false;
+            }
+            pos += element.serialized_key_size;
+        } else {
+            element.serialized_key = nullptr;
+            element.serialized_key_size = element.key_size = 0;
+        }
+        element.key_renamed = false;
+        element.value = in + pos;
+        element.value_size = datum_serialized_size_in_buf(in + pos, inner_end - pos);
+        pos += element.value_size;
+    }
+    guarantee(pos == inner_end, "Corrupted datum buffer.");
+
+    bool changed = false;
+    for (renamed_element_t &element : elements) {
+        if (is_object) {
+            element.key_renamed = rename_key(element.key_data(), element.key_size,
+                                             &element.new_key);
+            changed |= element.key_renamed;
+        }
+        element.value_renamed = call_with_enough_stack<bool>([&] () {
+                return datum_rename_keys_in_buf(element.value, element.value_size,
+                                                rename_key, &element.new_value);
+            }, MIN_DATUM_SERIALIZATION_STACK_SPACE);
+        changed |= element.value_renamed;
+    }
+    if (!changed) {
+        return false;
+    }
+
+    if (is_object) {
+        // The fields have to be sorted by their new keys.
+        std::sort(elements.begin(), elements.end(),
+            [](const renamed_element_t &a, const renamed_element_t &b) {
+                const size_t a_size = a.final_key_size();
+                const size_t b_size = b.final_key_size();
+                const int cmp = memcmp(a.key_data(), b.key_data(),
+                                       std::min(a_size, b_size));
+                return cmp < 0 || (cmp == 0 && a_size < b_size);
+            });
+    }
+
+    std::vector<size_tree_node_t> elem_sizes;
+    elem_sizes.reserve(elements.size() * (is_object ? 2 : 1));
+    size_t elem_sz = 0;
+    for (const renamed_element_t &element : elements) {
+        if (is_object) {
+            size_tree_node_t key_size;
+            key_size.size = element.final_serialized_key_size();
+            elem_sz += key_size.size;
+            elem_sizes.push_back(std::move(key_size));
+        }
+        size_tree_node_t value_size;
+        value_size.size = element.final_value_size();
+        elem_sz += value_size.size;
+        elem_sizes.push_back(std::move(value_size));
+    }
+    datum_offset_size_t offset_size;
+    const size_t new_inner_size =
+        elem_sz + offset_table_serialized_size(elements.size(), elem_sz, &offset_size);
+
+    out->clear();
+    out->reserve(1 + varint_uint64_serialized_size(new_inner_size) + new_inner_size);
+    out->push_back(in[0]);
+    append_varint(new_inner_size, out);
+    {
+        write_message_t wm;
+        serialize_offset_table(&wm,
+                               is_object ? datum_t::R_OBJECT : datum_t::R_ARRAY,
+                               elem_sizes, offset_size);
+        vector_stream_t stream;
+        stream.swap(out);
+        DEBUG_VAR int res = send_write_message(&stream, &wm);
+        rassert(res == 0);
+        stream.swap(out);
+    }
+    for (const renamed_element_t &element : elements) {
+        if (element.key_renamed) {
+            append_varint(element.new_key.size(), out);
+            out->insert(out->end(), element.new_key.begin(), element.new_key.end());
+        } else if (is_object) {
+            out->insert(out->end(), element.serialized_key,
+                        element.serialized_key + element.serialized_key_size);
+        }
+        if (element.value_renamed) {
+            out->insert(out->end(), element.new_value.begin(), element.new_value.end());
+        } else {
+            out->insert(out->end(), element.value, element.value + element.value_size);
+        }
+    }
+    rassert(out->size()
+            == 1 + varint_uint64_serialized_size(new_inner_size) + new_inner_size);
+    return true;
+}
+
 }  // namespace ql
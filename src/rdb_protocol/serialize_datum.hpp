@@ -1,7 +1,10 @@
 #ifndef RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 #define RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 
+#include <functional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "containers/archive/archive.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -52,12 +55,32 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum);
 datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_offset);
 std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
         const shared_buf_ref_t<char> &buf, size_t at_offset);
+// Compares `key` to the key of the object field at `at_offset` in the buffer, without
+// touching the field's value.  The result has the sign of `key.compare(field_key)`.
+int datum_compare_key_in_buf(const shared_buf_ref_t<char> &buf, size_t at_offset,
+                             const datum_string_t &key);
+// Deserializes only the value of the object field at `at_offset` in the buffer.
+datum_t datum_deserialize_pair_value_from_buf(
+        const shared_buf_ref_t<char> &buf, size_t at_offset);
 
 // Finds the offset of the given array element in the buffer
 size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index);
 // Reads the number of elements in the array stored in the buffer
 size_t datum_get_array_size(const shared_buf_ref_t<char> &array);
 
+// Returns true and sets `*renamed_out` if the object key of `key_size` bytes at `key`
+// should be replaced.
+typedef std::function<bool(const char *key, size_t key_size, std::string *renamed_out)>
+    datum_key_renamer_t;
+
+// Rewrites the serialized datum at `in` (starting with its type tag), with every
+// object key passed through `rename_key`, without deserializing it.  The fields of
+// each object are re-sorted by their new keys.  Pseudo-type objects are left as they
+// are.  Returns false and leaves `*out` alone if no key gets replaced.
+bool datum_rename_keys_in_buf(const char *in, size_t in_size,
+                              const datum_key_renamer_t &rename_key,
+                              std::vector<char> *out);
+
 size_t datum_serialized_size(const datum_string_t &s);
 serialization_result_t datum_serialize(write_message_t *wm, const datum_string_t &s);
 
@@ -1,11 +1,13 @@
 #ifndef RDB_PROTOCOL_SERIALIZE_DATUM_ONTO_BLOB_HPP_
 #define RDB_PROTOCOL_SERIALIZE_DATUM_ONTO_BLOB_HPP_
 
+#include "rdb_protocol/key_dictionary.hpp"
 #include "rdb_protocol/serialize_datum.hpp"
 
 inline ql::serialization_result_t
 datum_serialize_onto_blob(buf_parent_t parent, blob_t *blob,
-                          const ql::datum_t &value) {
+                          const ql::datum_t &value,
+                          const key_encoder_t &key_encoder = key_encoder_t()) {
     // We still make an unnecessary copy: serializing to a write_message_t instead of
     // directly onto the stream.  (However, don't be so sure it would be more
     // efficient to serialize onto an abstract stream type -- you've got a whole
@@ -15,10 +17,13 @@ datum_serialize_onto_blob(buf_parent_t parent, blob_t *blob,
     // Check for errors to enforce the static array size limit when writing
     // to disk
     ql::serialization_result_t res =
-        datum_serialize(&wm, value,
-                        ql::check_datum_serialization_errors_t::YES);
+        datum_serialize(&wm, value, ql::check_datum_serialization_errors_t::YES);
     if (bad(res)) return res;
-    write_onto_blob(parent, blob, wm);
+    write_message_t encoded;
+    const bool is_encoded = key_encoder.encode(wm, &encoded);
+    // Documents are read far more often than they are written, so we store them in
+    // one block if we can.
+    write_onto_blob(parent, blob, is_encoded ? encoded : wm, blob::layout_t::contiguous);
     return res;
 }
 
@@ -8,6 +8,7 @@
 #include <boost/variant.hpp>
 
 #include "debug.hpp"
+#include "rdb_protocol/batch_func.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -984,19 +985,31 @@ private:
 class map_trans_t : public ungrouped_op_t {
 public:
     explicit map_trans_t(const map_wire_func_t &_f)
-        : f(_f.compile_wire_func()) { }
+        : f(_f.compile_wire_func()),
+          batch_f(f->compile_batch()) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
+        datums_t results;
+        if (batch_f.has()) {
+            batch_f->eval(*lst, &results);
+        }
         try {
-            for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+            for (size_t i = 0; i < lst->size(); ++i) {
+                if (batch_f.has() && results[i].has()) {
+                    (*lst)[i] = std::move(results[i]);
+                } else {
+                    (*lst)[i] = f->call(env, (*lst)[i])->as_datum();
+                }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace(), 1);
         }
     }
     counted_t<const func_t> f;
+    // Empty unless `f` is simple enough to be evaluated a batch at a time.  Rows
+    // that `batch_f` can't handle are passed to `f`.
+    scoped_ptr_t<batch_func_t> batch_f;
 };
 
 // Note: this removes duplicates ONLY TO SAVE NETWORK TRAFFIC.  It's possible
@@ -1037,15 +1050,32 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()),
+          batch_f(f->compile_batch()) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const std::function<datum_t()> &) {
+        datums_t results;
+        if (batch_f.has()) {
+            batch_f->eval(*lst, &results);
+        }
         auto it = lst->begin();
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                bool keep;
+                const datum_t *result = batch_f.has()
+                    ? &results[it - lst->begin()]
+                    : nullptr;
+                // Objects might have to be matched against the row, which
+                // `filter_call()` takes care of.
+                if (result != nullptr && result->has()
+                    && result->get_type() != datum_t::R_OBJECT) {
+                    keep = result->as_bool();
+                } else {
+                    keep = f->filter_call(env, *it, default_val);
+                }
+                if (keep) {
                     std::swap(*loc, *it);
                     ++loc;
                 }
@@ -1056,6 +1086,8 @@ private:
         lst->erase(loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
+    // See `map_trans_t`.
+    scoped_ptr_t<batch_func_t> batch_f;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -190,6 +190,17 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
     return sindex_sb;
 }
 
+// Whether `rget` covers everything its shard has of the table or of the index.
+static bool is_unbounded_range_read(const rget_read_t &rget) {
+    if (static_cast<bool>(rget.primary_keys)) {
+        return false;
+    }
+    if (static_cast<bool>(rget.sindex)) {
+        return rget.sindex->datumspec.is_universe();
+    }
+    return rget.region.inner.is_superset(rget.current_shard->inner);
+}
+
 void do_read(ql::env_t *env,
              store_t *store,
              btree_slice_t *btree,
@@ -198,6 +209,13 @@ void do_read(ql::env_t *env,
              rget_read_response_t *res,
              release_superblock_t release_superblock) {
     guarantee(rget.current_shard);
+    if (static_cast<bool>(rget.terminal) && is_unbounded_range_read(rget)) {
+        // Terminals such as `count()` on a whole table traverse all of it without
+        // returning anything to the client, so we treat them as scans to keep them
+        // from evicting the working set from the cache.
+        superblock->expose_buf().txn()->set_access_pattern(
+            page_access_pattern_t::scan);
+    }
     if (!rget.sindex) {
         // Normal rget
         rdb_rget_slice(
@@ -281,12 +299,18 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const changefeed_subscribe_t &s) {
         auto cserver = store->get_or_make_changefeed_server(s.shard_region);
         guarantee(cserver.first != nullptr);
-        cserver.first->add_client(s.addr, s.shard_region, cserver.second);
+        if (s.filter_update) {
+            cserver.first->update_filters(
+                s.addr, ctx, *s.filter_update, cserver.second);
+        } else {
+            cserver.first->add_client(s.addr, s.shard_region, cserver.second);
+        }
         response->response = changefeed_subscribe_response_t();
         auto res = boost::get<changefeed_subscribe_response_t>(&response->response);
         guarantee(res != NULL);
         res->server_uuids.insert(cserver.first->get_uuid());
         res->addrs.insert(cserver.first->get_stop_addr());
+        res->filter_stop_addrs.insert(cserver.first->get_filter_stop_addr());
     }
 
     void operator()(const changefeed_limit_subscribe_t &s) {
@@ -297,6 +321,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             s.optargs,
             s.m_user_context,
             trace);
+        // We also read the rows the limit manager keeps past the top `limit`.
+        size_t n = s.spec.limit + ql::changefeed::limit_margin_size(s.spec.limit);
         ql::raw_stream_t stream;
         {
             std::vector<scoped_ptr_t<ql::op_t> > ops;
@@ -311,7 +337,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             if (s.spec.range.sindex) {
                 rget.terminal = ql::limit_read_t{
                     is_primary_t::NO,
-                    s.spec.limit,
+                    n,
                     s.region,
                     !reversed(s.spec.range.sorting)
                         ? store_key_t::min()
@@ -325,7 +351,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             } else {
                 rget.terminal = ql::limit_read_t{
                     is_primary_t::YES,
-                    s.spec.limit,
+                    n,
                     s.region,
                     !reversed(s.spec.range.sorting)
                         ? store_key_t::min()
@@ -358,7 +384,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             std::move(stream),
             s.spec.range.sindex ? is_primary_t::NO : is_primary_t::YES,
             s.spec.range.sorting,
-            s.spec.limit);
+            n);
 
         guarantee(s.current_shard);
         auto cserver = store->get_or_make_changefeed_server(*s.current_shard);
@@ -380,6 +406,74 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = changefeed_limit_subscribe_response_t(1, std::move(vec));
     }
 
+    void operator()(const changefeed_aggregate_subscribe_t &s) {
+        guarantee(s.current_shard);
+        guarantee(!superblock->get()->is_snapshotted());
+        auto cserver = store->get_or_make_changefeed_server(*s.current_shard);
+        guarantee(cserver.first != nullptr);
+        {
+            // Writes get in line for a stamp while holding the superblock, so
+            // getting in line once we have it splits the writes into the ones our
+            // read sees and the ones the aggregate manager will be sent.
+            superblock->get()->read_acq_signal()->wait_lazily_unordered();
+            rwlock_in_line_t stamp_spot =
+                store->get_in_line_for_cfeed_stamp(access_t::read);
+            cserver.first->add_aggregate_client(
+                s.addr,
+                s.region,
+                ctx,
+                s.optargs,
+                s.m_user_context,
+                s.uuid,
+                s.spec,
+                &stamp_spot,
+                cserver.second);
+        }
+        // Unlike the limit subscription we read the whole range, so we don't hold
+        // up writes while we do.  (See `use_snapshot_visitor_t`.)
+        superblock->get()->snapshot_subdag();
+
+        ql::env_t env(
+            ctx,
+            ql::return_empty_normal_batches_t::NO,
+            interruptor,
+            s.optargs,
+            s.m_user_context,
+            trace);
+        rget_read_t rget;
+        rget.region = s.region;
+        rget.current_shard = s.current_shard;
+        rget.table_name = s.table;
+        rget.batchspec = ql::batchspec_t::all();
+        rget.transforms = s.spec.range.transforms;
+        rget.terminal = ql::changefeed::make_aggregate_terminal(s.spec);
+        if (s.spec.range.sindex) {
+            rget.sindex = sindex_rangespec_t(
+                *s.spec.range.sindex,
+                boost::none, // We just want to use whole range.
+                s.spec.range.datumspec);
+        } else {
+            rget.primary_keys = s.spec.range.datumspec.primary_key_map();
+        }
+        rget.sorting = sorting_t::UNORDERED;
+        rget_read_response_t resp;
+        do_read(&env, store, btree, superblock, rget, &resp,
+                release_superblock_t::RELEASE);
+        if (boost::get<ql::exc_t>(&resp.result) != nullptr) {
+            cserver.first->remove_aggregate_client(s.addr, s.uuid);
+            response->response = resp;
+            return;
+        }
+        std::map<ql::datum_t, double> start_data;
+        ql::changefeed::add_aggregate_result(resp.result, 1, &start_data);
+        cserver.first->send_aggregate_start(
+            s.addr, s.uuid, std::move(start_data), cserver.second);
+
+        auto addr = cserver.first->get_limit_stop_addr();
+        std::vector<decltype(addr)> vec{addr};
+        response->response = changefeed_limit_subscribe_response_t(1, std::move(vec));
+    }
+
     changefeed_stamp_response_t do_stamp(const changefeed_stamp_t &s,
                                          const region_t &current_shard,
                                          const store_key_t &read_start) {
@@ -779,7 +873,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
         response->response =
             rdb_batched_replace(
-                btree_info_t(btree, timestamp, datum_string_t(br.pkey)),
+                btree_info_t(btree, timestamp, datum_string_t(br.pkey),
+                             key_encoder),
                 superblock,
                 br.keys,
                 &replacer,
@@ -809,7 +904,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         }
         response->response =
             rdb_batched_replace(
-                btree_info_t(btree, timestamp, datum_string_t(bi.pkey)),
+                btree_info_t(btree, timestamp, datum_string_t(bi.pkey),
+                             key_encoder),
                 superblock,
                 keys,
                 &replacer,
@@ -830,7 +926,8 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         rdb_live_deletion_context_t deletion_context;
         rdb_modification_report_t mod_report(w.key);
         rdb_set(w.key, w.data, w.overwrite, btree, timestamp, superblock->get(),
-                &deletion_context, res, &mod_report.info, trace);
+                &deletion_context, res, &mod_report.info, trace, nullptr,
+                key_encoder);
 
         update_sindexes(mod_report);
     }
@@ -888,7 +985,10 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         trace(_trace),
         sindex_block((*superblock)->expose_buf(),
                      (*superblock)->get_sindex_block_id(),
-                     access_t::write) {
+                     access_t::write),
+        key_encoder(btree->key_dictionary) {
+        // We still hold the superblock, so the key dictionary has all the ids that we
+        // can refer to, and none that we can't (see `key_dictionary_t`).
     }
 
 private:
@@ -912,6 +1012,7 @@ private:
     profile::sampler_t *const sampler;
     profile::trace_t *const trace;
     buf_lock_t sindex_block;
+    const key_encoder_t key_encoder;
     profile::event_log_t event_log_out;
 
     DISABLE_COPYING(rdb_write_visitor_t);
@@ -994,6 +1095,27 @@ store_t::sindex_context_map_t *store_t::get_sindex_context_map() {
     return &sindex_context;
 }
 
+store_t::sindex_postcon_parts_map_t *store_t::get_sindex_postcon_parts_map() {
+    return &sindex_postcon_parts;
+}
+
+bool store_t::sindex_needs_post_construction(
+        const secondary_index_t &sindex, const store_key_t &key) const {
+    if (!sindex.needs_post_construction_range.contains_key(key)) {
+        return false;
+    }
+    auto it = sindex_postcon_parts.find(sindex.id);
+    if (it == sindex_postcon_parts.end()) {
+        return true;
+    }
+    for (const key_range_t &part : it->second) {
+        if (part.contains_key(key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::pair<ql::changefeed::server_t *, auto_drainer_t::lock_t> store_t::changefeed_server(
         const region_t &_region,
         const rwlock_acq_t *acq) {
@@ -245,6 +245,17 @@ public:
         const key_range_t &except_for_remaining_range)
     THROWS_NOTHING;
 
+    // Like `mark_index_up_to_date()` for one of the parts of an index that gets
+    // post-constructed in parallel (see `get_sindex_postcon_parts_map()`). The index
+    // stays marked as not up to date for everything from the first part that isn't
+    // done yet to the last one.
+    bool mark_index_part_up_to_date(
+        uuid_u id,
+        buf_lock_t *sindex_block,
+        size_t part,
+        const key_range_t &except_for_remaining_range_of_part)
+    THROWS_NOTHING;
+
     MUST_USE bool acquire_sindex_superblock_for_read(
             const sindex_name_t &name,
             const std::string &table_name,
@@ -366,6 +377,19 @@ public:
     double get_sindex_progress(uuid_u const &id);
     microtime_t get_sindex_start_time(uuid_u const &id);
 
+    // While a secondary index gets post-constructed in several parts in parallel, the
+    // `needs_post_construction_range` that we store for it on disk only covers what
+    // remains of all parts together (see `resume_construct_sindex()`). This map has
+    // the ranges that each part still has to construct, so that writes to the keys
+    // between them can update the index right away.
+    typedef std::map<uuid_u, std::vector<key_range_t> > sindex_postcon_parts_map_t;
+    sindex_postcon_parts_map_t *get_sindex_postcon_parts_map();
+
+    // Whether writes to `key` must leave `sindex` alone, because it hasn't been
+    // post-constructed for the key yet.
+    bool sindex_needs_post_construction(
+        const secondary_index_t &sindex, const store_key_t &key) const;
+
     fifo_enforcer_source_t main_token_source, sindex_token_source;
     fifo_enforcer_sink_t main_token_sink, sindex_token_sink;
 
@@ -430,6 +454,7 @@ private:
     namespace_id_t table_id;
 
     sindex_context_map_t sindex_context;
+    sindex_postcon_parts_map_t sindex_postcon_parts;
 
     // Having a lot of writes queued up waiting for the superblock to become available
     // can stall reads for unacceptably long time periods.
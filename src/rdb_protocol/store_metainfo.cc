@@ -2,16 +2,26 @@
 #include "rdb_protocol/store_metainfo.hpp"
 
 #include "btree/reql_specific.hpp"
+#include "buffer_cache/alt.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 
-store_metainfo_manager_t::store_metainfo_manager_t(real_superblock_t *superblock) {
+store_metainfo_manager_t::store_metainfo_manager_t(real_superblock_t *superblock)
+    : key_dictionary_block_id_(NULL_BLOCK_ID) {
     std::vector<std::pair<std::vector<char>, std::vector<char> > > kv_pairs;
     // TODO: this is inefficient, cut out the middleman (vector)
     get_superblock_metainfo(superblock, &kv_pairs, &cache_version);
     std::vector<region_t> regions;
     std::vector<binary_blob_t> values;
     for (auto &pair : kv_pairs) {
+        if (pair.first.empty()) {
+            key_dictionary_block_id_ = binary_blob_t::get<block_id_t>(
+                binary_blob_t(pair.second.begin(), pair.second.end()));
+            buf_lock_t block(superblock->expose_buf(), key_dictionary_block_id_,
+                             access_t::read);
+            key_dictionary_.read_from_block(&block);
+            continue;
+        }
         region_t region;
         {
             buffer_read_stream_t key(pair.first.data(), pair.first.size());
@@ -62,6 +72,18 @@ void store_metainfo_manager_t::update(
 
     cache.update(new_values);
 
+    if (key_dictionary_.promote_hot_keys()) {
+        if (key_dictionary_block_id_ == NULL_BLOCK_ID) {
+            buf_lock_t block(superblock->expose_buf(), alt_create_t::create);
+            key_dictionary_.init_block(&block);
+            key_dictionary_block_id_ = block.block_id();
+        } else {
+            buf_lock_t block(superblock->expose_buf(), key_dictionary_block_id_,
+                             access_t::write);
+            key_dictionary_.write_to_block(&block);
+        }
+    }
+
     std::vector<std::vector<char> > keys;
     std::vector<binary_blob_t> values;
     cache.visit(region_t::universe(),
@@ -76,6 +98,10 @@ void store_metainfo_manager_t::update(
             keys.push_back(std::move(key.vector()));
             values.push_back(value);
         });
+    if (key_dictionary_block_id_ != NULL_BLOCK_ID) {
+        keys.push_back(std::vector<char>());
+        values.push_back(binary_blob_t(key_dictionary_block_id_));
+    }
 
     set_superblock_metainfo(superblock, keys, values, cache_version);
 }
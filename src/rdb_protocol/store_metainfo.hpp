@@ -5,10 +5,15 @@
 #include <functional>
 
 #include "containers/binary_blob.hpp"
+#include "rdb_protocol/key_dictionary.hpp"
 #include "region/region_map.hpp"
+#include "serializer/types.hpp"
 
 class real_superblock_t;
 
+/* Besides the metainfo proper, which maps regions to version information, this keeps
+track of the table's key dictionary (see `key_dictionary_t`).  Its block id is stored
+in the superblock's metainfo under an empty key, which no region serializes to. */
 class store_metainfo_manager_t {
 public:
     explicit store_metainfo_manager_t(real_superblock_t *superblock);
@@ -35,9 +40,16 @@ public:
 
     cluster_version_t get_version(real_superblock_t *superblock) const;
 
+    // `update()` assigns ids to hot field names and writes the dictionary to disk, so
+    // that every write can start referring to them.
+    key_dictionary_t *key_dictionary() { return &key_dictionary_; }
+
 private:
     cluster_version_t cache_version;
     region_map_t<binary_blob_t> cache;
+
+    key_dictionary_t key_dictionary_;
+    block_id_t key_dictionary_block_id_;
 };
 
 #endif /* RDB_PROTOCOL_STORE_METAINFO_HPP_ */
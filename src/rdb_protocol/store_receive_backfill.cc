@@ -1,6 +1,7 @@
 #include "rdb_protocol/store.hpp"
 
 #include "btree/backfill.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/reql_specific.hpp"
 #include "rdb_protocol/btree.hpp"
 
@@ -208,6 +209,24 @@ void apply_item_pair(
     }
 }
 
+/* `bulk_load_item_pair()` is like `apply_item_pair()`, for pairs with a value whose
+key goes past the end of the B-tree. */
+void bulk_load_item_pair(
+        btree_slice_t *slice,
+        btree_bulk_loader_t *loader,
+        backfill_item_t::pair_t &&pair,
+        std::vector<rdb_modification_report_t> *mod_reports_out) {
+    guarantee(static_cast<bool>(pair.value));
+    mod_reports_out->resize(mod_reports_out->size() + 1);
+    mod_reports_out->back().primary_key = pair.key;
+    vector_read_stream_t read_stream(std::move(*pair.value));
+    ql::datum_t datum;
+    archive_result_t res = datum_deserialize(&read_stream, &datum);
+    guarantee(res == archive_result_t::SUCCESS);
+    rdb_bulk_load(pair.key, datum, slice, pair.recency, loader,
+        &mod_reports_out->back().info);
+}
+
 /* `apply_single_key_item()` applies a `backfill_item_t` whose range is a single key wide
 and which has a `backfill_item_t::pair_t` for that key. This eliminates the need to erase
 the previous contents of the range.
@@ -342,9 +361,32 @@ void apply_multi_key_item(
             guarantee(range_deleted.right == range_to_delete.right
                 || res == continue_bool_t::CONTINUE);
 
-            /* Apply any pairs from the item that fall within the deleted region */
-            while (next_pair < item.pairs.size() &&
-                    range_deleted.contains_key(item.pairs[next_pair].key)) {
+            /* Apply any pairs from the item that fall within the deleted region. When
+            they go past the end of the B-tree, which is what happens when we backfill
+            into an empty table, we bulk-load them instead of inserting them one by one.
+            That leaves us with full leaf nodes rather than half-full ones. Since the
+            bulk loader acquires the whole right-most path for write, we first check
+            that it would take the first pair at all. */
+            size_t end_pair = next_pair;
+            bool all_pairs_have_values = true;
+            while (end_pair < item.pairs.size() &&
+                    range_deleted.contains_key(item.pairs[end_pair].key)) {
+                all_pairs_have_values &= static_cast<bool>(item.pairs[end_pair].value);
+                ++end_pair;
+            }
+            if (end_pair != next_pair && all_pairs_have_values
+                    && btree_bulk_loader_t::can_append_to(superblock.get(),
+                        item.pairs[next_pair].key.btree_key())) {
+                rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+                btree_bulk_loader_t loader(&sizer, superblock.get());
+                while (next_pair < end_pair &&
+                        loader.can_append(item.pairs[next_pair].key.btree_key())) {
+                    bulk_load_item_pair(tokens.info->slice, &loader,
+                        std::move(item.pairs[next_pair]), &mod_reports);
+                    ++next_pair;
+                }
+            }
+            while (next_pair < end_pair) {
                 promise_t<superblock_t *> pass_back_superblock;
                 apply_item_pair(tokens.info->slice, superblock.get(),
                     std::move(item.pairs[next_pair]), &mod_reports,
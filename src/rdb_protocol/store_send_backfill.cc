@@ -3,9 +3,12 @@
 #include "btree/backfill.hpp"
 #include "btree/reql_specific.hpp"
 #include "btree/operations.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/key_dictionary.hpp"
 #include "rdb_protocol/lazy_btree_val.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 
 /* After every `MAX_BACKFILL_ITEMS_PER_TXN` backfill items or backfill pre-items, we'll
 release the superblock and start a new transaction. */
@@ -150,9 +153,11 @@ public:
     limiting_btree_backfill_item_consumer_t(
             store_view_t::backfill_item_consumer_t *_inner,
             key_range_t::right_bound_t *_threshold_ptr,
-            const region_map_t<binary_blob_t> *_metainfo_ptr) :
+            const region_map_t<binary_blob_t> *_metainfo_ptr,
+            const key_dictionary_t *_key_dictionary) :
         remaining(MAX_BACKFILL_ITEMS_PER_TXN), inner(_inner),
-        threshold_ptr(_threshold_ptr), metainfo_ptr(_metainfo_ptr) { }
+        threshold_ptr(_threshold_ptr), metainfo_ptr(_metainfo_ptr),
+        key_dictionary(_key_dictionary) { }
     continue_bool_t on_item(backfill_item_t &&item) {
         rassert(remaining > 0);
         --remaining;
@@ -188,6 +193,14 @@ public:
         buffer_group_t buffer_group;
         blob_wrapper.expose_all(
             parent, access_t::read, &buffer_group, &acq_group);
+        if (buffer_group.get_size() != 0
+            && *static_cast<const uint8_t *>(buffer_group.get_buffer(0).data)
+                == KEY_DICTIONARY_ENCODED_TAG) {
+            // The receiving replica has a key dictionary of its own, so we send the
+            // value with the field names that the ids stand for.
+            decode_stored_datum(const_view(&buffer_group), key_dictionary, value_out);
+            return;
+        }
         value_out->resize(buffer_group.get_size());
         size_t offset = 0;
         for (size_t i = 0; i < buffer_group.num_buffers(); ++i) {
@@ -217,6 +230,8 @@ private:
     Note that it can't be changed. This is OK because `limiting_..._consumer_t` never
     exists across multiple B-tree transactions, so the metainfo is constant. */
     const region_map_t<binary_blob_t> *const metainfo_ptr;
+
+    const key_dictionary_t *const key_dictionary;
 };
 
 continue_bool_t store_t::send_backfill(
@@ -261,7 +276,7 @@ continue_bool_t store_t::send_backfill(
             region_map_t<binary_blob_t> metainfo_copy =
                 metainfo->get(sb.get(), region_t(pair.first));
             limiting_btree_backfill_item_consumer_t limiter(
-                item_consumer, &threshold, &metainfo_copy);
+                item_consumer, &threshold, &metainfo_copy, btree->key_dictionary);
 
             rdb_value_sizer_t sizer(cache->max_block_size());
             key_range_t to_do = pair.first;
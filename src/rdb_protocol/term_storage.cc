@@ -295,6 +295,10 @@ raw_term_t json_term_storage_t::root_term() const {
     return raw_term_t(&query_json[1]);
 }
 
+size_t json_term_storage_t::memory_usage() {
+    return original_data.size() + query_json.GetAllocator().Size();
+}
+
 bool json_term_storage_t::static_optarg_as_bool(const std::string &key,
                                                 bool default_value) const {
     r_sanity_check(query_json.IsArray());
@@ -373,6 +377,10 @@ raw_term_t wire_term_storage_t::root_term() const {
     return raw_term_t(&func_json);
 }
 
+size_t wire_term_storage_t::memory_usage() {
+    return original_data.size() + func_json.GetAllocator().Size();
+}
+
 template <typename pb_t>
 MUST_USE archive_result_t deserialize_protobuf(read_stream_t *s, pb_t *p) {
     CT_ASSERT(sizeof(int) == sizeof(int32_t));
@@ -126,6 +126,8 @@ public:
 
     // These functions must be implemented by descendants
     virtual raw_term_t root_term() const = 0;
+    // Roughly how much memory the query takes up, in bytes.
+    virtual size_t memory_usage() = 0;
 
     // These functions are not valid for all descendants
     virtual Query::QueryType query_type() const;
@@ -147,6 +149,7 @@ public:
                                bool default_value) const;
     void preprocess();
     raw_term_t root_term() const;
+    size_t memory_usage();
     global_optargs_t global_optargs();
 private:
     scoped_array_t<char> original_data;
@@ -158,6 +161,7 @@ public:
     wire_term_storage_t(scoped_array_t<char> &&_original_data,
                         rapidjson::Document &&_query_json);
     raw_term_t root_term() const;
+    size_t memory_usage();
 private:
     scoped_array_t<char> original_data;
     rapidjson::Document func_json;
@@ -9,9 +9,10 @@ namespace ql {
 
 class datum_term_t : public term_t {
 public:
-    explicit datum_term_t(const raw_term_t &term)
+    datum_term_t(const raw_term_t &term, boost::optional<size_t> _plan_param)
             : term_t(term),
-              datum(term.datum(configured_limits_t::unlimited, reql_version_t::LATEST)) {
+              datum(term.datum(configured_limits_t::unlimited, reql_version_t::LATEST)),
+              plan_param(_plan_param) {
         r_sanity_check(datum.has());
     }
 
@@ -25,11 +26,17 @@ public:
 private:
     virtual void accumulate_captures(var_captures_t *) const { /* do nothing */ }
     virtual deterministic_t is_deterministic() const { return deterministic_t::always; }
-    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *, eval_flags_t) const {
+    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t) const {
+        if (plan_param) {
+            return new_val(env->env->get_plan_param(*plan_param));
+        }
         return new_val(datum);
     }
     virtual const char *name() const { return "datum"; }
     const datum_t datum;
+    // Set if this term is part of a cached query plan and its value is bound when
+    // the plan is evaluated.
+    const boost::optional<size_t> plan_param;
 };
 
 class constant_term_t : public op_term_t {
@@ -145,8 +152,18 @@ private:
 };
 
 counted_t<term_t> make_datum_term(
-        const raw_term_t &term) {
-    return make_counted<datum_term_t>(term);
+        compile_env_t *env, const raw_term_t &term) {
+    boost::optional<size_t> plan_param;
+    if (env->plan_params != nullptr) {
+        term_variant_t src = term.get_src();
+        if (auto json = boost::get<const rapidjson::Value *>(&src)) {
+            auto it = env->plan_params->find(*json);
+            if (it != env->plan_params->end()) {
+                plan_param = it->second;
+            }
+        }
+    }
+    return make_counted<datum_term_t>(term, plan_param);
 }
 counted_t<term_t> make_constant_term(
         compile_env_t *env, const raw_term_t &term,
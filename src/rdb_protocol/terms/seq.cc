@@ -14,6 +14,27 @@
 
 namespace ql {
 
+// An aggregation that `changes` can keep up to date as the rows being aggregated
+// change, instead of evaluating it.
+class aggregate_changes_source_t {
+public:
+    // Evaluates the sequence being aggregated, with the filtering the aggregation
+    // does itself added to it.  The aggregation is stored in `*terminal_out`.
+    virtual counted_t<datum_stream_t> eval_aggregated_seq(
+        scope_env_t *env,
+        changefeed::keyspec_t::aggregate_t::terminal_t *terminal_out) const = 0;
+protected:
+    virtual ~aggregate_changes_source_t() { }
+};
+
+// We evaluate the arguments ourselves, so we can't handle `r.args`.
+bool has_args_term(const std::vector<counted_t<const term_t> > &args) {
+    return std::any_of(args.begin(), args.end(),
+                       [](const counted_t<const term_t> &arg) {
+                           return arg->get_src().type() == Term::ARGS;
+                       });
+}
+
 template<class T>
 class map_acc_term_t : public grouped_seq_op_term_t {
 protected:
@@ -62,10 +83,29 @@ private:
         rfail(base_exc_t::LOGIC, "Cannot call %s on an index.", this->name());
     }
 };
-class sum_term_t : public unindexable_map_acc_term_t<sum_wire_func_t> {
+class sum_term_t : public unindexable_map_acc_term_t<sum_wire_func_t>,
+                   public aggregate_changes_source_t {
 public:
     template<class... Args> sum_term_t(Args... args)
         : unindexable_map_acc_term_t<sum_wire_func_t>(args...) { }
+
+    counted_t<datum_stream_t> eval_aggregated_seq(
+        scope_env_t *env,
+        changefeed::keyspec_t::aggregate_t::terminal_t *terminal_out) const final {
+        const std::vector<counted_t<const term_t> > &args = get_original_args();
+        rcheck(!has_args_term(args), base_exc_t::LOGIC,
+               "Cannot call `changes` on a `sum` with `r.args`.");
+        rcheck(!get_src().optarg("index"), base_exc_t::LOGIC,
+               "Cannot call sum on an index.");
+        counted_t<datum_stream_t> seq = args[0]->eval(env)->as_seq(env->env);
+        if (args.size() == 2) {
+            *terminal_out = sum_wire_func_t(
+                backtrace(), args[1]->eval(env)->as_func(GET_FIELD_SHORTCUT));
+        } else {
+            *terminal_out = sum_wire_func_t(backtrace());
+        }
+        return seq;
+    }
 private:
     virtual const char *name() const { return "sum"; }
 };
@@ -119,10 +159,30 @@ private:
     virtual const char *name() const { return "max"; }
 };
 
-class count_term_t : public grouped_seq_op_term_t {
+class count_term_t : public grouped_seq_op_term_t,
+                     public aggregate_changes_source_t {
 public:
     count_term_t(compile_env_t *env, const raw_term_t &term)
         : grouped_seq_op_term_t(env, term, argspec_t(1, 2)) { }
+
+    counted_t<datum_stream_t> eval_aggregated_seq(
+        scope_env_t *env,
+        changefeed::keyspec_t::aggregate_t::terminal_t *terminal_out) const final {
+        const std::vector<counted_t<const term_t> > &args = get_original_args();
+        rcheck(!has_args_term(args), base_exc_t::LOGIC,
+               "Cannot call `changes` on a `count` with `r.args`.");
+        counted_t<datum_stream_t> seq = args[0]->eval(env)->as_seq(env->env);
+        if (args.size() == 2) {
+            scoped_ptr_t<val_t> v1 = args[1]->eval(env);
+            counted_t<const func_t> f =
+                v1->get_type().is_convertible(val_t::type_t::FUNC)
+                    ? v1->as_func()
+                    : new_eq_comparison_func(v1->as_datum(), backtrace());
+            seq->add_transformation(filter_wire_func_t(f, boost::none), backtrace());
+        }
+        *terminal_out = count_wire_func_t();
+        return seq;
+    }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args,
                                           eval_flags_t) const {
@@ -527,6 +587,33 @@ struct rcheck_spec_visitor_t : public bt_rcheckable_t,
     }
     void operator()(const changefeed::keyspec_t::point_t &) const { }
     void operator()(const changefeed::keyspec_t::empty_t &) const { }
+    void operator()(const changefeed::keyspec_t::aggregate_t &spec) const {
+        rcheck(!spec.range.intersect_geometry, base_exc_t::LOGIC,
+               "Cannot call `changes` on an aggregation of `get_intersecting`.");
+        rcheck_transform_visitor_t transform_visitor(backtrace());
+        bool grouped = false;
+        for (const auto &t : spec.range.transforms) {
+            // The servers keep track of the groups, so that's the one place we
+            // allow `group`.
+            if (const auto *group = boost::get<group_wire_func_t>(&t)) {
+                for (const auto &f : group->compile_funcs()) {
+                    transform_visitor.check_f(wire_func_t(f));
+                }
+                grouped = true;
+            } else {
+                boost::apply_visitor(transform_visitor, t);
+            }
+        }
+        if (const auto *sum = boost::get<sum_wire_func_t>(&spec.terminal)) {
+            // A group that sums to 0 might still have rows, so we couldn't tell
+            // when it disappears.
+            rcheck(!grouped, base_exc_t::LOGIC,
+                   "Cannot call `changes` on a grouped `sum`.");
+            if (counted_t<const func_t> f = sum->compile_wire_func_or_null()) {
+                transform_visitor.check_f(wire_func_t(f));
+            }
+        }
+    }
     env_t *env;
 };
 
@@ -537,6 +624,7 @@ public:
             env, term, argspec_t(1),
             optargspec_t({"squash",
                           "changefeed_queue_size",
+                          "changefeed_queue_memory",
                           "include_initial",
                           "include_offsets",
                           "include_states",
@@ -577,9 +665,15 @@ private:
             include_offsets = v->as_bool();
         }
 
+        configured_limits_t limits = env->env->limits_with_changefeed_queue_optargs(
+                args->optarg(env, "changefeed_queue_size"),
+                args->optarg(env, "changefeed_queue_memory"));
+        if (const auto *agg = dynamic_cast<const aggregate_changes_source_t *>(
+                get_original_args()[0].get())) {
+            return aggregate_changes(env, agg, include_initial, include_offsets,
+                                     include_states, include_types, limits, squash);
+        }
         scoped_ptr_t<val_t> v = args->arg(env, 0);
-        configured_limits_t limits = env->env->limits_with_changefeed_queue_size(
-                args->optarg(env, "changefeed_queue_size"));
         if (v->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
             counted_t<datum_stream_t> seq = v->as_seq(env->env);
             std::vector<counted_t<datum_stream_t> > streams;
@@ -645,6 +739,48 @@ private:
         rfail(base_exc_t::LOGIC,
               ".changes() not yet supported on range selections");
     }
+
+    // `.count().changes()`, `.sum().changes()` and `.group().count().changes()`
+    // have the servers keep the aggregation up to date, rather than re-running it.
+    scoped_ptr_t<val_t> aggregate_changes(scope_env_t *env,
+                                          const aggregate_changes_source_t *agg,
+                                          bool include_initial,
+                                          bool include_offsets,
+                                          bool include_states,
+                                          bool include_types,
+                                          const configured_limits_t &limits,
+                                          const datum_t &squash) const {
+        changefeed::keyspec_t::aggregate_t::terminal_t terminal;
+        counted_t<datum_stream_t> seq = agg->eval_aggregated_seq(env, &terminal);
+        std::vector<changespec_t> changespecs = seq->get_changespecs();
+        rcheck(changespecs.size() == 1, base_exc_t::LOGIC,
+               "Cannot call `changes` on an aggregation of a union.");
+        changespec_t *changespec = &changespecs[0];
+        auto *range = boost::get<changefeed::keyspec_t::range_t>(
+            &changespec->keyspec.spec);
+        rcheck(range != nullptr, base_exc_t::LOGIC,
+               "Cannot call `changes` on an aggregation of this stream.");
+        changefeed::keyspec_t::aggregate_t spec{std::move(*range), std::move(terminal)};
+        rcheck_spec_visitor_t(env->env, backtrace())(spec);
+        return new_val(
+            env->env,
+            changespec->keyspec.table->read_changes(
+                env->env,
+                changefeed::streamspec_t(
+                    // The servers send the initial values, so the stream is only
+                    // used to tell whether to include them.
+                    include_initial
+                        ? std::move(changespec->stream)
+                        : counted_t<datum_stream_t>(),
+                    changespec->keyspec.table_name,
+                    include_offsets,
+                    include_states,
+                    include_types,
+                    limits,
+                    squash,
+                    std::move(spec)),
+                backtrace()));
+    }
     virtual const char *name() const { return "changes"; }
 };
 
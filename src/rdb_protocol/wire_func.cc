@@ -1,6 +1,7 @@
 // Copyright 2010-2015 RethinkDB, all rights reserved.
 #include "rdb_protocol/wire_func.hpp"
 
+#include "arch/runtime/coroutines.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
 #include "containers/archive/archive.hpp"
@@ -91,6 +92,118 @@ void serialize(write_message_t *wm, const wire_func_t &wf) {
 
 INSTANTIATE_SERIALIZE_FOR_CLUSTER_AND_DISK(wire_func_t);
 
+const size_t MIN_CANONICAL_TERM_STACK_SPACE = 16 * KILOBYTE;
+
+class canonical_func_visitor_t : public func_visitor_t {
+public:
+    explicit canonical_func_visitor_t(write_message_t *_wm) : wm(_wm) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        serialize<cluster_version_t::CLUSTER>(wm, wire_func_type_t::REQL);
+        std::vector<int64_t> arg_ids;
+        for (const sym_t &arg : reql_func->arg_names) {
+            arg_ids.push_back(bind(arg.value));
+        }
+        serialize<cluster_version_t::CLUSTER>(wm, arg_ids);
+        write_term(reql_func->body->get_src());
+        // The captured variables are the free variables of the body, so they've all
+        // been numbered by now.
+        const var_scope_t &scope = reql_func->captured_scope;
+        serialize<cluster_version_t::CLUSTER>(wm, free_vars.size());
+        for (int64_t var : free_vars) {
+            serialize<cluster_version_t::CLUSTER>(wm, ids.at(var));
+            serialize<cluster_version_t::CLUSTER>(wm, scope.lookup_var(sym_t(var)));
+        }
+        var_captures_t implicit_only;
+        implicit_only.implicit_is_captured =
+            scope.compute_visibility().implicit_is_accessible();
+        serialize<cluster_version_t::CLUSTER>(
+            wm, scope.filtered_by_captures(implicit_only));
+        serialize<cluster_version_t::CLUSTER>(wm, reql_func->backtrace());
+    }
+
+    void on_js_func(const js_func_t *js_func) {
+        // JavaScript functions don't have variable ids.
+        wire_func_serialization_visitor_t<cluster_version_t::CLUSTER> v(wm);
+        v.on_js_func(js_func);
+    }
+
+private:
+    int64_t bind(int64_t var) {
+        return ids.insert(std::make_pair(var, ids.size())).first->second;
+    }
+
+    void write_term(const raw_term_t &term) {
+        serialize<cluster_version_t::CLUSTER>(wm, static_cast<int32_t>(term.type()));
+        serialize<cluster_version_t::CLUSTER>(wm, term.bt());
+        if (term.type() == Term::DATUM) {
+            serialize<cluster_version_t::CLUSTER>(wm, term.datum());
+            return;
+        }
+        if (term.type() == Term::VAR) {
+            r_sanity_check(term.num_args() == 1);
+            const int64_t var = term.arg(0).datum().as_int();
+            if (ids.count(var) == 0) {
+                free_vars.push_back(var);
+            }
+            serialize<cluster_version_t::CLUSTER>(wm, bind(var));
+            return;
+        }
+        if (term.type() == Term::FUNC) {
+            r_sanity_check(term.num_args() == 2);
+            // The arguments are a literal array of numbers, written either as a
+            // datum or as a `MAKE_ARRAY` of datums.
+            const raw_term_t vars = term.arg(0);
+            std::vector<int64_t> arg_ids;
+            if (vars.type() == Term::DATUM) {
+                datum_t d = vars.datum();
+                for (size_t i = 0; i < d.arr_size(); ++i) {
+                    arg_ids.push_back(bind(d.get(i).as_int()));
+                }
+            } else {
+                r_sanity_check(vars.type() == Term::MAKE_ARRAY);
+                for (size_t i = 0; i < vars.num_args(); ++i) {
+                    arg_ids.push_back(bind(vars.arg(i).datum().as_int()));
+                }
+            }
+            serialize<cluster_version_t::CLUSTER>(wm, arg_ids);
+            call_with_enough_stack([&]() {
+                    write_term(term.arg(1));
+                }, MIN_CANONICAL_TERM_STACK_SPACE);
+            return;
+        }
+        serialize<cluster_version_t::CLUSTER>(wm, term.num_args());
+        for (size_t i = 0; i < term.num_args(); ++i) {
+            call_with_enough_stack([&]() {
+                    write_term(term.arg(i));
+                }, MIN_CANONICAL_TERM_STACK_SPACE);
+        }
+        std::map<std::string, raw_term_t> optargs;
+        term.each_optarg([&](const raw_term_t &optarg, const std::string &name) {
+                optargs.insert(std::make_pair(name, optarg));
+            });
+        serialize<cluster_version_t::CLUSTER>(wm, optargs.size());
+        for (const auto &pair : optargs) {
+            serialize<cluster_version_t::CLUSTER>(wm, pair.first);
+            call_with_enough_stack([&]() {
+                    write_term(pair.second);
+                }, MIN_CANONICAL_TERM_STACK_SPACE);
+        }
+    }
+
+    write_message_t *wm;
+    // The canonical ids of the variables we've seen so far.
+    std::map<int64_t, int64_t> ids;
+    // The variables the body uses without binding them, in order.
+    std::vector<int64_t> free_vars;
+};
+
+void serialize_canonical_func(write_message_t *wm, const wire_func_t &wf) {
+    r_sanity_check(wf.func.has());
+    canonical_func_visitor_t v(wm);
+    wf.func->visit(&v);
+}
+
 // deserialize function for 2.0 and before
 template <cluster_version_t W>
 archive_result_t deserialize(read_stream_t *s, wire_func_t *wf) {
@@ -39,6 +39,7 @@ public:
     friend archive_result_t deserialize(read_stream_t *s, wire_func_t *wf);
     template <cluster_version_t W>
     friend archive_result_t deserialize_wire_func(read_stream_t *s, wire_func_t *wf);
+    friend void serialize_canonical_func(write_message_t *wm, const wire_func_t &wf);
 
     bool is_simple_selector() const;
 private:
@@ -49,6 +50,12 @@ private:
     counted_t<const func_t> func;
 };
 
+// Writes `wf` like `serialize` does, except that the variables of a ReQL function are
+// numbered in the order they first appear in it.  Functions that only differ in
+// their variable ids are written the same way.  The result can't be deserialized; it's
+// only good for comparing or hashing functions.
+void serialize_canonical_func(write_message_t *wm, const wire_func_t &wf);
+
 class maybe_wire_func_t {
 protected:
     template<class... Args>
@@ -0,0 +1,106 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "serializer/log/block_codec.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "math.hpp"
+
+bool compress_block(block_codec_t codec,
+                    const ser_buffer_t *buf,
+                    block_size_t block_size,
+                    scoped_device_block_aligned_ptr_t<char> *out,
+                    block_size_t *disk_block_size_out) {
+    const uint32_t aligned_size = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
+    // Anything that doesn't fit into one device block less than the uncompressed
+    // block isn't worth keeping.
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return false;
+    }
+    const uint32_t max_disk_size = aligned_size - DEVICE_BLOCK_SIZE;
+    if (max_disk_size <= sizeof(ls_compressed_buf_header_t)) {
+        return false;
+    }
+
+    scoped_device_block_aligned_ptr_t<char> encoded(aligned_size);
+    ls_compressed_buf_header_t *header
+        = reinterpret_cast<ls_compressed_buf_header_t *>(encoded.get());
+    header->block_id = buf->ser_header.block_id;
+    header->codec = static_cast<uint8_t>(codec);
+    memset(header->padding, 0, sizeof(header->padding));
+    header->ser_block_size = block_size.ser_value();
+
+    // We give the compressor only as much room as would still save us a device
+    // block, so that it gives up early on incompressible data.
+    size_t compressed_size;
+    switch (codec) {
+    case block_codec_t::zlib: {
+        uLongf dest_len = max_disk_size - sizeof(ls_compressed_buf_header_t);
+        int res = compress2(reinterpret_cast<Bytef *>(header->compressed_data),
+                            &dest_len,
+                            reinterpret_cast<const Bytef *>(buf->cache_data),
+                            block_size.value(),
+                            Z_BEST_SPEED);
+        if (res == Z_BUF_ERROR) {
+            return false;
+        }
+        guarantee(res == Z_OK, "zlib failed to compress a block (error %d)", res);
+        compressed_size = dest_len;
+    } break;
+    case block_codec_t::none:
+    default:
+        unreachable();
+    }
+
+    const uint32_t disk_size = sizeof(ls_compressed_buf_header_t) + compressed_size;
+    guarantee(disk_size <= max_disk_size);
+    memset(encoded.get() + disk_size, 0,
+           ceil_aligned(disk_size, DEVICE_BLOCK_SIZE) - disk_size);
+
+    *out = std::move(encoded);
+    *disk_block_size_out = block_size_t::unsafe_make(disk_size);
+    return true;
+}
+
+void decompress_block(const char *data,
+                      block_size_t disk_block_size,
+                      block_size_t block_size,
+                      ser_buffer_t *buf_out) {
+    guarantee(disk_block_size.ser_value() > sizeof(ls_compressed_buf_header_t));
+    const ls_compressed_buf_header_t *header
+        = reinterpret_cast<const ls_compressed_buf_header_t *>(data);
+    guarantee(header->ser_block_size == block_size.ser_value(),
+              "Compressed block %" PR_BLOCK_ID " has size %" PRIu32
+              " in its header, but %" PRIu32 " in the index.",
+              header->block_id, header->ser_block_size, block_size.ser_value());
+
+    buf_out->ser_header.block_id = header->block_id;
+    const size_t compressed_size
+        = disk_block_size.ser_value() - sizeof(ls_compressed_buf_header_t);
+
+    switch (static_cast<block_codec_t>(header->codec)) {
+    case block_codec_t::zlib: {
+        uLongf dest_len = block_size.value();
+        int res = uncompress(reinterpret_cast<Bytef *>(buf_out->cache_data),
+                             &dest_len,
+                             reinterpret_cast<const Bytef *>(header->compressed_data),
+                             compressed_size);
+        guarantee(res == Z_OK && dest_len == block_size.value(),
+                  "Corrupted compressed block %" PR_BLOCK_ID " (zlib error %d).",
+                  header->block_id, res);
+    } break;
+    case block_codec_t::none:
+    default:
+        crash("Compressed block %" PR_BLOCK_ID " has unknown codec %d.",
+              header->block_id, static_cast<int>(header->codec));
+    }
+}
+
+block_size_t compressed_block_size_from_header(const char *data) {
+    const ls_compressed_buf_header_t *header
+        = reinterpret_cast<const ls_compressed_buf_header_t *>(data);
+    return block_size_t::unsafe_make(header->ser_block_size);
+}
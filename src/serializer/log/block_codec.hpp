@@ -0,0 +1,61 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_BLOCK_CODEC_HPP_
+#define SERIALIZER_LOG_BLOCK_CODEC_HPP_
+
+#include "arch/compiler.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
+
+/* Data blocks can optionally be stored compressed on disk.  This is invisible above
+the data block manager: block tokens and the LBA keep carrying the block's real size,
+which is what the cache works with, and additionally know how many bytes the block
+occupies on disk.  A block whose on-disk size is smaller than its real size is
+compressed.  Uncompressed blocks are laid out exactly as before, so files written
+without compression remain readable, and a single file can contain both kinds of
+blocks (for example after compression has been turned on for an existing table).
+
+Note that older versions of RethinkDB cannot read files that contain compressed
+blocks. */
+
+enum class block_codec_t : uint8_t {
+    // Blocks are written as is.  This is the default.
+    none = 0,
+    // Blocks are compressed with zlib's deflate, tuned for speed.
+    zlib = 1
+};
+
+/* The header of a compressed block on disk.  Its first field is the block id, at the
+same position as in an uncompressed block (see `ls_buf_data_t`), so that the GC and
+read-ahead can identify blocks without looking at how they are stored. */
+ATTR_PACKED(struct ls_compressed_buf_header_t {
+    block_id_t block_id;
+    // A `block_codec_t`.
+    uint8_t codec;
+    uint8_t padding[3];
+    // The size of the block after decompressing, in `block_size_t::ser_value()` units.
+    uint32_t ser_block_size;
+    char compressed_data[];
+});
+
+/* Compresses the `block_size` bytes at `buf` using `codec`.  Compression only pays off
+if it saves at least one device block, since blocks are aligned to device blocks on
+disk.  If it does, returns true, and puts the DEVICE_BLOCK_SIZE-aligned and
+zero-padded encoding into `*out` and its unpadded size into `*disk_block_size_out`.
+Otherwise returns false. */
+bool compress_block(block_codec_t codec,
+                    const ser_buffer_t *buf,
+                    block_size_t block_size,
+                    scoped_device_block_aligned_ptr_t<char> *out,
+                    block_size_t *disk_block_size_out);
+
+/* Decompresses the `disk_block_size` bytes at `data` into `buf_out`, which must have
+room for `block_size` bytes.  Crashes if the block turns out to be corrupted. */
+void decompress_block(const char *data,
+                      block_size_t disk_block_size,
+                      block_size_t block_size,
+                      ser_buffer_t *buf_out);
+
+/* Returns the size the compressed block at `data` has after decompressing. */
+block_size_t compressed_block_size_from_header(const char *data);
+
+#endif  // SERIALIZER_LOG_BLOCK_CODEC_HPP_
@@ -6,6 +6,7 @@
 
 #include "config/args.hpp"
 #include "containers/archive/archive.hpp"
+#include "serializer/log/block_codec.hpp"
 #include "serializer/types.hpp"
 #include "rpc/serialize_macros.hpp"
 
@@ -15,6 +16,8 @@ struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        block_codec = block_codec_t::none;
+        lba_snapshot_interval_ms = LBA_SNAPSHOT_INTERVAL_MS;
     }
 
     /* The (minimal) batch size of i/o requests being taken from a single i/o account.
@@ -24,6 +27,15 @@ struct log_serializer_dynamic_config_t {
 
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
+
+    /* How to compress data blocks that we write.  Blocks that have already been
+    written are read back correctly no matter what this is set to. */
+    block_codec_t block_codec;
+
+    /* How often to write a snapshot of the LBA index while the serializer is idle,
+    or 0 to only write one on clean shutdown.  If this is negative, we never write
+    snapshots and always replay the LBA at startup. */
+    int64_t lba_snapshot_interval_ms;
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
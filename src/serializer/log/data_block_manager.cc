@@ -13,6 +13,7 @@
 #include "errors.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/block_codec.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "stl_utils.hpp"
 
@@ -50,6 +51,9 @@ constexpr double GC_HIGH_RATIO = 0.3;
 const size_t GC_YOUNG_EXTENT_MAX_SIZE = 50;
 // What's the definition of a "young" extent in microseconds?
 const microtime_t GC_YOUNG_EXTENT_TIMELIMIT_MICROS = 50000;
+// How often do we recompute the GC scores of old extents, so that their age is
+// accounted for?
+const microtime_t GC_SCORE_REFRESH_INTERVAL_MICROS = 10 * MILLION;
 
 
 // Identifies an extent, the time we started writing to the
@@ -59,9 +63,13 @@ class gc_entry_t : public intrusive_list_node_t<gc_entry_t> {
 private:
     struct block_info_t {
         uint32_t relative_offset;
+        // The size of the block on disk.
         block_size_t block_size;
         bool token_referenced;
         bool index_referenced;
+        // Whether the block is stored compressed.  Its uncompressed size is then
+        // found in its header.
+        bool compressed;
     };
 
 public:
@@ -70,6 +78,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->gen_extent()),
           timestamp(current_microtime()),
+          gc_score(0.0),
           was_written(false),
           state(state_active),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -84,6 +93,7 @@ public:
         : parent(_parent),
           extent_ref(parent->extent_manager->reserve_extent(_offset)),
           timestamp(current_microtime()),
+          gc_score(0.0),
           was_written(false),
           state(state_reconstructing),
           garbage_bytes_stat(_parent->static_config->extent_size()),
@@ -128,7 +138,7 @@ public:
             + aligned_value(block_infos.back().block_size);
     }
 
-    // Returns the ostensible size of the block_index'th block.  Note that
+    // Returns the ostensible size of the block_index'th block on disk.  Note that
     // block_boundaries[i] + block_size(i) <= block_boundaries[i + 1].
     block_size_t block_size(unsigned int _block_index) const {
         guarantee(state != state_reconstructing);
@@ -136,6 +146,12 @@ public:
         return block_infos[_block_index].block_size;
     }
 
+    bool block_is_compressed(unsigned int _block_index) const {
+        guarantee(state != state_reconstructing);
+        guarantee(_block_index < block_infos.size());
+        return block_infos[_block_index].compressed;
+    }
+
     // Returns block_boundaries()[block_index].
     uint32_t relative_offset(unsigned int _block_index) const {
         guarantee(state != state_reconstructing);
@@ -155,6 +171,7 @@ public:
     }
 
     bool new_offset(block_size_t _block_size,
+                    bool _compressed,
                     uint32_t *relative_offset_out,
                     unsigned int *block_index_out) {
         // Returns true if there's enough room at the end of the extent for the new
@@ -170,7 +187,8 @@ public:
         } else {
             *relative_offset_out = offset;
             *block_index_out = block_infos.size();
-            block_infos.push_back(block_info_t{offset, _block_size, false, false});
+            block_infos.push_back(
+                block_info_t{offset, _block_size, false, false, _compressed});
             update_stats(nullptr, &block_infos.back());
             return true;
         }
@@ -195,6 +213,22 @@ public:
         return garbage_bytes_stat;
     }
 
+    // Computes the cost-benefit score of collecting this extent, as of
+    // `score_time`.  Following LFS, the benefit of collecting an extent is the
+    // space it frees, weighted by how long its data has remained unchanged, and the
+    // cost is reading the whole extent and writing back its live part:
+    // score = garbage * age / (1 + live).  Extents that are old and mostly garbage
+    // are collected first, while extents whose data is still changing are given a
+    // chance to become more empty on their own.
+    void update_gc_score(microtime_t score_time) {
+        const double garbage = static_cast<double>(garbage_bytes())
+            / parent->static_config->extent_size();
+        const double age_secs = score_time > timestamp
+            ? static_cast<double>(score_time - timestamp) / MILLION
+            : 0.0;
+        gc_score = garbage * (1.0 + age_secs) / (2.0 - garbage);
+    }
+
     bool block_is_garbage(unsigned int _block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(_block_index < block_infos.size());
@@ -239,22 +273,26 @@ public:
                                 &gc_entry_t::info_less);
     }
 
-    void mark_live_indexwise_with_offset(int64_t offset, block_size_t _block_size) {
+    void mark_live_indexwise_with_offset(int64_t offset, block_size_t _block_size,
+                                         bool _compressed) {
         guarantee(offset >= extent_ref.offset() && offset < extent_ref.offset() + UINT32_MAX);
 
         uint32_t _relative_offset = offset - extent_ref.offset();
 
         auto it = find_lower_bound_iter(_relative_offset);
         if (it == block_infos.end()) {
-            block_infos.push_back(block_info_t{_relative_offset, _block_size, false, true});
+            block_infos.push_back(
+                block_info_t{_relative_offset, _block_size, false, true, _compressed});
             update_stats(nullptr, &block_infos.back());
         } else if (it->relative_offset > _relative_offset) {
             guarantee(it->relative_offset >= _relative_offset + aligned_value(_block_size));
-            auto new_block = block_infos.insert(it, block_info_t{_relative_offset, _block_size, false, true});
+            auto new_block = block_infos.insert(
+                it, block_info_t{_relative_offset, _block_size, false, true, _compressed});
             update_stats(nullptr, &*new_block);
         } else {
             guarantee(it->relative_offset == _relative_offset);
             guarantee(it->block_size == _block_size);
+            guarantee(it->compressed == _compressed);
             const block_info_t old_info = *it;
             it->index_referenced = true;
             update_stats(&old_info, &*it);
@@ -293,11 +331,12 @@ public:
         const int64_t offset = extent_ref.offset();
         std::string ret;
         for (auto it = block_infos.begin(); it != block_infos.end(); ++it) {
-            ret += strprintf("%s[%" PRIi64 "..+%" PRIu32 ") %c%c",
+            ret += strprintf("%s[%" PRIi64 "..+%" PRIu32 ") %c%c%c",
                              it == block_infos.begin() ? "" : separator,
                              offset + it->relative_offset, it->block_size.ser_value(),
                              it->token_referenced ? 'T' : ' ',
-                             it->index_referenced ? 'I' : ' ');
+                             it->index_referenced ? 'I' : ' ',
+                             it->compressed ? 'C' : ' ');
         }
         return ret;
     }
@@ -349,6 +388,9 @@ public:
     // When we started writing to the extent (this time).
     const microtime_t timestamp;
 
+    // The last value computed by update_gc_score().  Orders the extents in gc_pq.
+    double gc_score;
+
     // The PQ entry pointing to us.
     priority_queue_t<gc_entry_t *, gc_entry_less_t>::entry_t *our_pq_entry;
 
@@ -359,7 +401,7 @@ public:
         // It has been, or is being, reconstructed from data on disk.
         state_reconstructing,
         // We are currently putting things on this extent. It is equal to
-        // last_data_extent.
+        // active_extent or gc_active_extent.
         state_active,
         // Not active, but not a GC candidate yet. It is in young_extent_queue.
         state_young,
@@ -391,6 +433,7 @@ data_block_manager_t::data_block_manager_t(
     : stats(_stats), shutdown_callback(nullptr), state(state_unstarted),
       gc_enabled(true), static_config(_static_config), extent_manager(em),
       serializer(_serializer),
+      gc_score_time(current_microtime()),
       gc_index_write_pumper(std::bind(
           &data_block_manager_t::flush_gc_index_writes, this, std::placeholders::_1)),
       /* The capacity of the gc_index_write_semaphore will be scaled
@@ -419,7 +462,8 @@ void data_block_manager_t::start_reconstruct() {
 // gc_entry_t in the entries table.  (This is used when we start up, when
 // everything is presumed to be garbage, until we mark it as
 // non-garbage.)
-void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size) {
+void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size,
+                                     block_size_t disk_block_size) {
     uint64_t extent_id = static_config->extent_index(offset);
 
     if (entries.get(extent_id) == nullptr) {
@@ -430,7 +474,8 @@ void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size
     }
 
     gc_entry_t *entry = entries.get(extent_id);
-    entry->mark_live_indexwise_with_offset(offset, ser_block_size);
+    entry->mark_live_indexwise_with_offset(offset, disk_block_size,
+                                           disk_block_size != ser_block_size);
 }
 
 void data_block_manager_t::end_reconstruct() {
@@ -467,6 +512,7 @@ void data_block_manager_t::start_existing(file_t *file,
     } else {
         active_extent = nullptr;
     }
+    gc_active_extent = nullptr;
 
     /* Convert any extents that we found live blocks in, but that are not active
     extents, into old extents */
@@ -476,6 +522,7 @@ void data_block_manager_t::start_existing(file_t *file,
         guarantee(entry->state == gc_entry_t::state_reconstructing);
         entry->state = gc_entry_t::state_old;
 
+        entry->update_gc_score(gc_score_time);
         entry->our_pq_entry = gc_pq.push(entry);
 
         gc_stats.old_total_block_bytes += static_config->extent_size();
@@ -573,6 +620,16 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+// Copies the block stored at `data` into `buf_out`, decompressing it if necessary.
+void decode_block(const char *data, block_size_t block_size,
+                  block_size_t disk_block_size, ser_buffer_t *buf_out) {
+    if (disk_block_size == block_size) {
+        memcpy(buf_out, data, block_size.ser_value());
+    } else {
+        decompress_block(data, disk_block_size, block_size, buf_out);
+    }
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -586,8 +643,9 @@ public:
 
     static void perform_read_ahead(data_block_manager_t *const parent,
                                    const int64_t off_in,
-                                   const uint32_t ser_block_size_in,
-                                   void *const buf_out,
+                                   const block_size_t block_size_in,
+                                   const block_size_t disk_block_size_in,
+                                   ser_buffer_t *const buf_out,
                                    file_account_t *const io_account,
                                    log_serializer_stats_t *const stats) {
         const std::vector<uint32_t> boundaries = get_boundaries(parent, off_in);
@@ -597,7 +655,7 @@ public:
 
         // Finish initialization.
         read_ahead_offset_and_size(off_in,
-                                   ser_block_size_in,
+                                   disk_block_size_in.ser_value(),
                                    parent->static_config->extent_size(),
                                    boundaries,
                                    &read_ahead_offset,
@@ -634,7 +692,7 @@ public:
             if (current_offset == off_in) {
                 guarantee(!handled_required_block);
 
-                memcpy(buf_out, current_buf, ser_block_size_in);
+                decode_block(current_buf, block_size_in, disk_block_size_in, buf_out);
                 handled_required_block = true;
             } else {
                 const block_id_t block_id
@@ -651,14 +709,17 @@ public:
                 }
 
                 const block_size_t block_size = block_size_t::unsafe_make(info.ser_block_size);
+                const block_size_t disk_block_size
+                    = block_size_t::unsafe_make(info.disk_block_size());
+                guarantee(disk_block_size.ser_value() <= *(lower_it + 1) - *lower_it);
                 buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_size);
-                memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
+                decode_block(current_buf, block_size, disk_block_size, buf.ser_buffer());
                 buf.fill_padding_zero();
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size);
+                                                               block_size,
+                                                               disk_block_size);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, std::move(ls_token));
@@ -686,18 +747,33 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
 }
 
 buf_ptr_t data_block_manager_t::read(int64_t off_in, block_size_t block_size,
-                                   file_account_t *io_account) {
+                                     block_size_t disk_block_size,
+                                     file_account_t *io_account) {
     guarantee(state == state_ready);
     if (should_perform_read_ahead(off_in)) {
         buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
-        dbm_read_ahead_t::perform_read_ahead(this, off_in, block_size.ser_value(),
+        dbm_read_ahead_t::perform_read_ahead(this, off_in, block_size, disk_block_size,
                                              ret.ser_buffer(), io_account, stats);
         // We have to fill the padding with zero, since only the first part of the
         // buf got memcpy'd into.
         ret.fill_padding_zero();
         return ret;
     } else {
-        if (divides(DEVICE_BLOCK_SIZE, off_in)) {
+        if (disk_block_size != block_size) {
+            // The block is compressed.  Compressed blocks are always written at
+            // DEVICE_BLOCK_SIZE-aligned offsets.
+            guarantee(divides(DEVICE_BLOCK_SIZE, off_in));
+            const int64_t aligned_disk_size
+                = ceil_aligned(disk_block_size.ser_value(), DEVICE_BLOCK_SIZE);
+            scoped_device_block_aligned_ptr_t<char> buf(aligned_disk_size);
+            co_read(dbfile, off_in, aligned_disk_size, buf.get(), io_account);
+            stats->bytes_read(aligned_disk_size);
+
+            buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+            decompress_block(buf.get(), disk_block_size, block_size, ret.ser_buffer());
+            ret.fill_padding_zero();
+            return ret;
+        } else if (divides(DEVICE_BLOCK_SIZE, off_in)) {
             buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
             co_read(dbfile, off_in, ret.aligned_block_size(),
                     ret.ser_buffer(), io_account);
@@ -729,13 +805,60 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        it->buf->ser_header.block_id = it->block_id;
+    }
+
+    const block_codec_t codec = serializer->dynamic_config.block_codec;
+
+    std::vector<dbm_write_info_t> disk_writes;
+    disk_writes.reserve(writes.size());
+    std::vector<scoped_device_block_aligned_ptr_t<char> > encoded_bufs;
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        scoped_device_block_aligned_ptr_t<char> encoded;
+        block_size_t disk_block_size = block_size_t::undefined();
+        if (codec != block_codec_t::none
+            && compress_block(codec, it->buf, it->block_size,
+                              &encoded, &disk_block_size)) {
+            disk_writes.push_back(dbm_write_info_t(
+                reinterpret_cast<ser_buffer_t *>(encoded.get()),
+                it->block_size, disk_block_size));
+            encoded_bufs.push_back(std::move(encoded));
+
+            ++stats->pm_serializer_compressed_block_writes;
+            stats->pm_serializer_compression_saved_bytes
+                += gc_entry_t::aligned_value(it->block_size)
+                - gc_entry_t::aligned_value(disk_block_size);
+        } else {
+            disk_writes.push_back(dbm_write_info_t(it->buf, it->block_size,
+                                                   it->block_size));
+        }
+    }
+
+    return write_blocks(disk_writes, std::move(encoded_bufs), write_origin_t::user,
+                        io_account, cb);
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks(
+        const std::vector<dbm_write_info_t> &writes,
+        std::vector<scoped_device_block_aligned_ptr_t<char> > &&encoded_bufs,
+        write_origin_t origin,
+        file_account_t *io_account,
+        iocallback_t *cb) {
     // These tokens are grouped by extent.  You can do a contiguous write in each
     // extent.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
+        = gimme_some_new_offsets(writes, origin);
 
+    int64_t bytes_written = 0;
     for (auto it = writes.begin(); it != writes.end(); ++it) {
-        it->buf->ser_header.block_id = it->block_id;
+        bytes_written += gc_entry_t::aligned_value(it->disk_block_size);
+    }
+    if (origin == write_origin_t::gc) {
+        stats->pm_serializer_gc_block_bytes_written += bytes_written;
+    } else {
+        stats->pm_serializer_user_block_bytes_written += bytes_written;
     }
 
     struct intermediate_cb_t : public iocallback_t {
@@ -750,6 +873,8 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         size_t ops_remaining;
         iocallback_t *cb;
+        // Freed once all writes are done.
+        std::vector<scoped_device_block_aligned_ptr_t<char> > encoded_bufs;
     };
 
     intermediate_cb_t *const intermediate_cb = new intermediate_cb_t;
@@ -757,13 +882,14 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
     // intermediate_cb->on_io_complete later.
     intermediate_cb->ops_remaining = token_groups.size() + 1;
     intermediate_cb->cb = cb;
+    intermediate_cb->encoded_bufs = std::move(encoded_bufs);
 
     size_t write_number = 0;
     for (size_t i = 0; i < token_groups.size(); ++i) {
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->disk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -776,14 +902,14 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->disk_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
             total_aligned_size += j_aligned_size;
 
             // The behavior of gimme_some_new_offsets is supposed to retain order, so
             // we expect writes[write_number] to have the currently-relevant write.
-            guarantee(writes[write_number].block_size == j_block_size);
+            guarantee(writes[write_number].disk_block_size == j_block_size);
 
             iovecs[j].iov_base = writes[write_number].buf;
             iovecs[j].iov_len = j_aligned_size;
@@ -874,6 +1000,7 @@ void data_block_manager_t::check_and_handle_empty_extent(uint64_t extent_id) {
         destroy_entry(entry);
 
     } else if (entry->state == gc_entry_t::state_old) {
+        entry->update_gc_score(gc_score_time);
         entry->our_pq_entry->update();
     }
 }
@@ -1064,6 +1191,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
 
         /* grab the entry */
         guarantee (!gc_pq.empty());
+        maybe_refresh_gc_scores();
         guarantee(gc_state->current_entry == nullptr);
         gc_state->current_entry = gc_pq.pop();
         gc_state->current_entry->our_pq_entry = nullptr;
@@ -1177,8 +1305,16 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
                     gc_state->current_entry->extent_ref.offset()
                     + gc_state->current_entry->relative_offset(i);
 
+                const block_size_t disk_block_size
+                    = gc_state->current_entry->block_size(i);
+                const block_size_t block_size
+                    = gc_state->current_entry->block_is_compressed(i)
+                    ? compressed_block_size_from_header(
+                        reinterpret_cast<const char *>(block))
+                    : disk_block_size;
+
                 gc_writes.push_back(gc_write_t(block, block_offset,
-                    gc_state->current_entry->block_size(i)));
+                                               block_size, disk_block_size));
             }
             guarantee(gc_writes.size() == num_writes);
         }
@@ -1235,19 +1371,24 @@ void data_block_manager_t::write_gcs(
         // Step 1: Write buffers to disk and assemble index operations
         ASSERT_NO_CORO_WAITING;
 
-        std::vector<buf_write_info_t> the_writes;
+        std::vector<dbm_write_info_t> the_writes;
         the_writes.reserve(writes.size());
         for (size_t i = 0; i < writes.size(); ++i) {
-            old_block_tokens.push_back(serializer->generate_block_token(writes[i].old_offset,
-                                                                        writes[i].block_size));
+            old_block_tokens.push_back(serializer->generate_block_token(
+                writes[i].old_offset, writes[i].block_size, writes[i].disk_block_size));
 
-            the_writes.push_back(buf_write_info_t(writes[i].buf,
+            the_writes.push_back(dbm_write_info_t(writes[i].buf,
                                                   writes[i].block_size,
-                                                  writes[i].buf->ser_header.block_id));
+                                                  writes[i].disk_block_size));
         }
 
-        new_block_tokens = many_writes(the_writes, choose_gc_io_account(),
-                                       &block_write_cond);
+        // The blocks are copied exactly as they are on disk, so compressed blocks
+        // don't get decompressed and compressed again.
+        new_block_tokens = write_blocks(the_writes,
+                                        std::vector<scoped_device_block_aligned_ptr_t<char> >(),
+                                        write_origin_t::gc,
+                                        choose_gc_io_account(),
+                                        &block_write_cond);
 
         guarantee(new_block_tokens.size() == writes.size());
     }
@@ -1401,6 +1542,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = nullptr;
     }
 
+    if (gc_active_extent != nullptr) {
+        UNUSED int64_t extent = gc_active_extent->extent_ref.release();
+        delete gc_active_extent;
+        gc_active_extent = nullptr;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1419,17 +1566,22 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<dbm_write_info_t> &writes,
+                                             write_origin_t origin) {
     ASSERT_NO_CORO_WAITING;
 
+    gc_entry_t *&active = origin == write_origin_t::gc
+        ? gc_active_extent
+        : active_extent;
+
     // Start a new extent if necessary.
-    if (active_extent == nullptr) {
-        active_extent = new gc_entry_t(this);
+    if (active == nullptr) {
+        active = new gc_entry_t(this);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(active->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1437,25 +1589,27 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        const bool compressed = it->disk_block_size != it->block_size;
+        if (!active->new_offset(it->disk_block_size, compressed,
+                                &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
-                destroy_entry(old_active_extent);
+            if (active->num_live_blocks() == 0) {
+                gc_entry_t *old_active = active;
+                active = new gc_entry_t(this);
+                destroy_entry(old_active);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                active->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(active);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                active = new gc_entry_t(this);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = active->new_offset(it->disk_block_size,
+                                                      compressed,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1465,11 +1619,12 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = active->extent_ref.offset() + relative_offset;
+        active->was_written = true;
+        active->mark_live_tokenwise(block_index);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+        tokens.push_back(serializer->generate_block_token(offset, it->block_size,
+                                                          it->disk_block_size));
     }
 
     if (!tokens.empty()) {
@@ -1509,12 +1664,25 @@ void data_block_manager_t::remove_last_unyoung_entry() {
     guarantee(entry->state == gc_entry_t::state_young);
     entry->state = gc_entry_t::state_old;
 
+    entry->update_gc_score(gc_score_time);
     entry->our_pq_entry = gc_pq.push(entry);
 
     gc_stats.old_total_block_bytes += static_config->extent_size();
     gc_stats.old_garbage_block_bytes += entry->garbage_bytes();
 }
 
+void data_block_manager_t::maybe_refresh_gc_scores() {
+    ASSERT_NO_CORO_WAITING;
+    const microtime_t now = current_microtime();
+    if (now < gc_score_time + GC_SCORE_REFRESH_INTERVAL_MICROS) {
+        return;
+    }
+    gc_score_time = now;
+    gc_pq.update_all([now](gc_entry_t *entry) {
+        entry->update_gc_score(now);
+    });
+}
+
 /* functions for gc structures */
 
 // Answers the following question: We're in the middle of gc'ing, and
@@ -1537,7 +1705,7 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_score < y->gc_score;
 }
 
 /****************
@@ -25,14 +25,38 @@ struct gc_entry_less_t {
     bool operator() (const gc_entry_t *x, const gc_entry_t *y);
 };
 
+/* A block write as it is laid out on disk.  `buf` holds `disk_block_size` bytes,
+padded with zeros to a multiple of DEVICE_BLOCK_SIZE.  These are either the block's
+contents, or its compressed encoding if `disk_block_size` is smaller than
+`block_size` (see block_codec.hpp). */
+struct dbm_write_info_t {
+    dbm_write_info_t(ser_buffer_t *_buf, block_size_t _block_size,
+                     block_size_t _disk_block_size)
+        : buf(_buf), block_size(_block_size), disk_block_size(_disk_block_size) { }
+    ser_buffer_t *buf;
+    block_size_t block_size;
+    block_size_t disk_block_size;
+};
+
+/* Blocks that the GC relocates have survived at least one GC, so they tend to be cold,
+while freshly written blocks are often overwritten again soon.  We write the two
+kinds into separate active extents, so that the GC doesn't have to keep copying cold
+blocks out of extents that are mostly garbage because of the hot ones. */
+enum class write_origin_t { user, gc };
+
 namespace data_block_manager {
 struct shutdown_callback_t;  // see log_serializer.hpp.
 struct metablock_mixin_t;  // see log_serializer.hpp.
 }  // namespace data_block_manager
 
+namespace unittest {
+void run_SerializerTest_GcPrefersOldExtents();
+}
+
 class data_block_manager_t {
     friend class gc_entry_t;
     friend class dbm_read_ahead_t;
+    friend void unittest::run_SerializerTest_GcPrefersOldExtents();
 
 public:
     data_block_manager_t(extent_manager_t *em, log_serializer_t *serializer,
@@ -48,7 +72,7 @@ public:
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
     buf_ptr_t read(int64_t off_in, block_size_t block_size,
-                 file_account_t *io_account);
+                   block_size_t disk_block_size, file_account_t *io_account);
 
     /* exposed gc api */
     /* mark a buffer as garbage */
@@ -56,7 +80,8 @@ public:
 
     /* r{start,end}_reconstruct functions for safety */
     void start_reconstruct();
-    void mark_live(int64_t offset, block_size_t block_size);
+    void mark_live(int64_t offset, block_size_t block_size,
+                   block_size_t disk_block_size);
     void end_reconstruct();
 
     /* We must make sure that blocks which have tokens pointing to them don't
@@ -81,19 +106,30 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    // Compresses the blocks if the serializer is configured to do so.
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
+    gimme_some_new_offsets(const std::vector<dbm_write_info_t> &writes,
+                           write_origin_t origin);
 
     bool is_gc_active() const;
 
 private:
     void actually_shutdown();
 
+    // Writes the blocks as they are.  `encoded_bufs` are buffers that `writes`
+    // point into and that must be kept alive until the writes are done.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks(const std::vector<dbm_write_info_t> &writes,
+                 std::vector<scoped_device_block_aligned_ptr_t<char> > &&encoded_bufs,
+                 write_origin_t origin,
+                 file_account_t *io_account,
+                 iocallback_t *cb);
+
     struct gc_state_t : public intrusive_list_node_t<gc_state_t>{
     public:
         // The entry we're currently GCing.
@@ -107,13 +143,16 @@ private:
     };
 
     struct gc_write_t {
+        // The block as found on disk, compressed or not.  The GC moves blocks
+        // around without recompressing them.
         ser_buffer_t *buf;
         int64_t old_offset;
         block_size_t block_size;
+        block_size_t disk_block_size;
         gc_write_t(ser_buffer_t *b, int64_t _old_offset,
-                   block_size_t _block_size)
+                   block_size_t _block_size, block_size_t _disk_block_size)
             : buf(b), old_offset(_old_offset),
-              block_size(_block_size) { }
+              block_size(_block_size), disk_block_size(_disk_block_size) { }
     };
 
     /* Runs in a coroutine and keeps calling `gc_one_extent()` for as long as
@@ -157,6 +196,10 @@ private:
 
     void destroy_entry(gc_entry_t *entry);
 
+    // Recomputes the GC scores of all extents in `gc_pq` if the current ones are
+    // outdated.
+    void maybe_refresh_gc_scores();
+
     bool should_perform_read_ahead(int64_t offset);
 
     log_serializer_stats_t *const stats;
@@ -191,8 +234,11 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contain the extents in the gc_entry_t::state_active state, one for each
+    `write_origin_t`.  Only `active_extent` is stored in the metablock.  After a
+    restart, the GC's active extent becomes an old extent like any other. */
     gc_entry_t *active_extent;
+    gc_entry_t *gc_active_extent;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -200,6 +246,9 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time as of which the GC scores of the extents in `gc_pq` are computed. */
+    microtime_t gc_score_time;
+
     /* \brief structure to keep track of global stats about the data blocks
      */
     class gc_stat_t {
@@ -64,9 +64,11 @@ ATTR_PACKED(struct lba_entry_t {
     // (It probably assumes that sizeof(lba_entry_t) evenly divides
     // DEVICE_BLOCK_SIZE).
 
-    // Put the zero-padding at the beginning of the LBA entry.  We could use this, or
-    // the first 16 bits, perhaps, as a version flag.
-    uint32_t zero_reserved;
+    // The number of bytes the block occupies on disk if it was stored compressed
+    // (see block_codec.hpp), or 0 if it's stored as is.  This used to be a reserved
+    // field that was always zero, so entries written before block compression
+    // existed read as uncompressed blocks.
+    uint32_t compressed_block_size;
 
     // This could be a uint16_t if you wanted it to be, as long as block sizes are
     // all less than or equal to 4K (which is less than 64K).
@@ -80,10 +82,12 @@ ATTR_PACKED(struct lba_entry_t {
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint32_t ser_block_size) {
+                            flagged_off64_t offset, uint32_t ser_block_size,
+                            uint32_t compressed_block_size) {
         guarantee(ser_block_size != 0 || !offset.has_value());
+        guarantee(compressed_block_size < ser_block_size || compressed_block_size == 0);
         lba_entry_t entry;
-        entry.zero_reserved = 0;
+        entry.compressed_block_size = compressed_block_size;
         entry.ser_block_size = ser_block_size;
         entry.block_id = block_id;
         entry.recency = recency;
@@ -96,7 +100,7 @@ ATTR_PACKED(struct lba_entry_t {
     }
 
     static lba_entry_t make_padding_entry() {
-        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0);
+        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0, 0);
     }
 });
 
@@ -128,7 +132,12 @@ ATTR_PACKED(struct lba_metablock_mixin_t {
      */
     lba_entry_t inline_lba_entries[LBA_NUM_INLINE_ENTRIES];
     int32_t inline_lba_entries_count;
-    int32_t padding;
+
+    /* The index of the first extent of the current snapshot of the in-memory index
+     * (see `lba_snapshot_header_t`), or 0 if there is none.  Extent 0 holds the static
+     * header, so it can never be the start of a snapshot.  This used to be a padding
+     * field that was always zero. */
+    int32_t snapshot_extent_index;
 });
 
 
@@ -188,6 +197,46 @@ struct lba_superblock_t {
 };
 
 
+#define LBA_SNAPSHOT_MAGIC_SIZE 8
+static const char lba_snapshot_magic[LBA_SNAPSHOT_MAGIC_SIZE] = {'l', 'b', 'a', 's', 'n', 'a', 'p', '1'};
+
+ATTR_PACKED(struct lba_snapshot_extent_t {
+    int64_t offset;
+    int32_t entries_count;
+    // The CRC of the `entries_count` LBA entries at the start of the extent.
+    uint32_t crc;
+});
+
+/* A snapshot is a compacted copy of the in-memory index, stored as one LBA entry per
+ * block.  It is only used at startup, and only if the LBA hasn't changed since the
+ * snapshot was taken.  In that case we can load it instead of replaying all the LBA
+ * extents.  The LBA extents stay the authoritative copy of the index either way.
+ *
+ * The header fills the first extent of the snapshot.  The entries are stored in
+ * separate extents, which are ordered by shard: the first `shard_extents_count[0]`
+ * extents only hold entries of shard 0, the next `shard_extents_count[1]` extents
+ * those of shard 1 and so on. */
+ATTR_PACKED(struct lba_snapshot_header_t {
+    char magic[LBA_SNAPSHOT_MAGIC_SIZE];
+
+    // The CRC of the remainder of the header, starting at `extents_count`.
+    uint32_t crc;
+
+    int32_t extents_count;
+    int32_t shard_extents_count[LBA_SHARD_FACTOR];
+
+    // The LBA metablock that the snapshot is equivalent to, with
+    // `snapshot_extent_index` set to 0.
+    lba_metablock_mixin_t lba_state;
+
+    lba_snapshot_extent_t extents[0];
+
+    static size_t size(int32_t extents_count) {
+        return offsetof(lba_snapshot_header_t, extents[0])
+            + sizeof(lba_snapshot_extent_t) * extents_count;
+    }
+});
+
 
 #endif  // SERIALIZER_LOG_LBA_DISK_FORMAT_HPP_
 
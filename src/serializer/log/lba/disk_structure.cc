@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/lba/disk_structure.hpp"
 
+#include "arch/io/blocker_pool.hpp"
+#include "arch/runtime/runtime.hpp"
 #include "containers/scoped.hpp"
 #include "math.hpp"
 
@@ -66,6 +68,7 @@ void lba_disk_structure_t::on_extent_read() {
 
 void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t recency,
                                      flagged_off64_t offset, uint32_t ser_block_size,
+                                     uint32_t compressed_block_size,
                                      file_account_t *io_account, extent_transaction_t *txn) {
     if (last_extent && last_extent->full()) {
         /* We have filled up an extent. Transfer it to the superblock. */
@@ -84,7 +87,9 @@ void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t rece
 
     rassert(!last_extent->full());
 
-    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size), io_account);
+    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size,
+                                             compressed_block_size),
+                           io_account);
 }
 
 std::set<lba_disk_extent_t *> lba_disk_structure_t::get_inactive_extents() const {
@@ -195,11 +200,15 @@ struct reader_t
 {
     lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
+    blocker_pool_t *replay_pool;   // Where to apply the extents to the index, or NULL
+    threadnum_t home_thread;   // The thread that `read()` was called on
     lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
 
     /* extent_reader_t takes care of reading a single extent. */
     struct extent_reader_t :
-        public extent_t::read_callback_t
+        public extent_t::read_callback_t,
+        public blocker_pool_t::job_t,
+        public linux_thread_message_t
     {
         reader_t *parent;   // Our reader_t that we were created by
         int index;   // parent->readers[index] = this
@@ -233,15 +242,37 @@ struct reader_t
         void on_extent_read() {   // Called when our extent has been read from disk
             rassert(!have_read);
             have_read = true;
-            if (prev_done) done();
+            if (prev_done) replay();
         }
         void on_prev_done() {   // Called by the previous extent_reader_t when it finishes
             rassert(!prev_done);
             prev_done = true;
-            if (have_read) done();
+            if (have_read) replay();
         }
-        void done() {
+        void replay() {
+            /* Applying the extent's entries is where most of the startup time goes for
+            large LBAs. If we have a replay pool, we do it there, so that the other
+            shards can be replayed at the same time and we can keep reading ahead in
+            the meantime. */
+            if (parent->replay_pool != nullptr) {
+                parent->replay_pool->do_job(this);
+            } else {
+                run();
+                on_replayed();
+            }
+        }
+        void run() {   // Called in the replay pool
             extent->read_step_2(&read_info, parent->index);
+        }
+        void done() {   // Called on the thread that owns the replay pool
+            if (continue_on_thread(parent->home_thread, this)) {
+                on_replayed();
+            }
+        }
+        void on_thread_switch() {
+            on_replayed();
+        }
+        void on_replayed() {
             parent->active_readers--;
             parent->start_more_readers();
             if (index == static_cast<int>(parent->readers.size()) - 1) {
@@ -260,8 +291,10 @@ struct reader_t
     // reading process so that we stay under LBA_READ_BUFFER_SIZE.
     int active_readers;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index,
+             blocker_pool_t *_replay_pool, lba_disk_structure_t::read_callback_t *cb)
+        : ds(_ds), index(_index), replay_pool(_replay_pool), home_thread(get_thread_id()),
+          rcb(cb)
     {
         for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
              e != nullptr; e = ds->extents_in_superblock.next(e)) {
@@ -295,8 +328,9 @@ struct reader_t
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read(in_memory_index_t *index, blocker_pool_t *replay_pool,
+                                read_callback_t *cb) {
+    new reader_t(this, index, replay_pool, cb);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
@@ -3,48 +3,74 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "serializer/log/lba/disk_format.hpp"
 
-in_memory_index_t::in_memory_index_t()
-    : end_block_id_(0), end_aux_block_id_(FIRST_AUX_BLOCK_ID) { }
+in_memory_index_t::shard_t::shard_t()
+    : end_block_id(0), end_aux_block_id(FIRST_AUX_BLOCK_ID) { }
+
+in_memory_index_t::in_memory_index_t() { }
 
 block_id_t in_memory_index_t::end_block_id() {
-    return end_block_id_;
+    block_id_t res = 0;
+    for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+        res = std::max(res, shards_[i].end_block_id);
+    }
+    return res;
 }
 
 block_id_t in_memory_index_t::end_aux_block_id() {
-    return end_aux_block_id_;
+    block_id_t res = FIRST_AUX_BLOCK_ID;
+    for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+        res = std::max(res, shards_[i].end_aux_block_id);
+    }
+    return res;
 }
 
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
+    shard_t *shard = &shards_[id % LBA_SHARD_FACTOR];
     if (is_aux_block_id(id)) {
-        index_aux_block_info_t aux_info = aux_infos_.get(make_aux_block_id_relative(id));
+        index_aux_block_info_t aux_info = shard->aux_infos.get(
+            make_aux_block_id_relative(id) / LBA_SHARD_FACTOR);
         return index_block_info_t(aux_info.offset,
                                   repli_timestamp_t::invalid,
-                                  aux_info.ser_block_size);
+                                  aux_info.ser_block_size,
+                                  aux_info.compressed_block_size);
     } else {
-        return infos_.get(id);
+        return shard->infos.get(id / LBA_SHARD_FACTOR);
     }
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
-                                       flagged_off64_t offset, uint16_t ser_block_size) {
+                                       flagged_off64_t offset, uint16_t ser_block_size,
+                                       uint16_t compressed_block_size) {
+    shard_t *shard = &shards_[id % LBA_SHARD_FACTOR];
     if (is_aux_block_id(id)) {
-        if (id >= end_aux_block_id_) {
-            end_aux_block_id_ = id + 1;
+        if (id >= shard->end_aux_block_id) {
+            shard->end_aux_block_id = id + 1;
         }
         // If you're trying to set the timestamp of  an aux block to anything
         // other than `invalid`, you might be doing something wrong. It will be
         // discarded anyway.
         rassert(recency == repli_timestamp_t::invalid);
-        index_aux_block_info_t info(offset, ser_block_size);
-        aux_infos_.set(make_aux_block_id_relative(id), info);
+        index_aux_block_info_t info(offset, ser_block_size, compressed_block_size);
+        shard->aux_infos.set(make_aux_block_id_relative(id) / LBA_SHARD_FACTOR, info);
     } else {
-        if (id >= end_block_id_) {
-            end_block_id_ = id + 1;
+        if (id >= shard->end_block_id) {
+            shard->end_block_id = id + 1;
         }
-        index_block_info_t info(offset, recency, ser_block_size);
-        infos_.set(id, info);
+        index_block_info_t info(offset, recency, ser_block_size,
+                                compressed_block_size);
+        shard->infos.set(id / LBA_SHARD_FACTOR, info);
     }
 }
 
+void in_memory_index_t::clear() {
+    for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+        shards_[i].infos.clear();
+        shards_[i].end_block_id = 0;
+        shards_[i].aux_infos.clear();
+        shards_[i].end_aux_block_id = FIRST_AUX_BLOCK_ID;
+    }
+}
@@ -12,25 +12,36 @@ ATTR_PACKED(struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          compressed_block_size(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint16_t _ser_block_size)
+                       uint16_t _ser_block_size,
+                       uint16_t _compressed_block_size)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          compressed_block_size(_compressed_block_size) { }
 
     // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            compressed_block_size == other.compressed_block_size;
+    }
+
+    // The number of bytes the block occupies on disk.
+    uint16_t disk_block_size() const {
+        return compressed_block_size != 0 ? compressed_block_size : ser_block_size;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
     uint16_t ser_block_size;
+    // 0 if the block is stored uncompressed.  See `lba_entry_t`.
+    uint16_t compressed_block_size;
 });
 
 /* This is a reduced-size block info for auxiliary blocks (currently
@@ -39,30 +50,47 @@ timestamp, because we don't need it for those blocks. */
 ATTR_PACKED(struct index_aux_block_info_t {
     index_aux_block_info_t()
         : offset(flagged_off64_t::unused()),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          compressed_block_size(0) { }
 
     index_aux_block_info_t(flagged_off64_t _offset,
-                           uint16_t _ser_block_size)
+                           uint16_t _ser_block_size,
+                           uint16_t _compressed_block_size)
         : offset(_offset),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          compressed_block_size(_compressed_block_size) { }
 
     // For two_level_array_t.
     bool operator==(const index_aux_block_info_t &other) const {
         return offset == other.offset &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            compressed_block_size == other.compressed_block_size;
     }
 
     flagged_off64_t offset;
     uint16_t ser_block_size;
+    uint16_t compressed_block_size;
 });
 
 
 
+/* The index is split into `LBA_SHARD_FACTOR` shards in the same way as the LBA on disk,
+that is by `block_id % LBA_SHARD_FACTOR`.  The shards don't share any state, so
+different shards may be modified from different threads at the same time.  The LBA
+relies on this to replay its shards concurrently at startup. */
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
-    two_level_array_t<index_aux_block_info_t> aux_infos_;
-    block_id_t end_aux_block_id_;
+    // Each shard only holds every `LBA_SHARD_FACTOR`th block, so we use smaller chunks
+    // to not waste memory on small tables.
+    static const size_t SHARD_CHUNK_SIZE = (1 << 14) / LBA_SHARD_FACTOR;
+
+    struct shard_t {
+        shard_t();
+        two_level_array_t<index_block_info_t, SHARD_CHUNK_SIZE> infos;
+        block_id_t end_block_id;
+        two_level_array_t<index_aux_block_info_t, SHARD_CHUNK_SIZE> aux_infos;
+        block_id_t end_aux_block_id;
+    };
+    shard_t shards_[LBA_SHARD_FACTOR];
 
 public:
     in_memory_index_t();
@@ -73,8 +101,11 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint16_t ser_block_size);
+                        flagged_off64_t offset, uint16_t ser_block_size,
+                        uint16_t compressed_block_size);
 
+    // Forgets all blocks, as if the index had just been constructed.
+    void clear();
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
@@ -1,19 +1,28 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/lba/lba_list.hpp"
 
+#include "errors.hpp"
+#include <boost/crc.hpp>
+
 #include "utils.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 #include "arch/arch.hpp"
+#include "arch/runtime/thread_pool.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/stats.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/pmap.hpp"
+#include "logger.hpp"
+#include "math.hpp"
 
 // TODO: Some of the code in this file is bullshit disgusting shit.
 
 lba_list_t::lba_list_t(extent_manager_t *em,
         const lba_list_t::write_metablock_fun_t &_write_metablock_fun)
     : gc_drainer(new auto_drainer_t), write_metablock_fun(_write_metablock_fun),
-      extent_manager(em), state(state_unstarted), inline_lba_entries_count(0)
+      extent_manager(em), state(state_unstarted), inline_lba_entries_count(0),
+      snapshot_active(false), index_modification_count(0),
+      snapshot_modification_count(0)
 {
     for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
         gc_active[i] = false;
@@ -33,6 +42,7 @@ void lba_list_t::prepare_initial_metablock(metablock_mixin_t *mb_out) {
     memset(mb_out->inline_lba_entries,
            0,
            LBA_NUM_INLINE_ENTRIES * sizeof(lba_entry_t));
+    mb_out->snapshot_extent_index = 0;
 }
 
 void lba_list_t::prepare_metablock(metablock_mixin_t *mb_out) {
@@ -48,6 +58,21 @@ void lba_list_t::prepare_metablock(metablock_mixin_t *mb_out) {
     memset(&mb_out->inline_lba_entries[inline_lba_entries_count],
            0,
            (LBA_NUM_INLINE_ENTRIES - inline_lba_entries_count) * sizeof(lba_entry_t));
+    if (snapshot_extents.empty()) {
+        mb_out->snapshot_extent_index = 0;
+    } else {
+        mb_out->snapshot_extent_index = static_cast<int32_t>(
+            snapshot_extents[0].offset() / extent_manager->extent_size);
+    }
+}
+
+static uint32_t compute_snapshot_header_crc(const lba_snapshot_header_t *header) {
+    const char *begin = reinterpret_cast<const char *>(&header->extents_count);
+    const char *end = reinterpret_cast<const char *>(header)
+        + lba_snapshot_header_t::size(header->extents_count);
+    boost::crc_32_type crc_computer;
+    crc_computer.process_bytes(begin, end - begin);
+    return crc_computer.checksum();
 }
 
 class lba_start_fsm_t :
@@ -59,6 +84,11 @@ public:
     lba_list_t *owner;
     lba_list_t::ready_callback_t *callback;
 
+    // The snapshot that the metablock references, if any, and the LBA state that
+    // it must match to be usable.
+    int32_t snapshot_extent_index;
+    lba_list_t::metablock_mixin_t lba_state;
+
     lba_start_fsm_t(lba_list_t *l, lba_list_t::metablock_mixin_t *last_metablock)
         : owner(l), callback(nullptr)
     {
@@ -72,6 +102,10 @@ public:
                last_metablock->inline_lba_entries,
                last_metablock->inline_lba_entries_count * sizeof(lba_entry_t));
 
+        snapshot_extent_index = last_metablock->snapshot_extent_index;
+        lba_state = *last_metablock;
+        lba_state.snapshot_extent_index = 0;
+
         cbs_out = LBA_SHARD_FACTOR;
         for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
             owner->disk_structures[i] = new lba_disk_structure_t(
@@ -85,37 +119,177 @@ public:
         rassert(cbs_out > 0);
         cbs_out--;
         if (cbs_out == 0) {
-            cbs_out = LBA_SHARD_FACTOR;
-            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
+            if (snapshot_extent_index != 0) {
+                coro_t::spawn_sometime(std::bind(&lba_start_fsm_t::load_snapshot, this));
+            } else {
+                read_extents();
             }
         }
     }
 
+    void load_snapshot() {
+        if (try_load_snapshot()) {
+            // We don't need to read the LBA extents at all.
+            finish();
+        } else {
+            owner->in_memory_index.clear();
+            read_extents();
+        }
+    }
+
+    bool try_load_snapshot() {
+        extent_manager_t *em = owner->extent_manager;
+        const int64_t file_size = owner->dbfile->get_file_size();
+        const int64_t header_offset = snapshot_extent_index * em->extent_size;
+        if (snapshot_extent_index < 0
+            || header_offset + static_cast<int64_t>(em->extent_size) > file_size) {
+            logWRN("Ignoring the LBA snapshot because it lies outside of the file.");
+            return false;
+        }
+
+        scoped_device_block_aligned_ptr_t<lba_snapshot_header_t> header(em->extent_size);
+        co_read(owner->dbfile, header_offset, em->extent_size, header.get(),
+                owner->gc_io_account.get());
+        if (memcmp(header->magic, lba_snapshot_magic, LBA_SNAPSHOT_MAGIC_SIZE) != 0
+            || header->extents_count < 0
+            || lba_snapshot_header_t::size(header->extents_count) > em->extent_size
+            || header->crc != compute_snapshot_header_crc(header.get())) {
+            logWRN("Ignoring the LBA snapshot because its header is corrupted.");
+            return false;
+        }
+
+        if (memcmp(&header->lba_state, &lba_state, sizeof(lba_state)) != 0) {
+            // The LBA has changed since the snapshot was written, probably because
+            // the server didn't shut down cleanly.  This is expected, so we don't
+            // complain about it.
+            return false;
+        }
+
+        int32_t extents_count = 0;
+        for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+            if (header->shard_extents_count[i] < 0) {
+                extents_count = -1;
+                break;
+            }
+            extents_count += header->shard_extents_count[i];
+        }
+        const int32_t max_entries = em->extent_size / sizeof(lba_entry_t);
+        bool valid = extents_count == header->extents_count;
+        for (int32_t i = 0; valid && i < header->extents_count; ++i) {
+            const lba_snapshot_extent_t &extent = header->extents[i];
+            valid = extent.offset > 0
+                && extent.offset % em->extent_size == 0
+                && extent.offset + static_cast<int64_t>(em->extent_size) <= file_size
+                && extent.entries_count > 0
+                && extent.entries_count <= max_entries;
+        }
+        if (!valid) {
+            logWRN("Ignoring the LBA snapshot because its header is inconsistent.");
+            return false;
+        }
+
+        // Every shard reads its own extents, so that the reads of one shard overlap
+        // with replaying the entries of another one.
+        bool shards_valid[LBA_SHARD_FACTOR];
+        pmap(LBA_SHARD_FACTOR, [&](int shard) {
+            shards_valid[shard] = load_snapshot_shard(header.get(), shard);
+        });
+        for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+            if (!shards_valid[i]) {
+                logWRN("Ignoring the LBA snapshot because it is corrupted.");
+                return false;
+            }
+        }
+
+        // The snapshot extents remain in use until we write a newer snapshot.
+        owner->snapshot_extents.push_back(em->reserve_extent(header_offset));
+        for (int32_t i = 0; i < header->extents_count; ++i) {
+            owner->snapshot_extents.push_back(
+                em->reserve_extent(header->extents[i].offset));
+        }
+        return true;
+    }
+
+    bool load_snapshot_shard(const lba_snapshot_header_t *header, int shard) {
+        extent_manager_t *em = owner->extent_manager;
+        int32_t first_extent = 0;
+        for (int i = 0; i < shard; ++i) {
+            first_extent += header->shard_extents_count[i];
+        }
+
+        scoped_device_block_aligned_ptr_t<lba_entry_t> entries(em->extent_size);
+        for (int32_t i = first_extent;
+             i < first_extent + header->shard_extents_count[shard];
+             ++i) {
+            const lba_snapshot_extent_t &extent = header->extents[i];
+            const size_t size = extent.entries_count * sizeof(lba_entry_t);
+            co_read(owner->dbfile, extent.offset, ceil_aligned(size, DEVICE_BLOCK_SIZE),
+                    entries.get(), owner->gc_io_account.get());
+
+            boost::crc_32_type crc_computer;
+            crc_computer.process_bytes(entries.get(), size);
+            if (crc_computer.checksum() != extent.crc) {
+                return false;
+            }
+
+            for (int32_t j = 0; j < extent.entries_count; ++j) {
+                const lba_entry_t &e = entries.get()[j];
+                if (e.block_id % LBA_SHARD_FACTOR != static_cast<block_id_t>(shard)
+                    || e.ser_block_size > std::numeric_limits<uint16_t>::max()
+                    || e.compressed_block_size > std::numeric_limits<uint16_t>::max()) {
+                    return false;
+                }
+                owner->in_memory_index.set_block_info(
+                        e.block_id,
+                        e.recency,
+                        e.offset,
+                        static_cast<uint16_t>(e.ser_block_size),
+                        static_cast<uint16_t>(e.compressed_block_size));
+            }
+        }
+        return true;
+    }
+
+    void read_extents() {
+        // The shards are replayed into the in-memory index concurrently on the
+        // process-wide CPU pool.
+        cbs_out = LBA_SHARD_FACTOR;
+        for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+            owner->disk_structures[i]->read(&owner->in_memory_index,
+                                            linux_thread_pool_t::get_cpu_blocker_pool(),
+                                            this);
+        }
+    }
+
     void on_lba_extents_read() {
         rassert(cbs_out > 0);
         cbs_out--;
         if (cbs_out == 0) {
-            // All LBA entries from the LBA extents have been read.
-            // Now we can load the (more recent) inlined entries from
-            // the metablock into the index:
-            for (int32_t i = 0; i < owner->inline_lba_entries_count; ++i) {
-                lba_entry_t *e = &owner->inline_lba_entries[i];
-                // The on-disk format still stores 32 bit block sizes.
-                // We've never actually used them, and we now use 16 bit block sizes
-                // for the in-memory index to save a few bytes.
-                guarantee(e->ser_block_size <= std::numeric_limits<uint16_t>::max());
-                owner->in_memory_index.set_block_info(
-                        e->block_id,
-                        e->recency,
-                        e->offset,
-                        static_cast<uint16_t>(e->ser_block_size));
-            }
+            finish();
+        }
+    }
 
-            owner->state = lba_list_t::state_ready;
-            if (callback) callback->on_lba_ready();
-            delete this;
+    void finish() {
+        // All LBA entries from the LBA extents have been read.
+        // Now we can load the (more recent) inlined entries from
+        // the metablock into the index:
+        for (int32_t i = 0; i < owner->inline_lba_entries_count; ++i) {
+            lba_entry_t *e = &owner->inline_lba_entries[i];
+            // The on-disk format still stores 32 bit block sizes.
+            // We've never actually used them, and we now use 16 bit block sizes
+            // for the in-memory index to save a few bytes.
+            guarantee(e->ser_block_size <= std::numeric_limits<uint16_t>::max());
+            owner->in_memory_index.set_block_info(
+                    e->block_id,
+                    e->recency,
+                    e->offset,
+                    static_cast<uint16_t>(e->ser_block_size),
+                    static_cast<uint16_t>(e->compressed_block_size));
         }
+
+        owner->state = lba_list_t::state_ready;
+        if (callback) callback->on_lba_ready();
+        delete this;
     }
 };
 
@@ -164,6 +338,10 @@ block_size_t lba_list_t::get_block_size(block_id_t block) {
     return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
 }
 
+block_size_t lba_list_t::get_disk_block_size(block_id_t block) {
+    return block_size_t::unsafe_make(get_block_info(block).disk_block_size());
+}
+
 repli_timestamp_t lba_list_t::get_block_recency(block_id_t block) {
     return get_block_info(block).recency;
 }
@@ -192,13 +370,18 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t compressed_block_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
     guarantee(ser_block_size <= std::numeric_limits<uint16_t>::max());
     uint16_t ser_block_size_16 = static_cast<uint16_t>(ser_block_size);
+    guarantee(compressed_block_size < ser_block_size || compressed_block_size == 0);
+    uint16_t compressed_block_size_16 = static_cast<uint16_t>(compressed_block_size);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size_16);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size_16,
+                                   compressed_block_size_16);
+    ++index_modification_count;
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -207,7 +390,8 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size_16);
+    add_inline_entry(block, recency, offset, ser_block_size_16,
+                     compressed_block_size_16);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -245,6 +429,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.compressed_block_size,
                 io_account,
                 txn);
     }
@@ -253,11 +438,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint16_t ser_block_size) {
+                                flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t compressed_block_size) {
 
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              compressed_block_size);
 }
 
 class lba_syncer_t :
@@ -348,11 +535,12 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
 
         flagged_off64_t off = get_block_offset(id);
         if (off.has_value()) {
-            uint32_t ser_block_size = get_ser_block_size(id);
+            const index_block_info_t info = get_block_info(id);
             disk_structures[lba_shard]->add_entry(id,
-                                                  get_block_recency(id),
+                                                  info.recency,
                                                   off,
-                                                  ser_block_size,
+                                                  info.ser_block_size,
+                                                  info.compressed_block_size,
                                                   gc_io_account.get(),
                                                   txns.back().get());
         }
@@ -466,6 +654,193 @@ bool lba_list_t::we_want_to_gc(int i) {
     return true;
 }
 
+void lba_list_t::consider_snapshot() {
+    if (state != state_ready || snapshot_active
+        || index_modification_count == snapshot_modification_count) {
+        return;
+    }
+    coro_t *snapshot_coro = coro_t::spawn_sometime(std::bind(
+        &lba_list_t::write_snapshot_in_background,
+        this, auto_drainer_t::lock_t(gc_drainer.get())));
+    snapshot_coro->set_priority(CORO_PRIORITY_LBA_GC);
+}
+
+void lba_list_t::write_snapshot_in_background(auto_drainer_t::lock_t gc_drainer_lock) {
+    // Another snapshot might have been started since we were spawned.
+    if (!snapshot_active && state == state_ready) {
+        write_snapshot(gc_drainer_lock.get_drain_signal());
+    }
+}
+
+bool lba_list_t::write_snapshot(const signal_t *interruptor) {
+    guarantee(coro_t::self() != nullptr);
+    rassert(state == state_ready || state == state_gc_shutting_down);
+    guarantee(!snapshot_active);
+    snapshot_active = true;
+
+    // If this changes while we write the snapshot, the snapshot is outdated.
+    const uint64_t modification_count = index_modification_count;
+    const auto is_outdated = [&]() {
+        return index_modification_count != modification_count
+            || interruptor->is_pulsed();
+    };
+
+    const int32_t max_entries = extent_manager->extent_size / sizeof(lba_entry_t);
+    std::vector<extent_reference_t> new_extents;
+    new_extents.push_back(extent_manager->gen_extent());
+    std::vector<lba_snapshot_extent_t> extent_infos;
+    int32_t shard_extents_count[LBA_SHARD_FACTOR];
+
+    scoped_device_block_aligned_ptr_t<lba_entry_t> entries(extent_manager->extent_size);
+    int32_t entries_count = 0;
+    const auto flush_entries = [&]() {
+        const size_t size = entries_count * sizeof(lba_entry_t);
+        const size_t aligned_size = ceil_aligned(size, DEVICE_BLOCK_SIZE);
+        memset(reinterpret_cast<char *>(entries.get()) + size, 0, aligned_size - size);
+
+        new_extents.push_back(extent_manager->gen_extent());
+        lba_snapshot_extent_t info;
+        info.offset = new_extents.back().offset();
+        info.entries_count = entries_count;
+        boost::crc_32_type crc_computer;
+        crc_computer.process_bytes(entries.get(), size);
+        info.crc = crc_computer.checksum();
+        extent_infos.push_back(info);
+        entries_count = 0;
+
+        // The metablock write at the end syncs the file before it references
+        // the snapshot, so we don't have to sync here.
+        co_write(dbfile, info.offset, aligned_size, entries.get(),
+                 gc_io_account.get(), file_t::NO_DATASYNCS);
+    };
+
+    // Like the GC, we write all regular block ids first and then the aux block ids.
+    // We also write the entry for the last block id of either kind even if it's
+    // unused, so that `end_block_id()` and `end_aux_block_id()` come out the same
+    // when the snapshot is loaded.
+    const block_id_t end_id = end_block_id();
+    const block_id_t aux_end_id = end_aux_block_id();
+    bool aborted = false;
+    int num_scanned_in_batch = 0;
+    for (int shard = 0; shard < LBA_SHARD_FACTOR && !aborted; ++shard) {
+        const size_t first_shard_extent = extent_infos.size();
+        for (block_id_t id = shard; ; id += LBA_SHARD_FACTOR) {
+            CT_ASSERT(FIRST_AUX_BLOCK_ID % LBA_SHARD_FACTOR == 0);
+            if (!is_aux_block_id(id) && id >= end_id) {
+                id = shard + FIRST_AUX_BLOCK_ID;
+            }
+            if (id >= aux_end_id) {
+                break;
+            }
+
+            const index_block_info_t info = in_memory_index.get_block_info(id);
+            if (!(info == index_block_info_t()) || id + 1 == end_id || id + 1 == aux_end_id) {
+                entries.get()[entries_count] = lba_entry_t::make(
+                    id, info.recency, info.offset, info.ser_block_size,
+                    info.compressed_block_size);
+                ++entries_count;
+                if (entries_count == max_entries) {
+                    flush_entries();
+                    if (is_outdated()) {
+                        aborted = true;
+                        break;
+                    }
+                }
+            }
+
+            ++num_scanned_in_batch;
+            if (num_scanned_in_batch >= LBA_GC_BATCH_SIZE) {
+                num_scanned_in_batch = 0;
+                coro_t::yield();
+                if (is_outdated()) {
+                    aborted = true;
+                    break;
+                }
+            }
+        }
+        if (!aborted && entries_count > 0) {
+            flush_entries();
+            aborted = is_outdated();
+        }
+        shard_extents_count[shard] = extent_infos.size() - first_shard_extent;
+    }
+
+    const int64_t header_extent_index =
+        new_extents[0].offset() / extent_manager->extent_size;
+    const size_t header_size = lba_snapshot_header_t::size(extent_infos.size());
+    if (header_size > extent_manager->extent_size
+        || header_extent_index > std::numeric_limits<int32_t>::max()) {
+        // This would take an absurdly large index.
+        aborted = true;
+    }
+
+    scoped_device_block_aligned_ptr_t<lba_snapshot_header_t> header;
+    if (!aborted) {
+        const size_t aligned_header_size = ceil_aligned(header_size, DEVICE_BLOCK_SIZE);
+        header = scoped_device_block_aligned_ptr_t<lba_snapshot_header_t>(
+            aligned_header_size);
+        memset(header.get(), 0, aligned_header_size);
+        memcpy(header->magic, lba_snapshot_magic, LBA_SNAPSHOT_MAGIC_SIZE);
+        header->extents_count = extent_infos.size();
+        for (int i = 0; i < LBA_SHARD_FACTOR; ++i) {
+            header->shard_extents_count[i] = shard_extents_count[i];
+        }
+        // We haven't yielded since the last check, so the LBA is in the state
+        // that the snapshot reflects.
+        prepare_metablock(&header->lba_state);
+        header->lba_state.snapshot_extent_index = 0;
+        for (size_t i = 0; i < extent_infos.size(); ++i) {
+            header->extents[i] = extent_infos[i];
+        }
+        header->crc = compute_snapshot_header_crc(header.get());
+
+        co_write(dbfile, new_extents[0].offset(), aligned_header_size, header.get(),
+                 gc_io_account.get(), file_t::NO_DATASYNCS);
+
+        // The LBA GC might have changed the LBA metablock in the meantime, even
+        // though it leaves the index alone.
+        metablock_mixin_t lba_state;
+        memset(&lba_state, 0, sizeof(lba_state));
+        prepare_metablock(&lba_state);
+        lba_state.snapshot_extent_index = 0;
+        aborted = is_outdated()
+            || memcmp(&lba_state, &header->lba_state, sizeof(lba_state)) != 0;
+    }
+
+    if (aborted) {
+        // No metablock references these extents yet.
+        for (auto it = new_extents.begin(); it != new_extents.end(); ++it) {
+            extent_manager->release_extent(std::move(*it));
+        }
+        snapshot_active = false;
+        return false;
+    }
+
+    // Replace the previous snapshot.  Its extents must stay intact until the new
+    // metablock is on disk.
+    extent_transaction_t txn;
+    extent_manager->begin_transaction(&txn);
+    for (auto it = snapshot_extents.begin(); it != snapshot_extents.end(); ++it) {
+        extent_manager->release_extent_into_transaction(std::move(*it), &txn);
+    }
+    snapshot_extents = std::move(new_extents);
+    extent_manager->end_transaction(&txn);
+    snapshot_modification_count = modification_count;
+    ++extent_manager->stats->pm_serializer_lba_snapshots;
+
+    // Some of the LBA entries that the snapshot's LBA state refers to might not have
+    // been synced yet, for example if the GC is in the middle of a batch.
+    struct : public cond_t, public lba_list_t::sync_callback_t {
+        void on_lba_sync() { pulse(); }
+    } on_lba_sync;
+    sync(gc_io_account.get(), &on_lba_sync);
+    write_metablock_fun(&on_lba_sync, gc_io_account.get());
+
+    extent_manager->commit_transaction(&txn);
+    snapshot_active = false;
+    return true;
+}
+
 void lba_list_t::shutdown_gc() {
     guarantee(state == state_ready);
     guarantee(coro_t::self() != nullptr);
@@ -485,6 +860,11 @@ void lba_list_t::shutdown() {
         disk_structures[i] = nullptr;
     }
 
+    for (auto it = snapshot_extents.begin(); it != snapshot_extents.end(); ++it) {
+        UNUSED int64_t extent = it->release();
+    }
+    snapshot_extents.clear();
+
     gc_io_account.reset();
 
     state = state_shut_down;
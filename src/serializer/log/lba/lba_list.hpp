@@ -3,6 +3,7 @@
 #define SERIALIZER_LOG_LBA_LBA_LIST_HPP_
 
 #include <functional>
+#include <vector>
 
 #include "concurrency/signal.hpp"
 #include "concurrency/auto_drainer.hpp"
@@ -46,6 +47,9 @@ public:
     flagged_off64_t get_block_offset(block_id_t block);
     uint32_t get_ser_block_size(block_id_t block);
     block_size_t get_block_size(block_id_t block);
+    // The number of bytes the block occupies on disk, which is less than
+    // `get_block_size()` if the block is stored compressed.
+    block_size_t get_disk_block_size(block_id_t block);
     repli_timestamp_t get_block_recency(block_id_t block);
     segmented_vector_t<repli_timestamp_t> get_block_recencies(block_id_t first,
                                                               block_id_t step);
@@ -63,6 +67,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t compressed_block_size,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -74,6 +79,16 @@ public:
 
     void consider_gc();
 
+    /* Writes a snapshot of the in-memory index (see `lba_snapshot_header_t`) together
+    with a metablock that references it, so that the next startup doesn't have to
+    replay the LBA extents.  Must be run in a coroutine.  Gives up and returns false
+    if the index changes or `interruptor` is pulsed while the snapshot is being
+    written, which is why this is only useful while there are no index writes. */
+    bool write_snapshot(const signal_t *interruptor);
+
+    // Writes a snapshot in the background if the index has changed since the last one.
+    void consider_snapshot();
+
     // The garbage collector must be shut down first through `shutdown_gc()`
     // (must be run in a coroutine). Once that is done, call `shutdown()` to
     // shut down the whole lba_list.
@@ -117,7 +132,8 @@ private:
     bool check_inline_lba_full() const;
     void move_inline_entries_to_extents(file_account_t *io_account, extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint16_t ser_block_size);
+                                flagged_off64_t offset, uint16_t ser_block_size,
+                                uint16_t compressed_block_size);
 
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
@@ -128,6 +144,19 @@ private:
     // gc. The integer is which shard to GC.
     bool we_want_to_gc(int i);
 
+    void write_snapshot_in_background(auto_drainer_t::lock_t gc_drainer_lock);
+
+    // The extents of the snapshot that the most recent metablock references, with the
+    // header extent first.  Empty if there is no such snapshot.
+    std::vector<extent_reference_t> snapshot_extents;
+    bool snapshot_active;
+
+    // Incremented on every change to the in-memory index.  Snapshots use this to find
+    // out whether the index changed while they were being written.
+    uint64_t index_modification_count;
+    // The value of `index_modification_count` at the time of the last snapshot.
+    uint64_t snapshot_modification_count;
+
     DISABLE_COPYING(lba_list_t);
 };
 
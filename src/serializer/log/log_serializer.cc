@@ -2,6 +2,7 @@
 #include "serializer/log/log_serializer.hpp"
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -17,6 +18,7 @@
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
 #include "serializer/log/data_block_manager.hpp"
+#include "time.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
                                                io_backender_t *backender)
@@ -129,7 +131,12 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_extents_gced(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_compressed_block_writes(),
+      pm_serializer_compression_saved_bytes(),
+      pm_serializer_user_block_bytes_written(),
+      pm_serializer_gc_block_bytes_written(),
       pm_serializer_lba_gcs(),
+      pm_serializer_lba_snapshots(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
@@ -149,7 +156,12 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
-          &pm_serializer_lba_gcs, "serializer_lba_gcs")
+          &pm_serializer_compressed_block_writes, "serializer_compressed_block_writes",
+          &pm_serializer_compression_saved_bytes, "serializer_compression_saved_bytes",
+          &pm_serializer_user_block_bytes_written, "serializer_user_block_bytes_written",
+          &pm_serializer_gc_block_bytes_written, "serializer_gc_block_bytes_written",
+          &pm_serializer_lba_gcs, "serializer_lba_gcs",
+          &pm_serializer_lba_snapshots, "serializer_lba_snapshots")
 { }
 
 void log_serializer_stats_t::bytes_read(size_t count) {
@@ -204,6 +216,7 @@ struct ls_start_existing_fsm_t :
         rassert(start_existing_state == state_start);
         rassert(ser->state == log_serializer_t::state_unstarted);
         ser->state = log_serializer_t::state_starting_up;
+        start_ticks = phase_start_ticks = get_ticks();
 
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
@@ -285,9 +298,11 @@ struct ls_start_existing_fsm_t :
         }
 
         if (start_existing_state == state_reconstruct) {
+            end_phase(&lba_secs);
             ser->data_block_manager->start_reconstruct();
             start_existing_state = state_reconstruct_ongoing;
             next_block_to_reconstruct = 0;
+            live_blocks_reconstructed = 0;
             // Fall through into state_reconstruct_ongoing
         }
 
@@ -307,7 +322,9 @@ struct ls_start_existing_fsm_t :
                     ser->lba_index->get_block_offset(next_block_to_reconstruct);
                 if (offset.has_value()) {
                     ser->data_block_manager->mark_live(offset.get_value(),
-                        ser->lba_index->get_block_size(next_block_to_reconstruct));
+                        ser->lba_index->get_block_size(next_block_to_reconstruct),
+                        ser->lba_index->get_disk_block_size(next_block_to_reconstruct));
+                    ++live_blocks_reconstructed;
                 }
 
                 ++next_block_to_reconstruct;
@@ -322,6 +339,14 @@ struct ls_start_existing_fsm_t :
 
             ser->extent_manager->start_existing(&metablock_buffer.extent_manager_part);
 
+            end_phase(&reconstruct_secs);
+            logINF("Opened serializer file in %.3f s (static header: %.3f s, "
+                   "metablock: %.3f s, LBA: %.3f s, reconstructing %" PRIu64 " blocks: "
+                   "%.3f s).",
+                   ticks_to_secs(get_ticks() - start_ticks), static_header_secs,
+                   metablock_secs, lba_secs, live_blocks_reconstructed,
+                   reconstruct_secs);
+
             start_existing_state = state_finish;
         }
 
@@ -330,6 +355,13 @@ struct ls_start_existing_fsm_t :
             rassert(ser->state == log_serializer_t::state_starting_up);
             ser->state = log_serializer_t::state_ready;
 
+            if (ser->dynamic_config.lba_snapshot_interval_ms > 0) {
+                lba_list_t *lba_index = ser->lba_index;
+                ser->lba_snapshot_timer.init(new repeating_timer_t(
+                    ser->dynamic_config.lba_snapshot_interval_ms,
+                    [lba_index]() { lba_index->consider_snapshot(); }));
+            }
+
             if (to_signal_when_done) to_signal_when_done->pulse();
 
             delete this;
@@ -341,6 +373,7 @@ struct ls_start_existing_fsm_t :
 
     void on_static_header_read() {
         rassert(start_existing_state == state_waiting_for_static_header);
+        end_phase(&static_header_secs);
         // STATE C
         start_existing_state = state_find_metablock;
         // STATE C above implies STATE D here
@@ -349,6 +382,7 @@ struct ls_start_existing_fsm_t :
 
     void on_metablock_read() {
         rassert(start_existing_state == state_waiting_for_metablock);
+        end_phase(&metablock_secs);
         // state after F, state before G
         start_existing_state = state_start_lba;
         // STATE G
@@ -387,6 +421,20 @@ struct ls_start_existing_fsm_t :
     // When in state_reconstruct_ongoing, we keep track of how many blocks we
     // already have reconstructed.
     block_id_t next_block_to_reconstruct;
+    uint64_t live_blocks_reconstructed;
+
+    // How long each phase of the startup took, for the log.
+    void end_phase(double *secs_out) {
+        ticks_t now = get_ticks();
+        *secs_out = ticks_to_secs(now - phase_start_ticks);
+        phase_start_ticks = now;
+    }
+    ticks_t start_ticks;
+    ticks_t phase_start_ticks;
+    double static_header_secs;
+    double metablock_secs;
+    double lba_secs;
+    double reconstruct_secs;
 
     bool metablock_found;
     log_serializer_t::metablock_t metablock_buffer;
@@ -448,7 +496,7 @@ buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t>
     stats->pm_serializer_block_reads.begin(&pm_time);
 
     buf_ptr_t ret = data_block_manager->read(token->offset_, token->block_size(),
-                                           io_account);
+                                             token->disk_block_size(), io_account);
 
     stats->pm_serializer_block_reads.end(&pm_time);
     return ret;
@@ -494,7 +542,9 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
              ++write_op_it) {
             const index_write_op_t &op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
-            uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            const index_block_info_t old_info = lba_index->get_block_info(op.block_id);
+            uint32_t ser_block_size = old_info.ser_block_size;
+            uint32_t compressed_block_size = old_info.compressed_block_size;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -510,12 +560,17 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
                     ser_block_size = token->block_size().ser_value();
+                    compressed_block_size = token->disk_block_size() == token->block_size()
+                        ? 0
+                        : token->disk_block_size().ser_value();
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(), token->block_size(),
+                                                  token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    compressed_block_size = 0;
                 }
             }
 
@@ -523,7 +578,7 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 : lba_index->get_block_recency(op.block_id);
 
             lba_index->set_block_info(op.block_id, recency,
-                                      offset, ser_block_size,
+                                      offset, ser_block_size, compressed_block_size,
                                       index_writes_io_account.get(), &txn);
         }
     }
@@ -651,9 +706,11 @@ void log_serializer_t::write_metablock_sans_pipelining(const signal_t *safe_to_w
 }
 
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(
+        new ls_block_token_pointee_t(this, offset, block_size, disk_block_size));
     return ret;
 }
 
@@ -797,7 +854,9 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(info.offset.get_value(),
+                                    block_size_t::unsafe_make(info.ser_block_size),
+                                    block_size_t::unsafe_make(info.disk_block_size()));
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -828,6 +887,8 @@ void log_serializer_t::shutdown(cond_t *cb) {
     rassert(shutdown_state == shutdown_not_started);
     shutdown_state = shutdown_begin;
 
+    lba_snapshot_timer.reset();
+
     // We must shutdown the LBA GC before we shut down
     // the data_block_manager or metablock_manager, because the LBA GC
     // uses our `write_metablock()` method which depends on those.
@@ -857,7 +918,17 @@ void log_serializer_t::next_shutdown_step() {
         state = state_shutting_down;
     }
 
+    // There are no more index writes, so this is a good time to snapshot the LBA
+    // index.  The snapshot's metablock needs the data block manager, so it goes
+    // before it.
     if (shutdown_state == shutdown_waiting_on_serializer) {
+        shutdown_state = shutdown_waiting_on_lba_snapshot;
+        coro_t::spawn_sometime(std::bind(
+            &log_serializer_t::write_lba_snapshot_and_continue_shutdown, this));
+        return;
+    }
+
+    if (shutdown_state == shutdown_waiting_on_lba_snapshot) {
         shutdown_state = shutdown_waiting_on_datablock_manager;
         if (!data_block_manager->shutdown(this)) {
             return;
@@ -915,6 +986,16 @@ void log_serializer_t::next_shutdown_step() {
     unreachable("Invalid state.");
 }
 
+void log_serializer_t::write_lba_snapshot_and_continue_shutdown() {
+    // A data block GC that is still running can make this fail, in which case the
+    // next startup replays the LBA as usual.
+    if (dynamic_config.lba_snapshot_interval_ms >= 0) {
+        cond_t non_interruptor;
+        lba_index->write_snapshot(&non_interruptor);
+    }
+    next_shutdown_step();
+}
+
 void log_serializer_t::delete_dbfile_and_continue_shutdown() {
     index_writes_io_account.reset();
     rassert(dbfile != nullptr);
@@ -982,9 +1063,12 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset) {
+    rassert(disk_block_size_.ser_value() <= block_size_.ser_value());
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
@@ -17,6 +17,7 @@
 #include "concurrency/signal.hpp"
 #include "concurrency/cond_var.hpp"
 #include "containers/scoped.hpp"
+#include "arch/timing.hpp"
 
 #include "serializer/log/metablock_manager.hpp"
 #include "serializer/log/extent_manager.hpp"
@@ -103,6 +104,10 @@ private:
 // Used internally
 struct ls_start_existing_fsm_t;
 
+namespace unittest {
+void run_SerializerTest_GcPrefersOldExtents();
+}
+
 class log_serializer_t :
 #ifndef SEMANTIC_SERIALIZER_CHECK
     public serializer_t,
@@ -115,6 +120,7 @@ class log_serializer_t :
     friend class data_block_manager_t;
     friend class dbm_read_ahead_t;
     friend class ls_block_token_pointee_t;
+    friend void unittest::run_SerializerTest_GcPrefersOldExtents();
 
 public:
     /* Serializer configuration. dynamic_config_t is everything that can be changed from run
@@ -170,7 +176,8 @@ private:
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                             block_size_t block_size,
+                                                             block_size_t disk_block_size);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -191,6 +198,7 @@ private:
     void next_shutdown_step();
 
     void delete_dbfile_and_continue_shutdown();
+    void write_lba_snapshot_and_continue_shutdown();
 
     virtual void on_datablock_manager_shutdown();
 
@@ -238,6 +246,7 @@ private:
         shutdown_not_started,
         shutdown_begin,
         shutdown_waiting_on_serializer,
+        shutdown_waiting_on_lba_snapshot,
         shutdown_waiting_on_datablock_manager,
         shutdown_waiting_on_block_tokens,
         shutdown_waiting_on_dbfile_destruction,
@@ -265,6 +274,9 @@ private:
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
+    // Periodically tells the LBA to write a snapshot of its index.
+    scoped_ptr_t<repeating_timer_t> lba_snapshot_timer;
+
     /* The running index writes organize themselves into a list so that they can be sure to
     write their metablocks in the correct order. The first element in the list
     is the oldest transaction that started but did not finish. */
@@ -35,9 +35,16 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    perfmon_counter_t pm_serializer_compressed_block_writes;
+    perfmon_counter_t pm_serializer_compression_saved_bytes;
+    // Bytes of data blocks written on behalf of users and by the GC.  Their ratio is
+    // the write amplification caused by the GC.
+    perfmon_counter_t pm_serializer_user_block_bytes_written;
+    perfmon_counter_t pm_serializer_gc_block_bytes_written;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
+    perfmon_counter_t pm_serializer_lba_snapshots;
 
     perfmon_membership_t parent_collection_membership;
     perfmon_multi_membership_t stats_membership;
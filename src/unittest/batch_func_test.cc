@@ -0,0 +1,97 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/batch_func.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/wire_func.hpp"
+#include "stl_utils.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static std::vector<ql::datum_t> make_rows() {
+    std::vector<ql::datum_t> rows;
+    for (int i = 0; i < 20; ++i) {
+        ql::datum_object_builder_t row;
+        UNUSED bool b = row.add("id", ql::datum_t(static_cast<double>(i)));
+        if (i % 7 != 3) {
+            // Some rows lack the field, ...
+            b = row.add("a", i % 7 == 5
+                        // ... have a string in it, ...
+                        ? ql::datum_t("five")
+                        // ... or a number that overflows when doubled.
+                        : ql::datum_t(i == 8 ? 1e308 : static_cast<double>(i - 10)));
+        }
+        b = row.add("b", ql::datum_t(static_cast<double>(i % 3)));
+        rows.push_back(std::move(row).to_datum());
+    }
+    rows.push_back(ql::datum_t("not an object"));
+    return rows;
+}
+
+TPTEST(BatchFuncTest, MatchesInterpreter) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+    ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    std::vector<ql::raw_term_t> bodies = {
+        r.var(x)["a"].call(Term::MUL, 2.0).root_term(),
+        (r.var(x)["a"] > 5.0).root_term(),
+        (r.var(x)["a"] / r.var(x)["b"]).root_term(),
+        (r.var(x)["a"].call(Term::SUB, r.var(x)["b"], 1.0) <= 0.0).root_term(),
+        (r.var(x)["b"] == 1.0).root_term(),
+        ((r.var(x)["b"] >= 1.0) && !(r.var(x)["a"] < 0.0)).root_term(),
+        r.var(x)["b"].call(Term::OR, r.var(x)["a"]).root_term(),
+        r.var(x).bracket("b").call(Term::NE, 0.0, 2.0).root_term()
+    };
+    const std::vector<ql::datum_t> rows = make_rows();
+    for (const ql::raw_term_t &body : bodies) {
+        counted_t<const ql::func_t> f
+            = ql::map_wire_func_t(body, make_vector(x)).compile_wire_func();
+        scoped_ptr_t<ql::batch_func_t> batch_f = f->compile_batch();
+        ASSERT_TRUE(batch_f.has());
+        std::vector<ql::datum_t> results;
+        batch_f->eval(rows, &results);
+        ASSERT_EQ(rows.size(), results.size());
+        // The last row isn't an object, so it must be left to the interpreter.
+        ASSERT_FALSE(results.back().has());
+        size_t num_evaluated = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (results[i].has()) {
+                ASSERT_EQ(f->call(&env, rows[i])->as_datum(), results[i]);
+                ++num_evaluated;
+            }
+        }
+        ASSERT_GT(num_evaluated, 0u);
+    }
+}
+
+TEST(BatchFuncTest, Fallback) {
+    ql::sym_t x(1);
+    ql::sym_t y(2);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    ql::raw_term_t body = r.var(x)["a"].call(Term::MUL, 2.0).root_term();
+    std::vector<ql::datum_t> rows;
+    rows.push_back(ql::datum_t::empty_object());
+    rows.push_back(ql::datum_t(1.0));
+    scoped_ptr_t<ql::batch_func_t> batch_f
+        = ql::batch_func_t::compile(make_vector(x), body);
+    ASSERT_TRUE(batch_f.has());
+    std::vector<ql::datum_t> results;
+    batch_f->eval(rows, &results);
+    ASSERT_EQ(2u, results.size());
+    ASSERT_FALSE(results[0].has());
+    ASSERT_FALSE(results[1].has());
+
+    // Terms that aren't supported, and variables other than the argument.
+    ASSERT_FALSE(ql::batch_func_t::compile(
+        make_vector(x), r.var(x)["a"].call(Term::MOD, 2.0).root_term()).has());
+    ASSERT_FALSE(ql::batch_func_t::compile(
+        make_vector(x), (r.var(x)["a"] + r.var(y)).root_term()).has());
+}
+
+}  // namespace unittest
@@ -23,8 +23,10 @@ public:
         return ret;
     }
 
-    explicit blob_tracker_t(size_t maxreflen)
-        : buf_(alloc_emptybuf(maxreflen), maxreflen), blob_(max_block_size_t::unsafe_make(4096),
+    explicit blob_tracker_t(size_t maxreflen,
+                            blob::layout_t layout = blob::layout_t::tree)
+        : layout_(layout), contiguous_(false),
+          buf_(alloc_emptybuf(maxreflen), maxreflen), blob_(max_block_size_t::unsafe_make(4096),
                                                             buf_.data(), maxreflen) { }
 
     void check_region(txn_t *txn, int64_t offset, int64_t size) {
@@ -43,6 +45,9 @@ public:
                             &bg, &bacq);
 
         ASSERT_EQ(size, static_cast<int64_t>(bg.get_size()));
+        if (contiguous_ && size > 0) {
+            ASSERT_EQ(1u, bg.num_buffers());
+        }
 
         std::string::iterator p_orig = expected_.begin() + offset, p = p_orig, e = p + size;
         for (size_t i = 0, n = bg.num_buffers(); i < n; ++i) {
@@ -62,7 +67,10 @@ public:
         size_t size = expected_.size();
         uint64_t rs = blob_.refsize(txn->cache()->max_block_size());
         size_t sizesize = buf_.size() <= 255 ? 1 : 2;
-        if (size <= buf_.size() - sizesize) {
+        if (contiguous_) {
+            ASSERT_LT(buf_.size() - sizesize, size);
+            ASSERT_EQ(sizesize + 8 + sizeof(block_id_t), rs);
+        } else if (size <= buf_.size() - sizesize) {
             ASSERT_EQ(sizesize + size, rs);
         } else if (size <= static_cast<size_t>(size_after_magic)) {
             ASSERT_EQ(sizesize + 8 + sizeof(block_id_t), rs);
@@ -90,7 +98,17 @@ public:
         SCOPED_TRACE(strprintf("append (%zu) ", x.size()) + std::string(x.begin(), x.begin() + std::min<size_t>(x.size(), 50)));
         int64_t n = x.size();
 
-        blob_.append_region(buf_parent_t(txn), n);
+        blob_.append_region(buf_parent_t(txn), n, layout_);
+        const int64_t new_size = expected_.size() + n;
+        if (contiguous_) {
+            contiguous_ = new_size <= BLOB_MAX_CONTIGUOUS_SIZE;
+        } else {
+            const size_t sizesize = buf_.size() <= 255 ? 1 : 2;
+            contiguous_ = layout_ == blob::layout_t::contiguous
+                && expected_.empty()
+                && new_size > static_cast<int64_t>(buf_.size() - sizesize)
+                && new_size <= BLOB_MAX_CONTIGUOUS_SIZE;
+        }
 
         ASSERT_EQ(static_cast<int64_t>(expected_.size() + n), blob_.valuesize());
 
@@ -119,6 +137,8 @@ public:
 
         blob_.unappend_region(buf_parent_t(txn), n);
         expected_.erase(expected_.size() - n);
+        const size_t sizesize = buf_.size() <= 255 ? 1 : 2;
+        contiguous_ = contiguous_ && expected_.size() > buf_.size() - sizesize;
 
         check(txn);
     }
@@ -127,6 +147,7 @@ public:
         SCOPED_TRACE("clear");
         blob_.clear(buf_parent_t(txn));
         expected_.clear();
+        contiguous_ = false;
         check(txn);
     }
 
@@ -135,6 +156,9 @@ public:
     }
 
 private:
+    const blob::layout_t layout_;
+    // Whether we expect the blob to be stored in a single block.
+    bool contiguous_;
     std::string expected_;
     scoped_array_t<char> buf_;
     blob_t blob_;
@@ -216,10 +240,11 @@ void small_value_boundary_test(cache_t *cache) {
     ASSERT_EQ(1u, tk.refsize(block_size));
 }
 
-void general_journey_test(cache_t *cache, const std::vector<int64_t>& steps) {
+void general_journey_test(cache_t *cache, const std::vector<int64_t>& steps,
+                          blob::layout_t layout = blob::layout_t::tree) {
     cache_conn_t cache_conn(cache);
     txn_t txn(&cache_conn, write_durability_t::SOFT, 0);
-    blob_tracker_t tk(251);
+    blob_tracker_t tk(251, layout);
 
     char v = 'A';
     int64_t size = 0;
@@ -263,6 +288,52 @@ void combinations_test(cache_t *cache) {
     }
 }
 
+void contiguous_test(cache_t *cache) {
+    SCOPED_TRACE("contiguous_test");
+    max_block_size_t block_size = cache->max_block_size();
+
+    {
+        cache_conn_t cache_conn(cache);
+        txn_t txn(&cache_conn, write_durability_t::SOFT, 0);
+        blob_tracker_t tk(251, blob::layout_t::contiguous);
+
+        // A value that fits into the ref stays there.
+        tk.append(&txn, std::string(250, 'a'));
+        ASSERT_EQ(251u, tk.refsize(block_size));
+        // Only empty blobs become contiguous, so this one becomes a tree.
+        tk.append(&txn, std::string(size_after_magic, 'b'));
+        ASSERT_EQ(1 + 8 + 2 * sizeof(block_id_t), tk.refsize(block_size));
+        tk.clear(&txn);
+
+        tk.append(&txn, std::string(8 * size_after_magic, 'c'));
+        ASSERT_EQ(1 + 8 + sizeof(block_id_t), tk.refsize(block_size));
+        tk.append(&txn, std::string(1000, 'd'));
+        tk.unappend(&txn, 5000);
+        ASSERT_EQ(1 + 8 + sizeof(block_id_t), tk.refsize(block_size));
+        tk.check_region(&txn, 1000, 20000);
+        tk.unappend(&txn, 8 * size_after_magic - 4000 - 100);
+        ASSERT_EQ(1u + 100, tk.refsize(block_size));
+        tk.clear(&txn);
+        ASSERT_EQ(1u, tk.refsize(block_size));
+    }
+
+    int64_t l2_sz = size_after_magic * (size_after_magic / sizeof(block_id_t));
+    int64_t szs[] = { 0, 251, size_after_magic + 1, 32 * KILOBYTE,
+                      BLOB_MAX_CONTIGUOUS_SIZE, BLOB_MAX_CONTIGUOUS_SIZE + 1,
+                      l2_sz + 1 };
+
+    int n = sizeof(szs) / sizeof(szs[0]);
+
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            SCOPED_TRACE(strprintf("i,j = %d,%d", i, j));
+            std::vector<int64_t> steps;
+            steps.push_back(szs[i]);
+            steps.push_back(szs[j]);
+            general_journey_test(cache, steps, blob::layout_t::contiguous);
+        }
+    }
+}
 
 void run_tests(cache_t *cache) {
     // The tests above hard-code constants related to these numbers.
@@ -276,6 +347,7 @@ void run_tests(cache_t *cache) {
     small_value_test(cache);
     small_value_boundary_test(cache);
     combinations_test(cache);
+    contiguous_test(cache);
 }
 
 TPTEST(BlobTest, AllTests) {
@@ -294,4 +366,48 @@ TPTEST(BlobTest, AllTests) {
     run_tests(&cache);
 }
 
+TPTEST(BlobTest, ContiguousReload) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(
+            &file_opener,
+            log_serializer_t::static_config_t());
+    log_serializer_t log_serializer(
+            log_serializer_t::dynamic_config_t(),
+            &file_opener,
+            &get_global_perfmon_collection());
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    std::string value;
+    for (int i = 0; i < 50 * KILOBYTE; ++i) {
+        value.push_back('a' + i % 26);
+    }
+    std::vector<char> ref(blob::btree_maxreflen, 0);
+
+    {
+        cache_t cache(&log_serializer, &balancer, &get_global_perfmon_collection());
+        cache_conn_t cache_conn(&cache);
+        txn_t txn(&cache_conn, write_durability_t::HARD, 0);
+        blob_t blob(cache.max_block_size(), ref.data(), blob::btree_maxreflen);
+        blob.append_region(buf_parent_t(&txn), value.size(),
+                           blob::layout_t::contiguous);
+        blob.write_from_string(value, buf_parent_t(&txn), 0);
+    }
+
+    // A new cache has to load the block from the serializer.
+    cache_t cache(&log_serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+    txn_t txn(&cache_conn, read_access_t::read);
+    blob_t blob(cache.max_block_size(), ref.data(), blob::btree_maxreflen);
+    ASSERT_EQ(static_cast<int>(1 + 8 + sizeof(block_id_t)),
+              blob.refsize(cache.max_block_size()));
+
+    buffer_group_t group;
+    blob_acq_t acq;
+    blob.expose_all(buf_parent_t(&txn), access_t::read, &group, &acq);
+    ASSERT_EQ(1u, group.num_buffers());
+    buffer_group_t::buffer_t buffer = group.get_buffer(0);
+    ASSERT_EQ(value, std::string(static_cast<char *>(buffer.data), buffer.size));
+}
+
 }  // namespace unittest
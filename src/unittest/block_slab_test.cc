@@ -0,0 +1,116 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <pthread.h>
+
+#include <set>
+
+#include "containers/block_slab.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BlockSlabTest, AlignedAndDistinct) {
+    std::vector<void *> bufs;
+    std::set<void *> distinct;
+    for (size_t size : { 1, 511, 512, 4096, 4097, 16384, 16385, 100000 }) {
+        for (int i = 0; i < 10; ++i) {
+            void *buf = block_slab_malloc(size);
+            ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf) % DEVICE_BLOCK_SIZE);
+            // The whole buffer must be writable.
+            memset(buf, 0xab, size);
+            bufs.push_back(buf);
+            distinct.insert(buf);
+        }
+    }
+    ASSERT_EQ(bufs.size(), distinct.size());
+    for (void *buf : bufs) {
+        block_slab_free(buf);
+    }
+}
+
+TEST(BlockSlabTest, ReusesFreedBuffers) {
+    void *buf = block_slab_malloc(4096);
+    block_slab_free(buf);
+    // The thread's free list hands the same buffer out again.  (Unless we don't use
+    // slabs on this platform.)
+    void *again = block_slab_malloc(4000);
+    if (get_block_slab_stats().bytes_reserved > 0) {
+        ASSERT_EQ(buf, again);
+    }
+    block_slab_free(again);
+}
+
+TEST(BlockSlabTest, Stats) {
+    const block_slab_stats_t before = get_block_slab_stats();
+    {
+        std::vector<scoped_device_block_aligned_ptr_t<char> > bufs;
+        for (int i = 0; i < 1000; ++i) {
+            bufs.push_back(scoped_device_block_aligned_ptr_t<char>(4096));
+        }
+        const block_slab_stats_t during = get_block_slab_stats();
+        if (during.bytes_reserved == 0) {
+            // We don't use slabs on this platform.
+            return;
+        }
+        ASSERT_EQ(before.bytes_in_use + 1000 * 4096, during.bytes_in_use);
+        ASSERT_GE(during.bytes_reserved, during.bytes_in_use);
+        ASSERT_EQ(0, during.bytes_reserved % BLOCK_SLAB_CHUNK_SIZE);
+    }
+    ASSERT_EQ(before.bytes_in_use, get_block_slab_stats().bytes_in_use);
+}
+
+// Fills three chunks with buffers of a size that no other test uses, and frees them.
+static void *fill_and_free_chunks(void *) {
+    const size_t size = 12288;
+    std::vector<void *> bufs;
+    for (size_t i = 0; i < 3 * (BLOCK_SLAB_CHUNK_SIZE / size); ++i) {
+        bufs.push_back(block_slab_malloc(size));
+        memset(bufs.back(), 0xab, size);
+    }
+    for (void *buf : bufs) {
+        block_slab_free(buf);
+    }
+    return nullptr;
+}
+
+TEST(BlockSlabTest, ReleasesChunksOfExitedThreads) {
+    const block_slab_stats_t before = get_block_slab_stats();
+    for (int i = 0; i < 3; ++i) {
+        // Most of the buffers end up in the thread's own cache.  Once the thread
+        // exits, they go back to the shared pool, and the chunks are released.
+        pthread_t thread;
+        int res = pthread_create(&thread, nullptr, fill_and_free_chunks, nullptr);
+        guarantee_xerr(res == 0, res, "pthread_create failed");
+        res = pthread_join(thread, nullptr);
+        guarantee_xerr(res == 0, res, "pthread_join failed");
+        ASSERT_EQ(before.bytes_reserved, get_block_slab_stats().bytes_reserved);
+    }
+    ASSERT_EQ(before.bytes_in_use, get_block_slab_stats().bytes_in_use);
+}
+
+TEST(BlockSlabTest, HugePages) {
+    // Whether we get huge pages depends on the machine, but every mode must give us
+    // usable memory.
+    // Every mode uses a buffer size of its own, so that it needs fresh chunks.
+    std::vector<std::pair<block_slab_huge_pages_t, size_t> > modes = {
+        { block_slab_huge_pages_t::transparent, 16384 },
+        { block_slab_huge_pages_t::hugetlb, 15872 } };
+    for (const auto &mode : modes) {
+        set_block_slab_huge_pages(mode.first);
+        const size_t size = mode.second;
+        std::vector<scoped_device_block_aligned_ptr_t<char> > bufs;
+        for (int i = 0; i < 1000; ++i) {
+            bufs.push_back(scoped_device_block_aligned_ptr_t<char>(size));
+            memset(bufs.back().get(), i % 256, size);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQ(static_cast<char>(i % 256), bufs[i].get()[size - 1]);
+        }
+        const block_slab_stats_t stats = get_block_slab_stats();
+        ASSERT_LE(stats.bytes_hugetlb, stats.bytes_reserved);
+        ASSERT_LE(stats.bytes_transparent_huge_pages, stats.bytes_reserved);
+    }
+    set_block_slab_huge_pages(block_slab_huge_pages_t::off);
+}
+
+}  // namespace unittest
@@ -2,12 +2,15 @@
 
 #include "arch/io/disk.hpp"
 #include "arch/types.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "concurrency/pmap.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "repli_timestamp.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "serializer/merger.hpp"
+#include "time.hpp"
 #include "unittest/btree_utils.hpp"
 #include "unittest/gtest.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -92,7 +95,8 @@ public:
         fn(std::move(superblock));
     }
 
-    std::string get(const store_key_t &key) {
+    std::string get(const store_key_t &key,
+                    read_descent_t descent = read_descent_t::OPTIMISTIC) {
         std::string bt_result;
 
         run_txn_fn(false, [&](scoped_ptr_t<real_superblock_t> &&superblock){
@@ -106,7 +110,8 @@ public:
                 key.btree_key(),
                 &kv_location,
                 &stats,
-                &trace);
+                &trace,
+                descent);
 
             if (kv_location.value.has()) {
                 short_value_buffer_t *v = kv_location.value_as<short_value_buffer_t>();
@@ -205,6 +210,36 @@ public:
         remove(key, repli_timestamp_t::distant_past);
     }
 
+    // The keys of `pairs` must be greater than all keys in the B-tree.
+    void bulk_load(const std::map<store_key_t, std::string> &pairs) {
+        run_txn_fn(true, [&](scoped_ptr_t<real_superblock_t> &&superblock){
+            btree_bulk_loader_t loader(sizer.get(), superblock.get());
+            for (const auto &pair : pairs) {
+                ASSERT_TRUE(loader.can_append(pair.first.btree_key()));
+                loader.prepare_append(pair.first.btree_key());
+                short_value_buffer_t buf(pair.second);
+                loader.append(pair.first.btree_key(), buf.data(),
+                              repli_timestamp_t::distant_past);
+            }
+            loader.finish();
+        });
+
+        kv.insert(pairs.begin(), pairs.end());
+    }
+
+    bool can_bulk_load(const store_key_t &key) {
+        bool result;
+        run_txn_fn(true, [&](scoped_ptr_t<real_superblock_t> &&superblock){
+            // The cheap check must agree with the loader.
+            const bool cheap_result = btree_bulk_loader_t::can_append_to(
+                superblock.get(), key.btree_key());
+            btree_bulk_loader_t loader(sizer.get(), superblock.get());
+            result = loader.can_append(key.btree_key());
+            EXPECT_EQ(result, cheap_result);
+        });
+        return result;
+    }
+
     void range(const key_range_t &_range) {
         std::map<store_key_t, std::string> bt_map;
 
@@ -498,4 +533,103 @@ TPTEST(BTree, RemoveRandomOrder) {
     ctx.verify();
 }
 
+TPTEST(BTree, BulkLoad) {
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    for (int batch = 0; batch < 100; ++batch) {
+        // Every batch goes past the end of the previous one, which got followed by a
+        // regular write.
+        std::map<store_key_t, std::string> pairs;
+        // Small batches make it likely that a batch ends while a node is waiting for
+        // its parent.
+        const int batch_size = 1 + rng.randint(rng.randint(2) == 0 ? 500 : 5);
+        for (int i = 0; i < batch_size; ++i) {
+            pairs[store_key_t(strprintf("%04d", batch)
+                              + random_letter_string(&rng, 1, 200))]
+                = random_letter_string(&rng, 0, 250);
+        }
+        ctx.bulk_load(pairs);
+        EXPECT_FALSE(ctx.can_bulk_load(pairs.begin()->first));
+        EXPECT_TRUE(ctx.can_bulk_load(store_key_t(strprintf("%04d", batch + 1))));
+        ctx.set(ctx.pick_random_key(&rng), random_letter_string(&rng, 0, 250));
+        ctx.verify();
+    }
+
+    // The bulk loaded B-tree must hold up to regular writes.
+    for (int i = 0; i < 1000; ++i) {
+        ctx.get(ctx.pick_random_key(&rng));
+        ctx.remove(ctx.pick_random_key(&rng));
+        if (rng.randint(2) == 0) {
+            ctx.set(store_key_t(random_letter_string(&rng, 1, 250)),
+                    random_letter_string(&rng, 0, 250));
+        }
+    }
+    ctx.verify();
+
+    while (!ctx.is_empty()) {
+        ctx.remove(ctx.lowest_key());
+    }
+    ctx.verify();
+}
+
+// This is not really a unit test, but a micro benchmark that compares the two ways of
+// descending the tree.  No need to run this in debug mode.
+#ifdef NDEBUG
+// Returns the average time per read, in microseconds.
+double concurrent_reads_benchmark(read_descent_t descent) {
+    const int num_keys = 20000;
+    const int num_readers = 16;
+    const int num_reads = 2000;
+    const int num_writers = 4;
+    const int num_writes = 200;
+
+    BTreeTestContext ctx;
+    rng_t rng;
+
+    std::map<store_key_t, std::string> pairs;
+    while (pairs.size() < static_cast<size_t>(num_keys)) {
+        pairs[store_key_t(random_letter_string(&rng, 1, 100))]
+            = random_letter_string(&rng, 0, 100);
+    }
+    ctx.bulk_load(pairs);
+    std::vector<store_key_t> keys;
+    for (const auto &pair : pairs) {
+        keys.push_back(pair.first);
+    }
+
+    ticks_t read_ticks = 0;
+    pmap(num_readers + num_writers, [&](int i) {
+        rng_t local_rng(i);
+        if (i < num_readers) {
+            for (int j = 0; j < num_reads; ++j) {
+                const ticks_t start = get_ticks();
+                ctx.get(keys[local_rng.randint(keys.size())], descent);
+                read_ticks += get_ticks() - start;
+            }
+        } else {
+            // Writers keep splitting nodes all over the tree, but they stay away from
+            // the keys that the readers read (which end with a letter).
+            for (int j = 0; j < num_writes; ++j) {
+                ctx.set(store_key_t(random_letter_string(&local_rng, 1, 100) + "!"),
+                        random_letter_string(&local_rng, 0, 100));
+                coro_t::yield();
+            }
+        }
+    });
+    ctx.verify();
+
+    return ticks_to_secs(read_ticks) / (num_readers * num_reads) * 1000000;
+}
+
+TPTEST(BTree, ConcurrentReadsBenchmark) {
+    ::testing::Test::RecordProperty(
+        "pessimistic_us_per_read",
+        strprintf("%f", concurrent_reads_benchmark(read_descent_t::PESSIMISTIC)));
+    ::testing::Test::RecordProperty(
+        "optimistic_us_per_read",
+        strprintf("%f", concurrent_reads_benchmark(read_descent_t::OPTIMISTIC)));
+}
+#endif  // NDEBUG
+
 } // namespace unittest
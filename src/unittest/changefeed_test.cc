@@ -0,0 +1,818 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "clustering/administration/metadata.hpp"
+#include "concurrency/rwlock.hpp"
+#include "extproc/extproc_pool.hpp"
+#include "btree/operations.hpp"
+#include "btree/reql_specific.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/store.hpp"
+#include "rdb_protocol/wire_func.hpp"
+#include "stl_utils.hpp"
+#include "unittest/clustering_utils.hpp"
+#include "unittest/dummy_metadata_controller.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static ql::datum_t make_row(double id, double a, double b) {
+    ql::datum_object_builder_t row;
+    UNUSED bool res = row.add("id", ql::datum_t(id));
+    res = row.add("a", ql::datum_t(a));
+    res = row.add("b", ql::datum_t(b));
+    return std::move(row).to_datum();
+}
+
+static store_key_t make_pkey(double id) {
+    return store_key_t(ql::datum_t(id).print_primary());
+}
+
+static ql::changefeed::msg_t make_change(double id,
+                                         ql::datum_t old_val,
+                                         ql::datum_t new_val) {
+    return ql::changefeed::msg_t(ql::changefeed::msg_t::change_t{
+        index_vals_t(),
+        index_vals_t(),
+        make_pkey(id),
+        std::move(old_val),
+        std::move(new_val),
+        boost::none});
+}
+
+// A range subscription on the primary keys in `range` that maps rows to `field`.
+static ql::changefeed::keyspec_t::range_t make_range_spec(
+        const ql::datum_range_t &range, const std::string &field) {
+    ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    std::vector<ql::transform_variant_t> transforms;
+    transforms.push_back(
+        ql::map_wire_func_t(r.var(x)[field].root_term(), make_vector(x)));
+    return ql::changefeed::keyspec_t::range_t{
+        std::move(transforms),
+        boost::none,
+        sorting_t::UNORDERED,
+        ql::datumspec_t(range),
+        boost::none};
+}
+
+// `.filter(func(x) { x[field].contains(func(y) { y == x["id"] }) }).map(func(x) {
+// x[field] })`, with the variables numbered `x_id` and `y_id`.
+static ql::changefeed::keyspec_t::range_t make_numbered_spec(
+        int64_t x_id, int64_t y_id, const std::string &field) {
+    ql::sym_t x(x_id), y(y_id);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    auto nested = r.array(static_cast<double>(y.value))
+        .call(Term::FUNC, r.var(y) == r.var(x)["id"]);
+    std::vector<ql::transform_variant_t> transforms;
+    transforms.push_back(ql::filter_wire_func_t(
+        ql::wire_func_t(r.var(x)[field].contains(nested).root_term(), make_vector(x)),
+        boost::none));
+    transforms.push_back(
+        ql::map_wire_func_t(r.var(x)[field].root_term(), make_vector(x)));
+    return ql::changefeed::keyspec_t::range_t{
+        std::move(transforms),
+        boost::none,
+        sorting_t::UNORDERED,
+        ql::datumspec_t(ql::datum_range_t::universe()),
+        boost::none};
+}
+
+// Collects the messages a `server_t` sends to one client, by stamp.
+class test_cfeed_client_t {
+public:
+    explicit test_cfeed_client_t(mailbox_manager_t *manager)
+        : mailbox(manager,
+                  [this](signal_t *, ql::changefeed::stamped_msg_t msg) {
+                      // The server stops us when it goes away.
+                      if (boost::get<ql::changefeed::msg_t::stop_t>(
+                              &msg.submsg.op) != nullptr) {
+                          return;
+                      }
+                      bool inserted = msgs.insert(
+                          std::make_pair(msg.stamp, std::move(msg.submsg))).second;
+                      guarantee(inserted);
+                  }) { }
+
+    // Checks that the client got `count` messages of type `T` with contiguous
+    // stamps, and returns them in order.
+    template <class T>
+    std::vector<T> received(size_t count) {
+        std::vector<T> res;
+        uint64_t expected_stamp = 0;
+        for (const auto &pair : msgs) {
+            EXPECT_EQ(expected_stamp, pair.first);
+            ++expected_stamp;
+            const T *op = boost::get<T>(&pair.second.op);
+            guarantee(op != nullptr);
+            res.push_back(*op);
+        }
+        EXPECT_EQ(count, res.size());
+        return res;
+    }
+
+    std::vector<ql::changefeed::msg_t::change_t> changes(size_t count) {
+        return received<ql::changefeed::msg_t::change_t>(count);
+    }
+
+    std::map<uint64_t, ql::changefeed::msg_t> msgs;
+    mailbox_t<void(ql::changefeed::stamped_msg_t)> mailbox;
+};
+
+// What a `server_t` needs: a mailbox manager and a store for the stamp lock.
+class test_cfeed_env_t {
+public:
+    test_cfeed_env_t()
+        : io_backender(file_direct_io_mode_t::buffered_desired),
+          extproc_pool(2),
+          ctx(&extproc_pool, nullptr, auth_manager.get_view()),
+          test_store(&io_backender, &order_source, &ctx) { }
+
+    mailbox_manager_t *manager() { return cluster.get_mailbox_manager(); }
+    store_t *store() { return &test_store.store; }
+    rdb_context_t *context() { return &ctx; }
+
+    void send_all(ql::changefeed::server_t *server,
+                  const ql::changefeed::msg_t &msg,
+                  const auto_drainer_t::lock_t &keepalive) {
+        rwlock_in_line_t stamp_spot(&test_store.store.cfeed_stamp_lock,
+                                    access_t::write);
+        server->send_all(
+            msg,
+            boost::get<ql::changefeed::msg_t::change_t>(msg.op).pkey,
+            &stamp_spot,
+            keepalive);
+    }
+
+private:
+    order_source_t order_source;
+    simple_mailbox_cluster_t cluster;
+    io_backender_t io_backender;
+    extproc_pool_t extproc_pool;
+    dummy_semilattice_controller_t<auth_semilattice_metadata_t> auth_manager;
+    rdb_context_t ctx;
+    test_store_t test_store;
+};
+
+TPTEST(ChangefeedTest, ServerFiltersAndProjects) {
+    test_cfeed_env_t env;
+
+    // `a` gets the `a` fields of the rows with ids in [0, 10), `b` the `b` fields
+    // of all the rows, `both` has both of these filters, `point` gets the whole
+    // row with id 20, and `unfiltered` never tells the server what it wants.
+    test_cfeed_client_t a(env.manager());
+    test_cfeed_client_t b(env.manager());
+    test_cfeed_client_t both(env.manager());
+    test_cfeed_client_t point(env.manager());
+    test_cfeed_client_t unfiltered(env.manager());
+    const uuid_u a_filter = generate_uuid();
+    const uuid_u b_filter = generate_uuid();
+
+    const std::vector<std::pair<double, ql::changefeed::msg_t> > changes = {
+        // Everyone but `point` wants this one.
+        std::make_pair(5.0, make_change(5, make_row(5, 1, 10), make_row(5, 2, 20))),
+        // Out of `a`'s range.
+        std::make_pair(
+            20.0, make_change(20, make_row(20, 1, 10), make_row(20, 2, 20))),
+        // The row changes, but not its `a` field.
+        std::make_pair(6.0, make_change(6, make_row(6, 1, 10), make_row(6, 1, 30))),
+        // An insert.
+        std::make_pair(7.0, make_change(7, ql::datum_t(), make_row(7, 3, 30)))};
+
+    {
+        ql::changefeed::server_t server(env.manager(), env.store());
+        auto_drainer_t::lock_t keepalive = server.get_keepalive();
+        for (auto *client : {&a, &b, &both, &point, &unfiltered}) {
+            server.add_client(
+                client->mailbox.get_address(), region_t::universe(), keepalive);
+        }
+        auto add_range_filter = [&](test_cfeed_client_t *client,
+                                    const uuid_u &filter,
+                                    const ql::datum_range_t &range,
+                                    const std::string &field) {
+            server.update_filters(
+                client->mailbox.get_address(),
+                nullptr,
+                ql::changefeed::filter_update_t{
+                    generate_uuid(),
+                    filter,
+                    make_range_spec(range, field),
+                    ql::global_optargs_t(),
+                    auth::user_context_t()},
+                keepalive);
+        };
+        const ql::datum_range_t a_range(ql::datum_t(0.0), key_range_t::closed,
+                                        ql::datum_t(10.0), key_range_t::open);
+        add_range_filter(&a, a_filter, a_range, "a");
+        add_range_filter(&b, b_filter, ql::datum_range_t::universe(), "b");
+        add_range_filter(&both, a_filter, a_range, "a");
+        add_range_filter(&both, b_filter, ql::datum_range_t::universe(), "b");
+        server.update_filters(
+            point.mailbox.get_address(),
+            nullptr,
+            ql::changefeed::filter_update_t{
+                generate_uuid(),
+                nil_uuid(),
+                ql::changefeed::keyspec_t::point_t{ql::datum_t(20.0)},
+                ql::global_optargs_t(),
+                auth::user_context_t()},
+            keepalive);
+
+        for (const auto &change : changes) {
+            env.send_all(&server, change.second, keepalive);
+        }
+        let_stuff_happen();
+    }
+
+    // The stamps of the changes `a` didn't want weren't used up.
+    std::vector<ql::changefeed::msg_t::change_t> a_changes = a.changes(2);
+    ASSERT_EQ(2u, a_changes.size());
+    EXPECT_EQ(make_pkey(5), a_changes[0].pkey);
+    EXPECT_EQ(ql::datum_t(1.0), a_changes[0].old_val);
+    EXPECT_EQ(ql::datum_t(2.0), a_changes[0].new_val);
+    EXPECT_EQ(boost::make_optional(a_filter), a_changes[0].transformed_for);
+    EXPECT_EQ(make_pkey(7), a_changes[1].pkey);
+    EXPECT_FALSE(a_changes[1].old_val.has());
+    EXPECT_EQ(ql::datum_t(3.0), a_changes[1].new_val);
+    EXPECT_EQ(boost::make_optional(a_filter), a_changes[1].transformed_for);
+
+    // `b` gets the same changes projected its own way.
+    std::vector<ql::changefeed::msg_t::change_t> b_changes = b.changes(4);
+    ASSERT_EQ(4u, b_changes.size());
+    const std::vector<std::pair<double, double> > b_vals = {
+        std::make_pair(10.0, 20.0),
+        std::make_pair(10.0, 20.0),
+        std::make_pair(10.0, 30.0)};
+    for (size_t i = 0; i < b_vals.size(); ++i) {
+        EXPECT_EQ(make_pkey(changes[i].first), b_changes[i].pkey);
+        EXPECT_EQ(ql::datum_t(b_vals[i].first), b_changes[i].old_val);
+        EXPECT_EQ(ql::datum_t(b_vals[i].second), b_changes[i].new_val);
+        EXPECT_EQ(boost::make_optional(b_filter), b_changes[i].transformed_for);
+    }
+    EXPECT_FALSE(b_changes[3].old_val.has());
+    EXPECT_EQ(ql::datum_t(30.0), b_changes[3].new_val);
+
+    // Changes both of `both`'s filters want are sent whole, the others projected.
+    std::vector<ql::changefeed::msg_t::change_t> both_changes = both.changes(4);
+    ASSERT_EQ(4u, both_changes.size());
+    EXPECT_EQ(make_row(5, 2, 20), both_changes[0].new_val);
+    EXPECT_FALSE(static_cast<bool>(both_changes[0].transformed_for));
+    for (size_t i : {1, 2}) {
+        EXPECT_EQ(ql::datum_t(b_vals[i].second), both_changes[i].new_val);
+        EXPECT_EQ(boost::make_optional(b_filter), both_changes[i].transformed_for);
+    }
+    EXPECT_EQ(make_row(7, 3, 30), both_changes[3].new_val);
+    EXPECT_FALSE(static_cast<bool>(both_changes[3].transformed_for));
+
+    // Point subscriptions get whole rows.
+    std::vector<ql::changefeed::msg_t::change_t> point_changes = point.changes(1);
+    ASSERT_EQ(1u, point_changes.size());
+    EXPECT_EQ(make_row(20, 2, 20), point_changes[0].new_val);
+    EXPECT_FALSE(static_cast<bool>(point_changes[0].transformed_for));
+
+    std::vector<ql::changefeed::msg_t::change_t> all_changes =
+        unfiltered.changes(changes.size());
+    ASSERT_EQ(changes.size(), all_changes.size());
+    for (size_t i = 0; i < changes.size(); ++i) {
+        const auto &change =
+            boost::get<ql::changefeed::msg_t::change_t>(changes[i].second.op);
+        EXPECT_EQ(change.pkey, all_changes[i].pkey);
+        EXPECT_EQ(change.new_val, all_changes[i].new_val);
+        EXPECT_FALSE(static_cast<bool>(all_changes[i].transformed_for));
+    }
+}
+
+TPTEST(ChangefeedTest, ServerDropsStoppedFilters) {
+    test_cfeed_env_t env;
+    test_cfeed_client_t client(env.manager());
+    const uuid_u stopped_sub = generate_uuid();
+    const uuid_u running_sub = generate_uuid();
+    {
+        ql::changefeed::server_t server(env.manager(), env.store());
+        auto_drainer_t::lock_t keepalive = server.get_keepalive();
+        server.add_client(client.mailbox.get_address(), region_t::universe(), keepalive);
+        for (const auto &pair : {std::make_pair(stopped_sub, 20.0),
+                                 std::make_pair(running_sub, 21.0)}) {
+            server.update_filters(
+                client.mailbox.get_address(),
+                nullptr,
+                ql::changefeed::filter_update_t{
+                    pair.first,
+                    nil_uuid(),
+                    ql::changefeed::keyspec_t::point_t{ql::datum_t(pair.second)},
+                    ql::global_optargs_t(),
+                    auth::user_context_t()},
+                keepalive);
+        }
+
+        // This is what the client's feed sends when a subscription stops.
+        send(env.manager(), server.get_filter_stop_addr(),
+             client.mailbox.get_address(), std::vector<uuid_u>{stopped_sub});
+        let_stuff_happen();
+
+        env.send_all(&server,
+                     make_change(20, make_row(20, 1, 10), make_row(20, 2, 20)),
+                     keepalive);
+        env.send_all(&server,
+                     make_change(21, make_row(21, 1, 10), make_row(21, 2, 20)),
+                     keepalive);
+        let_stuff_happen();
+    }
+
+    std::vector<ql::changefeed::msg_t::change_t> changes = client.changes(1);
+    ASSERT_EQ(1u, changes.size());
+    EXPECT_EQ(make_pkey(21), changes[0].pkey);
+}
+
+typedef std::map<ql::datum_t, double> deltas_t;
+
+// Registers an aggregate changefeed on `spec` with a new server, sends it `changes`,
+// and returns the deltas the client was sent.
+static std::vector<deltas_t> aggregate_deltas(
+        const ql::changefeed::keyspec_t::aggregate_t &spec,
+        const std::vector<ql::changefeed::msg_t> &changes,
+        size_t expected_count) {
+    test_cfeed_env_t env;
+    test_cfeed_client_t client(env.manager());
+    const uuid_u sub = generate_uuid();
+    {
+        ql::changefeed::server_t server(env.manager(), env.store());
+        auto_drainer_t::lock_t keepalive = server.get_keepalive();
+        server.add_client(client.mailbox.get_address(), region_t::universe(), keepalive);
+        {
+            rwlock_in_line_t stamp_spot(&env.store()->cfeed_stamp_lock,
+                                        access_t::read);
+            server.add_aggregate_client(
+                client.mailbox.get_address(),
+                region_t::universe(),
+                nullptr,
+                ql::global_optargs_t(),
+                auth::user_context_t(),
+                sub,
+                spec,
+                &stamp_spot,
+                keepalive);
+        }
+        for (const auto &change : changes) {
+            env.send_all(&server, change, keepalive);
+        }
+        let_stuff_happen();
+    }
+    std::vector<deltas_t> res;
+    for (const auto &change :
+             client.received<ql::changefeed::msg_t::aggregate_change_t>(
+                 expected_count)) {
+        EXPECT_EQ(sub, change.sub);
+        res.push_back(change.deltas);
+    }
+    return res;
+}
+
+static ql::transform_variant_t make_map(const std::string &field) {
+    ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    return ql::map_wire_func_t(r.var(x)[field].root_term(), make_vector(x));
+}
+
+static ql::transform_variant_t make_group(const std::string &field) {
+    ql::sym_t x(1);
+    ql::minidriver_t r(ql::backtrace_id_t::empty());
+    std::vector<counted_t<const ql::func_t> > funcs;
+    funcs.push_back(
+        ql::map_wire_func_t(r.var(x)[field].root_term(), make_vector(x))
+            .compile_wire_func());
+    return ql::group_wire_func_t(std::move(funcs), false, false);
+}
+
+static ql::changefeed::keyspec_t::aggregate_t make_aggregate_spec(
+        std::vector<ql::transform_variant_t> transforms,
+        boost::optional<std::string> sindex,
+        ql::datumspec_t datumspec,
+        ql::changefeed::keyspec_t::aggregate_t::terminal_t terminal) {
+    return ql::changefeed::keyspec_t::aggregate_t{
+        ql::changefeed::keyspec_t::range_t{
+            std::move(transforms),
+            std::move(sindex),
+            sorting_t::UNORDERED,
+            std::move(datumspec),
+            boost::none},
+        std::move(terminal)};
+}
+
+TPTEST(ChangefeedTest, RangeFilterIdIgnoresVariableIds) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+    const uuid_u id = ql::changefeed::range_filter_id(
+        make_numbered_spec(1, 2, "a"), env);
+    EXPECT_EQ(id, ql::changefeed::range_filter_id(make_numbered_spec(1, 2, "a"), env));
+    EXPECT_EQ(id, ql::changefeed::range_filter_id(make_numbered_spec(9, 7, "a"), env));
+    EXPECT_NE(id, ql::changefeed::range_filter_id(make_numbered_spec(1, 2, "b"), env));
+}
+
+TEST(ChangefeedTest, LimitMarginSize) {
+    EXPECT_EQ(16u, ql::changefeed::limit_margin_size(1));
+    EXPECT_EQ(16u, ql::changefeed::limit_margin_size(16));
+    EXPECT_EQ(100u, ql::changefeed::limit_margin_size(100));
+    EXPECT_EQ(1024u, ql::changefeed::limit_margin_size(1024));
+    EXPECT_EQ(1024u, ql::changefeed::limit_margin_size(5000));
+}
+
+// The ids of the rows in the limit tests are below this.
+const int MAX_LIMIT_ROW_ID = 200;
+
+static ql::datum_t make_limit_row(int id, int version) {
+    ql::datum_object_builder_t row;
+    UNUSED bool res = row.add("id", ql::datum_t(static_cast<double>(id)));
+    res = row.add("version", ql::datum_t(static_cast<double>(version)));
+    return std::move(row).to_datum();
+}
+
+static ql::changefeed::item_t make_limit_item(int id, int version) {
+    ql::raw_stream_t stream;
+    stream.push_back(
+        ql::rget_item_t(make_pkey(id), ql::datum_t(), make_limit_row(id, version)));
+    std::vector<ql::changefeed::item_t> items =
+        ql::changefeed::mangle_sort_truncate_stream(
+            std::move(stream), is_primary_t::YES, sorting_t::ASCENDING, 1);
+    guarantee(items.size() == 1);
+    return items[0];
+}
+
+// Writes the rows with ids in [begin, end) to the store's btree behind the limit
+// manager's back, or deletes them if `version` is negative.
+static void write_limit_rows(store_t *store, int begin, int end, int version) {
+    cond_t non_interruptor;
+    write_token_t token;
+    store->new_write_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_write(
+        end - begin, write_durability_t::SOFT,
+        &token, &txn, &superblock, &non_interruptor);
+    rdb_live_deletion_context_t deletion_context;
+    for (int id = begin; id < end; ++id) {
+        rdb_modification_info_t mod_info;
+        if (version >= 0) {
+            point_write_response_t response;
+            rdb_set(make_pkey(id), make_limit_row(id, version), true,
+                    store->btree.get(), repli_timestamp_t::distant_past,
+                    superblock.get(), &deletion_context, &response, &mod_info,
+                    nullptr);
+        } else {
+            point_delete_response_t response;
+            rdb_delete(make_pkey(id), store->btree.get(),
+                       repli_timestamp_t::distant_past, superblock.get(),
+                       &deletion_context, delete_mode_t::REGULAR_QUERY, &response,
+                       &mod_info, nullptr);
+        }
+    }
+}
+
+/* An `orderBy({index: 'id'}).limit(limit).changes()` feed on `env`'s store, whose
+limit manager starts out with the rows with ids in [0, initial_end) at version 0. */
+class test_limit_feed_t {
+public:
+    test_limit_feed_t(test_cfeed_env_t *_env, size_t limit, int initial_end)
+        : env(_env),
+          client(env->manager()),
+          server(env->manager(), env->store()),
+          keepalive(server.get_keepalive()),
+          seen(0) {
+        for (int id = 0; id < MAX_LIMIT_ROW_ID; ++id) {
+            ids_by_key[make_limit_item(id, 0).first] = id;
+        }
+        server.add_client(client.mailbox.get_address(), region_t::universe(), keepalive);
+        std::vector<ql::changefeed::item_t> items;
+        for (int id = 0; id < initial_end; ++id) {
+            items.push_back(make_limit_item(id, 0));
+        }
+        server.add_limit_client(
+            client.mailbox.get_address(),
+            region_t::universe(),
+            "test",
+            env->context(),
+            ql::global_optargs_t(),
+            auth::user_context_t(),
+            generate_uuid(),
+            ql::changefeed::keyspec_t::limit_t{
+                ql::changefeed::keyspec_t::range_t{
+                    std::vector<ql::transform_variant_t>(),
+                    boost::none,
+                    sorting_t::ASCENDING,
+                    ql::datumspec_t(ql::datum_range_t::universe()),
+                    boost::none},
+                limit},
+            ql::changefeed::limit_order_t(sorting_t::ASCENDING),
+            std::move(items),
+            keepalive);
+    }
+
+    // The ids of the rows the client starts out with.
+    std::vector<int> start_ids() {
+        let_stuff_happen();
+        std::vector<int> ids;
+        EXPECT_EQ(1u, client.msgs.size());
+        if (client.msgs.size() != 0) {
+            const auto *start = boost::get<ql::changefeed::msg_t::limit_start_t>(
+                &client.msgs.begin()->second.op);
+            guarantee(start != nullptr);
+            for (const auto &item : start->start_data) {
+                ids.push_back(row_id(item.second.second));
+            }
+        }
+        seen = client.msgs.size();
+        return ids;
+    }
+
+    // Deletes the rows with ids in [begin, end) from the btree, tells the limit
+    // manager about it and about `added`, and commits.  Returns the ids of the rows
+    // that left the client's set, and the ids and versions of those that joined it.
+    std::pair<std::set<int>, std::set<std::pair<int, int> > > commit(
+            int begin, int end, const std::vector<int> &added = std::vector<int>()) {
+        write_limit_rows(env->store(), begin, end, -1);
+        cond_t non_interruptor;
+        read_token_t token;
+        env->store()->new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        env->store()->acquire_superblock_for_read(
+            &token, &txn, &superblock, &non_interruptor, false);
+        server.foreach_limit(
+            boost::optional<std::string>(),
+            nullptr,
+            [&](rwlock_in_line_t *, rwlock_in_line_t *, rwlock_in_line_t *spot,
+                ql::changefeed::limit_manager_t *lm) {
+                for (int id = begin; id < end; ++id) {
+                    lm->del(spot, make_pkey(id), is_primary_t::YES);
+                }
+                for (int id : added) {
+                    lm->add(spot, make_pkey(id), is_primary_t::YES,
+                            ql::datum_t::null(), make_limit_row(id, 0));
+                }
+                lm->commit(spot, ql::changefeed::primary_ref_t{
+                        env->store()->btree.get(), superblock.get()});
+            },
+            keepalive);
+        let_stuff_happen();
+
+        std::pair<std::set<int>, std::set<std::pair<int, int> > > res;
+        for (auto it = std::next(client.msgs.begin(), seen);
+             it != client.msgs.end();
+             ++it) {
+            const auto *change = boost::get<ql::changefeed::msg_t::limit_change_t>(
+                &it->second.op);
+            guarantee(change != nullptr);
+            if (change->old_key) {
+                auto id = ids_by_key.find(*change->old_key);
+                guarantee(id != ids_by_key.end());
+                res.first.insert(id->second);
+            }
+            if (change->new_val) {
+                const ql::datum_t &row = change->new_val->second.second;
+                res.second.insert(std::make_pair(
+                    row_id(row),
+                    static_cast<int>(row.get_field("version").as_num())));
+            }
+        }
+        seen = client.msgs.size();
+        return res;
+    }
+
+private:
+    int row_id(const ql::datum_t &row) {
+        return static_cast<int>(row.get_field("id").as_num());
+    }
+
+    test_cfeed_env_t *env;
+    test_cfeed_client_t client;
+    ql::changefeed::server_t server;
+    auto_drainer_t::lock_t keepalive;
+    size_t seen;
+    // The ids of the rows, by their keys in the limit manager.
+    std::map<std::string, int> ids_by_key;
+};
+
+TPTEST(ChangefeedTest, LimitMarginComplete) {
+    test_cfeed_env_t env;
+    // The btree has rows that the limit manager doesn't know about, so we can tell
+    // whether it reads them.
+    write_limit_rows(env.store(), 0, 50, 1);
+    // With fewer rows than the limit plus the margin, the initial read got them all.
+    test_limit_feed_t feed(&env, 2, 5);
+    EXPECT_EQ(std::vector<int>({0, 1}), feed.start_ids());
+
+    auto changes = feed.commit(0, 1);
+    EXPECT_EQ(std::set<int>({0}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{2, 0}}), changes.second);
+
+    // A row past the end of a complete margin still goes into it.
+    changes = feed.commit(1, 2, {100});
+    EXPECT_EQ(std::set<int>({1}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{3, 0}}), changes.second);
+
+    // Once the margin runs out, there is nothing on disk to replace the rows with.
+    changes = feed.commit(2, 5);
+    EXPECT_EQ(std::set<int>({2, 3}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{100, 0}}), changes.second);
+}
+
+TPTEST(ChangefeedTest, LimitMarginRefill) {
+    test_cfeed_env_t env;
+    write_limit_rows(env.store(), 0, 100, 1);
+    // The initial read got the limit plus a full margin of 16 rows, at version 0.
+    test_limit_feed_t feed(&env, 2, 18);
+    EXPECT_EQ(std::vector<int>({0, 1}), feed.start_ids());
+
+    // Rows leaving the top come from the margin.
+    auto changes = feed.commit(0, 10);
+    EXPECT_EQ(std::set<int>({0, 1}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{10, 0}, {11, 0}}), changes.second);
+
+    // These deletes eat through the margin, so the commit reads the replacements and
+    // a new margin from disk.
+    changes = feed.commit(10, 20);
+    EXPECT_EQ(std::set<int>({10, 11}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{20, 1}, {21, 1}}), changes.second);
+
+    // The next replacement comes from the new margin, not from disk.
+    write_limit_rows(env.store(), 20, 100, 2);
+    changes = feed.commit(20, 21);
+    EXPECT_EQ(std::set<int>({20}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{22, 1}}), changes.second);
+
+    // Until that one runs out too.
+    changes = feed.commit(21, 38);
+    EXPECT_EQ(std::set<int>({21, 22}), changes.first);
+    EXPECT_EQ((std::set<std::pair<int, int> >{{38, 2}, {39, 2}}), changes.second);
+}
+
+TPTEST(ChangefeedTest, AggregateGroupedDeltas) {
+    // `r.table(...).group('a').count().changes()`
+    std::vector<deltas_t> deltas = aggregate_deltas(
+        make_aggregate_spec(make_vector(make_group("a")),
+                            boost::none,
+                            ql::datumspec_t(ql::datum_range_t::universe()),
+                            ql::count_wire_func_t()),
+        {make_change(1, ql::datum_t(), make_row(1, 1, 10)),
+         // The row moves to another group.
+         make_change(1, make_row(1, 1, 10), make_row(1, 2, 20)),
+         // The row stays in its group, so there's nothing to send.
+         make_change(1, make_row(1, 2, 20), make_row(1, 2, 30)),
+         make_change(1, make_row(1, 2, 30), ql::datum_t())},
+        3);
+    ASSERT_EQ(3u, deltas.size());
+    EXPECT_EQ((deltas_t{{ql::datum_t(1.0), 1}}), deltas[0]);
+    EXPECT_EQ((deltas_t{{ql::datum_t(1.0), -1}, {ql::datum_t(2.0), 1}}), deltas[1]);
+    EXPECT_EQ((deltas_t{{ql::datum_t(2.0), -1}}), deltas[2]);
+}
+
+TPTEST(ChangefeedTest, AggregateMultiCopyPrimaryKeys) {
+    // `r.table(...).getAll(1, 1, 2).count().changes()`
+    std::vector<deltas_t> deltas = aggregate_deltas(
+        make_aggregate_spec(std::vector<ql::transform_variant_t>(),
+                            boost::none,
+                            ql::datumspec_t(std::map<ql::datum_t, uint64_t>{
+                                    {ql::datum_t(1.0), 2}, {ql::datum_t(2.0), 1}}),
+                            ql::count_wire_func_t()),
+        {make_change(1, ql::datum_t(), make_row(1, 1, 10)),
+         // Not one of the keys.
+         make_change(3, ql::datum_t(), make_row(3, 1, 10)),
+         make_change(2, ql::datum_t(), make_row(2, 1, 10)),
+         make_change(1, make_row(1, 1, 10), ql::datum_t())},
+        3);
+    ASSERT_EQ(3u, deltas.size());
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 2}}), deltas[0]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 1}}), deltas[1]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), -2}}), deltas[2]);
+}
+
+static ql::changefeed::msg_t make_sindex_change(
+        const std::vector<std::string> &old_keys,
+        const std::vector<std::string> &new_keys) {
+    auto index_vals = [](const std::vector<std::string> &keys) {
+        index_vals_t vals;
+        std::vector<index_pair_t> *pairs = &vals["idx"];
+        for (const std::string &key : keys) {
+            pairs->push_back(std::make_pair(ql::datum_t(key.c_str()), key));
+        }
+        return vals;
+    };
+    return ql::changefeed::msg_t(ql::changefeed::msg_t::change_t{
+        index_vals(old_keys),
+        index_vals(new_keys),
+        make_pkey(1),
+        old_keys.empty() ? ql::datum_t() : make_row(1, 1, 10),
+        new_keys.empty() ? ql::datum_t() : make_row(1, 1, 10),
+        boost::none});
+}
+
+TPTEST(ChangefeedTest, AggregateSindexCopies) {
+    // `r.table(...).getAll('x', 'y', 'y', {index: 'idx'}).count().changes()` on a
+    // multi index.
+    std::vector<deltas_t> deltas = aggregate_deltas(
+        make_aggregate_spec(std::vector<ql::transform_variant_t>(),
+                            std::string("idx"),
+                            ql::datumspec_t(std::map<ql::datum_t, uint64_t>{
+                                    {ql::datum_t("x"), 1}, {ql::datum_t("y"), 2}}),
+                            ql::count_wire_func_t()),
+        {make_sindex_change({}, {"x", "y", "z"}),
+         make_sindex_change({"x", "y", "z"}, {"y"}),
+         make_sindex_change({"y"}, {"z"}),
+         // Not in the range before or after.
+         make_sindex_change({"z"}, {"z"})},
+        3);
+    ASSERT_EQ(3u, deltas.size());
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 3}}), deltas[0]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), -1}}), deltas[1]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), -2}}), deltas[2]);
+}
+
+TPTEST(ChangefeedTest, AggregateSum) {
+    // `r.table(...).map(r.row('a')).sum().changes()`
+    std::vector<deltas_t> deltas = aggregate_deltas(
+        make_aggregate_spec(make_vector(make_map("a")),
+                            boost::none,
+                            ql::datumspec_t(ql::datum_range_t::universe()),
+                            ql::sum_wire_func_t(ql::backtrace_id_t::empty())),
+        {make_change(1, ql::datum_t(), make_row(1, 2.5, 10)),
+         make_change(1, make_row(1, 2.5, 10), make_row(1, 4, 10)),
+         make_change(1, make_row(1, 4, 10), make_row(1, 4, 20)),
+         make_change(1, make_row(1, 4, 20), ql::datum_t())},
+        3);
+    ASSERT_EQ(3u, deltas.size());
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 2.5}}), deltas[0]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 1.5}}), deltas[1]);
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), -4}}), deltas[2]);
+}
+
+TEST(ChangefeedTest, AggregateValuesUngrouped) {
+    ql::changefeed::aggregate_values_t values(false);
+    // The initial values of two shards, and a change of one of them that arrives
+    // before the other one's initial values.
+    values.add(deltas_t{{ql::datum_t::null(), 3}});
+    values.add(deltas_t{{ql::datum_t::null(), 1}});
+    values.add(deltas_t{{ql::datum_t::null(), 2}});
+    EXPECT_EQ((deltas_t{{ql::datum_t::null(), 6}}), values.start());
+    EXPECT_TRUE(values.take_changes().empty());
+
+    // Changes that cancel out while we're squashing aren't reported.
+    values.add(deltas_t{{ql::datum_t::null(), -1}});
+    values.add(deltas_t{{ql::datum_t::null(), 1}});
+    EXPECT_TRUE(values.take_changes().empty());
+
+    // The only group stays around when it drops to 0.
+    values.add(deltas_t{{ql::datum_t::null(), -4}});
+    values.add(deltas_t{{ql::datum_t::null(), -2}});
+    std::vector<ql::changefeed::aggregate_values_t::change_t> changes =
+        values.take_changes();
+    ASSERT_EQ(1u, changes.size());
+    EXPECT_EQ(ql::datum_t::null(), changes[0].group);
+    EXPECT_EQ(ql::datum_t(6.0), changes[0].old_val);
+    EXPECT_EQ(ql::datum_t(0.0), changes[0].new_val);
+    EXPECT_TRUE(values.take_changes().empty());
+}
+
+TEST(ChangefeedTest, AggregateValuesGrouped) {
+    const ql::datum_t a("a"), b("b"), c("c");
+    ql::changefeed::aggregate_values_t values(true);
+    // A change removing a row from `a` arrives before the initial values that
+    // count it.
+    values.add(deltas_t{{a, -1}});
+    values.add(deltas_t{{a, 2}, {b, 2}});
+    EXPECT_EQ((deltas_t{{a, 1}, {b, 2}}), values.start());
+
+    // `a` drops to 0 and disappears.
+    values.add(deltas_t{{a, -1}});
+    std::vector<ql::changefeed::aggregate_values_t::change_t> changes =
+        values.take_changes();
+    ASSERT_EQ(1u, changes.size());
+    EXPECT_EQ(a, changes[0].group);
+    EXPECT_EQ(ql::datum_t(1.0), changes[0].old_val);
+    EXPECT_EQ(ql::datum_t::null(), changes[0].new_val);
+
+    // With squashing, groups that come and go in between, or end up where they
+    // were, aren't reported.
+    values.add(deltas_t{{c, 1}});
+    values.add(deltas_t{{b, -2}});
+    values.add(deltas_t{{c, -1}});
+    values.add(deltas_t{{b, 2}});
+    EXPECT_TRUE(values.take_changes().empty());
+
+    // `a` comes back, and `b` disappears.
+    values.add(deltas_t{{a, 1}, {b, -2}});
+    changes = values.take_changes();
+    ASSERT_EQ(2u, changes.size());
+    EXPECT_EQ(a, changes[0].group);
+    EXPECT_EQ(ql::datum_t::null(), changes[0].old_val);
+    EXPECT_EQ(ql::datum_t(1.0), changes[0].new_val);
+    EXPECT_EQ(b, changes[1].group);
+    EXPECT_EQ(ql::datum_t(2.0), changes[1].old_val);
+    EXPECT_EQ(ql::datum_t::null(), changes[1].new_val);
+}
+
+}  // namespace unittest
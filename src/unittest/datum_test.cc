@@ -172,6 +172,47 @@ TEST(DatumTest, ArraySerialization) {
     }
 }
 
+// Tests field lookups in objects that are backed by their serialized representation.
+TEST(DatumTest, BufferObjectGetField) {
+    std::map<datum_string_t, ql::datum_t> fields;
+    for (int i = 0; i < 300; ++i) {
+        ql::datum_t value;
+        switch (i % 4) {
+        case 0: value = ql::datum_t(static_cast<double>(i)); break;
+        case 1: value = ql::datum_t(datum_string_t(std::string(i, 'x'))); break;
+        case 2: value = ql::datum_t::null(); break;
+        case 3: value = ql::datum_t(std::map<datum_string_t, ql::datum_t>
+                    {std::make_pair(datum_string_t("n"), ql::datum_t(1.0))}); break;
+        default: unreachable();
+        }
+        fields.insert(std::make_pair(datum_string_t(strprintf("key_%03d", i)), value));
+    }
+    const ql::datum_t object(std::move(fields));
+
+    ql::datum_t deserialized_object;
+    {
+        string_stream_t write_stream;
+        write_message_t wm;
+        serialize<cluster_version_t::LATEST_OVERALL>(&wm, object);
+        ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+        string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+        ASSERT_EQ(archive_result_t::SUCCESS,
+                  deserialize<cluster_version_t::LATEST_OVERALL>(
+                      &read_stream, &deserialized_object));
+    }
+    ASSERT_TRUE(deserialized_object.get_buf_ref() != nullptr);
+
+    for (size_t i = 0; i < object.obj_size(); ++i) {
+        auto pair = object.get_pair(i);
+        ASSERT_EQ(pair.second, deserialized_object.get_field(pair.first));
+    }
+    const char *missing_keys[] = { "", "key", "key_000a", "key_1", "key_299 ", "z" };
+    for (const char *key : missing_keys) {
+        ASSERT_FALSE(deserialized_object.get_field(key, ql::NOTHROW).has());
+        ASSERT_FALSE(object.get_field(key, ql::NOTHROW).has());
+    }
+}
+
 // Tests serialization with different offset sizes, up to 32 bit
 // (64 bit not tested here, because that would use too much memory for a unit test)
 TEST(DatumTest, OffsetScaling) {
@@ -0,0 +1,107 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/disk_backed_sorter.hpp"
+#include "random.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+serializer_filepath_t dbs_run_path(size_t run) {
+    const std::string path = strprintf("test_disk_backed_sorter_%zu", run);
+    return manual_serializer_filepath(path, path + ".create");
+}
+
+void run_sort_test(int num_values,
+                   size_t max_values_in_memory,
+                   size_t max_runs_merged,
+                   size_t expected_runs,
+                   size_t expected_max_open_runs) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    disk_backed_sorter_t<std::string> sorter(
+        &io_backender, &dbs_run_path, &get_global_perfmon_collection(),
+        max_values_in_memory * sizeof(std::string), max_runs_merged);
+    std::vector<std::string> ref_values;
+
+    rng_t rng(0);
+    for (int i = 0; i < num_values; ++i) {
+        // Some values appear more than once.
+        std::string value = strprintf("%d", rng.randint(num_values));
+        ref_values.push_back(value);
+        sorter.push(std::move(value));
+    }
+    EXPECT_EQ(num_values, sorter.size());
+    std::sort(ref_values.begin(), ref_values.end());
+
+    for (const std::string &ref_value : ref_values) {
+        ASSERT_FALSE(sorter.empty());
+        std::string value;
+        sorter.pop(&value);
+        EXPECT_EQ(ref_value, value);
+    }
+    EXPECT_TRUE(sorter.empty());
+    EXPECT_EQ(expected_runs, sorter.num_runs());
+    EXPECT_EQ(expected_max_open_runs, sorter.max_open_runs());
+}
+
+TEST(DiskBackedSorter, InMemory) {
+    unittest::run_in_thread_pool([]() { run_sort_test(1000, 1000, 16, 0, 0); }, 2);
+}
+
+TEST(DiskBackedSorter, ManyRuns) {
+    // The last run isn't full.
+    unittest::run_in_thread_pool([]() { run_sort_test(1050, 100, 16, 11, 11); }, 2);
+}
+
+TEST(DiskBackedSorter, MultiPassMerge) {
+    // Every three runs of the same size get merged into one, and the final merge has
+    // to merge some runs first to get down to three.  11 runs get written for the
+    // values, 4 more by merging, and no more than 6 exist at the same time.
+    unittest::run_in_thread_pool([]() { run_sort_test(1050, 100, 3, 15, 6); }, 2);
+}
+
+TEST(DiskBackedSorter, ManySmallRuns) {
+    // 200 runs, but never more than 13 of them at the same time.
+    unittest::run_in_thread_pool([]() { run_sort_test(2000, 10, 4, 266, 13); }, 2);
+}
+
+TEST(DiskBackedSorter, Empty) {
+    unittest::run_in_thread_pool([]() { run_sort_test(0, 10, 16, 0, 0); }, 2);
+}
+
+struct string_memory_usage_t {
+    size_t operator()(const std::string &value) const {
+        return value.size();
+    }
+};
+
+TPTEST(DiskBackedSorter, RunsAreSizedByMemoryUsage, 2) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    disk_backed_sorter_t<std::string, std::less<std::string>, string_memory_usage_t>
+        sorter(&io_backender, &dbs_run_path, &get_global_perfmon_collection(), 1000);
+    // Ten values of 100 bytes fit into a run, but a single value that is bigger than
+    // that gets a run of its own.
+    for (int i = 0; i < 100; ++i) {
+        sorter.push(std::string(100, 'a' + i % 26));
+    }
+    sorter.push(std::string(2000, 'z'));
+    sorter.push(std::string(100, 'z'));
+
+    std::string prev;
+    while (!sorter.empty()) {
+        std::string value;
+        sorter.pop(&value);
+        EXPECT_LE(prev, value);
+        prev = std::move(value);
+    }
+    EXPECT_EQ(12u, sorter.num_runs());
+}
+
+}  // namespace unittest
@@ -0,0 +1,111 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <sys/uio.h>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct test_io_cb_t : public iocallback_t, public cond_t {
+    test_io_cb_t() : failed(false) { }
+    void on_io_complete() {
+        pulse();
+    }
+    void on_io_failure(int, int64_t, int64_t) {
+        failed = true;
+        pulse();
+    }
+    bool failed;
+};
+
+// Writes a number of blocks through the disk manager in all the ways the serializer
+// does (plain, wrapped in datasyncs, vectored), resizes the file, and reads it all
+// back.  Both backends must behave identically.
+void run_read_write_test(io_backend_t backend) {
+    const int NUM_BLOCKS = 64;
+    const int64_t BLOCK_SIZE = DEVICE_BLOCK_SIZE * 4;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                                backend);
+    if (io_backender.get_backend_type() != backend) {
+        // Only io_uring can be unavailable, in which case there's nothing to test.
+        ASSERT_EQ(io_backend_t::uring, backend);
+        printf("io_uring is not available, skipping the test\n");
+        return;
+    }
+    temp_file_t temp_file;
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(
+        temp_file.name().permanent_path().c_str(),
+        linux_file_t::mode_read | linux_file_t::mode_write | linux_file_t::mode_create,
+        &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+    file->set_file_size_at_least(NUM_BLOCKS * BLOCK_SIZE);
+
+    file_account_t account(file.get(), 1);
+
+    std::vector<scoped_device_block_aligned_ptr_t<char> > bufs(NUM_BLOCKS);
+    for (int i = 0; i < NUM_BLOCKS; ++i) {
+        bufs[i] = scoped_device_block_aligned_ptr_t<char>(BLOCK_SIZE);
+        memset(bufs[i].get(), 'a' + (i % 26), BLOCK_SIZE);
+    }
+
+    // Issue all writes at once, so that many of them are in flight simultaneously.
+    std::vector<scoped_ptr_t<test_io_cb_t> > write_cbs(NUM_BLOCKS);
+    for (int i = 0; i < NUM_BLOCKS; ++i) {
+        write_cbs[i].init(new test_io_cb_t);
+        if (i % 3 == 2) {
+            scoped_array_t<iovec> iovecs(2);
+            iovecs[0].iov_base = bufs[i].get();
+            iovecs[0].iov_len = BLOCK_SIZE / 2;
+            iovecs[1].iov_base = bufs[i].get() + BLOCK_SIZE / 2;
+            iovecs[1].iov_len = BLOCK_SIZE / 2;
+            file->writev_async(i * BLOCK_SIZE, BLOCK_SIZE, std::move(iovecs),
+                               &account, write_cbs[i].get());
+        } else {
+            file->write_async(i * BLOCK_SIZE, BLOCK_SIZE, bufs[i].get(),
+                              &account, write_cbs[i].get(),
+                              i % 3 == 1
+                                  ? file_t::WRAP_IN_DATASYNCS
+                                  : file_t::NO_DATASYNCS);
+        }
+    }
+    for (int i = 0; i < NUM_BLOCKS; ++i) {
+        write_cbs[i]->wait();
+        EXPECT_FALSE(write_cbs[i]->failed);
+    }
+
+    // Grow the file, which goes through the resize path of the backend.
+    file->set_file_size((NUM_BLOCKS + 1) * BLOCK_SIZE);
+    EXPECT_EQ((NUM_BLOCKS + 1) * BLOCK_SIZE, file->get_file_size());
+
+    std::vector<scoped_ptr_t<test_io_cb_t> > read_cbs(NUM_BLOCKS);
+    std::vector<scoped_device_block_aligned_ptr_t<char> > read_bufs(NUM_BLOCKS);
+    for (int i = 0; i < NUM_BLOCKS; ++i) {
+        read_cbs[i].init(new test_io_cb_t);
+        read_bufs[i] = scoped_device_block_aligned_ptr_t<char>(BLOCK_SIZE);
+        file->read_async(i * BLOCK_SIZE, BLOCK_SIZE, read_bufs[i].get(),
+                         &account, read_cbs[i].get());
+    }
+    for (int i = 0; i < NUM_BLOCKS; ++i) {
+        read_cbs[i]->wait();
+        EXPECT_FALSE(read_cbs[i]->failed);
+        EXPECT_EQ(0, memcmp(bufs[i].get(), read_bufs[i].get(), BLOCK_SIZE));
+    }
+}
+
+TEST(DiskBackendTest, PoolReadWrite) {
+    run_in_thread_pool(std::bind(&run_read_write_test, io_backend_t::pool));
+}
+
+// Skipped if the kernel or the build doesn't support io_uring.
+TEST(DiskBackendTest, UringReadWrite) {
+    run_in_thread_pool(std::bind(&run_read_write_test, io_backend_t::uring));
+}
+
+}  // namespace unittest
@@ -52,10 +52,12 @@ TEST(DiskFormatTest, LbaMetablockMixinT) {
     EXPECT_EQ(METABLOCK_SIZE - 512, LBA_INLINE_SIZE);
     EXPECT_EQ(32u, sizeof(lba_entry_t));
     EXPECT_EQ(32ul * LBA_SHARD_FACTOR + 8ul + LBA_INLINE_SIZE, sizeof(lba_metablock_mixin_t));
+    EXPECT_EQ(3712u, offsetof(lba_metablock_mixin_t, inline_lba_entries_count));
+    EXPECT_EQ(3716u, offsetof(lba_metablock_mixin_t, snapshot_extent_index));
 }
 
 TEST(DiskFormatTest, LbaEntryT) {
-    EXPECT_EQ(0u, offsetof(lba_entry_t, zero_reserved));
+    EXPECT_EQ(0u, offsetof(lba_entry_t, compressed_block_size));
     EXPECT_EQ(4u, offsetof(lba_entry_t, ser_block_size));
     EXPECT_EQ(8u, offsetof(lba_entry_t, block_id));
     EXPECT_EQ(16u, offsetof(lba_entry_t, recency));
@@ -68,11 +70,11 @@ TEST(DiskFormatTest, LbaEntryT) {
     ASSERT_TRUE(lba_entry_t::is_padding(&ent));
     flagged_off64_t real = flagged_off64_t::unused();
     real = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
     flagged_off64_t deleteblock = flagged_off64_t::unused();
     deleteblock = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
 }
 
@@ -97,6 +99,22 @@ TEST(DiskFormatTest, LbaSuperblockT) {
     EXPECT_EQ(16u, offsetof(lba_superblock_t, entries));
 }
 
+TEST(DiskFormatTest, LbaSnapshotHeaderT) {
+    EXPECT_EQ(0u, offsetof(lba_snapshot_extent_t, offset));
+    EXPECT_EQ(8u, offsetof(lba_snapshot_extent_t, entries_count));
+    EXPECT_EQ(12u, offsetof(lba_snapshot_extent_t, crc));
+    EXPECT_EQ(16u, sizeof(lba_snapshot_extent_t));
+
+    EXPECT_EQ(8, LBA_SNAPSHOT_MAGIC_SIZE);
+    EXPECT_EQ(0u, offsetof(lba_snapshot_header_t, magic));
+    EXPECT_EQ(8u, offsetof(lba_snapshot_header_t, crc));
+    EXPECT_EQ(12u, offsetof(lba_snapshot_header_t, extents_count));
+    EXPECT_EQ(16u, offsetof(lba_snapshot_header_t, shard_extents_count));
+    EXPECT_EQ(32u, offsetof(lba_snapshot_header_t, lba_state));
+    EXPECT_EQ(3752u, offsetof(lba_snapshot_header_t, extents));
+    EXPECT_EQ(3752u + 3 * 16, lba_snapshot_header_t::size(3));
+}
+
 TEST(DiskFormatTest, DataBlockManagerMetablockMixinT) {
     EXPECT_EQ(0u, offsetof(data_block_manager::metablock_mixin_t, active_extent));
     EXPECT_EQ(8u, sizeof(data_block_manager::metablock_mixin_t));
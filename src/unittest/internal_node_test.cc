@@ -6,6 +6,7 @@
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 namespace unittest {
 
@@ -61,6 +62,28 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+TEST(InternalNodeTest, SpareCapacity) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+    store_key_t first_key(std::string(MAX_KEY_SIZE, 'a'));
+    ASSERT_TRUE(internal_node::insert(node.get(), first_key.btree_key(), 1, 2));
+
+    // Fill the node with maximum size keys, checking that `spare_capacity()` counts
+    // down to `is_full()`.
+    int spare = internal_node::spare_capacity(node.get());
+    ASSERT_LT(0, spare);
+    for (int i = 0; i < spare; ++i) {
+        ASSERT_FALSE(internal_node::is_full(node.get()));
+        ASSERT_EQ(spare - i, internal_node::spare_capacity(node.get()));
+        store_key_t key(std::string(MAX_KEY_SIZE, 'b' + i));
+        ASSERT_TRUE(internal_node::insert(node.get(), key.btree_key(), i + 2, i + 3));
+        verify(bs, node.get());
+    }
+    ASSERT_TRUE(internal_node::is_full(node.get()));
+    ASSERT_EQ(0, internal_node::spare_capacity(node.get()));
+}
+
 
 }  // namespace unittest
 
@@ -0,0 +1,147 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "buffer_cache/alt.hpp"
+#include "buffer_cache/blob.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "buffer_cache/serialize_onto_blob.hpp"
+#include "config/args.hpp"
+#include "containers/buffer_group.hpp"
+#include "rdb_protocol/key_dictionary.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/serialize_datum_onto_blob.hpp"
+#include "serializer/log/log_serializer.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static ql::datum_t make_document(int i) {
+    ql::datum_object_builder_t address;
+    UNUSED bool b = address.add("street", ql::datum_t("Main Street"));
+    b = address.add("city", ql::datum_t("Springfield"));
+
+    ql::datum_object_builder_t doc;
+    b = doc.add("id", ql::datum_t(static_cast<double>(i)));
+    b = doc.add("name", ql::datum_t("x"));
+    b = doc.add("address", std::move(address).to_datum());
+    b = doc.add("created_at", ql::pseudo::make_time(1234567890.0 + i, "+00:00"));
+    std::vector<ql::datum_t> tags;
+    for (int j = 0; j < 3; ++j) {
+        ql::datum_object_builder_t tag;
+        b = tag.add("label", ql::datum_t(static_cast<double>(j)));
+        tags.push_back(std::move(tag).to_datum());
+    }
+    b = doc.add("tags", ql::datum_t(std::move(tags), ql::configured_limits_t()));
+    return std::move(doc).to_datum();
+}
+
+/* Stores documents in blobs, the way the btree does. */
+class document_store_t {
+public:
+    document_store_t() {
+        log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+        serializer.init(new log_serializer_t(log_serializer_t::dynamic_config_t(),
+                                             &file_opener,
+                                             &get_global_perfmon_collection()));
+        balancer.init(new dummy_cache_balancer_t(GIGABYTE));
+        cache.init(new cache_t(serializer.get(), balancer.get(),
+                               &get_global_perfmon_collection()));
+        cache_conn.init(new cache_conn_t(cache.get()));
+        txn.init(new txn_t(cache_conn.get(), write_durability_t::SOFT, 0));
+    }
+
+    // Returns the bytes that `datum_serialize_onto_blob()` stores for `doc`.
+    std::vector<char> store(const key_encoder_t &encoder, const ql::datum_t &doc) {
+        std::vector<char> ref(blob::btree_maxreflen, 0);
+        blob_t blob(cache->max_block_size(), ref.data(), blob::btree_maxreflen);
+        ql::serialization_result_t res =
+            datum_serialize_onto_blob(buf_parent_t(txn.get()), &blob, doc, encoder);
+        EXPECT_FALSE(ql::bad(res));
+        std::vector<char> stored;
+        {
+            buffer_group_t group;
+            blob_acq_t acq;
+            blob.expose_all(buf_parent_t(txn.get()), access_t::read, &group, &acq);
+            for (size_t i = 0; i < group.num_buffers(); ++i) {
+                const char *data = static_cast<const char *>(group.get_buffer(i).data);
+                stored.insert(stored.end(), data, data + group.get_buffer(i).size);
+            }
+        }
+        blob.clear(buf_parent_t(txn.get()));
+        return stored;
+    }
+
+private:
+    mock_file_opener_t file_opener;
+    scoped_ptr_t<log_serializer_t> serializer;
+    scoped_ptr_t<dummy_cache_balancer_t> balancer;
+    scoped_ptr_t<cache_t> cache;
+    scoped_ptr_t<cache_conn_t> cache_conn;
+    scoped_ptr_t<txn_t> txn;
+};
+
+static ql::datum_t load_document(const key_dictionary_t *dictionary,
+                                 const std::vector<char> &stored) {
+    const_buffer_group_t group;
+    group.add_buffer(stored.size(), stored.data());
+    return deserialize_stored_datum(&group, dictionary);
+}
+
+TPTEST(KeyDictionaryTest, HotKeys) {
+    document_store_t documents;
+    key_dictionary_t dictionary;
+
+    // The dictionary starts out empty, so nothing gets encoded.
+    std::vector<char> plain = documents.store(key_encoder_t(&dictionary),
+                                              make_document(0));
+    ASSERT_NE(KEY_DICTIONARY_ENCODED_TAG, static_cast<uint8_t>(plain[0]));
+    ASSERT_EQ(make_document(0), load_document(&dictionary, plain));
+    ASSERT_FALSE(dictionary.has_hot_keys());
+
+    for (int i = 1; i < KEY_DICTIONARY_PROMOTION_THRESHOLD; ++i) {
+        documents.store(key_encoder_t(&dictionary), make_document(i));
+    }
+    ASSERT_TRUE(dictionary.has_hot_keys());
+
+    // A write that started before the promotion can't refer to the new ids.
+    key_encoder_t old_encoder(&dictionary);
+    ASSERT_TRUE(dictionary.promote_hot_keys());
+    ASSERT_FALSE(dictionary.promote_hot_keys());
+    // "id" is too short to be worth an id, and the fields of times are left alone.
+    ASSERT_EQ(7u, dictionary.size());
+    std::vector<char> old_stored = documents.store(old_encoder, make_document(1));
+    ASSERT_EQ(plain.size(), old_stored.size());
+
+    std::vector<char> stored = documents.store(key_encoder_t(&dictionary),
+                                               make_document(1));
+    ASSERT_EQ(KEY_DICTIONARY_ENCODED_TAG, static_cast<uint8_t>(stored[0]));
+    ASSERT_LT(stored.size(), plain.size());
+    ql::datum_t loaded = load_document(&dictionary, stored);
+    ASSERT_EQ(make_document(1), loaded);
+    ASSERT_EQ(ql::datum_t("Springfield"),
+              loaded.get_field("address").get_field("city"));
+    // The decoded document is still backed by a buffer, so looking up a field
+    // doesn't deserialize the other ones.
+    ASSERT_TRUE(loaded.get_buf_ref() != nullptr);
+    ASSERT_TRUE(loaded.get_field("address").get_buf_ref() != nullptr);
+
+    // Documents that were stored without ids can still be read.
+    ASSERT_EQ(make_document(0), load_document(&dictionary, plain));
+}
+
+TPTEST(KeyDictionaryTest, EscapedKeys) {
+    document_store_t documents;
+    key_dictionary_t dictionary;
+    const std::string reserved_key("\xFF\x00\x01", 3);
+
+    ql::datum_object_builder_t builder;
+    UNUSED bool b = builder.add(datum_string_t(reserved_key), ql::datum_t(1.0));
+    b = builder.add("regular", ql::datum_t(2.0));
+    ql::datum_t doc = std::move(builder).to_datum();
+
+    std::vector<char> stored = documents.store(key_encoder_t(&dictionary), doc);
+    ASSERT_EQ(KEY_DICTIONARY_ENCODED_TAG, static_cast<uint8_t>(stored[0]));
+    ASSERT_EQ(doc, load_document(&dictionary, stored));
+}
+
+}  // namespace unittest
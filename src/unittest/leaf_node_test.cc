@@ -264,7 +264,6 @@ TEST(LeafNodeTest, Offsets) {
     ASSERT_EQ(6u, offsetof(leaf_node_t, live_size));
     ASSERT_EQ(8u, offsetof(leaf_node_t, frontmost));
     ASSERT_EQ(10u, offsetof(leaf_node_t, tstamp_cutpoint));
-    ASSERT_EQ(12u, offsetof(leaf_node_t, pair_offsets));
     ASSERT_EQ(12u, sizeof(leaf_node_t));
 }
 
@@ -402,11 +401,12 @@ void make_node_underfull(LeafNodeTracker *tracker, rng_t *rng) {
     while (!tracker->IsUnderfull() ||
            (node->num_pairs > 0 && rng->randint(2) == 0)) {
         int chosen = rng->randint(node->num_pairs);
-        auto pair = *leaf_node_t::iterator(node, chosen);
+        leaf_node_t::iterator it(node, chosen);
+        store_key_t key((*it).first);
 
         // We might hit a removal entry; skip those.
-        if (tracker->ShouldHave(store_key_t(pair.first))) {
-            tracker->Remove(store_key_t(pair.first));
+        if (tracker->ShouldHave(key)) {
+            tracker->Remove(key);
         }
     }
 }
@@ -692,8 +692,7 @@ TEST(LeafNodeTest, LevelingRightToZero) {
 
 TEST(LeafNodeTest, Splitting) {
     LeafNodeTracker left;
-    for (int i = 0; i < 4272 / 12; ++i) {
-        left.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i));
+    for (int i = 0; left.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)); ++i) {
     }
 
     LeafNodeTracker right;
@@ -704,11 +703,65 @@ TEST(LeafNodeTest, Splitting) {
 TEST(LeafNodeTest, Fullness) {
     LeafNodeTracker node;
     int i;
-    for (i = 0; i < 4272 / 12; ++i) {
+    for (i = 0; !node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)); ++i) {
         node.Insert(store_key_t(strprintf("a%d", i)), strprintf("A%d", i));
     }
 
-    ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
+    // Without the key prefix, the node would be full after 4272 / 12 entries.
+    ASSERT_GE(i, 4272 / 12);
+}
+
+std::string prefixed_key(int i) {
+    return strprintf("user/profile/%06d", i);
+}
+
+TEST(LeafNodeTest, KeyPrefix) {
+    LeafNodeTracker left;
+    int count = 0;
+    while (left.Insert(store_key_t(prefixed_key(count)), "v")) {
+        ++count;
+    }
+    ASSERT_TRUE(leaf::is_prefixed(left.node()));
+    // The common prefix of all of the node's keys.
+    ASSERT_EQ(0u, key_to_unescaped_str(leaf::key_prefix(left.node())).find("user/profile/0"));
+    // Entries of 24 bytes apart from the key prefix (19 bytes of key, 2 of value, 2
+    // of pair offset and 1 of timestamp on average) wouldn't come close.
+    ASSERT_GT(count, 4072 / 24);
+
+    LeafNodeTracker right;
+    left.Split(&right);
+    ASSERT_TRUE(leaf::is_prefixed(right.node()));
+
+    // Keys without the prefix get escaped, rather than shortening the prefix.
+    std::string prefix = key_to_unescaped_str(leaf::key_prefix(left.node()));
+    ASSERT_TRUE(left.Insert(store_key_t("user/"), "escaped"));
+    ASSERT_EQ(prefix, key_to_unescaped_str(leaf::key_prefix(left.node())));
+
+    // Make both nodes underfull, and merge them again.
+    for (int i = 0; i < count; ++i) {
+        store_key_t key(prefixed_key(i));
+        LeafNodeTracker *tracker = left.ShouldHave(key) ? &left : &right;
+        if (i % 4 != 0) {
+            tracker->Remove(key);
+        }
+    }
+    ASSERT_TRUE(left.IsUnderfull());
+    ASSERT_TRUE(right.IsUnderfull());
+    ASSERT_TRUE(leaf::is_mergable(left.sizer(), left.node(), right.node()));
+    right.Merge(&left);
+    ASSERT_TRUE(right.ShouldHave(store_key_t("user/")));
+}
+
+TEST(LeafNodeTest, KeyPrefixLeveling) {
+    LeafNodeTracker left;
+    LeafNodeTracker right;
+    for (int i = 0; left.Insert(store_key_t(prefixed_key(i)), "v"); ++i) {
+    }
+    right.Insert(store_key_t("zzz"), "z");
+
+    bool could_level;
+    right.Level(1, &left, &could_level);
+    ASSERT_TRUE(could_level);
 }
 
 }  // namespace unittest
@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(NumaTest, ParseCpuList) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(parse_cpu_list("0-3,8,10-11\n", &cpus));
+    ASSERT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), cpus);
+
+    ASSERT_TRUE(parse_cpu_list("\n", &cpus));
+    ASSERT_TRUE(cpus.empty());
+
+    ASSERT_FALSE(parse_cpu_list("0-", &cpus));
+    ASSERT_FALSE(parse_cpu_list("3-1", &cpus));
+    ASSERT_FALSE(parse_cpu_list("0,,1", &cpus));
+    ASSERT_FALSE(parse_cpu_list("a", &cpus));
+}
+
+std::vector<numa_node_t> make_nodes(std::vector<size_t> cpu_counts,
+                                    std::vector<uint64_t> memory) {
+    std::vector<numa_node_t> nodes;
+    int next_cpu = 0;
+    for (size_t i = 0; i < cpu_counts.size(); ++i) {
+        numa_node_t node;
+        for (size_t j = 0; j < cpu_counts[i]; ++j) {
+            node.cpus.push_back(next_cpu++);
+        }
+        node.memory_bytes = memory[i];
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+TEST(NumaTest, AssignNode) {
+    // Threads are spread over the nodes in proportion to their CPUs.
+    std::vector<numa_node_t> nodes = make_nodes({4, 12}, {0, 0});
+    std::vector<size_t> counts(nodes.size(), 0);
+    for (int i = 0; i < 32; ++i) {
+        size_t node = assign_numa_node(i, 32, nodes);
+        ASSERT_LT(node, nodes.size());
+        // Every node gets a contiguous range of threads.
+        if (i > 0) {
+            ASSERT_LE(assign_numa_node(i - 1, 32, nodes), node);
+        }
+        ++counts[node];
+    }
+    ASSERT_EQ(8u, counts[0]);
+    ASSERT_EQ(24u, counts[1]);
+
+    // With fewer threads than nodes, no node gets more than one thread.
+    nodes = make_nodes({2, 2, 2, 2}, {0, 0, 0, 0});
+    ASSERT_EQ(0u, assign_numa_node(0, 2, nodes));
+    ASSERT_EQ(2u, assign_numa_node(1, 2, nodes));
+}
+
+TEST(NumaTest, SplitCacheSize) {
+    std::vector<numa_node_t> nodes = make_nodes({1, 1, 1}, {GIGABYTE, 3 * GIGABYTE, 0});
+
+    // The node without evicters gets nothing, the others are weighted by memory.
+    std::vector<uint64_t> sizes
+        = split_cache_size_between_nodes(1001, nodes, {1, 5, 0});
+    ASSERT_EQ(3u, sizes.size());
+    ASSERT_EQ(250u, sizes[0]);
+    ASSERT_EQ(751u, sizes[1]);
+    ASSERT_EQ(0u, sizes[2]);
+
+    // Unknown memory sizes give every node an equal share.
+    sizes = split_cache_size_between_nodes(900, nodes, {1, 1, 1});
+    ASSERT_EQ(std::vector<uint64_t>({300, 300, 300}), sizes);
+
+    sizes = split_cache_size_between_nodes(900, nodes, {0, 0, 0});
+    ASSERT_EQ(std::vector<uint64_t>({0, 0, 0}), sizes);
+}
+
+}  // namespace unittest
@@ -52,8 +52,10 @@ class test_cache_t : public page_cache_t {
 public:
     test_cache_t(serializer_t *_serializer,
                  cache_balancer_t *balancer,
-                 alt_txn_throttler_t *throttler)
-        : page_cache_t(_serializer, balancer, throttler),
+                 alt_txn_throttler_t *throttler,
+                 alt::page_repl_policy_t page_repl_policy
+                     = alt::page_repl_policy_t::two_queue)
+        : page_cache_t(_serializer, balancer, throttler, page_repl_policy),
           throttler_(throttler) { }
 
     void flush(scoped_ptr_t<test_txn_t> txn) {
@@ -106,8 +108,10 @@ public:
 class test_acq_t : public page_acq_t {
 public:
     test_acq_t() : page_acq_t() { }
-    void init(page_t *page, page_cache_t *_page_cache) {
-        page_acq_t::init(page, _page_cache, _page_cache->default_reads_account());
+    void init(page_t *page, page_cache_t *_page_cache,
+              page_access_pattern_t access_pattern = page_access_pattern_t::normal) {
+        page_acq_t::init(page, _page_cache, _page_cache->default_reads_account(),
+                         access_pattern);
     }
 
     void *get_buf_write() {
@@ -1181,4 +1185,115 @@ TPTEST(PageTest, BiggerTestNoMemory, 4) {
     test.run();
 }
 
+void read_blocks(test_cache_t *cache, const std::vector<block_id_t> &block_ids,
+                 page_access_pattern_t access_pattern) {
+    auto txn = make_scoped<test_txn_t>(cache);
+    for (block_id_t block_id : block_ids) {
+        current_test_acq_t acq(txn.get(), block_id, access_t::read);
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_read(), cache, access_pattern);
+        ASSERT_TRUE(page_acq.get_buf_read() != nullptr);
+    }
+    cache->flush(std::move(txn));
+}
+
+TPTEST(PageTest, ScanDoesNotEvictHotPages, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> hot_ids;
+    std::vector<block_id_t> scan_ids;
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (size_t i = 0; i < 200; ++i) {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &cache);
+            memset(page_acq.get_buf_write(), 0, cache.max_block_size().value());
+            (i < 5 ? hot_ids : scan_ids).push_back(acq.block_id());
+        }
+        cache.flush(std::move(txn));
+    }
+
+    // Room for a few dozen blocks.
+    const uint64_t memory_limit = 50 * DEFAULT_BTREE_BLOCK_SIZE;
+    dummy_cache_balancer_t balancer(memory_limit);
+    test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get(),
+                       alt::page_repl_policy_t::two_queue);
+
+    // Access the hot blocks twice, so that they get out of probation.
+    read_blocks(&cache, hot_ids, page_access_pattern_t::normal);
+    read_blocks(&cache, hot_ids, page_access_pattern_t::normal);
+
+    // A scan over many more blocks than fit into the cache.
+    read_blocks(&cache, scan_ids, page_access_pattern_t::scan);
+
+    ASSERT_LE(cache.evicter().in_memory_size(), memory_limit);
+    auto txn = make_scoped<test_txn_t>(&cache);
+    for (block_id_t block_id : hot_ids) {
+        current_test_acq_t acq(txn.get(), block_id, access_t::read);
+        page_t *page = acq.current_page_for_read();
+        EXPECT_TRUE(page->is_loaded());
+        EXPECT_TRUE(page->is_hot());
+    }
+    cache.flush(std::move(txn));
+}
+
+TPTEST(PageTest, HotPagesCoolDown, 4) {
+    mock_ser_t mock;
+    std::vector<block_id_t> old_ids;
+    std::vector<block_id_t> new_ids;
+    {
+        dummy_cache_balancer_t balancer(GIGABYTE);
+        test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get());
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (size_t i = 0; i < 105; ++i) {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &cache);
+            memset(page_acq.get_buf_write(), 0, cache.max_block_size().value());
+            (i < 5 ? old_ids : new_ids).push_back(acq.block_id());
+        }
+        cache.flush(std::move(txn));
+    }
+
+    const uint64_t memory_limit = 50 * DEFAULT_BTREE_BLOCK_SIZE;
+    dummy_cache_balancer_t balancer(memory_limit);
+    test_cache_t cache(mock.ser.get(), &balancer, mock.throttler.get(),
+                       alt::page_repl_policy_t::two_queue);
+
+    read_blocks(&cache, old_ids, page_access_pattern_t::normal);
+    read_blocks(&cache, old_ids, page_access_pattern_t::normal);
+
+    // The working set moves on to more hot pages than fit into the cache.
+    for (block_id_t block_id : new_ids) {
+        read_blocks(&cache, { block_id }, page_access_pattern_t::normal);
+        read_blocks(&cache, { block_id }, page_access_pattern_t::normal);
+    }
+    ASSERT_LE(cache.evicter().in_memory_size(), memory_limit);
+
+    // The old pages have been demoted, and the evicted ones don't become hot when
+    // they're read once more.
+    std::vector<block_id_t> evicted_ids;
+    {
+        auto txn = make_scoped<test_txn_t>(&cache);
+        for (block_id_t block_id : old_ids) {
+            current_test_acq_t acq(txn.get(), block_id, access_t::read);
+            EXPECT_FALSE(acq.current_page_for_read()->is_hot());
+            if (!acq.current_page_for_read()->is_loaded()) {
+                evicted_ids.push_back(block_id);
+            }
+        }
+        cache.flush(std::move(txn));
+    }
+    EXPECT_FALSE(evicted_ids.empty());
+    read_blocks(&cache, evicted_ids, page_access_pattern_t::normal);
+    auto txn = make_scoped<test_txn_t>(&cache);
+    for (block_id_t block_id : evicted_ids) {
+        current_test_acq_t acq(txn.get(), block_id, access_t::read);
+        EXPECT_FALSE(acq.current_page_for_read()->is_hot());
+    }
+    cache.flush(std::move(txn));
+}
+
 }  // namespace unittest
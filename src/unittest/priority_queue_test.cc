@@ -0,0 +1,42 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/priority_queue.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(PriorityQueueTest, PushPop) {
+    priority_queue_t<int> pq;
+    for (int i : { 5, 1, 9, 3, 7 }) {
+        pq.push(i);
+    }
+    pq.validate();
+    for (int expected : { 9, 7, 5, 3, 1 }) {
+        ASSERT_FALSE(pq.empty());
+        ASSERT_EQ(expected, pq.pop());
+    }
+    ASSERT_TRUE(pq.empty());
+}
+
+TEST(PriorityQueueTest, UpdateAll) {
+    priority_queue_t<int> pq;
+    for (int i = 0; i < 100; ++i) {
+        pq.push(i);
+    }
+
+    // Reverse the order of all elements at once.
+    pq.update_all([](int &x) { x = 99 - x; });
+    pq.validate();
+    ASSERT_EQ(100u, pq.size());
+
+    // Now every element's priority depends on its value modulo 10.
+    pq.update_all([](int &x) { x = (x % 10) * 100 + x; });
+    pq.validate();
+    int last = pq.pop();
+    while (!pq.empty()) {
+        const int next = pq.pop();
+        ASSERT_LT(next, last);
+        last = next;
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,98 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rapidjson/document.h"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/query_plan_cache.hpp"
+#include "rdb_protocol/term_storage.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static scoped_ptr_t<ql::term_storage_t> make_query(const std::string &json) {
+    scoped_array_t<char> data(json.size() + 1);
+    memcpy(data.data(), json.c_str(), json.size() + 1);
+    rapidjson::Document doc;
+    doc.ParseInsitu(data.data());
+    guarantee(!doc.HasParseError());
+    scoped_ptr_t<ql::term_storage_t> res(
+        new ql::json_term_storage_t(std::move(data), std::move(doc)));
+    res->preprocess();
+    return res;
+}
+
+static ql::datum_t eval_plan(const counted_t<const ql::query_plan_t> &plan,
+                             const std::vector<ql::datum_t> &params) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::NO,
+                  reql_version_t::LATEST);
+    env.set_plan_params(&params);
+    ql::scope_env_t scope_env(&env, ql::var_scope_t());
+    return plan->term_tree->eval(&scope_env)->as_datum();
+}
+
+TPTEST(QueryPlanCacheTest, BindsLiterals) {
+    ql::query_plan_cache_t cache(nullptr);
+    std::vector<ql::datum_t> params;
+
+    // r.expr(5).add(7)
+    scoped_ptr_t<ql::term_storage_t> q1 = make_query("[1,[24,[5,7]]]");
+    counted_t<const ql::query_plan_t> p1 = cache.compile(&q1, &params);
+    ASSERT_FALSE(q1.has());
+    ASSERT_EQ(2u, params.size());
+    ASSERT_EQ(ql::datum_t(12.0), eval_plan(p1, params));
+
+    // r.expr(1).add(2) has the same shape.
+    scoped_ptr_t<ql::term_storage_t> q2 = make_query("[1,[24,[1,2]]]");
+    counted_t<const ql::query_plan_t> p2 = cache.compile(&q2, &params);
+    ASSERT_TRUE(q2.has());
+    ASSERT_EQ(p1.get(), p2.get());
+    ASSERT_EQ(ql::datum_t(3.0), eval_plan(p2, params));
+
+    // The types of the literals are part of the shape.
+    scoped_ptr_t<ql::term_storage_t> q3 = make_query("[1,[24,[\"a\",\"b\"]]]");
+    counted_t<const ql::query_plan_t> p3 = cache.compile(&q3, &params);
+    ASSERT_NE(p1.get(), p3.get());
+    ASSERT_EQ(ql::datum_t("ab"), eval_plan(p3, params));
+}
+
+TPTEST(QueryPlanCacheTest, UnbindableLiterals) {
+    ql::query_plan_cache_t cache(nullptr);
+    std::vector<ql::datum_t> params;
+
+    // r.expr({a: 1, b: 2})('a'): the object's fields are bound, but the field name
+    // isn't.
+    scoped_ptr_t<ql::term_storage_t> q1 = make_query("[1,[170,[{\"a\":1,\"b\":2},\"a\"]]]");
+    counted_t<const ql::query_plan_t> p1 = cache.compile(&q1, &params);
+    ASSERT_EQ(2u, params.size());
+    ASSERT_EQ(ql::datum_t(1.0), eval_plan(p1, params));
+
+    scoped_ptr_t<ql::term_storage_t> q2 = make_query("[1,[170,[{\"a\":3,\"b\":4},\"a\"]]]");
+    counted_t<const ql::query_plan_t> p2 = cache.compile(&q2, &params);
+    ASSERT_EQ(p1.get(), p2.get());
+    ASSERT_EQ(ql::datum_t(3.0), eval_plan(p2, params));
+
+    scoped_ptr_t<ql::term_storage_t> q3 = make_query("[1,[170,[{\"a\":3,\"b\":4},\"b\"]]]");
+    counted_t<const ql::query_plan_t> p3 = cache.compile(&q3, &params);
+    ASSERT_NE(p1.get(), p3.get());
+    ASSERT_EQ(ql::datum_t(4.0), eval_plan(p3, params));
+}
+
+TPTEST(QueryPlanCacheTest, LargeQueriesAreNotCached) {
+    ql::query_plan_cache_t cache(nullptr);
+    std::vector<ql::datum_t> params;
+
+    // r.expr(<long string>).add("b") has few terms but takes up a lot of memory.
+    const std::string query = "[1,[24,[\"" + std::string(64 * KILOBYTE, 'a')
+        + "\",\"b\"]]]";
+    scoped_ptr_t<ql::term_storage_t> q1 = make_query(query);
+    counted_t<const ql::query_plan_t> p1 = cache.compile(&q1, &params);
+    ASSERT_TRUE(params.empty());
+
+    scoped_ptr_t<ql::term_storage_t> q2 = make_query(query);
+    counted_t<const ql::query_plan_t> p2 = cache.compile(&q2, &params);
+    ASSERT_FALSE(q2.has());
+    ASSERT_NE(p1.get(), p2.get());
+}
+
+}  // namespace unittest
@@ -4,20 +4,25 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "concurrency/queue/disk_backed_queue_wrapper.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/uuid.hpp"
 #include "rapidjson/document.h"
 #include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/distribution_progress.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/erase_range.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/store.hpp"
 #include "rdb_protocol/sym.hpp"
+#include "random.hpp"
 #include "stl_utils.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "unittest/gtest.hpp"
@@ -439,4 +444,351 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     store.reset();
 }
 
+// Replaces the key at each index with the row at that index, or deletes it if the row
+// is null.
+class test_batched_replacer_t : public btree_batched_replacer_t {
+public:
+    explicit test_batched_replacer_t(const std::vector<ql::datum_t> *_rows)
+        : rows(_rows) { }
+    ql::datum_t replace(const ql::datum_t &, size_t index) const {
+        return (*rows)[index];
+    }
+    return_changes_t should_return_changes() const { return return_changes_t::NO; }
+private:
+    const std::vector<ql::datum_t> *const rows;
+};
+
+store_key_t batched_replace_key(int id) {
+    return store_key_t(ql::datum_t(static_cast<double>(id)).print_primary());
+}
+
+// The rows are big enough that a leaf node only holds a dozen or so of them.
+ql::datum_t batched_replace_row(int id, int version) {
+    ql::datum_object_builder_t row;
+    UNUSED bool res = row.add("id", ql::datum_t(static_cast<double>(id)));
+    res = row.add("version", ql::datum_t(static_cast<double>(version)));
+    res = row.add("payload", ql::datum_t(datum_string_t(std::string(200, 'x'))));
+    return std::move(row).to_datum();
+}
+
+int btree_depth(store_t *store) {
+    cond_t non_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(
+        &token, &txn, &superblock, &non_interruptor, false);
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return 0;
+    }
+    buf_lock_t buf(superblock->expose_buf(), root_id, access_t::read);
+    superblock->release();
+    int depth = 1;
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (!node::is_internal(node)) {
+                return depth;
+            }
+            child_id = internal_node::get_pair_by_index(
+                reinterpret_cast<const internal_node_t *>(node), 0)->lnode;
+        }
+        buf_lock_t child(&buf, child_id, access_t::read);
+        buf = std::move(child);
+        ++depth;
+    }
+}
+
+void check_rows(store_t *store, const std::map<store_key_t, ql::datum_t> &rows) {
+    for (const auto &pair : rows) {
+        cond_t non_interruptor;
+        read_token_t token;
+        store->new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store->acquire_superblock_for_read(
+            &token, &txn, &superblock, &non_interruptor, false);
+        point_read_response_t response;
+        rdb_get(pair.first, store->btree.get(), superblock.get(), &response, nullptr);
+        ASSERT_EQ(pair.second.has() ? pair.second : ql::datum_t::null(),
+                  response.data);
+    }
+}
+
+/* Replaces `keys` with `new_rows` in one `rdb_batched_replace`, and checks that the
+modification reports that come out of `reports` are in key order, with repeated keys
+in their original order.  `rows` holds the rows before and gets updated. */
+void batched_replace_and_check_reports(
+        store_t *store,
+        disk_backed_queue_wrapper_t<rdb_modification_report_t> *reports,
+        const std::vector<store_key_t> &keys,
+        const std::vector<ql::datum_t> &new_rows,
+        std::map<store_key_t, ql::datum_t> *rows) {
+    {
+        cond_t non_interruptor;
+        write_token_t token;
+        store->new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store->acquire_superblock_for_write(
+            keys.size(), write_durability_t::SOFT,
+            &token, &txn, &superblock, &non_interruptor);
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::write);
+        auto_drainer_t drainer;
+        rdb_modification_report_cb_t mod_cb(
+            store, &sindex_block, auto_drainer_t::lock_t(&drainer));
+        test_batched_replacer_t replacer(&new_rows);
+        profile::sampler_t sampler("batched replace", nullptr);
+        ql::datum_t stats = rdb_batched_replace(
+            btree_info_t(store->btree.get(), repli_timestamp_t::distant_past,
+                         datum_string_t("id"),
+                         key_encoder_t(store->btree->key_dictionary)),
+            &superblock, keys, &replacer, &mod_cb, ql::configured_limits_t(),
+            &sampler, nullptr);
+        ASSERT_FALSE(stats.get_field("first_error", ql::NOTHROW).has());
+    }
+
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+    ASSERT_EQ(keys.size(), reports->size());
+    for (size_t index : order) {
+        rdb_modification_report_t report = reports->pop();
+        ASSERT_EQ(keys[index], report.primary_key);
+        ql::datum_t *row = &(*rows)[keys[index]];
+        ASSERT_EQ(row->has(), report.info.deleted.first.has());
+        if (row->has()) {
+            EXPECT_EQ(*row, report.info.deleted.first);
+        }
+        const bool deleted = new_rows[index].get_type() == ql::datum_t::R_NULL;
+        ASSERT_EQ(!deleted, report.info.added.first.has());
+        if (!deleted) {
+            EXPECT_EQ(new_rows[index], report.info.added.first);
+        }
+        *row = report.info.added.first;
+    }
+}
+
+/* Batched replaces write runs of keys with one descent each.  Shuffled batches of big
+rows make the runs cross leaf splits and root growth on the way in, and leaf merges on
+the way out. */
+TPTEST(RDBBtree, BatchedReplaceRuns) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    // Outlives the store, which it gets registered with.
+    disk_backed_queue_wrapper_t<rdb_modification_report_t> reports(
+        &io_backender,
+        serializer_filepath_t(base_path_t("."), "batched_replace_reports"),
+        &get_global_perfmon_collection(),
+        GIGABYTE);
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    // The store pushes every modification report onto its sindex queues, in the
+    // order it gets them.
+    auto with_sindex_queue_spot = [&](const std::function<void(
+            const new_mutex_in_line_t *)> &fn) {
+        cond_t non_interruptor;
+        write_token_t token;
+        store.new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_write(
+            1, write_durability_t::SOFT, &token, &txn, &superblock, &non_interruptor);
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::write);
+        new_mutex_in_line_t acq = store.get_in_line_for_sindex_queue(&sindex_block);
+        fn(&acq);
+    };
+    with_sindex_queue_spot([&](const new_mutex_in_line_t *acq) {
+        store.register_sindex_queue(&reports, key_range_t::universe(), acq);
+    });
+
+    const int num_rows = 8000;
+    const int batch_size = 1000;
+    rng_t rng(0);
+    std::map<store_key_t, ql::datum_t> rows;
+
+    std::vector<int> ids(num_rows);
+    for (int i = 0; i < num_rows; ++i) {
+        ids[i] = i;
+    }
+    for (int i = num_rows - 1; i > 0; --i) {
+        std::swap(ids[i], ids[rng.randint(i + 1)]);
+    }
+
+    // Inserts every row, and updates some of them again in the same batch.
+    EXPECT_EQ(0, btree_depth(&store));
+    for (int begin = 0; begin < num_rows; begin += batch_size) {
+        std::vector<store_key_t> keys;
+        std::vector<ql::datum_t> new_rows;
+        for (int i = begin; i < begin + batch_size; ++i) {
+            keys.push_back(batched_replace_key(ids[i]));
+            new_rows.push_back(batched_replace_row(ids[i], 0));
+        }
+        for (int i = 0; i < 20; ++i) {
+            const int id = ids[begin + rng.randint(batch_size)];
+            keys.push_back(batched_replace_key(id));
+            new_rows.push_back(batched_replace_row(id, i + 1));
+        }
+        batched_replace_and_check_reports(&store, &reports, keys, new_rows, &rows);
+        if (begin == 0) {
+            EXPECT_LE(2, btree_depth(&store));
+        }
+    }
+    EXPECT_LE(3, btree_depth(&store));
+    check_rows(&store, rows);
+
+    // Deletes nine out of ten rows, and updates the others.
+    for (int begin = 0; begin < num_rows; begin += batch_size) {
+        std::vector<store_key_t> keys;
+        std::vector<ql::datum_t> new_rows;
+        for (int i = begin; i < begin + batch_size; ++i) {
+            keys.push_back(batched_replace_key(ids[i]));
+            new_rows.push_back(ids[i] % 10 == 0
+                               ? batched_replace_row(ids[i], 100)
+                               : ql::datum_t::null());
+        }
+        batched_replace_and_check_reports(&store, &reports, keys, new_rows, &rows);
+    }
+    check_rows(&store, rows);
+
+    with_sindex_queue_spot([&](const new_mutex_in_line_t *acq) {
+        store.deregister_sindex_queue(&reports, acq);
+    });
+}
+
+/* Runs `fn` with an estimator for a store that holds `TOTAL_KEYS_TO_INSERT` rows, so
+that its distribution has a bucket per leaf node. */
+void run_split_range_test(
+        const std::function<void(const distribution_progress_estimator_t &)> &fn) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    log_serializer_t::create(
+        &file_opener,
+        log_serializer_t::static_config_t());
+
+    log_serializer_t serializer(
+        log_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            region_t::universe(),
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            nullptr,
+            &io_backender,
+            base_path_t("."),
+            generate_uuid(),
+            update_sindexes_t::UPDATE);
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    cond_t dummy_interruptor;
+    distribution_progress_estimator_t estimator(&store, &dummy_interruptor);
+    fn(estimator);
+}
+
+// Checks that `parts` are at most `max_parts` consecutive, non-empty ranges that
+// make up `range`.
+void check_split_range(const key_range_t &range,
+                       const std::vector<key_range_t> &parts,
+                       size_t max_parts) {
+    ASSERT_FALSE(parts.empty());
+    EXPECT_GE(max_parts, parts.size());
+    EXPECT_EQ(range.left, parts.front().left);
+    EXPECT_EQ(range.right, parts.back().right);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        EXPECT_FALSE(parts[i].is_empty());
+        if (i + 1 < parts.size()) {
+            EXPECT_EQ(key_range_t::right_bound_t(parts[i + 1].left), parts[i].right);
+        }
+    }
+}
+
+TPTEST(RDBBtree, SplitRangeEmpty) {
+    run_split_range_test([](const distribution_progress_estimator_t &estimator) {
+        std::vector<key_range_t> parts =
+            estimator.split_range(key_range_t::empty(), 4);
+        ASSERT_EQ(1u, parts.size());
+        EXPECT_EQ(key_range_t::empty(), parts[0]);
+    });
+}
+
+TPTEST(RDBBtree, SplitRangeUnbounded) {
+    run_split_range_test([](const distribution_progress_estimator_t &estimator) {
+        const key_range_t range = key_range_t::universe();
+        std::vector<key_range_t> parts = estimator.split_range(range, 4);
+        check_split_range(range, parts, 4);
+        EXPECT_EQ(4u, parts.size());
+        EXPECT_TRUE(parts.back().right.unbounded);
+
+        // Asking for one part doesn't split at all.
+        parts = estimator.split_range(range, 1);
+        ASSERT_EQ(1u, parts.size());
+        EXPECT_EQ(range, parts[0]);
+    });
+}
+
+TPTEST(RDBBtree, SplitRangeSingleKey) {
+    run_split_range_test([](const distribution_progress_estimator_t &estimator) {
+        // The first key of a bucket, which is where a split would go.
+        std::vector<key_range_t> parts =
+            estimator.split_range(key_range_t::universe(), 2);
+        ASSERT_EQ(2u, parts.size());
+        const store_key_t bucket_key = parts[1].left;
+
+        for (const store_key_t &key : {bucket_key, store_key_t("a")}) {
+            const key_range_t range = key_range_t::one_key(key);
+            parts = estimator.split_range(range, 4);
+            ASSERT_EQ(1u, parts.size());
+            EXPECT_EQ(range, parts[0]);
+        }
+    });
+}
+
 } //namespace unittest
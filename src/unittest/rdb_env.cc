@@ -94,6 +94,11 @@ void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
     throw cannot_perform_query_exc_t("unimplemented", query_state_t::FAILED);
 }
 
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
+        const changefeed_aggregate_subscribe_t &) {
+    throw cannot_perform_query_exc_t("unimplemented", query_state_t::FAILED);
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
         const changefeed_stamp_t &) {
     throw cannot_perform_query_exc_t("unimplemented", query_state_t::FAILED);
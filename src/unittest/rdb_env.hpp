@@ -78,6 +78,7 @@ private:
         void operator()(const dummy_read_t &d);
         void NORETURN operator()(const changefeed_subscribe_t &);
         void NORETURN operator()(const changefeed_limit_subscribe_t &);
+        void NORETURN operator()(const changefeed_aggregate_subscribe_t &);
         void NORETURN operator()(const changefeed_stamp_t &);
         void NORETURN operator()(const changefeed_point_stamp_t &);
         void NORETURN operator()(UNUSED const rget_read_t &rget);
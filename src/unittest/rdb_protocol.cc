@@ -964,7 +964,8 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
             index_vals_t(),
             store_key_t(ql::datum_t(static_cast<double>(i)).print_primary()),
             ql::datum_t(-static_cast<double>(i)),
-            ql::datum_t(static_cast<double>(i))}));
+            ql::datum_t(static_cast<double>(i)),
+            boost::none}));
     }
     for (const auto &pair : bundles) {
         ql::batchspec_t bs(ql::batchspec_t::all()
@@ -1,8 +1,11 @@
 #include <functional>
 
 #include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "serializer/buf_ptr.hpp"
+#include "serializer/log/block_codec.hpp"
+#include "serializer/log/data_block_manager.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
@@ -21,10 +24,12 @@ TPTEST(SerializerTest, CreateConstructDestroy, 4) {
                               &get_global_perfmon_collection());
 }
 
-void run_AddDeleteRepeatedly(bool perform_index_write) {
+void run_AddDeleteRepeatedly(bool perform_index_write, block_codec_t block_codec) {
     mock_file_opener_t file_opener;
     log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
-    log_serializer_t ser(log_serializer_t::dynamic_config_t(),
+    log_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.block_codec = block_codec;
+    log_serializer_t ser(dynamic_config,
                               &file_opener,
                               &get_global_perfmon_collection());
 
@@ -82,13 +87,450 @@ void run_AddDeleteRepeatedly(bool perform_index_write) {
 }
 
 TEST(SerializerTest, AddDeleteRepeatedly) {
-    run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, false), 4);
+    unittest::run_in_thread_pool(
+        std::bind(run_AddDeleteRepeatedly, false, block_codec_t::none), 4);
 }
 
 // This is a regression test for #1691.
 TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
-    run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
+    unittest::run_in_thread_pool(
+        std::bind(run_AddDeleteRepeatedly, true, block_codec_t::none), 4);
+}
+
+// Same as above, but the GC has to move compressed blocks around.
+TEST(SerializerTest, AddDeleteRepeatedlyCompressed) {
+    unittest::run_in_thread_pool(
+        std::bind(run_AddDeleteRepeatedly, true, block_codec_t::zlib), 4);
+}
+
+// Fills the block with data that compresses well if `compressible` is true, and
+// with data that doesn't compress at all otherwise.
+void fill_block(buf_ptr_t *buf, block_id_t block_id, bool compressible) {
+    char *data = buf->ser_buffer()->cache_data;
+    const uint32_t size = buf->block_size().value();
+    uint32_t state = 12345 + block_id;
+    for (uint32_t i = 0; i < size; ++i) {
+        if (compressible) {
+            data[i] = 'a' + (i / 64 + block_id) % 26;
+        } else {
+            state = state * 1103515245 + 12345;
+            data[i] = static_cast<char>(state >> 16);
+        }
+    }
 }
 
+void write_blocks_and_index(log_serializer_t *ser,
+                            file_account_t *account,
+                            const std::vector<block_id_t> &block_ids,
+                            std::vector<buf_ptr_t> *bufs) {
+    std::vector<buf_write_info_t> infos;
+    for (size_t i = 0; i < block_ids.size(); ++i) {
+        infos.push_back(buf_write_info_t((*bufs)[i].ser_buffer(),
+                                         (*bufs)[i].block_size(),
+                                         block_ids[i]));
+    }
+
+    struct : public iocallback_t, public cond_t {
+        void on_io_complete() {
+            pulse();
+        }
+    } cb;
+    std::vector<counted_t<standard_block_token_t> > tokens
+        = ser->block_writes(infos, account, &cb);
+    cb.wait();
+
+    std::vector<index_write_op_t> write_ops;
+    for (size_t i = 0; i < block_ids.size(); ++i) {
+        write_ops.push_back(index_write_op_t(block_ids[i], tokens[i],
+                                             repli_timestamp_t::distant_past));
+    }
+    new_mutex_in_line_t dummy_acq;
+    ser->index_write(&dummy_acq, []{ }, write_ops);
+}
+
+void check_blocks(log_serializer_t *ser,
+                  file_account_t *account,
+                  const std::vector<block_id_t> &block_ids,
+                  const std::vector<buf_ptr_t> &expected) {
+    for (size_t i = 0; i < block_ids.size(); ++i) {
+        counted_t<standard_block_token_t> token = ser->index_read(block_ids[i]);
+        ASSERT_TRUE(token.has());
+        ASSERT_EQ(expected[i].block_size(), token->block_size());
+        buf_ptr_t buf = ser->block_read(token, account);
+        ASSERT_EQ(expected[i].block_size(), buf.block_size());
+        EXPECT_EQ(block_ids[i], buf.ser_buffer()->ser_header.block_id);
+        EXPECT_EQ(0, memcmp(expected[i].cache_data(), buf.cache_data(),
+                            buf.block_size().value()));
+    }
+}
+
+TPTEST(SerializerTest, CompressedBlocks, 4) {
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, log_serializer_t::static_config_t());
+
+    const block_id_t num_blocks = 64;
+    std::vector<block_id_t> block_ids;
+    std::vector<buf_ptr_t> bufs;
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        block_ids.push_back(i);
+        buf_ptr_t buf = buf_ptr_t::alloc_zeroed(
+            log_serializer_t::static_config_t().max_block_size());
+        fill_block(&buf, i, i % 4 != 3);
+        bufs.push_back(std::move(buf));
+    }
+
+    {
+        log_serializer_t::dynamic_config_t dynamic_config;
+        dynamic_config.block_codec = block_codec_t::zlib;
+        log_serializer_t ser(dynamic_config, &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        write_blocks_and_index(&ser, account.get(), block_ids, &bufs);
+
+        // Compressible blocks take less space on disk, the others are stored as is.
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            counted_t<standard_block_token_t> token = ser.index_read(i);
+            ASSERT_TRUE(token.has());
+            if (i % 4 != 3) {
+                EXPECT_LT(token->disk_block_size().ser_value(),
+                          token->block_size().ser_value());
+            } else {
+                EXPECT_EQ(token->block_size(), token->disk_block_size());
+            }
+        }
+        check_blocks(&ser, account.get(), block_ids, bufs);
+    }
+
+    // Reopen the file with compression turned off.  The compressed blocks must still
+    // be readable after the LBA has been reconstructed, and new blocks are written
+    // uncompressed next to them.
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        check_blocks(&ser, account.get(), block_ids, bufs);
+
+        std::vector<block_id_t> overwritten_ids;
+        std::vector<buf_ptr_t> overwritten_bufs;
+        for (block_id_t i = 0; i < num_blocks; i += 2) {
+            overwritten_ids.push_back(i);
+            fill_block(&bufs[i], i + 1, true);
+            overwritten_bufs.push_back(buf_ptr_t::alloc_copy(bufs[i]));
+        }
+        write_blocks_and_index(&ser, account.get(), overwritten_ids, &overwritten_bufs);
+        for (block_id_t i = 0; i < num_blocks; i += 2) {
+            counted_t<standard_block_token_t> token = ser.index_read(i);
+            ASSERT_TRUE(token.has());
+            EXPECT_EQ(token->block_size(), token->disk_block_size());
+        }
+        check_blocks(&ser, account.get(), block_ids, bufs);
+    }
+}
+
+TPTEST(SerializerTest, ReopenReplaysLbaShards, 4) {
+    // With small extents, the index writes below fill more than one LBA extent per
+    // shard, all of which have to be replayed in order when the file is reopened.
+    log_serializer_t::static_config_t static_config;
+    static_config.extent_size_ = 16 * static_config.block_size_;
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, static_config);
+
+    const block_id_t num_blocks = 256;
+    const int num_rounds = 64;
+    std::vector<block_id_t> block_ids;
+    std::vector<buf_ptr_t> bufs;
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        block_ids.push_back(i);
+        buf_ptr_t buf = buf_ptr_t::alloc_zeroed(static_config.max_block_size());
+        fill_block(&buf, i, true);
+        bufs.push_back(std::move(buf));
+    }
+
+    // We don't want the serializer to write an LBA snapshot on shutdown, which we
+    // would load instead of replaying the LBA.
+    log_serializer_t::dynamic_config_t dynamic_config;
+    dynamic_config.lba_snapshot_interval_ms = -1;
+
+    repli_timestamp_t recency = repli_timestamp_t::distant_past;
+    {
+        log_serializer_t ser(dynamic_config, &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        write_blocks_and_index(&ser, account.get(), block_ids, &bufs);
+
+        for (int round = 0; round < num_rounds; ++round) {
+            recency = recency.next();
+            std::vector<index_write_op_t> write_ops;
+            for (block_id_t i = 0; i < num_blocks; ++i) {
+                write_ops.push_back(index_write_op_t(i, boost::none, recency));
+            }
+            new_mutex_in_line_t dummy_acq;
+            ser.index_write(&dummy_acq, []{ }, write_ops);
+        }
+
+        std::vector<index_write_op_t> delete_ops;
+        for (block_id_t i = 0; i < num_blocks; i += 5) {
+            delete_ops.push_back(index_write_op_t(i, counted_t<standard_block_token_t>()));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, delete_ops);
+    }
+
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        ASSERT_EQ(num_blocks, ser.end_block_id());
+
+        std::vector<block_id_t> live_ids;
+        std::vector<buf_ptr_t> live_bufs;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            if (i % 5 == 0) {
+                EXPECT_FALSE(ser.index_read(i).has());
+            } else {
+                live_ids.push_back(i);
+                live_bufs.push_back(buf_ptr_t::alloc_copy(bufs[i]));
+            }
+        }
+        check_blocks(&ser, account.get(), live_ids, live_bufs);
+
+        segmented_vector_t<repli_timestamp_t> recencies = ser.get_all_recencies(0, 1);
+        ASSERT_EQ(num_blocks, recencies.size());
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            if (i % 5 != 0) {
+                EXPECT_EQ(recency, recencies[i]);
+            }
+        }
+    }
+}
+
+void check_recencies(log_serializer_t *ser, block_id_t num_blocks,
+                     repli_timestamp_t recency) {
+    ASSERT_EQ(num_blocks, ser->end_block_id());
+    segmented_vector_t<repli_timestamp_t> recencies = ser->get_all_recencies(0, 1);
+    ASSERT_EQ(num_blocks, recencies.size());
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        EXPECT_EQ(recency, recencies[i]);
+    }
+}
+
+TPTEST(SerializerTest, ReopenFromLbaSnapshot, 4) {
+    // With small extents, every shard of the snapshot spans several extents.
+    log_serializer_t::static_config_t static_config;
+    static_config.extent_size_ = 16 * static_config.block_size_;
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, static_config);
+
+    // Most of the blocks only have a recency and no data.
+    const block_id_t num_data_blocks = 64;
+    const block_id_t num_blocks = 20000;
+    std::vector<block_id_t> block_ids;
+    std::vector<buf_ptr_t> bufs;
+    for (block_id_t i = 0; i < num_data_blocks; ++i) {
+        block_ids.push_back(i);
+        buf_ptr_t buf = buf_ptr_t::alloc_zeroed(static_config.max_block_size());
+        fill_block(&buf, i, true);
+        bufs.push_back(std::move(buf));
+    }
+
+    const repli_timestamp_t recency = repli_timestamp_t::distant_past.next();
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        write_blocks_and_index(&ser, account.get(), block_ids, &bufs);
+
+        std::vector<index_write_op_t> write_ops;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            write_ops.push_back(index_write_op_t(i, boost::none, recency));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, write_ops);
+    }
+
+    // The serializer wrote a snapshot when it shut down, which we load now.  We then
+    // delete some blocks, so the next shutdown replaces the snapshot.
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        check_blocks(&ser, account.get(), block_ids, bufs);
+        check_recencies(&ser, num_blocks, recency);
+
+        std::vector<index_write_op_t> delete_ops;
+        for (block_id_t i = 0; i < num_data_blocks; i += 2) {
+            delete_ops.push_back(index_write_op_t(i, counted_t<standard_block_token_t>()));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, delete_ops);
+    }
+
+    std::vector<block_id_t> live_ids;
+    std::vector<buf_ptr_t> live_bufs;
+    for (block_id_t i = 1; i < num_data_blocks; i += 2) {
+        live_ids.push_back(i);
+        live_bufs.push_back(buf_ptr_t::alloc_copy(bufs[i]));
+    }
+
+    // This time, the serializer also writes snapshots in the background while we
+    // keep changing the index.  Most of them have to give up.
+    {
+        log_serializer_t::dynamic_config_t dynamic_config;
+        dynamic_config.lba_snapshot_interval_ms = 1;
+        log_serializer_t ser(dynamic_config, &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (block_id_t i = 0; i < num_data_blocks; i += 2) {
+            EXPECT_FALSE(ser.index_read(i).has());
+        }
+        check_blocks(&ser, account.get(), live_ids, live_bufs);
+        check_recencies(&ser, num_blocks, recency);
+
+        for (int round = 0; round < 20; ++round) {
+            std::vector<index_write_op_t> write_ops;
+            for (block_id_t i = round; i < num_blocks; i += 20) {
+                write_ops.push_back(index_write_op_t(i, boost::none, recency));
+            }
+            new_mutex_in_line_t dummy_acq;
+            ser.index_write(&dummy_acq, []{ }, write_ops);
+            nap(round % 4);
+        }
+        nap(50);
+    }
+
+    {
+        log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                             &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        for (block_id_t i = 0; i < num_data_blocks; i += 2) {
+            EXPECT_FALSE(ser.index_read(i).has());
+        }
+        check_blocks(&ser, account.get(), live_ids, live_bufs);
+        check_recencies(&ser, num_blocks, recency);
+    }
+}
+
+// The GC has to pick between an old extent and a younger one that has more garbage.
+// We run the GC by hand, so that it doesn't start on its own while we set this up.
+TPTEST(SerializerTest, GcPrefersOldExtents, 4) {
+    log_serializer_t::static_config_t static_config;
+    static_config.extent_size_ = 16 * static_config.block_size_;
+    mock_file_opener_t file_opener;
+    log_serializer_t::create(&file_opener, static_config);
+
+    log_serializer_t ser(log_serializer_t::dynamic_config_t(), &file_opener,
+                         &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    data_block_manager_t *dbm = ser.data_block_manager;
+    dbm->disable_gc();
+
+    auto extent_of = [&](block_id_t block_id) -> int64_t {
+        counted_t<standard_block_token_t> token = ser.index_read(block_id);
+        guarantee(token.has());
+        return static_config.extent_index(token->offset());
+    };
+
+    auto make_buf = [&](block_id_t block_id) -> buf_ptr_t {
+        buf_ptr_t buf = buf_ptr_t::alloc_zeroed(static_config.max_block_size());
+        fill_block(&buf, block_id, false);
+        return buf;
+    };
+
+    block_id_t next_block_id = 0;
+    auto write_block = [&]() -> block_id_t {
+        std::vector<block_id_t> block_ids(1, next_block_id);
+        std::vector<buf_ptr_t> bufs;
+        bufs.push_back(make_buf(next_block_id));
+        write_blocks_and_index(&ser, account.get(), block_ids, &bufs);
+        return next_block_id++;
+    };
+
+    // Keeps writing blocks into the extent of `*first` until one spills over into
+    // the next extent.  Returns the blocks of the full extent and sets `*first` to
+    // the one that spilled over.
+    auto fill_extent = [&](block_id_t *first) -> std::vector<block_id_t> {
+        std::vector<block_id_t> block_ids(1, *first);
+        const int64_t extent = extent_of(*first);
+        for (;;) {
+            const block_id_t block_id = write_block();
+            if (extent_of(block_id) != extent) {
+                *first = block_id;
+                return block_ids;
+            }
+            block_ids.push_back(block_id);
+        }
+    };
+
+    auto delete_blocks = [&](const std::vector<block_id_t> &block_ids) {
+        std::vector<index_write_op_t> delete_ops;
+        for (block_id_t block_id : block_ids) {
+            delete_ops.push_back(
+                index_write_op_t(block_id, counted_t<standard_block_token_t>()));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, []{ }, delete_ops);
+    };
+
+    // An extent's age counts from when its first block was written.
+    block_id_t user_block = write_block();
+    nap(1000);
+    const std::vector<block_id_t> old_blocks = fill_extent(&user_block);
+    const std::vector<block_id_t> young_blocks = fill_extent(&user_block);
+    ASSERT_EQ(16u, old_blocks.size());
+    ASSERT_EQ(16u, young_blocks.size());
+    const int64_t old_extent = extent_of(old_blocks[0]);
+    const int64_t young_extent = extent_of(young_blocks[0]);
+    const int64_t user_extent = extent_of(user_block);
+
+    // 6/16 of the old extent and half of the young one become garbage.
+    const size_t old_garbage = 6;
+    const size_t young_garbage = 8;
+    delete_blocks(std::vector<block_id_t>(old_blocks.begin(),
+                                          old_blocks.begin() + old_garbage));
+    delete_blocks(std::vector<block_id_t>(young_blocks.begin(),
+                                          young_blocks.begin() + young_garbage));
+
+    // Wait for the young extent to stop being young, so both are GC candidates.
+    nap(100);
+    dbm->mark_unyoung_entries();
+    ASSERT_EQ(2u, dbm->gc_pq.size());
+
+    // The scores still date from when the serializer started, when neither extent
+    // had any age, so the one with more garbage comes first.
+    EXPECT_EQ(dbm->entries.get(young_extent), dbm->gc_pq.peak());
+
+    // Once its age counts, the old extent is the better deal, about
+    // 0.375 * (1 + 1.1) / (2 - 0.375) against 0.5 * (1 + 0.1) / (2 - 0.5).
+    // Backdating the last refresh makes the GC recompute the scores first.
+    dbm->gc_score_time = 0;
+    {
+        data_block_manager_t::gc_state_t gc_state;
+        dbm->active_gcs.push_back(&gc_state);
+        dbm->gc_one_extent(&gc_state);
+        dbm->active_gcs.remove(&gc_state);
+    }
+
+    EXPECT_TRUE(dbm->entries.get(old_extent) == nullptr);
+    for (size_t i = young_garbage; i < young_blocks.size(); ++i) {
+        EXPECT_EQ(young_extent, extent_of(young_blocks[i]));
+    }
+
+    // The relocated blocks went into an extent of their own, not into the one that
+    // takes the user's writes, and the user's writes keep going where they did.
+    const int64_t gc_extent = extent_of(old_blocks[old_garbage]);
+    EXPECT_NE(old_extent, gc_extent);
+    EXPECT_NE(young_extent, gc_extent);
+    EXPECT_NE(user_extent, gc_extent);
+    std::vector<block_id_t> live_ids;
+    std::vector<buf_ptr_t> live_bufs;
+    for (size_t i = old_garbage; i < old_blocks.size(); ++i) {
+        EXPECT_EQ(gc_extent, extent_of(old_blocks[i]));
+        live_ids.push_back(old_blocks[i]);
+        live_bufs.push_back(make_buf(old_blocks[i]));
+    }
+    check_blocks(&ser, account.get(), live_ids, live_bufs);
+    EXPECT_EQ(user_extent, extent_of(write_block()));
+}
 
 }  // namespace unittest
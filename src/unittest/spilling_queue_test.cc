@@ -0,0 +1,146 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/queue/spilling_queue.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const char *const SPILL_TEST_PATH = "test_spilling_queue";
+
+// Every value takes 100 bytes, so a queue spills once it holds more than 10.
+const size_t SPILL_TEST_BUDGET = 1000;
+
+std::string spill_test_value(int i) {
+    std::string value = strprintf("%d", i);
+    value.resize(100, ' ');
+    return value;
+}
+
+size_t spill_test_size(const std::string &value) {
+    return value.size();
+}
+
+// The file lives on another thread, so that moving values to and from disk blocks
+// and the tests can get in between.
+counted_t<spill_file_t> make_spill_file(io_backender_t *io_backender) {
+    on_thread_t th((threadnum_t(1)));
+    return make_counted<spill_file_t>(
+        io_backender,
+        manual_serializer_filepath(
+            SPILL_TEST_PATH, std::string(SPILL_TEST_PATH) + ".create"));
+}
+
+void push_values(spilling_queue_t<std::string> *queue, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        queue->push(spill_test_value(i));
+    }
+}
+
+void pop_values(spilling_queue_t<std::string> *queue, int begin, int end) {
+    ASSERT_EQ(static_cast<size_t>(end - begin), queue->size());
+    for (int i = begin; i < end; ++i) {
+        queue->load();
+        ASSERT_NE(0u, queue->available());
+        ASSERT_EQ(spill_test_value(i), queue->pop());
+        ASSERT_EQ(static_cast<size_t>(end - i - 1), queue->size());
+    }
+}
+
+// Checks that the queue is empty and its memory accounting is back to zero, so that
+// it holds a full budget without spilling.
+void check_drained(spilling_queue_t<std::string> *queue) {
+    ASSERT_EQ(0u, queue->size());
+    push_values(queue, 0, 10);
+    coro_t::yield();
+    EXPECT_EQ(10u, queue->available());
+    pop_values(queue, 0, 10);
+}
+
+TPTEST(SpillingQueue, SpillAndLoad, 2) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    spilling_queue_t<std::string> queue(
+        SPILL_TEST_BUDGET, &spill_test_size, make_spill_file(&io_backender));
+
+    push_values(&queue, 0, 100);
+    // Let the spilling coroutine start moving values to disk.
+    coro_t::yield();
+    EXPECT_EQ(100u, queue.size());
+    EXPECT_EQ(0u, queue.available());
+
+    pop_values(&queue, 0, 100);
+    check_drained(&queue);
+}
+
+TPTEST(SpillingQueue, ClearWhileSpilling, 2) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    spilling_queue_t<std::string> queue(
+        SPILL_TEST_BUDGET, &spill_test_size, make_spill_file(&io_backender));
+
+    push_values(&queue, 0, 20);
+    coro_t::yield();
+    // Some values are on their way to disk, so none of them can be popped.
+    EXPECT_EQ(20u, queue.size());
+    EXPECT_EQ(0u, queue.available());
+
+    queue.clear();
+    EXPECT_EQ(0u, queue.size());
+
+    // The values that were on their way to disk get dropped when they're loaded,
+    // ahead of these, which follow them to disk once the first batch gets there.
+    push_values(&queue, 100, 130);
+    EXPECT_EQ(30u, queue.available());
+    while (queue.available() != 0) {
+        nap(1);
+    }
+    pop_values(&queue, 100, 130);
+    check_drained(&queue);
+}
+
+TPTEST(SpillingQueue, ClearWithValuesOnDisk, 2) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    spilling_queue_t<std::string> queue(
+        SPILL_TEST_BUDGET, &spill_test_size, make_spill_file(&io_backender));
+
+    push_values(&queue, 0, 100);
+    coro_t::yield();
+    // Waits for the spill, and loads some of the values back.
+    queue.load();
+    EXPECT_NE(0u, queue.available());
+    EXPECT_LT(queue.available(), queue.size());
+    ASSERT_EQ(spill_test_value(0), queue.pop());
+
+    queue.clear();
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_EQ(0u, queue.available());
+
+    push_values(&queue, 100, 150);
+    coro_t::yield();
+    pop_values(&queue, 100, 150);
+    check_drained(&queue);
+}
+
+TPTEST(SpillingQueue, SharedFile, 2) {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    counted_t<spill_file_t> file = make_spill_file(&io_backender);
+    spilling_queue_t<std::string> queue(SPILL_TEST_BUDGET, &spill_test_size, file);
+    {
+        spilling_queue_t<std::string> other(SPILL_TEST_BUDGET, &spill_test_size, file);
+        for (int i = 0; i < 50; ++i) {
+            queue.push(spill_test_value(i));
+            other.push(spill_test_value(1000 + i));
+            coro_t::yield();
+        }
+        EXPECT_LT(other.available(), other.size());
+        // `other` is destroyed with values on disk.
+    }
+    push_values(&queue, 50, 100);
+    coro_t::yield();
+    pop_values(&queue, 0, 100);
+    check_drained(&queue);
+}
+
+}  // namespace unittest